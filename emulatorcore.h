@@ -25,6 +25,19 @@ public:
 
   virtual bool Init(ViceOptions *options) = 0;
   virtual void LaunchEmulator(char *timing_option) = 0;
+
+  // Called on the emulation core once the helper cores finished their
+  // init work.
+  virtual void HelperCoresComplete() {}
+
+  // Called on the emulation core once a frame from circle_yield. Work
+  // that writes to the SD card in the background is done here a piece
+  // at a time.
+  virtual void BackgroundStep() {}
+
+  // Called on the emulation core when a machine switch changed the
+  // timing in place. Only after HelperCoresComplete().
+  virtual void SetCyclesPerSecond(int cyclesPerSecond) {}
 };
 
 #endif
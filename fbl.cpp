@@ -28,6 +28,7 @@
 
 #include "crt_pi_idx.h"
 #include "crt_pi_rgb.h"
+#include "third_party/common/blit.h"
 
 #ifndef ALIGN_UP
 #define ALIGN_UP(x,y)  ((x + (y)-1) & ~((y)-1))
@@ -87,6 +88,7 @@ static const char sNoInt[] = "scaling_kernel 0 0 0 0 0 0 0 0 1 1 1 1 255 255 255
 static char config_scaling_kernel[1024];
 
 bool FrameBufferLayer::initialized_ = false;
+bool FrameBufferLayer::allow_cpu_palette_ = false;
 DISPMANX_DISPLAY_HANDLE_T FrameBufferLayer::dispman_display_;
 EGLDisplay FrameBufferLayer::egl_display_;
 EGLContext FrameBufferLayer::egl_context_;
@@ -124,16 +126,16 @@ FrameBufferLayer::FrameBufferLayer() :
         display_width_(0), display_height_(0),
         src_x_(0), src_y_(0), src_w_(0), src_h_(0),
         dst_x_(0), dst_y_(0), dst_w_(0), dst_h_(0),
-        showing_(false), allocated_(false),
+        showing_(false), allocated_(false), track_dirty_(false),
         mode_(VC_IMAGE_8BPP), bytes_per_pixel_(1), uses_shader_(false),
         shader_init_(false),
         vshader_(-1), fshader_(-1), shader_program_(-1),
         vbo_(-1),
         attr_vertex_(-1), attr_texcoord_(-1),
         texture_sampler_(-1), palette_sampler_(-1),
-        tex_(-1), pal_(-1), mvp_(0),
+        tex_(-1), pal_(-1), cpu_palette_(false), tex_pixels_(nullptr),
+        mvp_(0),
         input_size_(0), output_size_(0), texture_size_(0), texel_size_(0),
-        need_cpu_crop_(true), cropped_pixels_(0),
         curvature_(false) {
   alpha_.flags = DISPMANX_FLAGS_ALPHA_FROM_SOURCE;
   alpha_.opacity = 255;
@@ -141,6 +143,12 @@ FrameBufferLayer::FrameBufferLayer() :
 
   memcpy (pal_565_, pal_565, sizeof(pal_565));
   memcpy (pal_argb_, pal_argb, sizeof(pal_argb));
+  pal_used_ = 16;
+
+  for (int i = 0; i < 3; i++) {
+     dirty_y0_[i] = 0;
+     dirty_y1_[i] = 0;
+  }
 }
 
 FrameBufferLayer::~FrameBufferLayer() {
@@ -172,8 +180,8 @@ void FrameBufferLayer::CreateTexture() {
   float inputSize[2] = { (float) src_w_, (float)src_h_ };
   float outputSize[2] = { (float) dst_w_, (float)dst_h_ };
 
-  int tx = need_cpu_crop_ ? src_w_ : fb_pitch_ / bytes_per_pixel_;
-  int ty = need_cpu_crop_ ? src_h_ : fb_height_;
+  int tx = TextureWidth();
+  int ty = src_h_;
   float textureSize[2] = { (float) tx, (float) ty };
   float texelSize[2] = { 1.0f / (float) tx, 1.0f / (float) ty };
 
@@ -182,21 +190,39 @@ void FrameBufferLayer::CreateTexture() {
   glUniform2fv(texture_size_, 1, textureSize);
   glUniform2fv(texel_size_, 1, texelSize);
 
+  if (cpu_palette_) {
+     free(tex_pixels_);
+     tex_pixels_ = (uint16_t*) malloc(tx * ty * sizeof(uint16_t));
+  }
+
   glBindTexture(GL_TEXTURE_2D,tex_);
-  if (mode_ == VC_IMAGE_8BPP) {
-     glTexImage2D(GL_TEXTURE_2D,0,GL_LUMINANCE,
-        need_cpu_crop_ ? src_w_ : fb_pitch_ / bytes_per_pixel_,
-        need_cpu_crop_ ? src_h_ : fb_height_,
+  if (IndexedTexture()) {
+     glTexImage2D(GL_TEXTURE_2D,0,GL_LUMINANCE, tx, ty,
         0,GL_LUMINANCE,GL_UNSIGNED_BYTE, 0);
   } else {
-     glTexImage2D(GL_TEXTURE_2D,0,GL_RGB,
-        need_cpu_crop_ ? src_w_ : fb_pitch_ / bytes_per_pixel_,
-        need_cpu_crop_ ? src_h_ : fb_height_,
+     glTexImage2D(GL_TEXTURE_2D,0,GL_RGB, tx, ty,
         0,GL_RGB,GL_UNSIGNED_SHORT_5_6_5, 0);
   }
 
   glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
   glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+  // New texture has no content yet.
+  dirty_y0_[DIRTY_GL] = 0;
+  dirty_y1_[DIRTY_GL] = fb_height_;
+}
+
+bool FrameBufferLayer::IndexedTexture() {
+  return mode_ == VC_IMAGE_8BPP && !cpu_palette_;
+}
+
+int FrameBufferLayer::TextureWidth() {
+  if (cpu_palette_) {
+     // Rows are cropped to the src region. Keep them 4 byte aligned
+     // for the default unpack alignment.
+     return ALIGN_UP(src_w_, 2);
+  }
+  return fb_pitch_ / bytes_per_pixel_;
 }
 
 void FrameBufferLayer::ReCreateTexture() {
@@ -294,13 +320,26 @@ void FrameBufferLayer::ShaderInit() {
       return;
   }
 
+  // The crt-pi shader looks up every palette index it samples in a
+  // second texture. With NEON, the changed rows can instead be expanded
+  // to RGB565 while uploading them, as long as the palette fits in the
+  // kernel's registers (every machine but the Plus/4). Which is faster
+  // depends on the model and shader options, so the GPU lookup stays
+  // the default and the CPU expansion must be asked for.
+#ifdef BLIT_NEON
+  cpu_palette_ = allow_cpu_palette_ && mode_ == VC_IMAGE_8BPP &&
+                     !transparency_ && pal_used_ <= BLIT_NEON_PALETTE;
+#else
+  cpu_palette_ = false;
+#endif
+
   const char *shader_txt;
   int len;
 
 #ifdef LOAD_SHADER_FROM_FILE
   if (!file_shader_txt_) {
      FILE *f;
-     if (mode_ == VC_IMAGE_8BPP) {
+     if (IndexedTexture()) {
         // Use indexed texture version
         f = fopen("crt-pi-idx.gls", "r");
      } else {
@@ -319,7 +358,7 @@ void FrameBufferLayer::ShaderInit() {
   shader_txt = file_shader_txt_;
 #else
   // Use statically linked shader txt.
-  if (mode_ == VC_IMAGE_8BPP) {
+  if (IndexedTexture()) {
      shader_txt = idx_shader;
   } else {
      shader_txt = rgb_shader;
@@ -395,7 +434,7 @@ void FrameBufferLayer::ShaderInit() {
   attr_vertex_ = glGetAttribLocation(shader_program_, "VertexCoord");
   attr_texcoord_ = glGetAttribLocation(shader_program_, "TexCoord");
   texture_sampler_ = glGetUniformLocation(shader_program_, "Texture");
-  if (mode_ == VC_IMAGE_8BPP) {
+  if (IndexedTexture()) {
      palette_sampler_ = glGetUniformLocation(shader_program_, "Palette");
   }
   input_size_ = glGetUniformLocation (shader_program_, "InputSize");
@@ -414,7 +453,7 @@ void FrameBufferLayer::ShaderInit() {
   glGenTextures(1, &tex_);
   CreateTexture();
 
-  if (mode_ == VC_IMAGE_8BPP) {
+  if (IndexedTexture()) {
      glGenTextures(1, &pal_);
      glBindTexture(GL_TEXTURE_2D,pal_);
      glTexImage2D(GL_TEXTURE_2D,0,GL_RGB,256,1,0,GL_RGB,GL_UNSIGNED_SHORT_5_6_5, pal_565_);
@@ -441,6 +480,8 @@ void FrameBufferLayer::ShaderDestroy() {
     glDeleteProgram(shader_program_);
     glDeleteShader(vshader_);
     glDeleteShader(fshader_);
+    free(tex_pixels_);
+    tex_pixels_ = nullptr;
     shader_init_ = false;
   }
 }
@@ -470,38 +511,27 @@ void FrameBufferLayer::ShaderUpdate() {
   tex_coords_[6] = (float)(dst_x_ + dst_w_) / (float)display_width_;
   tex_coords_[7] = (float)(dst_y_ + dst_h_) / (float)display_height_;
 
-  if (!need_cpu_crop_) {
-    // Now futz with the texture coordinates (for triangle strip)
-    // to crop out only the portion of the frame buffer we want to see.
-    // When curvature is requested, we can't do this because the
-    // shader seems to want the texture to be only visible pixels
-    // for its curvature calculation.
+  // The texture starts at the top left of the src region (see
+  // RenderGL) so only the width needs to be cropped with texture
+  // coordinates. The columns to the right are never visible. The
+  // curvature shader handles this through InputSize / TextureSize.
+  float tex_right = (float)src_w_ / (float)TextureWidth();
 
-    // Top left
-    tex_coords_[8] = (float)src_x_ / (float)(fb_pitch_ / bytes_per_pixel_);
-    tex_coords_[9] = (float)(src_y_ + src_h_) / (float)fb_height_;
+  // Top left
+  tex_coords_[8] = 0.0f;
+  tex_coords_[9] = 1.0f;
 
-    // Top right
-    tex_coords_[10] = (float)(src_x_ + src_w_) / (float)(fb_pitch_ / bytes_per_pixel_);
-    tex_coords_[11] = (float)(src_y_ + src_h_) / (float)fb_height_;
+  // Top right
+  tex_coords_[10] = tex_right;
+  tex_coords_[11] = 1.0f;
 
-    // Bottom left
-    tex_coords_[12] = (float)src_x_ / (float)(fb_pitch_ / bytes_per_pixel_);
-    tex_coords_[13] = (float)src_y_ / (float)fb_height_;
+  // Bottom left
+  tex_coords_[12] = 0.0f;
+  tex_coords_[13] = 0.0f;
 
-    // Bottom right
-    tex_coords_[14] = (float)(src_x_+src_w_) / (float)(fb_pitch_ / bytes_per_pixel_);
-    tex_coords_[15] = (float)src_y_ / (float)fb_height_;
-  } else {
-    tex_coords_[8] = 0.0f;
-    tex_coords_[9] = 1.0f;
-    tex_coords_[10] = 1.0f;
-    tex_coords_[11] = 1.0f;
-    tex_coords_[12] = 0.0f;
-    tex_coords_[13] = 0.0f;
-    tex_coords_[14] = 1.0f;
-    tex_coords_[15] = 0.0f;
-  }
+  // Bottom right
+  tex_coords_[14] = tex_right;
+  tex_coords_[15] = 0.0f;
 
   glBindBuffer(GL_ARRAY_BUFFER, vbo_);
   glBufferData(GL_ARRAY_BUFFER, sizeof (GLfloat) * 16, tex_coords_, GL_STATIC_DRAW);
@@ -541,7 +571,6 @@ void FrameBufferLayer::SetShaderParams(
      ShaderDestroy();
   }
   curvature_ = curvature;
-  need_cpu_crop_ = curvature;
   curvature_x_ = curvature_x;
   curvature_y_ = curvature_y;
   mask_ = mask;
@@ -623,8 +652,11 @@ int FrameBufferLayer::Allocate(int pixelmode, uint8_t **pixels,
   display_height_ = dispman_info.height;
 
   if (pixels) {
-     pixels_ = (uint8_t*) malloc(fb_pitch_ * height);
-     cropped_pixels_ = (uint8_t*) malloc(fb_pitch_ * fb_height_);
+     // One extra line because the shader texture is uploaded starting
+     // at src_x_ with a full pitch per row. The last row can read
+     // up to src_x_ pixels past the end of the frame.
+     pixels_ = (uint8_t*) malloc(fb_pitch_ * (height + 1));
+     memset(pixels_ + fb_pitch_ * height, 0, fb_pitch_);
      *pixels = pixels_;
   }
 
@@ -643,6 +675,11 @@ int FrameBufferLayer::Allocate(int pixelmode, uint8_t **pixels,
 
   vc_dispmanx_rect_set(&copy_dst_rect_, 0, 0, width, height);
 
+  // New resources have no content yet. The owner must opt in to
+  // dirty tracking again.
+  track_dirty_ = false;
+  MarkAllDirty();
+
   if (pixels) {
      // Don't clobber these on realloc.
      dst_x_ = 0;
@@ -705,13 +742,60 @@ int FrameBufferLayer::ReAllocate(bool shader_enable) {
   if (mode_ == VC_IMAGE_RGB565) pixelmode = 1;
 
   // Reallocate with same params.
-  return Allocate(pixelmode, nullptr, fb_width_, fb_height_, nullptr);
+  bool track_dirty = track_dirty_;
+  int ret = Allocate(pixelmode, nullptr, fb_width_, fb_height_, nullptr);
+  track_dirty_ = track_dirty;
+  return ret;
 }
 
 void FrameBufferLayer::Clear() {
   assert (allocated_);
 
   memset(pixels_, 0, fb_height_ * fb_pitch_);
+  MarkAllDirty();
+}
+
+void FrameBufferLayer::SetDirtyTracking(bool enable) {
+  track_dirty_ = enable;
+}
+
+void FrameBufferLayer::MarkDirty(int y0, int y1) {
+  if (y0 < 0) y0 = 0;
+  if (y1 > fb_height_) y1 = fb_height_;
+  if (y0 >= y1) return;
+
+  for (int i = 0; i < 3; i++) {
+     if (dirty_y0_[i] >= dirty_y1_[i]) {
+        dirty_y0_[i] = y0;
+        dirty_y1_[i] = y1;
+     } else {
+        if (y0 < dirty_y0_[i]) dirty_y0_[i] = y0;
+        if (y1 > dirty_y1_[i]) dirty_y1_[i] = y1;
+     }
+  }
+}
+
+void FrameBufferLayer::MarkAllDirty() {
+  for (int i = 0; i < 3; i++) {
+     dirty_y0_[i] = 0;
+     dirty_y1_[i] = fb_height_;
+  }
+}
+
+// Returns the rows that must be written to the given destination
+// and clears its pending range. Returns false if there is nothing
+// to write.
+bool FrameBufferLayer::TakeDirty(int dst, int *y0, int *y1) {
+  if (!track_dirty_) {
+     *y0 = 0;
+     *y1 = fb_height_;
+  } else {
+     *y0 = dirty_y0_[dst];
+     *y1 = dirty_y1_[dst];
+  }
+  dirty_y0_[dst] = 0;
+  dirty_y1_[dst] = 0;
+  return *y0 < *y1;
 }
 
 // When keepPixels is true, don't clobber any dimensions or delete
@@ -738,7 +822,6 @@ void FrameBufferLayer::FreeInternal(bool keepPixels) {
      fb_height_ = 0;
      fb_pitch_ = 0;
      free(pixels_);
-     free(cropped_pixels_);
   }
 
   ret = vc_dispmanx_resource_delete(dispman_resource_[0]);
@@ -953,11 +1036,27 @@ void FrameBufferLayer::FrameReady(int to_offscreen) {
   // Copy data into either the offscreen resource (if swap) or the
   // on screen resource (if !swap).
   if (!uses_shader_) {
-      vc_dispmanx_resource_write_data(dispman_resource_[rnum],
-                                      mode_,
-                                      fb_pitch_,
-                                      pixels_,
-                                      &copy_dst_rect_);
+      int y0, y1;
+      if (!TakeDirty(rnum, &y0, &y1)) {
+         // Resource already holds this frame.
+         return;
+      }
+      if (y0 == 0 && y1 == fb_height_) {
+         vc_dispmanx_resource_write_data(dispman_resource_[rnum],
+                                         mode_,
+                                         fb_pitch_,
+                                         pixels_,
+                                         &copy_dst_rect_);
+      } else {
+         // The source address must point at the first row of the rect.
+         VC_RECT_T rect;
+         vc_dispmanx_rect_set(&rect, 0, y0, fb_width_, y1 - y0);
+         vc_dispmanx_resource_write_data(dispman_resource_[rnum],
+                                         mode_,
+                                         fb_pitch_,
+                                         pixels_ + y0 * fb_pitch_,
+                                         &rect);
+      }
   } else {
       RenderGL();
   }
@@ -984,41 +1083,62 @@ void FrameBufferLayer::SwapGL(bool sync) {
 
 void FrameBufferLayer::RenderGL() {
     // Our pixels_ framebuffer includes a lot of black border area around
-    // the visible pixels we want to see. When shader curvature is needed,
-    // we need to provide a texture with only the pixels we actually want
-    // to see, otherwise the curvature gets applied incorrectly to the
-    // larger area. So we crop on the CPU rather than by texture coords.
-    if (need_cpu_crop_) {
-       int wid = ALIGN_UP(src_w_ * bytes_per_pixel_, 4);
-       uint8_t *src_col = pixels_ + src_x_ * bytes_per_pixel_;
-       for (int yy=src_y_; yy < src_y_ + src_h_;yy++) {
-          memcpy (cropped_pixels_ + (yy - src_y_) * wid,
-                  src_col + yy * fb_pitch_, wid);
-       }
-    }
+    // the visible pixels we want to see. The curvature shader needs the
+    // visible pixels to start at the texture origin, otherwise the
+    // curvature gets applied incorrectly to the larger area. Rather than
+    // cropping on the CPU, the texture is uploaded straight from pixels_
+    // starting at the top left of the src region. Rows keep the frame
+    // buffer pitch so each texture row is the visible pixels followed by
+    // border (and the start of the next line) that is never sampled.
+    //
+    // When the palette is expanded on the CPU, the src region is
+    // cropped into tex_pixels_ instead.
+    //
+    // Only the dirty rows within the src region are uploaded. The
+    // texture keeps the rest from previous frames.
+    int y0, y1;
+    TakeDirty(DIRTY_GL, &y0, &y1);
+    if (y0 < src_y_) y0 = src_y_;
+    if (y1 > src_y_ + src_h_) y1 = src_y_ + src_h_;
 
     glBindTexture(GL_TEXTURE_2D,tex_);
 
-    if (mode_ == VC_IMAGE_8BPP) {
+    if (y0 >= y1) {
+        // Nothing changed, just draw again.
+    } else if (cpu_palette_) {
+        int tx = TextureWidth();
+        blit_crop_expand_565(tex_pixels_, tx,
+                             pixels_ + y0 * fb_pitch_ + src_x_, fb_pitch_,
+                             pal_565_, src_w_, y1 - y0);
         glTexSubImage2D(GL_TEXTURE_2D,
         0,
         0,
+        y0 - src_y_,
+        tx,
+        y1 - y0,
+        GL_RGB,
+        GL_UNSIGNED_SHORT_5_6_5,
+        tex_pixels_);
+    } else if (mode_ == VC_IMAGE_8BPP) {
+        glTexSubImage2D(GL_TEXTURE_2D,
+        0,
         0,
-        need_cpu_crop_ ? src_w_ : fb_pitch_ / bytes_per_pixel_,
-        need_cpu_crop_ ? src_h_ : fb_height_,
+        y0 - src_y_,
+        fb_pitch_ / bytes_per_pixel_,
+        y1 - y0,
         GL_LUMINANCE,
         GL_UNSIGNED_BYTE,
-        need_cpu_crop_ ? cropped_pixels_ : pixels_);
+        pixels_ + y0 * fb_pitch_ + src_x_ * bytes_per_pixel_);
     } else {
         glTexSubImage2D(GL_TEXTURE_2D,
         0,
         0,
-        0,
-        need_cpu_crop_ ? src_w_ : fb_pitch_ / bytes_per_pixel_,
-        need_cpu_crop_ ? src_h_ : fb_height_,
+        y0 - src_y_,
+        fb_pitch_ / bytes_per_pixel_,
+        y1 - y0,
         GL_RGB,
         GL_UNSIGNED_SHORT_5_6_5,
-        need_cpu_crop_ ? cropped_pixels_ : pixels_);
+        pixels_ + y0 * fb_pitch_ + src_x_ * bytes_per_pixel_);
     }
 
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
@@ -1029,7 +1149,7 @@ void FrameBufferLayer::RenderGL() {
     glBindTexture(GL_TEXTURE_2D, tex_);
     glUniform1i(texture_sampler_, 0);
 
-    if (mode_ == VC_IMAGE_8BPP) {
+    if (IndexedTexture()) {
        glActiveTexture(GL_TEXTURE0 + 1);
        glBindTexture(GL_TEXTURE_2D, pal_);
        glUniform1i(palette_sampler_, 1);
@@ -1071,6 +1191,9 @@ void FrameBufferLayer::SetPalette(uint8_t index, uint16_t rgb565) {
   assert(!transparency_);
   assert (mode_ == VC_IMAGE_8BPP);
   pal_565_[index] = rgb565;
+  if (index >= pal_used_) {
+     pal_used_ = index + 1;
+  }
 }
 
 void FrameBufferLayer::SetPalette(uint8_t index, uint32_t argb) {
@@ -1102,8 +1225,14 @@ void FrameBufferLayer::UpdatePalette() {
 	  // Not supported yet.
 	  assert(false);
      } else {
-	  glBindTexture(GL_TEXTURE_2D,pal_);
-	  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 256, 1, GL_RGB, GL_UNSIGNED_SHORT_5_6_5, pal_565_);
+	  if (cpu_palette_) {
+	     // Every row must be expanded again.
+	     dirty_y0_[DIRTY_GL] = 0;
+	     dirty_y1_[DIRTY_GL] = fb_height_;
+	  } else {
+	     glBindTexture(GL_TEXTURE_2D,pal_);
+	     glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 256, 1, GL_RGB, GL_UNSIGNED_SHORT_5_6_5, pal_565_);
+	  }
 	  RenderGL();
           SwapResources(false, this, nullptr);
      }
@@ -1138,8 +1267,9 @@ void FrameBufferLayer::SetSrcRect(int x, int y, int w, int h) {
   src_w_ = w;
   src_h_ = h;
 
-  if (has_changed && need_cpu_crop_) {
-      // When using cpu crop, we have to resize our texture.
+  if (has_changed) {
+      // The texture covers only the src region so it must be resized
+      // and uploaded again.
       ReCreateTexture();
   }
 }
@@ -1193,6 +1323,10 @@ void FrameBufferLayer::GetDimensions(int *display_w, int *display_h,
   *dst_h = dst_h_;
 }
 
+void FrameBufferLayer::SetCpuPalette(bool enable) {
+  allow_cpu_palette_ = enable;
+}
+
 void FrameBufferLayer::SetInterpolation(int enable) {
   if (enable) {
      bcm_set_sclker(config_scaling_kernel);
@@ -52,6 +52,16 @@ public:
   void Free();
   void Clear();
 
+  // When dirty tracking is enabled, FrameReady only uploads the rows
+  // that were marked with MarkDirty since the destination was last
+  // written and skips the upload entirely if there are none. The
+  // owner of the pixels is then responsible for reporting every change.
+  // Tracking is disabled by Allocate.
+  void SetDirtyTracking(bool enable);
+
+  // Mark rows y0 (inclusive) to y1 (exclusive) as changed.
+  void MarkDirty(int y0, int y1);
+
   // Get a pointer to raw pixel data for this frame buffer
   void* GetPixels();
 
@@ -146,6 +156,11 @@ public:
 
   static void SetInterpolation(int enable);
 
+  // Allows 8bpp layers to expand their palette on the CPU instead of
+  // looking it up in the shader. Off unless cpu_palette=true is in
+  // cmdline.txt. Takes effect the next time a shader is initialized.
+  static void SetCpuPalette(bool enable);
+
 private:
   void FreeInternal(bool keepPixels);
   void Swap(DISPMANX_UPDATE_HANDLE_T& dispman_update);
@@ -163,6 +178,14 @@ private:
 
   void ConcatShaderDefines(char *dst);
 
+  // True if the shader texture holds palette indices that the shader
+  // looks up. Otherwise 8bpp pixels are expanded to RGB565 on the CPU.
+  bool IndexedTexture();
+  int TextureWidth();
+
+  void MarkAllDirty();
+  bool TakeDirty(int dst, int *y0, int *y1);
+
   // Raw pixel data. Not VC memory.
   uint8_t* pixels_;
 
@@ -184,6 +207,7 @@ private:
   VC_DISPMANX_ALPHA_T alpha_;
 
   static bool initialized_;
+  static bool allow_cpu_palette_;
 
   int fb_width_;
   int fb_height_;
@@ -234,12 +258,23 @@ private:
   bool showing_;
   bool allocated_;
 
+  // Pending dirty rows for each destination. Indices 0 and 1 are the
+  // dispmanx resources, DIRTY_GL is the shader texture. Rows are
+  // marked in all of them and cleared as each one is written.
+  static const int DIRTY_GL = 2;
+  bool track_dirty_;
+  int dirty_y0_[3];
+  int dirty_y1_[3];
+
   VC_IMAGE_TYPE_T mode_;
   int bytes_per_pixel_;
 
   uint16_t pal_565_[256];
   uint32_t pal_argb_[256];
 
+  // One past the highest palette index set.
+  int pal_used_;
+
   bool uses_shader_;
 
   bool shader_init_;
@@ -254,6 +289,11 @@ private:
   GLuint tex_;
   GLuint pal_;
 
+  // Decided when the shader is initialized. When set, the texture is
+  // RGB565 and tex_pixels_ holds the cropped, expanded src region.
+  bool cpu_palette_;
+  uint16_t* tex_pixels_;
+
   // Orthographic projection matrix
   GLint mvp_;
 
@@ -263,15 +303,6 @@ private:
   GLuint texture_size_;
   GLuint texel_size_;
 
-  // Curvature requires the texture to have only
-  // the visible pixels in it. We can't get away
-  // with texture coords to crop what we want out
-  // of the buffer.  The shader could probably be
-  // updated to avoid this.  This flag being true
-  // causes hundreds of memcpy's to crop the data.
-  bool need_cpu_crop_;
-  uint8_t* cropped_pixels_;
-
   // Coordinates. One array is used for both vertex and
   // texture coordinates. 0-7 = vertex, 8-15 = texture
   GLfloat tex_coords_[16];
@@ -28,6 +28,9 @@ CKernel *static_kernel = NULL;
 #define MAX_KEY_CODES 128
 #define TICKS_PER_SECOND 1000000L
 
+// How often modified blocks in the file block cache are written back.
+#define FILE_FLUSH_TICKS (2 * TICKS_PER_SECOND)
+
 // A global to control whether our special VICE CIA port changes
 // should take effect. Only set when gpio_outputs_enabled is allowed.
 int raspi_userport_enabled;
@@ -91,6 +94,11 @@ int circle_sound_bufferspace() {
   return static_kernel->circle_sound_bufferspace();
 }
 
+void circle_sound_stats(unsigned *fill, unsigned *underruns,
+                        unsigned *overruns) {
+  static_kernel->circle_sound_stats(fill, underruns, overruns);
+}
+
 int circle_sound_init(const char *param, int *speed, int *fragsize, int *fragnr,
                       int *channels) {
   // VCHIQ is guaranteed to have been constructed but not necessarily
@@ -184,6 +192,14 @@ void circle_frames_ready_fbl(int layer1, int layer2, int sync) {
   static_kernel->circle_frames_ready_fbl(layer1, layer2, sync);
 }
 
+void circle_track_dirty_fbl(int layer, int enable) {
+  static_kernel->circle_track_dirty_fbl(layer, enable);
+}
+
+void circle_dirty_fbl(int layer, int y0, int y1) {
+  static_kernel->circle_dirty_fbl(layer, y0, y1);
+}
+
 void circle_set_palette_fbl(int layer, uint8_t index, uint16_t rgb565) {
   static_kernel->circle_set_palette_fbl(layer, index, rgb565);
 }
@@ -244,6 +260,10 @@ void circle_set_volume(int value) {
   static_kernel->circle_set_volume(value);
 }
 
+int circle_apply_options(const char *cmdline) {
+  return static_kernel->circle_apply_options(cmdline);
+}
+
 int circle_get_model() {
   return static_kernel->circle_get_model();
 }
@@ -347,7 +367,8 @@ CKernel::CKernel(void)
     : ViceStdioApp("vice"), mViceSound(nullptr),
       mNumJoy(emu_get_num_joysticks()),
       mVolume(100), mNumCoresComplete(0),
-      mNeedSoundInit(false), mNumSoundChannels(1) {
+      mNeedSoundInit(false), mHelperCoresNotified(false),
+      mNumSoundChannels(1), mLastFileFlush(0) {
   static_kernel = this;
   mod_states = 0;
   memset(key_states, 0, MAX_KEY_CODES * sizeof(bool));
@@ -377,6 +398,8 @@ CKernel::CKernel(void)
   fbl[FB_LAYER_UI].SetLayer(3);
   fbl[FB_LAYER_UI].SetTransparency(true);
 
+  FrameBufferLayer::SetCpuPalette(mViceOptions.CpuPaletteEnabled());
+
   if (circle_gpio_outputs_enabled()) {
      raspi_userport_enabled = 1;
   }
@@ -413,6 +436,7 @@ static void exec_button_func(int button_func, int is_press, int is_ui) {
      case BTN_ASSIGN_PIP_SWAP:
      case BTN_ASSIGN_40_80_COLUMN:
      case BTN_ASSIGN_VKBD_TOGGLE:
+     case BTN_ASSIGN_REWIND:
        if (is_press) {
           emu_quick_func_interrupt(button_func);
        }
@@ -1194,7 +1218,30 @@ int CKernel::circle_sound_bufferspace(void) {
   return FRAG_SIZE * NUM_FRAGS;
 }
 
-void CKernel::circle_yield(void) { CScheduler::Get()->Yield(); }
+void CKernel::circle_sound_stats(unsigned *fill, unsigned *underruns,
+                                 unsigned *overruns) {
+  if (mViceSound) {
+    mViceSound->GetStats(fill, underruns, overruns);
+    return;
+  }
+  *fill = 0;
+  *underruns = 0;
+  *overruns = 0;
+}
+
+void CKernel::circle_yield(void) {
+  CScheduler::Get()->Yield();
+
+  // The emulator calls this once a frame from the thread doing all
+  // file I/O so it's a safe place to persist pending disk writes.
+  unsigned long now = mTimer.GetClockTicks();
+  if (now - mLastFileFlush >= FILE_FLUSH_TICKS) {
+    mLastFileFlush = now;
+    CGlueStdioFlush();
+  }
+
+  mEmulatorCore->BackgroundStep();
+}
 
 void CKernel::MouseStatusHandler(unsigned nButtons, int deltaX, int deltaY) {
   static unsigned int prev_buttons = {0};
@@ -1385,7 +1432,13 @@ void CKernel::circle_check_gpio() {
      mViceSound->Playback(vol_percent_to_vchiq(mVolume), mNumSoundChannels);
      mNeedSoundInit = false;
   }
+  bool notify = !mHelperCoresNotified && mNumCoresComplete >= 2;
+  mHelperCoresNotified |= notify;
   circle_lock_release();
+
+  if (notify) {
+     mEmulatorCore->HelperCoresComplete();
+  }
 #endif
 
   int gpio_config = emu_get_gpio_config();
@@ -1556,13 +1609,25 @@ void CKernel::circle_hide_fbl(int layer) {
 void CKernel::circle_frames_ready_fbl(int layer1, int layer2, int sync) {
   // If we're going to sync to vblank, indicate this frame data should go
   // to the offscreen resource.
+  PROFILE_BEGIN(PROFILE_VIDEO);
   fbl[layer1].FrameReady(sync);
   if (layer2 >= 0) {
      fbl[layer2].FrameReady(sync);
   }
+  PROFILE_END(PROFILE_VIDEO);
   // Flip the buffers and wait for vblank.
+  profile_wait_begin();
   FrameBufferLayer::SwapResources(sync,
       &fbl[layer1], layer2 >= 0 ? &fbl[layer2] : nullptr);
+  profile_wait_end();
+}
+
+void CKernel::circle_track_dirty_fbl(int layer, int enable) {
+  fbl[layer].SetDirtyTracking(enable);
+}
+
+void CKernel::circle_dirty_fbl(int layer, int y0, int y1) {
+  fbl[layer].MarkDirty(y0, y1);
 }
 
 void CKernel::circle_set_palette_fbl(int layer, uint8_t index, uint16_t rgb565) {
@@ -1618,6 +1683,47 @@ void CKernel::circle_set_volume(int value) {
   }
 }
 
+// Takes the options of a new cmdline.txt without a reboot. Returns 0 if
+// any of them is only read at boot. The caller still has to re-time the
+// machine and re-apply the scaling params.
+int CKernel::circle_apply_options(const char *cmdline) {
+  ViceOptions options(cmdline);
+  if (!mViceOptions.SameBootOptions(options)) {
+    return 0;
+  }
+
+  if (options.GetMachineTiming() != mViceOptions.GetMachineTiming() ||
+      options.GetCyclesPerSecond() != mViceOptions.GetCyclesPerSecond()) {
+#if defined(RASPI_PLUS4EMU)
+    // The Plus4Emu VM is only timed at start up.
+    return 0;
+#else
+    // VICE only re-times the machine when the video standard changes.
+    if (options.IsNTSC() == mViceOptions.IsNTSC() &&
+        CyclesPerSecond(options) != circle_cycles_per_second()) {
+      return 0;
+    }
+#ifdef ARM_ALLOW_MULTI_CORE
+    // Cores 2 and 3 may still be filling the reSID tables.
+    circle_lock_acquire();
+    bool helpers_done = mHelperCoresNotified;
+    circle_lock_release();
+    if (!helpers_done) {
+      return 0;
+    }
+#endif
+#endif
+  }
+
+  mViceOptions.ApplyRuntimeOptions(options);
+  mEmulatorCore->SetCyclesPerSecond(circle_cycles_per_second());
+  if (mViceSound) {
+    mViceSound->SetControl(vol_percent_to_vchiq(mVolume),
+                           mViceOptions.GetAudioOut());
+  }
+  return 1;
+}
+
 int CKernel::circle_get_model() {
   return mMachineInfo.GetModelMajor();
 }
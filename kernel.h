@@ -42,6 +42,7 @@
 extern "C" {
 #include "third_party/common/circle.h"
 #include "third_party/common/keycodes.h"
+#include "third_party/common/profile.h"
 #include "third_party/vice-3.3/src/main.h"
 }
 
@@ -78,6 +79,8 @@ public:
   void circle_show_fbl(int layer);
   void circle_hide_fbl(int layer);
   void circle_frames_ready_fbl(int layer1, int layer2, int sync);
+  void circle_track_dirty_fbl(int layer, int enable);
+  void circle_dirty_fbl(int layer, int y0, int y1);
   void circle_set_palette_fbl(int layer, uint8_t index, uint16_t rgb565);
   void circle_set_palette32_fbl(int layer, uint8_t index, uint32_t argb);
   void circle_update_palette_fbl(int layer);
@@ -97,6 +100,8 @@ public:
   int circle_sound_suspend(void);
   int circle_sound_resume(void);
   int circle_sound_bufferspace(void);
+  void circle_sound_stats(unsigned *fill, unsigned *underruns,
+                          unsigned *overruns);
   void circle_yield(void);
   void circle_check_gpio();
   void circle_reset_gpio(int gpio_config);
@@ -104,6 +109,7 @@ public:
   void circle_lock_release();
   void circle_boot_complete();
   void circle_set_volume(int value);
+  int circle_apply_options(const char *cmdline);
   int circle_get_model();
   int circle_gpio_enabled();
   int circle_gpio_outputs_enabled();
@@ -155,7 +161,9 @@ private:
   int mVolume;
   int mNumCoresComplete;
   bool mNeedSoundInit;
+  bool mHelperCoresNotified;
   int mNumSoundChannels;
+  unsigned long mLastFileFlush;
 
   int gpio_debounce_state[NUM_GPIO_PINS];
 
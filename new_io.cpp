@@ -7,6 +7,7 @@
 #include <sys/dirent.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <time.h>
 #undef errno
 extern int errno;
 #include "warning.h"
@@ -21,42 +22,37 @@ extern int errno;
 #include <ff.h>
 
 // This is a replacement io.cpp specifically for BMC64.
-// This implementation will sometimes load the entire file
-// into memory to provide faster seek operations, improving
-// performance on slow SD cards.  Since any file the emulator
-// attempts to load is relatively small (<200k), this works out
-// just fine for our needs. Obviously, this would not be a
-// viable solution for most other circumstances.  It also
-// works around an issue with circle/fatfs integration that
-// was causing memory corruption.
+// File data is accessed through a small LRU cache of fixed size
+// blocks shared by all open files. This makes seeks cheap on slow SD
+// cards without having to load whole files into ram, so memory use
+// does not scale with the size of disk images, REUs or carts. It
+// also works around an issue with circle/fatfs integration that was
+// causing memory corruption.
 //
-// When a file is opened for READ ONLY, fatfs is used to open
-// the file.  As long as the client never seeks, the file will
-// not be loaded into ram and the disk still backs the data.  As
-// soon as seek is called, the file will be loaded into ram and
-// from then on, ram backs the data.  NOTE the fatfs file remains
-// open even after the file is loaded into ram in this case. If
-// the client never calls seek, the data will be read from fatfs.
+// Reads fill blocks from fatfs on a miss. When misses are
+// sequential, the next few blocks are read ahead in the same go.
 //
-// When a file is opened for WRITE ONLY, fatfs is used to create
-// the file. However, all write operations write to ram and only
-// when the file is finally closed will the data be dumped to
-// the fat fs filesystem.  The fatfs file remains open during
-// the entire time between open/close.  Seek is technically
-// supported in this case but attempting to seek past the
-// current file size is not.  Call to fstat on a file in WRTE_ONLY
-// mode will not work as expected.
+// Writes only touch cached blocks and mark them dirty. Dirty blocks
+// are written back when they are evicted, when the file is closed and
+// whenever CGlueStdioFlush is called, which the kernel does
+// periodically. A flush also syncs the fatfs file so that what was
+// written survives a power cut.
 //
-// When a file is opened for READ_WRITE, fat fs is used to
-// immediately load the contents of the existing file into ram.
-// The input fat fs file is immediatly closed in this case.
-// Writes & seeks use the ram copy. Only when the file is closed
-// will the fatfs system be used to create a new file from the ram.
-// Again, seeking past the file's current length is not supported.
+// When a file is opened for WRITE ONLY, fatfs is used to create
+// the file. When a file is opened for READ_WRITE, the existing file is
+// opened for reading and writing and modified blocks are written back
+// in place. If the file can't be opened for writing (read only
+// attribute), it is opened read only and modifications are dropped,
+// as before. In all cases, seeking past the current file size is not
+// supported.
 
 #define MAX_OPEN_FILES 10
 #define MAX_OPEN_DIRS 10
-#define READ_BUF_SIZE 1024
+
+// 1MB of cache in total.
+#define CACHE_BLOCK_SIZE 8192
+#define CACHE_NUM_BLOCKS 128
+#define CACHE_READ_AHEAD 2
 
 static const char *pattern = "*";
 
@@ -171,14 +167,20 @@ struct CircleFile {
   int in_use;
   char fname[256];
 
-  char readBuf[READ_BUF_SIZE]; // tmp read buffer
-  char *contents; // bytes for file in memory
-  int allocated; // total bytes allocated for in memory file
-  unsigned size; // total size of file in memory file
-  unsigned position; // current in memory write position
+  unsigned size; // size of the file including cached writes
+  unsigned position; // current read/write position
   int mode; // remembers mode this file was opened under
-  int written_to; // at least one write was performed on this file
-  int fopen_called; // f_open was called and thus f_close needs to be called
+  int can_write; // FIL was opened with write access
+  int needs_sync; // blocks were written back since the last f_sync
+  unsigned last_miss; // block following the last cache miss
+};
+
+struct CacheBlock {
+  int fildes; // owner or -1 when free
+  unsigned block; // block number within the file
+  int dirty;
+  unsigned lru; // cache_tick at last use
+  char *data;
 };
 
 struct CircleDir {
@@ -197,6 +199,14 @@ struct CircleDir {
 CircleFile fileTab[MAX_OPEN_FILES];
 CircleDir dirTab[MAX_OPEN_DIRS];
 
+static CacheBlock cacheTab[CACHE_NUM_BLOCKS];
+static char *cacheMem;
+static unsigned cache_tick;
+static unsigned cache_hits;
+static unsigned cache_misses;
+static unsigned cache_read_aheads;
+static unsigned cache_writebacks;
+
 static const char* const VolumeStr[FF_VOLUMES] = {FF_VOLUME_STRS};
 PARTITION VolToPart[FF_VOLUMES];
 
@@ -288,44 +298,211 @@ static CircleDir *FindCircleDirFromDIR(DIR *dir) {
   return nullptr;
 }
 
-// Returns non zero value on any failure. Any memory will be
-// freed on error and file.contents nulled.
-static int slurp_file(CircleFile &file) {
-  if (file.contents == nullptr) {
-    // Read the entire contents of the file into memory.
-    file.size = 0;
-    unsigned total = 0;
-    if (f_lseek(&file.file, 0) != FR_OK) {
-       return -1;
+static void cache_init(void) {
+  if (cacheMem == nullptr) {
+    cacheMem = (char *)malloc(CACHE_BLOCK_SIZE * CACHE_NUM_BLOCKS);
+    for (int i = 0; i < CACHE_NUM_BLOCKS; i++) {
+      cacheTab[i].fildes = -1;
+      cacheTab[i].dirty = 0;
+      cacheTab[i].data = cacheMem + i * CACHE_BLOCK_SIZE;
     }
-    while (true) {
-      unsigned int num_read;
-      if (f_read(&file.file, file.readBuf, READ_BUF_SIZE, &num_read) != FR_OK) {
-        if (file.contents) {
-           free(file.contents);
-           file.contents = nullptr;
-        }  
-        return -1;
-      }
+  }
+}
+
+static CacheBlock *cache_find(int fildes, unsigned block) {
+  for (int i = 0; i < CACHE_NUM_BLOCKS; i++) {
+    if (cacheTab[i].fildes == fildes && cacheTab[i].block == block) {
+      return &cacheTab[i];
+    }
+  }
+  return nullptr;
+}
+
+// Write a dirty block back to its file. Returns non zero on failure,
+// in which case the modifications are lost.
+static int cache_writeback(CacheBlock *b) {
+  if (!b->dirty) {
+    return 0;
+  }
+  b->dirty = 0;
+
+  CircleFile &file = fileTab[b->fildes];
+  if (!file.can_write) {
+    logm("io: dropped write to read only file ");
+    logm(file.fname);
+    logm("\r\n");
+    return -1;
+  }
+
+  unsigned start = b->block * CACHE_BLOCK_SIZE;
+  unsigned len = file.size - start;
+  if (len > CACHE_BLOCK_SIZE) {
+    len = CACHE_BLOCK_SIZE;
+  }
+
+  // Seeking past the end of a file opened for writing extends it
+  // so blocks can go back in any order.
+  unsigned int num_written;
+  if (f_lseek(&file.file, start) != FR_OK ||
+      f_write(&file.file, b->data, len, &num_written) != FR_OK ||
+      num_written != len) {
+    return -1;
+  }
+  file.needs_sync = 1;
+  cache_writebacks++;
+  return 0;
+}
+
+// Take the least recently used block, writing it back first if
+// necessary.
+static CacheBlock *cache_evict(void) {
+  CacheBlock *victim = &cacheTab[0];
+  for (int i = 0; i < CACHE_NUM_BLOCKS; i++) {
+    if (cacheTab[i].fildes == -1) {
+      victim = &cacheTab[i];
+      break;
+    }
+    if (cacheTab[i].lru < victim->lru) {
+      victim = &cacheTab[i];
+    }
+  }
+  if (victim->fildes != -1) {
+    cache_writeback(victim);
+    victim->fildes = -1;
+  }
+  return victim;
+}
+
+// Read a block's data from fatfs. Anything past the end of what is on
+// disk reads as zero.
+static int cache_fill(CircleFile &file, CacheBlock *b) {
+  unsigned start = b->block * CACHE_BLOCK_SIZE;
+  unsigned int num_read = 0;
+  if (start < f_size(&file.file)) {
+    if (f_lseek(&file.file, start) != FR_OK ||
+        f_read(&file.file, b->data, CACHE_BLOCK_SIZE, &num_read) != FR_OK) {
+      return -1;
+    }
+  }
+  if (num_read < CACHE_BLOCK_SIZE) {
+    memset(b->data + num_read, 0, CACHE_BLOCK_SIZE - num_read);
+  }
+  return 0;
+}
+
+// Get the cached block for this file. When fill is zero the block
+// is about to be completely overwritten and is not read from disk.
+static CacheBlock *cache_get(int fildes, unsigned block, int fill) {
+  CircleFile &file = fileTab[fildes];
+
+  CacheBlock *b = cache_find(fildes, block);
+  if (b != nullptr) {
+    b->lru = ++cache_tick;
+    cache_hits++;
+    return b;
+  }
 
-      if (num_read == 0) {
+  cache_misses++;
+  b = cache_evict();
+  b->block = block;
+  b->dirty = 0;
+  b->lru = ++cache_tick;
+  if (fill && cache_fill(file, b)) {
+    return nullptr;
+  }
+  b->fildes = fildes;
+
+  // Sequential misses pull in the next few blocks while fatfs is
+  // already positioned there.
+  if (fill && file.last_miss == block) {
+    for (unsigned n = 1; n <= CACHE_READ_AHEAD; n++) {
+      unsigned next = block + n;
+      if (next * CACHE_BLOCK_SIZE >= f_size(&file.file) ||
+          cache_find(fildes, next) != nullptr) {
         break;
       }
-      
-      if (file.contents == nullptr) {
-        file.allocated = READ_BUF_SIZE;
-        file.contents = (char *)malloc(file.allocated);
-      } else if (file.allocated < total + num_read) {
-        file.allocated *= 2;
-        file.contents = (char *)realloc(file.contents, file.allocated);
+      CacheBlock *ra = cache_evict();
+      ra->block = next;
+      ra->dirty = 0;
+      ra->lru = cache_tick;
+      if (cache_fill(file, ra)) {
+        break;
       }
+      ra->fildes = fildes;
+      cache_read_aheads++;
+    }
+  }
+  file.last_miss = block + 1;
+  return b;
+}
 
-      memcpy(file.contents + total, file.readBuf, num_read);
-      total += num_read;
-      file.size = total;
+// Write back all dirty blocks of a file in ascending order.
+static int cache_flush_file(int fildes) {
+  int result = 0;
+  while (true) {
+    CacheBlock *next = nullptr;
+    for (int i = 0; i < CACHE_NUM_BLOCKS; i++) {
+      CacheBlock *b = &cacheTab[i];
+      if (b->fildes == fildes && b->dirty &&
+          (next == nullptr || b->block < next->block)) {
+        next = b;
+      }
+    }
+    if (next == nullptr) {
+      break;
+    }
+    if (cache_writeback(next)) {
+      result = -1;
+    }
+  }
+  return result;
+}
+
+static void cache_drop_file(int fildes) {
+  for (int i = 0; i < CACHE_NUM_BLOCKS; i++) {
+    if (cacheTab[i].fildes == fildes) {
+      cacheTab[i].fildes = -1;
+      cacheTab[i].dirty = 0;
     }
   }
-  return 0;
+}
+
+void CGlueStdioFlush(void) {
+  if (cacheMem == nullptr) {
+    return;
+  }
+  unsigned writebacks = cache_writebacks;
+  for (int fildes = 3; fildes < MAX_OPEN_FILES; fildes++) {
+    CircleFile &file = fileTab[fildes];
+    if (!file.in_use) {
+      continue;
+    }
+    cache_flush_file(fildes);
+    if (file.needs_sync) {
+      f_sync(&file.file);
+      file.needs_sync = 0;
+    }
+  }
+
+  if (cache_writebacks != writebacks) {
+    logm("io: flushed ");
+    logi(cache_writebacks - writebacks);
+    logm(" blocks, hits ");
+    logi(cache_hits);
+    logm(" misses ");
+    logi(cache_misses);
+    logm(" read ahead ");
+    logi(cache_read_aheads);
+    logm("\r\n");
+  }
+}
+
+void CGlueStdioCacheStats(unsigned *hits, unsigned *misses,
+                          unsigned *read_aheads, unsigned *writebacks) {
+  *hits = cache_hits;
+  *misses = cache_misses;
+  *read_aheads = cache_read_aheads;
+  *writebacks = cache_writebacks;
 }
 
 extern "C" int _DEFUN(_open, (file, flags, mode),
@@ -353,16 +530,22 @@ extern "C" int _DEFUN(_open, (file, flags, mode),
     CircleFile &newFile = fileTab[slot];
 
     int result;
+    newFile.can_write = 1;
     if (masked_flags == O_RDONLY) {
       result = f_open(&newFile.file, circlePath.path, FA_READ);
+      newFile.can_write = 0;
     } else if (masked_flags == O_WRONLY) {
-      result = f_open(&newFile.file, circlePath.path, 
-         FA_WRITE | FA_CREATE_ALWAYS);
+      // Read access too so partially written blocks can be reloaded
+      // after they were evicted.
+      result = f_open(&newFile.file, circlePath.path,
+         FA_READ | FA_WRITE | FA_CREATE_ALWAYS);
     } else {
       assert(masked_flags == O_RDWR);
-      // Note: We open read only because this will be slurped and changed
-      // in memory.
-      result = f_open(&newFile.file, circlePath.path, FA_READ);
+      result = f_open(&newFile.file, circlePath.path, FA_READ | FA_WRITE);
+      if (result != FR_OK) {
+        result = f_open(&newFile.file, circlePath.path, FA_READ);
+        newFile.can_write = 0;
+      }
     }
 
     if (result != FR_OK) {
@@ -370,27 +553,15 @@ extern "C" int _DEFUN(_open, (file, flags, mode),
       return -1;
     }
 
-    newFile.fopen_called = 1;
-    newFile.contents = nullptr;
+    cache_init();
+
     newFile.position = 0;
-    newFile.size = 0;
-    newFile.allocated = 0;
+    newFile.size = f_size(&newFile.file);
     newFile.mode = masked_flags;
-    newFile.written_to = 0;
+    newFile.needs_sync = 0;
+    newFile.last_miss = 0;
     strcpy(newFile.fname, circlePath.path);
 
-    // When file is opened O_RDWR, slurp it into memory.
-    if (masked_flags == O_RDWR) {
-       if (slurp_file(newFile)) {
-          errno = ENFILE;
-          return -1;
-       }
-       if (f_close(&newFile.file) != FR_OK) {
-          errno = ENFILE;
-          return -1;
-       }
-    }
-
     newFile.in_use = 1;
   } else {
     errno = ENFILE;
@@ -411,45 +582,15 @@ extern "C" int _DEFUN(_close, (fildes), int fildes) {
     return -1;
   }
 
-  if (file.contents) {
-     // Only open if something was actually written to memory
-     if (file.mode == O_RDWR && file.written_to) {
-        // Assert FIL is not used
-        file.fopen_called = 1;
-        if (f_open(&file.file, file.fname,
-                      FA_WRITE | FA_CREATE_ALWAYS) != FR_OK) {
-           // We won't be able to flush in memory changes back to disk.
-        }
-     }
+  int result = cache_flush_file(fildes);
+  cache_drop_file(fildes);
 
-     // Always flush to disk for WRONLY but only if written to for RDRW
-     if ((file.mode == O_RDWR && file.written_to) || file.mode == O_WRONLY) {
-        // Dump contents of memory buffer to actual file.
-        unsigned int num_written;
-        if (f_write(&file.file, file.contents,
-                      file.size, &num_written) != FR_OK) {
-           // Can't write new file or modified file contents back to disk.
-        }
-     }
-  }
-
-  int need_close = file.fopen_called;
-
-  file.allocated = 0;
   file.size = 0;
   file.mode = 0;
   file.in_use = 0;
-  file.written_to = 0;
-  file.fopen_called = 0;
   file.fname[0] = '\0';
 
-  if (file.contents) {
-    free(file.contents);
-    file.contents = nullptr;
-  } 
-  
-  // If we opened for RDWR but never wrote, nothing do to.
-  if (need_close && f_close(&file.file) != FR_OK) {
+  if (f_close(&file.file) != FR_OK || result != 0) {
     errno = EIO;
     return -1;
   }
@@ -470,34 +611,30 @@ extern "C" int _DEFUN(_read, (fildes, ptr, len),
     return -1;
   }
 
-  unsigned int num_read;
-  if (file.contents == nullptr) {
-     // Assert file.FIL has been opened
-     // else EBADF -1
-
-     // Read data from the file
-     if (f_read(&file.file, ptr, len, &num_read) != FR_OK) {
-       errno = EIO;
-       return -1;
-     }
-
-     file.position += num_read;
-     return static_cast<int>(num_read);
-  } else {
-     // Read data from our internal buffer
-     unsigned int max = len;
-     unsigned int remain = file.size - file.position;
-
-     if (max > remain) {
-        max = remain;
-     }
+  unsigned int total = 0;
+  while (len > 0 && file.position < file.size) {
+    unsigned block = file.position / CACHE_BLOCK_SIZE;
+    unsigned offset = file.position % CACHE_BLOCK_SIZE;
+    CacheBlock *b = cache_get(fildes, block, 1);
+    if (b == nullptr) {
+      errno = EIO;
+      return -1;
+    }
 
-     if (max > 0) {
-        memcpy(ptr, file.contents + file.position, max);
-        file.position += max;
-     }
-     return static_cast<int>(max);
+    unsigned int n = CACHE_BLOCK_SIZE - offset;
+    if (n > (unsigned)len) {
+      n = len;
+    }
+    if (n > file.size - file.position) {
+      n = file.size - file.position;
+    }
+    memcpy(ptr, b->data + offset, n);
+    ptr += n;
+    len -= n;
+    total += n;
+    file.position += n;
   }
+  return static_cast<int>(total);
 }
 
 extern "C" int _DEFUN(_write, (fildes, ptr, len),
@@ -520,30 +657,36 @@ extern "C" int _DEFUN(_write, (fildes, ptr, len),
     return -1;
   }
 
-  // Mark this dirty so it will be flushed from memory to disk on close
-  file.written_to = 1;
-
-  // Nothing allocated yet? Allocate now.
-  if (file.contents == nullptr) {
-     file.allocated = READ_BUF_SIZE;
-     file.contents = (char *) malloc(file.allocated);
-  }
+  int total = len;
+  while (len > 0) {
+    unsigned block = file.position / CACHE_BLOCK_SIZE;
+    unsigned offset = file.position % CACHE_BLOCK_SIZE;
+    unsigned int n = CACHE_BLOCK_SIZE - offset;
+    if (n > (unsigned)len) {
+      n = len;
+    }
 
-  // Make sure we always have enough room allocated for the
-  // next write.
-  while (file.position + len >= file.allocated) {
-     file.allocated *= 2;
-     file.contents = (char *)realloc(file.contents, file.allocated);
-  }
+    // No need to read what is about to be overwritten or what was
+    // never there.
+    int fill = block * CACHE_BLOCK_SIZE < file.size &&
+               n < CACHE_BLOCK_SIZE;
+    CacheBlock *b = cache_get(fildes, block, fill);
+    if (b == nullptr) {
+      errno = EIO;
+      return -1;
+    }
 
-  // Do the write.
-  memcpy(file.contents + file.position, ptr, len);
-  file.position += len;
-  if (file.position > file.size) {
-     file.size = file.position;
+    memcpy(b->data + offset, ptr, n);
+    b->dirty = 1;
+    ptr += n;
+    len -= n;
+    file.position += n;
+    if (file.position > file.size) {
+      file.size = file.position;
+    }
   }
 
-  return len;
+  return total;
 }
 
 extern "C" DIR *opendir(const char *name) {
@@ -618,6 +761,18 @@ extern "C" int readdir_r(DIR *__restrict dir, dirent *__restrict de,
 
 extern "C" void rewinddir(DIR *dir) { f_rewinddir(dir); }
 
+extern "C" int mkdir(const char *name, mode_t mode) {
+  CirclePath circlePath(name);
+
+  int result = f_mkdir(circlePath.path);
+  if (result != FR_OK) {
+     if (result == FR_EXIST) errno = EEXIST;
+     else errno = EACCES;
+     return -1;
+  }
+  return 0;
+}
+
 extern "C" int closedir(DIR *dir) {
   CircleDir *c_dir = FindCircleDirFromDIR(dir);
   if (c_dir == nullptr) {
@@ -671,6 +826,17 @@ extern "C" int _DEFUN(_stat, (file, st),
     }
 
     st->st_size = fno.fsize;
+
+    // FAT timestamps are local time with 2 second resolution.
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    tm.tm_year = ((fno.fdate >> 9) & 0x7f) + 80;
+    tm.tm_mon = ((fno.fdate >> 5) & 0xf) - 1;
+    tm.tm_mday = fno.fdate & 0x1f;
+    tm.tm_hour = (fno.ftime >> 11) & 0x1f;
+    tm.tm_min = (fno.ftime >> 5) & 0x3f;
+    tm.tm_sec = (fno.ftime & 0x1f) * 2;
+    st->st_mtime = mktime(&tm);
     return 0;
   }
 
@@ -686,7 +852,12 @@ extern "C" int _DEFUN(_fstat, (fildes, st), int fildes _AND struct stat *st) {
     return -1;
   }
 
-  return _stat(file.fname, st);
+  int result = _stat(file.fname, st);
+  // Include writes that are still in the cache.
+  if (result == 0 && st->st_size < file.size) {
+    st->st_size = file.size;
+  }
+  return result;
 }
 
 extern "C" int _DEFUN(_lseek, (fildes, ptr, dir),
@@ -703,14 +874,6 @@ extern "C" int _DEFUN(_lseek, (fildes, ptr, dir),
     return -1;
   }
 
-  if (file.mode == O_RDONLY) {
-    // Assert FIL has been opened
-    if (slurp_file(file)) {
-       errno = EACCES;
-       return -1;
-    }
-  }
-
   if (dir == SEEK_SET) {
     file.position = ptr;
   } else if (dir == SEEK_CUR) {
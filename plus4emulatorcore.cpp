@@ -72,12 +72,18 @@ void Plus4EmulatorCore::Run(unsigned nCore) {
     RunMainPlus4(true);
     break;
   case 2:
-    // Core 2 will initialize 6581 filter data. Then sleep.
+    // Core 2 will initialize 6581 filter data. Then decode video lines.
     ComputeResidFilter(0);
+#ifdef ARM_ALLOW_MULTI_CORE
+    emu_video_line_worker();
+#endif
     break;
   case 3:
-    // Core 3 will initialize 8580 filter data. Then sleep.
+    // Core 3 will initialize 8580 filter data. Then run the SID.
     ComputeResidFilter(1);
+#ifdef ARM_ALLOW_MULTI_CORE
+    emu_sid_worker();
+#endif
     break;
   }
 
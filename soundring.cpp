@@ -0,0 +1,78 @@
+//
+// soundring.cpp
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "soundring.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+SoundRing::SoundRing(unsigned capacity)
+    : mCapacity(capacity), mMask(capacity - 1), mHead(0), mTail(0) {
+  assert((capacity & (capacity - 1)) == 0);
+  mBuffer = (s16 *)malloc(sizeof(s16) * capacity);
+  memset(mBuffer, 0, sizeof(s16) * capacity);
+}
+
+SoundRing::~SoundRing(void) { free(mBuffer); }
+
+unsigned SoundRing::Write(const s16 *pBuffer, unsigned count) {
+  unsigned head = mHead;
+  unsigned space = mCapacity - (head - mTail);
+  if (count > space) {
+    count = space;
+  }
+
+  unsigned pos = head & mMask;
+  unsigned first = mCapacity - pos;
+  if (first > count) {
+    first = count;
+  }
+  memcpy(mBuffer + pos, pBuffer, first * sizeof(s16));
+  memcpy(mBuffer, pBuffer + first, (count - first) * sizeof(s16));
+
+  // Samples must be visible before the consumer sees the new head.
+  __sync_synchronize();
+  mHead = head + count;
+  return count;
+}
+
+unsigned SoundRing::Read(s16 *pBuffer, unsigned count) {
+  unsigned tail = mTail;
+  unsigned avail = mHead - tail;
+  if (count > avail) {
+    count = avail;
+  }
+
+  // Don't read samples ahead of the head update we just observed.
+  __sync_synchronize();
+
+  unsigned pos = tail & mMask;
+  unsigned first = mCapacity - pos;
+  if (first > count) {
+    first = count;
+  }
+  memcpy(pBuffer, mBuffer + pos, first * sizeof(s16));
+  memcpy(pBuffer + first, mBuffer, (count - first) * sizeof(s16));
+
+  // Done with the samples before the producer may overwrite them.
+  __sync_synchronize();
+  mTail = tail + count;
+  return count;
+}
+
+void SoundRing::Reset(void) {
+  mHead = 0;
+  mTail = 0;
+}
@@ -0,0 +1,53 @@
+//
+// soundring.h
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     https://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef _sound_ring_h
+#define _sound_ring_h
+
+#include <circle/types.h>
+
+// Lock-free single producer / single consumer ring of 16 bit samples.
+// The producer is VICE's sound flush on the emulation core. The consumer
+// is whoever feeds the VC4 (see ViceSound::Drain). Only the producer
+// moves mHead and only the consumer moves mTail, so no lock is needed;
+// a memory barrier orders the sample copy against the index update.
+class SoundRing {
+public:
+  // capacity is in samples (s16 words) and must be a power of two.
+  SoundRing(unsigned capacity);
+  ~SoundRing(void);
+
+  // Copies up to count samples in/out. Returns the number copied.
+  unsigned Write(const s16 *pBuffer, unsigned count);
+  unsigned Read(s16 *pBuffer, unsigned count);
+
+  // Drops everything queued. Only safe when neither side is active.
+  void Reset(void);
+
+  unsigned Available(void) const { return mHead - mTail; }
+  unsigned Free(void) const { return mCapacity - Available(); }
+  unsigned Capacity(void) const { return mCapacity; }
+
+private:
+  s16 *mBuffer;
+  unsigned mCapacity;
+  unsigned mMask;
+
+  // Free running indices; wrap around is handled by unsigned arithmetic.
+  volatile unsigned mHead;
+  volatile unsigned mTail;
+};
+
+#endif
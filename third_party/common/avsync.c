@@ -0,0 +1,113 @@
+/*
+ * avsync.c
+ *
+ * Written by
+ *  Randy Rossi <randy.rossi@gmail.com>
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#include "avsync.h"
+
+// RASPI includes
+#include "circle.h"
+
+// Refresh rates outside of this are not measured.
+#define MIN_FRAME_US 8000
+#define MAX_FRAME_US 40000
+
+// The feed forward ratio never goes further than this from 1. Beyond
+// it, the machine is simply running at the wrong speed for the display.
+#define MAX_FF 0.05
+
+// Limits of the controller's trim on top of the feed forward ratio.
+#define MAX_TRIM 0.005
+
+// Proportional gain and integral gain per frame, on the fill error
+// relative to the target.
+#define KP 0.005
+#define KI 0.00001
+
+static unsigned long last_vsync;
+static double frame_us;
+static double fill_avg = -1;
+static double integral;
+static unsigned last_underruns;
+
+void avsync_reset(void) {
+  last_vsync = 0;
+  frame_us = 0;
+  fill_avg = -1;
+  integral = 0;
+}
+
+void avsync_vsync(void) {
+  unsigned long now = circle_get_ticks();
+
+  if (last_vsync) {
+     double period = now - last_vsync;
+     if (frame_us == 0) {
+        if (period >= MIN_FRAME_US && period <= MAX_FRAME_US) {
+           frame_us = period;
+        }
+     } else if (period > frame_us * 0.75 && period < frame_us * 1.25) {
+        // Missed vsyncs, pauses and the like are ignored. Averaging
+        // over many frames smooths out the jitter of when we get to
+        // run after the vsync.
+        frame_us += (period - frame_us) / 256;
+     }
+  }
+  last_vsync = now;
+}
+
+static double clamp(double v, double lo, double hi) {
+  return v < lo ? lo : (v > hi ? hi : v);
+}
+
+double avsync_ratio(double machine_fps, unsigned target_fill) {
+  unsigned fill, underruns, overruns;
+  double ff = 1.0;
+  double err;
+
+  circle_sound_stats(&fill, &underruns, &overruns);
+
+  if (frame_us > 0 && machine_fps > 0) {
+     ff = clamp(1000000.0 / frame_us / machine_fps, 1.0 - MAX_FF,
+                1.0 + MAX_FF);
+  }
+
+  if (target_fill == 0) {
+     return ff;
+  }
+
+  // The fill moves in VC4 sized chunks so it is averaged first. After
+  // an underrun the buffer starts over from empty.
+  if (fill_avg < 0 || underruns != last_underruns) {
+     fill_avg = fill;
+     last_underruns = underruns;
+  } else {
+     fill_avg += (fill - fill_avg) / 16;
+  }
+
+  err = (fill_avg - (double)target_fill) / (double)target_fill;
+  integral = clamp(integral + err * KI, -MAX_TRIM, MAX_TRIM);
+
+  return ff * (1.0 + clamp(err * KP + integral, -MAX_TRIM, MAX_TRIM));
+}
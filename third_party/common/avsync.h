@@ -0,0 +1,58 @@
+/*
+ * avsync.h
+ *
+ * Written by
+ *  Randy Rossi <randy.rossi@gmail.com>
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef RASPI_AVSYNC_H
+#define RASPI_AVSYNC_H
+
+// Keeps the rate samples are produced at in line with the rate VC4
+// plays them at.
+//
+// Emulation is paced by the display's vsync, so a display that runs a
+// little faster or slower than the emulated machine makes the emulator
+// produce a little more or less sound than is played. avsync measures
+// the actual refresh rate from vsync timestamps and the audio buffer
+// fill from the sound device and returns a resampling ratio that
+// cancels the drift. The ratio is the measured refresh over the machine
+// refresh, trimmed by a slow controller that holds the buffer at its
+// target fill. The trim is limited to a fraction of a percent so the
+// pitch change is inaudible.
+//
+// Everything is called from the emulator core.
+
+// Forget the measured refresh and the controller state. Call when the
+// sound device or machine timing changes.
+void avsync_reset(void);
+
+// Call right after the wait for vsync returns. Not while warping.
+void avsync_vsync(void);
+
+// Returns the factor to apply to the number of machine cycles per
+// sample (> 1 produces fewer samples). machine_fps is the emulated
+// refresh rate and target_fill the buffer fill to hold, in samples per
+// channel. Call once a frame.
+double avsync_ratio(double machine_fps, unsigned target_fill);
+
+#endif
@@ -0,0 +1,106 @@
+/*
+ * blit.h
+ *
+ * Written by
+ *  Randy Rossi <randy.rossi@gmail.com>
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef RASPI_BLIT_H
+#define RASPI_BLIT_H
+
+#include <stdint.h>
+#include <string.h>
+
+// Pixel loops for the shader texture upload. Header only and free of
+// other bmc64 headers so tools/blit_bench can build it on the host and
+// compare it against the _scalar versions.
+//
+// The NEON palette lookup only holds the first BLIT_NEON_PALETTE entries
+// in registers. Any 16 pixel block with a larger index falls back to the
+// scalar loop, so the result is always identical to the reference.
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define BLIT_NEON 1
+#define BLIT_NEON_PALETTE 32
+#endif
+
+// The reference 8bpp indexed to RGB565 expansion.
+static inline void blit_expand_565_scalar(uint16_t *dst, const uint8_t *src,
+                                          const uint16_t *pal, int n) {
+  int i;
+  for (i = 0; i < n; i++) {
+    dst[i] = pal[src[i]];
+  }
+}
+
+static inline void blit_expand_565(uint16_t *dst, const uint8_t *src,
+                                   const uint16_t *pal, int n) {
+  int i = 0;
+#ifdef BLIT_NEON
+  // De-interleave the first 32 entries into low and high byte tables.
+  uint8x16x2_t p0 = vld2q_u8((const uint8_t *)pal);
+  uint8x16x2_t p1 = vld2q_u8((const uint8_t *)(pal + 16));
+  uint8x8x4_t lo_tab = {{ vget_low_u8(p0.val[0]), vget_high_u8(p0.val[0]),
+                          vget_low_u8(p1.val[0]), vget_high_u8(p1.val[0]) }};
+  uint8x8x4_t hi_tab = {{ vget_low_u8(p0.val[1]), vget_high_u8(p0.val[1]),
+                          vget_low_u8(p1.val[1]), vget_high_u8(p1.val[1]) }};
+
+  for (; i + 16 <= n; i += 16) {
+    uint8x16_t idx = vld1q_u8(src + i);
+    uint8x8_t idx_lo = vget_low_u8(idx);
+    uint8x8_t idx_hi = vget_high_u8(idx);
+    uint64_t any = vget_lane_u64(
+        vreinterpret_u64_u8(vorr_u8(idx_lo, idx_hi)), 0);
+    if (any & 0xe0e0e0e0e0e0e0e0ULL) {
+      blit_expand_565_scalar(dst + i, src + i, pal, 16);
+      continue;
+    }
+    uint8x16x2_t out;
+    out.val[0] = vcombine_u8(vtbl4_u8(lo_tab, idx_lo),
+                             vtbl4_u8(lo_tab, idx_hi));
+    out.val[1] = vcombine_u8(vtbl4_u8(hi_tab, idx_lo),
+                             vtbl4_u8(hi_tab, idx_hi));
+    // Interleaving low and high bytes gives little endian RGB565.
+    vst2q_u8((uint8_t *)(dst + i), out);
+  }
+#endif
+  for (; i < n; i++) {
+    dst[i] = pal[src[i]];
+  }
+}
+
+// Expands the w x h region of an 8bpp frame buffer starting at src into
+// a tightly packed RGB565 buffer with dst_pitch pixels per row. This is
+// the CPU crop and palette lookup in one pass.
+static inline void blit_crop_expand_565(uint16_t *dst, int dst_pitch,
+                                        const uint8_t *src, int src_pitch,
+                                        const uint16_t *pal, int w, int h) {
+  int y;
+  for (y = 0; y < h; y++) {
+    blit_expand_565(dst, src, pal, w);
+    dst += dst_pitch;
+    src += src_pitch;
+  }
+}
+
+#endif
@@ -110,6 +110,7 @@
 #define BTN_ASSIGN_PIP_SWAP 26
 #define BTN_ASSIGN_40_80_COLUMN 27
 #define BTN_ASSIGN_VKBD_TOGGLE 28
+#define BTN_ASSIGN_REWIND 30
 
 // These are intermediate values not meant to
 // be directly assigned to buttons. Never used as
@@ -199,6 +200,10 @@ extern void circle_clear_fbl(int layer);
 extern void circle_show_fbl(int layer);
 extern void circle_hide_fbl(int layer);
 extern void circle_frames_ready_fbl(int layer1, int layer2, int sync);
+// Once enabled (until the next alloc), frames_ready only uploads rows
+// reported by circle_dirty_fbl. y1 is exclusive.
+extern void circle_track_dirty_fbl(int layer, int enable);
+extern void circle_dirty_fbl(int layer, int y0, int y1);
 extern void circle_set_palette_fbl(int layer, uint8_t index, uint16_t rgb565);
 extern void circle_set_palette32_fbl(int layer, uint8_t index, uint32_t argb);
 extern void circle_update_palette_fbl(int layer);
@@ -218,6 +223,7 @@ extern void circle_find_usb(int (*usb)[3]);
 extern int circle_mount_usb(int usb);
 extern int circle_unmount_usb(int usb);
 extern void circle_set_volume(int value);
+extern int circle_apply_options(const char *cmdline);
 extern int circle_get_model();
 extern unsigned circle_get_arm_clock();
 extern int circle_gpio_enabled();
@@ -230,6 +236,8 @@ extern void circle_sound_close(void);
 extern int circle_sound_suspend(void);
 extern int circle_sound_resume(void);
 extern int circle_sound_bufferspace(void);
+extern void circle_sound_stats(unsigned *fill, unsigned *underruns,
+                               unsigned *overruns);
 
 extern uint8_t circle_get_userport_ddr(void);
 extern uint8_t circle_get_userport(void);
@@ -0,0 +1,363 @@
+/*
+ * dir_index.c
+ *
+ * Written by
+ *  Randy Rossi <randy.rossi@gmail.com>
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#include "dir_index.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+
+#define DIR_INDEX_MAGIC 0x58444942 // 'BIDX'
+#define DIR_INDEX_VERSION 2
+
+// Names are paged in this many entries at a time.
+#define PAGE_ENTRIES 64
+#define NUM_PAGES 4
+
+struct dir_index_header {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t num_entries;
+  uint32_t hash;
+  uint32_t names_len;
+  // The directory indexed, in case two paths hash to the same file.
+  char dir_path[256];
+};
+
+struct dir_index {
+  // Of the index file
+  char path[256];
+  int num_entries;
+  struct dir_index_entry *entries;
+  uint32_t names_len;
+  long names_base;
+
+  // The whole blob, only when we just built the index ourselves (or
+  // could not write it out).
+  char *names;
+
+  // Otherwise, the last few pages of names read from the index file.
+  int page_num[NUM_PAGES];
+  char *page_buf[NUM_PAGES];
+  int next_page;
+};
+
+// Index build scratch. Only used during a rebuild.
+struct build_entry {
+  uint32_t off;
+  int is_dir;
+};
+
+static const char *build_names;
+
+static uint32_t hash_name(const char *name, int is_dir) {
+  uint32_t h = 2166136261u;
+  while (*name) {
+    h = (h ^ (uint8_t)*name++) * 16777619u;
+  }
+  return h ^ is_dir;
+}
+
+// The index file is named after a hash of the directory's path.
+static void index_path(char *dst, const char *dir_path) {
+  sprintf(dst, "%s/%08x.idx", DIR_INDEX_DIR,
+          (unsigned)hash_name(dir_path, 0));
+}
+
+// Readdir order is stable on FAT but the fingerprint doesn't need to
+// rely on it. Entry hashes are summed.
+static int fingerprint(const char *dir_path, uint32_t *count,
+                       uint32_t *hash) {
+  DIR *dp = opendir(dir_path);
+  if (dp == NULL) {
+    return -1;
+  }
+  struct dirent *ep;
+  *count = 0;
+  *hash = 0;
+  while ((ep = readdir(dp))) {
+    *count = *count + 1;
+    *hash += hash_name(ep->d_name, (ep->d_type & DT_DIR) ? 1 : 0);
+  }
+  closedir(dp);
+  return 0;
+}
+
+static void tail_of(char *dst, const char *name) {
+  int len = strlen(name);
+  if (len > DIR_INDEX_TAIL_LEN) {
+    name += len - DIR_INDEX_TAIL_LEN;
+  }
+  strcpy(dst, name);
+}
+
+static int compare_build_entry(const void *a, const void *b) {
+  const struct build_entry *ea = (const struct build_entry *)a;
+  const struct build_entry *eb = (const struct build_entry *)b;
+  if (ea->is_dir != eb->is_dir) {
+    return eb->is_dir - ea->is_dir;
+  }
+  return strcasecmp(build_names + ea->off, build_names + eb->off);
+}
+
+static void write_index(struct dir_index *idx,
+                        struct dir_index_header *hdr) {
+  // Fails with EEXIST all but the first time.
+  mkdir(DIR_INDEX_DIR, 0777);
+  FILE *fp = fopen(idx->path, "w");
+  if (fp == NULL) {
+    // No SD card to write to? Fine, we still have it in memory.
+    return;
+  }
+  int ok = fwrite(hdr, sizeof(*hdr), 1, fp) == 1;
+  if (ok && idx->num_entries > 0) {
+    ok = fwrite(idx->entries, sizeof(struct dir_index_entry),
+                idx->num_entries, fp) == idx->num_entries;
+  }
+  if (ok && idx->names_len > 0) {
+    ok = fwrite(idx->names, 1, idx->names_len, fp) == idx->names_len;
+  }
+  fclose(fp);
+  if (!ok) {
+    remove(idx->path);
+  }
+}
+
+static int build_index(struct dir_index *idx, const char *dir_path,
+                       uint32_t count, uint32_t hash) {
+  DIR *dp = opendir(dir_path);
+  if (dp == NULL) {
+    return -1;
+  }
+
+  // Names go into one growing blob rather than one allocation each.
+  int cap = count > 0 ? count : 16;
+  struct build_entry *tmp =
+      (struct build_entry *)malloc(cap * sizeof(struct build_entry));
+  uint32_t blob_cap = cap * 32;
+  char *blob = (char *)malloc(blob_cap);
+  uint32_t blob_len = 0;
+  int n = 0;
+
+  struct dirent *ep;
+  while ((ep = readdir(dp))) {
+    int len = strlen(ep->d_name) + 1;
+    if (n == cap) {
+      cap *= 2;
+      tmp = (struct build_entry *)realloc(tmp,
+                                          cap * sizeof(struct build_entry));
+    }
+    while (blob_len + len > blob_cap) {
+      blob_cap *= 2;
+      blob = (char *)realloc(blob, blob_cap);
+    }
+    memcpy(blob + blob_len, ep->d_name, len);
+    tmp[n].off = blob_len;
+    tmp[n].is_dir = (ep->d_type & DT_DIR) ? 1 : 0;
+    blob_len += len;
+    n++;
+  }
+  closedir(dp);
+
+  build_names = blob;
+  qsort(tmp, n, sizeof(struct build_entry), compare_build_entry);
+  build_names = NULL;
+
+  // Lay the names out again in sorted order so a page of entries is
+  // one contiguous read.
+  idx->num_entries = n;
+  idx->entries = (struct dir_index_entry *)malloc(
+      (n > 0 ? n : 1) * sizeof(struct dir_index_entry));
+  idx->names = (char *)malloc(blob_len > 0 ? blob_len : 1);
+  idx->names_len = blob_len;
+
+  uint32_t off = 0;
+  for (int i = 0; i < n; i++) {
+    const char *name = blob + tmp[i].off;
+    int len = strlen(name) + 1;
+    memcpy(idx->names + off, name, len);
+    memset(&idx->entries[i], 0, sizeof(struct dir_index_entry));
+    idx->entries[i].name_off = off;
+    idx->entries[i].is_dir = tmp[i].is_dir;
+    tail_of(idx->entries[i].tail, name);
+    off += len;
+  }
+
+  free(tmp);
+  free(blob);
+
+  struct dir_index_header hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.magic = DIR_INDEX_MAGIC;
+  hdr.version = DIR_INDEX_VERSION;
+  hdr.num_entries = n;
+  hdr.hash = hash;
+  hdr.names_len = blob_len;
+  strncpy(hdr.dir_path, dir_path, sizeof(hdr.dir_path) - 1);
+  write_index(idx, &hdr);
+  return 0;
+}
+
+static int read_index(struct dir_index *idx, const char *dir_path,
+                      uint32_t count, uint32_t hash) {
+  uint32_t num_entries;
+  FILE *fp = fopen(idx->path, "r");
+  if (fp == NULL) {
+    return -1;
+  }
+
+  struct dir_index_header hdr;
+  if (fread(&hdr, sizeof(hdr), 1, fp) != 1 ||
+      hdr.magic != DIR_INDEX_MAGIC || hdr.version != DIR_INDEX_VERSION ||
+      hdr.num_entries != count || hdr.hash != hash ||
+      strncmp(hdr.dir_path, dir_path, sizeof(hdr.dir_path) - 1)) {
+    fclose(fp);
+    return -1;
+  }
+
+  num_entries = hdr.num_entries;
+  idx->entries = (struct dir_index_entry *)malloc(
+      (num_entries > 0 ? num_entries : 1) * sizeof(struct dir_index_entry));
+  if (num_entries > 0 &&
+      fread(idx->entries, sizeof(struct dir_index_entry), num_entries,
+            fp) != num_entries) {
+    free(idx->entries);
+    idx->entries = NULL;
+    fclose(fp);
+    return -1;
+  }
+  fclose(fp);
+
+  idx->num_entries = num_entries;
+  idx->names_len = hdr.names_len;
+  idx->names_base =
+      sizeof(hdr) + num_entries * sizeof(struct dir_index_entry);
+  return 0;
+}
+
+struct dir_index *dir_index_load(const char *dir_path) {
+  uint32_t count;
+  uint32_t hash;
+  if (fingerprint(dir_path, &count, &hash)) {
+    return NULL;
+  }
+
+  struct dir_index *idx =
+      (struct dir_index *)malloc(sizeof(struct dir_index));
+  memset(idx, 0, sizeof(struct dir_index));
+  index_path(idx->path, dir_path);
+  for (int i = 0; i < NUM_PAGES; i++) {
+    idx->page_num[i] = -1;
+  }
+
+  if (read_index(idx, dir_path, count, hash) == 0) {
+    return idx;
+  }
+
+  if (build_index(idx, dir_path, count, hash) == 0) {
+    return idx;
+  }
+
+  dir_index_free(idx);
+  return NULL;
+}
+
+void dir_index_free(struct dir_index *idx) {
+  if (idx == NULL) return;
+  for (int i = 0; i < NUM_PAGES; i++) {
+    free(idx->page_buf[i]);
+  }
+  free(idx->names);
+  free(idx->entries);
+  free(idx);
+}
+
+int dir_index_num_entries(struct dir_index *idx) {
+  return idx->num_entries;
+}
+
+const struct dir_index_entry *dir_index_entry(struct dir_index *idx, int i) {
+  return &idx->entries[i];
+}
+
+// Read the names of one page of entries from the index file into
+// one of the page buffers. Returns the slot or -1.
+static int load_page(struct dir_index *idx, int page) {
+  int first = page * PAGE_ENTRIES;
+  int last = first + PAGE_ENTRIES;
+  if (last > idx->num_entries) {
+    last = idx->num_entries;
+  }
+  uint32_t start = idx->entries[first].name_off;
+  uint32_t end = last < idx->num_entries ? idx->entries[last].name_off
+                                         : idx->names_len;
+
+  FILE *fp = fopen(idx->path, "r");
+  if (fp == NULL) {
+    return -1;
+  }
+
+  int slot = idx->next_page;
+  idx->next_page = (idx->next_page + 1) % NUM_PAGES;
+  free(idx->page_buf[slot]);
+  idx->page_buf[slot] = (char *)malloc(end - start);
+  idx->page_num[slot] = -1;
+
+  if (fseek(fp, idx->names_base + start, SEEK_SET) != 0 ||
+      fread(idx->page_buf[slot], 1, end - start, fp) != end - start) {
+    fclose(fp);
+    return -1;
+  }
+  fclose(fp);
+
+  idx->page_num[slot] = page;
+  return slot;
+}
+
+const char *dir_index_name(struct dir_index *idx, int i) {
+  if (idx->names) {
+    return idx->names + idx->entries[i].name_off;
+  }
+
+  int page = i / PAGE_ENTRIES;
+  int slot;
+  for (slot = 0; slot < NUM_PAGES; slot++) {
+    if (idx->page_num[slot] == page) break;
+  }
+  if (slot == NUM_PAGES) {
+    slot = load_page(idx, page);
+    if (slot < 0) {
+      // Index went away underneath us. Show the tail at least.
+      return idx->entries[i].tail;
+    }
+  }
+
+  return idx->page_buf[slot] + idx->entries[i].name_off -
+         idx->entries[page * PAGE_ENTRIES].name_off;
+}
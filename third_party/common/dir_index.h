@@ -0,0 +1,79 @@
+/*
+ * dir_index.h
+ *
+ * Written by
+ *  Randy Rossi <randy.rossi@gmail.com>
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef RASPI_DIR_INDEX_H
+#define RASPI_DIR_INDEX_H
+
+#include <stdint.h>
+
+// A sorted index of a directory's entries that is kept in a cache
+// directory on the SD card so large folders don't have to be filtered
+// and sorted every time they are opened in the file browser.
+//
+// The index holds a small fixed size record per entry (dirs first,
+// then files, each sorted case insensitive) followed by a blob of
+// names. Only the records are kept in memory. Names are read from the
+// index file a page at a time when they are asked for.
+//
+// Every load checks the index against the directory's entry count and
+// a hash of its names, taken with a plain readdir pass. Folder
+// timestamps can't be trusted for this since copying files onto the
+// card from a PC often leaves them alone. Index files are only ever
+// written to DIR_INDEX_DIR, never into the directories being listed,
+// so USB sticks and read only media are left untouched.
+
+#define DIR_INDEX_DIR "SD:/dirindex"
+
+// Enough of the end of a name to run the extension filters on. Names
+// longer than 5 chars are cut to their last 5 so that filters that
+// require a name longer than the extension still behave.
+#define DIR_INDEX_TAIL_LEN 5
+
+struct dir_index_entry {
+  // Offset of the name in the names blob
+  uint32_t name_off;
+  uint8_t is_dir;
+  char tail[DIR_INDEX_TAIL_LEN + 1];
+  uint8_t pad;
+};
+
+struct dir_index;
+
+// Load the index for dir_path, rebuilding it if it is missing or
+// stale. Returns NULL if the directory can't be read.
+struct dir_index *dir_index_load(const char *dir_path);
+
+void dir_index_free(struct dir_index *idx);
+
+int dir_index_num_entries(struct dir_index *idx);
+
+const struct dir_index_entry *dir_index_entry(struct dir_index *idx, int i);
+
+// Returns the full name of entry i. The pointer is only good until
+// the next call.
+const char *dir_index_name(struct dir_index *idx, int i);
+
+#endif
@@ -91,6 +91,9 @@ typedef enum {
   Setting_VideoSize, // PET
   Setting_VideoFilter,
   Setting_AutostartWarp,
+  Setting_DriveAsync,
+  Setting_DriveAsyncLookahead,
+  Setting_MachineVideoStandard, // 1 for NTSC, 0 for PAL
 } IntSetting;
 
 typedef enum {
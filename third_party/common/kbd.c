@@ -328,6 +328,7 @@ static int handle_key_combo_release(long key) {
       case BTN_ASSIGN_PIP_LOCATION:
       case BTN_ASSIGN_PIP_SWAP:
       case BTN_ASSIGN_40_80_COLUMN:
+      case BTN_ASSIGN_REWIND:
         emu_quick_func_interrupt(key_combo_states[i].function);
         key_combo_states[i].invoked = 0;
         return 1;
@@ -37,6 +37,7 @@
 // RASPI Includes
 #include "emux_api.h"
 #include "demo.h"
+#include "dir_index.h"
 #include "joy.h"
 #include "kbd.h"
 #include "text.h"
@@ -49,6 +50,7 @@
 #include "menu_switch.h"
 #include "menu_gpio.h"
 #include "overlay.h"
+#include "profile.h"
 #include "raspi_util.h"
 #include "ui.h"
 
@@ -111,6 +113,8 @@ unsigned int gpio_bindings[NUM_GPIO_PINS];
 
 struct menu_item *drive_sounds_item;
 struct menu_item *drive_sounds_vol_item;
+struct menu_item *drive_async_item;
+struct menu_item *drive_async_lookahead_item;
 struct menu_item *hotkey_cf1_item;
 struct menu_item *hotkey_cf3_item;
 struct menu_item *hotkey_cf5_item;
@@ -134,6 +138,12 @@ struct menu_item *saturation_item[2];
 
 struct menu_item *warp_item;
 struct menu_item *reset_confirm_item;
+struct menu_item *instant_boot_item;
+struct menu_item *rewind_item;
+struct menu_item *rewind_interval_item;
+struct menu_item *rewind_memory_item;
+struct menu_item *input_polls_item;
+struct menu_item *turbo_warp_item;
 struct menu_item *gpio_config_item;
 struct menu_item *active_display_item;
 
@@ -249,6 +259,13 @@ static char full_path_str[256];
 // Keep track of last known position in the file list.
 static int current_dir_pos[NUM_DIR_TYPES];
 
+// Index of the directory being listed and the entries that made it
+// through the filter, in display order. Rows of the file list are
+// materialized from these only when they become visible.
+static struct dir_index *file_index;
+static int *file_rows;
+static int file_rows_cap;
+
 TEST_FILTER_MACRO(test_disk_name, num_disk_ext, disk_filt_ext);
 TEST_FILTER_MACRO(test_tape_name, num_tape_ext, tape_filt_ext);
 TEST_FILTER_MACRO(test_cart_name, num_cart_ext, cart_filt_ext);
@@ -308,25 +325,64 @@ static void remove_dir(char *path) {
   }
 }
 
+static int include_file(FileFilter filter, char *name) {
+  switch (filter) {
+  case FILTER_DISK:
+    return test_disk_name(name);
+  case FILTER_TAPE:
+    return test_tape_name(name);
+  case FILTER_CART:
+    return test_cart_name(name);
+  case FILTER_SNAP:
+    return test_snap_name(name);
+  case FILTER_PRGS:
+    return test_prg_name(name);
+  case FILTER_DIRS:
+    return 0;
+  case FILTER_NONE:
+  default:
+    return 1;
+  }
+}
+
+static void fill_file_row(struct menu_item *virt, int row,
+                          struct menu_item *dest) {
+  int i = file_rows[row];
+  const struct dir_index_entry *entry = dir_index_entry(file_index, i);
+  const char *name = dir_index_name(file_index, i);
+
+  dest->type = BUTTON;
+  strncpy(dest->name, name, MAX_MENU_STR - 1);
+  strncpy(dest->str_value, name, MAX_STR_VAL_LEN - 1);
+  if (entry->is_dir) {
+    strcpy(dest->displayed_value, "(dir)");
+    dest->sub_id = MENU_SUB_ENTER_DIR;
+  } else {
+    // Button name will be filename but it will be truncated
+    // due to menu width.  Actual filename will be stored in
+    // str_value which is never displayed except for text fields.
+    strcpy(dest->displayed_value, " ");
+    dest->sub_id = MENU_SUB_PICK_FILE;
+  }
+}
+
 // Clears the file menu and populates it with files.
 static void list_files(struct menu_item *parent,
                        DirType dir_type, FileFilter filter,
                        int menu_id) {
-  DIR *dp;
-  struct dirent *ep;
   int i;
-  int include;
 
-  dp = opendir(fullpath(dir_type,""));
-  if (dp == NULL) {
+  dir_index_free(file_index);
+  file_index = dir_index_load(fullpath(dir_type,""));
+  if (file_index == NULL) {
     // Machine dir may not be present. Try up one.
     remove_dir(current_dir_names[dir_type]);
-    dp = opendir(fullpath(dir_type,""));
-    if (dp == NULL) {
+    file_index = dir_index_load(fullpath(dir_type,""));
+    if (file_index == NULL) {
       // File dir may not be present. Try up one.
       remove_dir(current_dir_names[dir_type]);
-      dp = opendir(fullpath(dir_type,""));
-      if (dp == NULL) {
+      file_index = dir_index_load(fullpath(dir_type,""));
+      if (file_index == NULL) {
         return;
       }
     }
@@ -356,72 +412,27 @@ static void list_files(struct menu_item *parent,
     ui_menu_add_button(menu_id, parent, "..")->sub_id = MENU_SUB_UP_DIR;
   }
 
-  // Make two buckets
-  struct menu_item dirs_root;
-  memset(&dirs_root, 0, sizeof(struct menu_item));
-  dirs_root.type = FOLDER;
-  dirs_root.is_expanded = 1;
-  dirs_root.name[0] = '\0';
-
-  struct menu_item files_root;
-  memset(&files_root, 0, sizeof(struct menu_item));
-  files_root.type = FOLDER;
-  files_root.is_expanded = 1;
-  files_root.name[0] = '\0';
-
-  if (dp != NULL) {
-    while (ep = readdir(dp)) {
-      if (ep->d_type & DT_DIR) {
-        ui_menu_add_button_with_value(menu_id, &dirs_root, ep->d_name, 0,
-                                      ep->d_name, "(dir)")
-            ->sub_id = MENU_SUB_ENTER_DIR;
-      } else {
-        include = 0;
-        if (filter == FILTER_DISK) {
-          include = test_disk_name(ep->d_name);
-        } else if (filter == FILTER_TAPE) {
-          include = test_tape_name(ep->d_name);
-        } else if (filter == FILTER_CART) {
-          include = test_cart_name(ep->d_name);
-        } else if (filter == FILTER_SNAP) {
-          include = test_snap_name(ep->d_name);
-        } else if (filter == FILTER_PRGS) {
-          include = test_prg_name(ep->d_name);
-        } else if (filter == FILTER_DIRS) {
-          include = 0;
-        } else if (filter == FILTER_NONE) {
-          include = 1;
-        }
-        if (include) {
-          // Button name will be filename but it will be truncated
-          // due to menu width.  Actual filename will be stored in
-          // str_value which is never displayed except for text fields.
-          struct menu_item *new_button =
-              ui_menu_add_button(menu_id, &files_root, ep->d_name);
-          new_button->sub_id = MENU_SUB_PICK_FILE;
-          strncpy(new_button->str_value, ep->d_name, MAX_STR_VAL_LEN - 1);
-        }
-      }
-    }
-
-    (void)closedir(dp);
+  // The index is already sorted dirs first. Filters only look at the
+  // extension so the tail of each name is enough to decide.
+  int num_entries = dir_index_num_entries(file_index);
+  if (num_entries > file_rows_cap) {
+    file_rows = (int *)realloc(file_rows, num_entries * sizeof(int));
+    file_rows_cap = num_entries;
   }
 
-  struct menu_item *dfc = dirs_root.first_child;
-  merge_sort(&dfc);
-  dirs_root.first_child = dfc;
-
-  struct menu_item *ffc = files_root.first_child;
-  merge_sort(&ffc);
-  files_root.first_child = ffc;
-
-  // Transfer ownership of dirs children first, then files. Childless
-  // parents are on the stack.
-  ui_add_all(&dirs_root, parent);
-  ui_add_all(&files_root, parent);
+  int num_rows = 0;
+  for (i = 0; i < num_entries; i++) {
+    const struct dir_index_entry *entry = dir_index_entry(file_index, i);
+    char tail[DIR_INDEX_TAIL_LEN + 1];
+    strcpy(tail, entry->tail);
+    if (entry->is_dir || include_file(filter, tail)) {
+      file_rows[num_rows++] = i;
+    }
+  }
 
-  assert(dirs_root.first_child == NULL);
-  assert(files_root.first_child == NULL);
+  if (num_rows > 0) {
+    ui_menu_add_virtual(menu_id, parent, num_rows, fill_file_row);
+  }
 }
 
 static void files_cursor_listener(struct menu_item* parent,
@@ -874,31 +885,57 @@ static void next_integer_scaling(int layer,
   }
 }
 
-static int save_settings() {
-  FILE *fp;
+const char *menu_settings_file(void) {
   switch (emux_machine_class) {
   case BMC64_MACHINE_CLASS_C64:
-    fp = fopen("/settings.txt", "w");
-    break;
+    return "/settings.txt";
   case BMC64_MACHINE_CLASS_C128:
-    fp = fopen("/settings-c128.txt", "w");
-    break;
+    return "/settings-c128.txt";
   case BMC64_MACHINE_CLASS_VIC20:
-    fp = fopen("/settings-vic20.txt", "w");
-    break;
+    return "/settings-vic20.txt";
   case BMC64_MACHINE_CLASS_PLUS4:
-    fp = fopen("/settings-plus4.txt", "w");
-    break;
+    return "/settings-plus4.txt";
   case BMC64_MACHINE_CLASS_PLUS4EMU:
-    fp = fopen("/settings-plus4emu.txt", "w");
-    break;
+    return "/settings-plus4emu.txt";
   case BMC64_MACHINE_CLASS_PET:
-    fp = fopen("/settings-pet.txt", "w");
-    break;
+    return "/settings-pet.txt";
   default:
+    return NULL;
+  }
+}
+
+int menu_instant_boot_enabled(void) {
+  return instant_boot_item->value;
+}
+
+int menu_rewind_enabled(void) {
+  return rewind_item->value;
+}
+
+int menu_rewind_interval(void) {
+  return rewind_interval_item->value;
+}
+
+int menu_rewind_memory(void) {
+  return rewind_memory_item->value;
+}
+
+int menu_input_polls(void) {
+  return input_polls_item->value;
+}
+
+int menu_turbo_warp(void) {
+  return turbo_warp_item->value;
+}
+
+static int save_settings() {
+  FILE *fp;
+  const char *settings_file = menu_settings_file();
+  if (settings_file == NULL) {
     printf("ERROR: Unhandled machine\n");
     return 1;
   }
+  fp = fopen(settings_file, "w");
 
   int r = emux_save_settings();
   if (r < 0) {
@@ -954,6 +991,14 @@ static int save_settings() {
   fprintf(fp, "vkbd_trans=%d\n", vkbd_transparency_item->value);
   fprintf(fp, "tapereset=%d\n", tape_reset_with_machine_item->value);
   fprintf(fp, "reset_confirm=%d\n", reset_confirm_item->value);
+  fprintf(fp, "instant_boot=%d\n", instant_boot_item->value);
+  if (rewind_item) {
+    fprintf(fp, "rewind=%d\n", rewind_item->value);
+    fprintf(fp, "rewind_interval=%d\n", rewind_interval_item->value);
+    fprintf(fp, "rewind_memory=%d\n", rewind_memory_item->value);
+  }
+  fprintf(fp, "input_polls=%d\n", input_polls_item->value);
+  fprintf(fp, "turbo_warp=%d\n", turbo_warp_item->value);
   fprintf(fp, "scaling_interp=%d\n", scaling_interp_item->value);
   fprintf(fp, "gpio_config=%d\n", gpio_config_item->choice_ints[gpio_config_item->value]);
   fprintf(fp, "h_center_0=%d\n", h_center_item[0]->value);
@@ -1069,6 +1114,8 @@ static void load_settings() {
 #ifndef RASPI_LITE
   emux_get_int(Setting_DriveSoundEmulation, &drive_sounds_item->value);
   emux_get_int(Setting_DriveSoundEmulationVolume, &drive_sounds_vol_item->value);
+  emux_get_int(Setting_DriveAsync, &drive_async_item->value);
+  emux_get_int(Setting_DriveAsyncLookahead, &drive_async_lookahead_item->value);
 #endif
 
   brightness_item[0]->value = emux_get_color_brightness(0);
@@ -1093,29 +1140,12 @@ static void load_settings() {
   pot_y_low_value = 64;
 
   FILE *fp;
-  switch (emux_machine_class) {
-  case BMC64_MACHINE_CLASS_C64:
-    fp = fopen("/settings.txt", "r");
-    break;
-  case BMC64_MACHINE_CLASS_C128:
-    fp = fopen("/settings-c128.txt", "r");
-    break;
-  case BMC64_MACHINE_CLASS_VIC20:
-    fp = fopen("/settings-vic20.txt", "r");
-    break;
-  case BMC64_MACHINE_CLASS_PLUS4:
-    fp = fopen("/settings-plus4.txt", "r");
-    break;
-  case BMC64_MACHINE_CLASS_PLUS4EMU:
-    fp = fopen("/settings-plus4emu.txt", "r");
-    break;
-  case BMC64_MACHINE_CLASS_PET:
-    fp = fopen("/settings-pet.txt", "r");
-    break;
-  default:
+  const char *settings_file = menu_settings_file();
+  if (settings_file == NULL) {
     printf("ERROR: Unhandled machine\n");
     return;
   }
+  fp = fopen(settings_file, "r");
 
   if (fp == NULL)
     return;
@@ -1202,6 +1232,18 @@ static void load_settings() {
       hotkey_tf7_item->value = value;
     } else if (strcmp(name, "reset_confirm") == 0) {
       reset_confirm_item->value = value;
+    } else if (strcmp(name, "instant_boot") == 0) {
+      instant_boot_item->value = value;
+    } else if (rewind_item && strcmp(name, "rewind") == 0) {
+      rewind_item->value = value;
+    } else if (rewind_item && strcmp(name, "rewind_interval") == 0) {
+      rewind_interval_item->value = value;
+    } else if (rewind_item && strcmp(name, "rewind_memory") == 0) {
+      rewind_memory_item->value = value;
+    } else if (strcmp(name, "input_polls") == 0) {
+      input_polls_item->value = value;
+    } else if (strcmp(name, "turbo_warp") == 0) {
+      turbo_warp_item->value = value;
     } else if (strcmp(name, "scaling_interp") == 0) {
       scaling_interp_item->value = value;
     } else if (strcmp(name, "gpio_config") == 0) {
@@ -2453,6 +2495,19 @@ static void menu_value_changed(struct menu_item *item) {
   case MENU_WARP_MODE:
     toggle_warp(item->value);
     return;
+  case MENU_PROFILE:
+    profile_enable(item->value);
+    if (!item->value) {
+      overlay_profile_clear();
+    }
+    return;
+  case MENU_PROFILE_DUMP:
+    if (profile_dump(PROFILE_CSV_FILE)) {
+      ui_error("Problem writing %s", PROFILE_CSV_FILE);
+    } else {
+      ui_info("Wrote %s", PROFILE_CSV_FILE);
+    }
+    return;
   case MENU_DEMO_MODE:
     raspi_demo_mode = item->value;
     demo_reset();
@@ -2463,6 +2518,12 @@ static void menu_value_changed(struct menu_item *item) {
   case MENU_DRIVE_SOUND_EMULATION_VOLUME:
     emux_set_int(Setting_DriveSoundEmulationVolume, item->value);
     return;
+  case MENU_DRIVE_ASYNC:
+    emux_set_int(Setting_DriveAsync, item->value);
+    return;
+  case MENU_DRIVE_ASYNC_LOOKAHEAD:
+    emux_set_int(Setting_DriveAsyncLookahead, item->value);
+    return;
   case MENU_COLOR_BRIGHTNESS_0:
     ui_canvas_reveal_temp(FB_LAYER_VIC);
     emux_set_color_brightness(0, item->value);
@@ -2753,10 +2814,11 @@ static void menu_value_changed(struct menu_item *item) {
     if (item->sub_id == MENU_SWITCH_MACHINE) {
       load_machines(&head);
       struct machine_entry* ptr = head;
+      int need_reboot = 1;
       status = 0;
       while (ptr) {
           if (ptr->id == item->value) {
-            status = switch_apply_files(ptr);
+            status = switch_apply_files(ptr, &need_reboot);
             break;
           }
           ptr = ptr->next;
@@ -2766,6 +2828,9 @@ static void menu_value_changed(struct menu_item *item) {
          char failcode[32];
          sprintf (failcode, "FAILURE (CODE %d)", status);
          ui_confirm_wrapped(failcode, SWITCH_FAIL_MSG,-1,-1);
+      } else if (!need_reboot && switch_apply_in_place()) {
+         // Same kernel and video mode; nothing to boot into.
+         menu_machine_reset(0 /* hard */, 1 /* pop */);
       } else {
          reboot();
       }
@@ -2894,7 +2959,7 @@ void emu_get_usb_pref(int device, int *usb_pref_dst, int *x_axis, int *y_axis,
 
 // KEEP in sync with kernel.cpp, kbd.c, menu_usb.c
 static void set_hotkey_choices(struct menu_item *item) {
-  item->num_choices = 14;
+  item->num_choices = 16;
   strcpy(item->choices[HOTKEY_CHOICE_NONE], function_to_string(BTN_ASSIGN_UNDEF));
   strcpy(item->choices[HOTKEY_CHOICE_MENU], function_to_string(BTN_ASSIGN_MENU));
   strcpy(item->choices[HOTKEY_CHOICE_WARP], function_to_string(BTN_ASSIGN_WARP));
@@ -2910,6 +2975,7 @@ static void set_hotkey_choices(struct menu_item *item) {
   strcpy(item->choices[HOTKEY_CHOICE_PIP_LOCATION], function_to_string(BTN_ASSIGN_PIP_LOCATION));
   strcpy(item->choices[HOTKEY_CHOICE_PIP_SWAP], function_to_string(BTN_ASSIGN_PIP_SWAP));
   strcpy(item->choices[HOTKEY_CHOICE_40_80_COLUMN], function_to_string(BTN_ASSIGN_40_80_COLUMN));
+  strcpy(item->choices[HOTKEY_CHOICE_REWIND], function_to_string(BTN_ASSIGN_REWIND));
   item->choice_ints[HOTKEY_CHOICE_NONE] = BTN_ASSIGN_UNDEF;
   item->choice_ints[HOTKEY_CHOICE_MENU] = BTN_ASSIGN_MENU;
   item->choice_ints[HOTKEY_CHOICE_WARP] = BTN_ASSIGN_WARP;
@@ -2925,6 +2991,7 @@ static void set_hotkey_choices(struct menu_item *item) {
   item->choice_ints[HOTKEY_CHOICE_PIP_LOCATION] = BTN_ASSIGN_PIP_LOCATION;
   item->choice_ints[HOTKEY_CHOICE_PIP_SWAP] = BTN_ASSIGN_PIP_SWAP;
   item->choice_ints[HOTKEY_CHOICE_40_80_COLUMN] = BTN_ASSIGN_40_80_COLUMN;
+  item->choice_ints[HOTKEY_CHOICE_REWIND] = BTN_ASSIGN_REWIND;
 
   if (emux_machine_class == BMC64_MACHINE_CLASS_VIC20) {
      item->choice_disabled[HOTKEY_CHOICE_SWAP_PORTS] = 1;
@@ -2941,6 +3008,11 @@ static void set_hotkey_choices(struct menu_item *item) {
      item->choice_disabled[HOTKEY_CHOICE_PIP_SWAP] = 1;
      item->choice_disabled[HOTKEY_CHOICE_40_80_COLUMN] = 1;
   }
+
+  if (emux_machine_class == BMC64_MACHINE_CLASS_PET ||
+      emux_machine_class == BMC64_MACHINE_CLASS_PLUS4EMU) {
+     item->choice_disabled[HOTKEY_CHOICE_REWIND] = 1;
+  }
 }
 
 static void menu_build_machine_switch(struct menu_item* parent) {
@@ -3733,6 +3805,13 @@ void build_menu(struct menu_item *root) {
     drive_sounds_vol_item =
         ui_menu_add_range(MENU_DRIVE_SOUND_EMULATION_VOLUME, parent,
                         "Drive sound emulation volume", 0, 1000, 100, 1000);
+    // Only takes effect for C64 and VIC20 with 1541/1571 type drives
+    // and no drive sound or parallel cable.
+    drive_async_item = ui_menu_add_toggle(MENU_DRIVE_ASYNC, parent,
+                                         "Drive emulation on core 3", 0);
+    drive_async_lookahead_item =
+        ui_menu_add_range(MENU_DRIVE_ASYNC_LOOKAHEAD, parent,
+                        "Drive lookahead cycles", 0, 64, 8, 0);
   }
 #endif
 
@@ -3755,6 +3834,45 @@ void build_menu(struct menu_item *root) {
   reset_confirm_item = ui_menu_add_toggle(MENU_RESET_CONFIRM, parent,
                                           "Confirm Reset from Emulator", 1);
 
+  // Plus4emu has no boot warp and PET can't snapshot so this is a
+  // no-op for those.
+  instant_boot_item = ui_menu_add_toggle(MENU_INSTANT_BOOT, parent,
+                                         "Instant Boot", 0);
+
+  // Rewind is VICE only. PET can't snapshot so it's a no-op there.
+  // Memory is in MB and the interval in frames.
+  if (emux_machine_class != BMC64_MACHINE_CLASS_PLUS4EMU) {
+    rewind_item = ui_menu_add_toggle(MENU_REWIND, parent, "Rewind", 0);
+    rewind_interval_item =
+        ui_menu_add_range(MENU_REWIND_INTERVAL, parent,
+                          "Rewind capture interval", 10, 250, 5, 50);
+#ifdef RASPI_LITE
+    rewind_memory_item =
+        ui_menu_add_range(MENU_REWIND_MEMORY, parent,
+                          "Rewind memory (MB)", 1, 32, 1, 8);
+#else
+    rewind_memory_item =
+        ui_menu_add_range(MENU_REWIND_MEMORY, parent,
+                          "Rewind memory (MB)", 1, 64, 1, 16);
+#endif
+  }
+
+  // Times per frame USB/GPIO input is handed to the machine, at evenly
+  // spaced raster lines. Plus4emu always takes input once per frame.
+  input_polls_item =
+      ui_menu_add_range(MENU_INPUT_POLLS, parent,
+                        "Input polls per frame", 1, 8, 1, 1);
+
+  // While warping, only draw and show one frame in ten and don't
+  // synthesize audio that would be thrown away. Plus4emu warps as before.
+  turbo_warp_item =
+      ui_menu_add_toggle(MENU_TURBO_WARP, parent, "Turbo warp", 1);
+
+  // Not saved with settings. Only meant for measuring.
+  ui_menu_add_toggle(MENU_PROFILE, parent, "Show Profiler", 0);
+  ui_menu_add_button(MENU_PROFILE_DUMP, parent,
+                     "Write Profiler CSV to SD");
+
   char emu_folder[16];
   char folder_emu[16];
 
@@ -3821,8 +3939,9 @@ void build_menu(struct menu_item *root) {
   if (emux_machine_class == BMC64_MACHINE_CLASS_C128) {
      do_video_settings(FB_LAYER_VDC);
   }
+  // Only the C128 has a 40/80 column key.
   overlay_init(statusbar_padding_item->value,
-               c40_80_column_item->value,
+               c40_80_column_item ? c40_80_column_item->value : 0,
                vkbd_transparency_item->value);
 
   emux_set_joy_pot_x(0, pot_x_high_value);
@@ -4041,6 +4160,8 @@ const char* function_to_string(int button_func) {
        return "PIP Swap";
     case BTN_ASSIGN_40_80_COLUMN:
        return "40/80 Column Key";
+    case BTN_ASSIGN_REWIND:
+       return "Rewind";
     case BTN_ASSIGN_VKBD_TOGGLE:
        return "Virtual Keyboard";
     default:
@@ -4098,6 +4219,11 @@ void emux_geometry_changed(int layer) {
 
 void emux_frame_buffer_changed(int layer) {
   int canvas_index = layer == FB_LAYER_VIC ? VIC_INDEX : VDC_INDEX;
+  // The first canvas is created before the menu is built. build_menu
+  // applies these settings itself.
+  if (use_scaling_params_item[canvas_index] == NULL) {
+     return;
+  }
   if (use_scaling_params_item[canvas_index]->value) {
      if (!do_use_int_scaling(layer, 1 /* silent */)) {
         use_scaling_params_item[canvas_index]->value = 0;
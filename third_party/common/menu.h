@@ -32,7 +32,7 @@
 #define RASPI_MENU_H
 
 // Make sure does not exceed max choices in ui.h
-#define NUM_BUTTON_ASSIGNMENTS 29
+#define NUM_BUTTON_ASSIGNMENTS 31
 
 // Never used as values. Can be reorged.
 typedef enum {
@@ -466,6 +466,21 @@ typedef enum {
    MENU_SHADER_OUTPUT_GAMMA,
    MENU_SHADER_SHARPER,
    MENU_SHADER_RESET_ALL,
+
+   MENU_PROFILE,
+   MENU_PROFILE_DUMP,
+
+   MENU_INSTANT_BOOT,
+
+   MENU_DRIVE_ASYNC,
+   MENU_DRIVE_ASYNC_LOOKAHEAD,
+
+   MENU_REWIND,
+   MENU_REWIND_INTERVAL,
+   MENU_REWIND_MEMORY,
+
+   MENU_INPUT_POLLS,
+   MENU_TURBO_WARP,
 } MenuID;
 
 typedef enum {
@@ -529,6 +544,7 @@ typedef enum {
    HOTKEY_CHOICE_PIP_LOCATION,
    HOTKEY_CHOICE_PIP_SWAP,
    HOTKEY_CHOICE_40_80_COLUMN,
+   HOTKEY_CHOICE_REWIND,
 } HotKeyChoice;
 
 enum {
@@ -614,4 +630,13 @@ void menu_about_to_deactivate(void);
 void menu_quick_func(int button_assignment);
 const char* function_to_string(int);
 
+// Settings file for the current machine class or NULL.
+const char *menu_settings_file(void);
+int menu_instant_boot_enabled(void);
+int menu_rewind_enabled(void);
+int menu_rewind_interval(void);
+int menu_rewind_memory(void);
+int menu_input_polls(void);
+int menu_turbo_warp(void);
+
 #endif
@@ -75,6 +75,9 @@ struct s_cfg_flags {
   // to know whether it should be added if not
   // already present to config.txt
   int need_kernel;
+
+  // Set when config.txt had to be rewritten.
+  int config_changed;
 };
 
 static int entry_id;
@@ -122,6 +125,27 @@ static int copy_file(char* from, char* to) {
   return 0;
 }
 
+// Returns 1 if both files exist and have identical contents.
+static int same_file(char* a, char* b) {
+  FILE *fp = fopen(a,"r");
+  if (fp == NULL) {
+     return 0;
+  }
+  FILE *fp2 = fopen(b,"r");
+  if (fp2 == NULL) {
+     fclose(fp);
+     return 0;
+  }
+  int c, c2;
+  do {
+    c = fgetc(fp);
+    c2 = fgetc(fp2);
+  } while (c == c2 && c != EOF);
+  fclose(fp);
+  fclose(fp2);
+  return c == c2;
+}
+
 static int new_section(struct machine_entry** new_section, char* line) {
   char* header = &line[1];
   for (int i=0;i<strlen(header);i++) {
@@ -596,8 +620,10 @@ static int apply_cmdline(struct machine_entry* head, struct s_cfg_flags *cfg_fla
   fclose(fp);
   fclose(fp2);
 
-  if (copy_file("/cmdline.new","/cmdline.txt")) {
-     return ERROR_3;
+  if (!same_file("/cmdline.new","/cmdline.txt")) {
+     if (copy_file("/cmdline.new","/cmdline.txt")) {
+        return ERROR_3;
+     }
   }
   if (unlink("/cmdline.new")) {
      return ERROR_4;
@@ -737,8 +763,11 @@ static int apply_config(struct machine_entry* head, int pi_model, struct s_cfg_f
   fclose(fp);
   fclose(fp2);
 
-  if (copy_file("/config.new","/config.txt")) {
-    return ERROR_9;
+  if (!same_file("/config.new","/config.txt")) {
+    cfg_flags->config_changed = 1;
+    if (copy_file("/config.new","/config.txt")) {
+      return ERROR_9;
+    }
   }
   if (unlink("/config.new")) {
     return ERROR_10;
@@ -746,15 +775,57 @@ static int apply_config(struct machine_entry* head, int pi_model, struct s_cfg_f
   return 0;
 }
 
-int switch_apply_files(struct machine_entry* head) {
+// If need_reboot is not NULL, it is set to 0 when the entry targets the
+// running kernel and config.txt did not have to change. The video mode is
+// then the same and switch_apply_in_place can take cmdline.txt.
+int switch_apply_files(struct machine_entry* head, int *need_reboot) {
   struct s_cfg_flags cfg_flags;
   memset(&cfg_flags, 0, sizeof(struct s_cfg_flags));
 
   int status = apply_config(head, circle_get_model(), &cfg_flags);
   status |= apply_cmdline(head, &cfg_flags);
+  if (need_reboot) {
+    *need_reboot =
+       cfg_flags.config_changed || head->class != emux_machine_class;
+  }
   return status;
 }
 
+// Applies cmdline.txt to the running machine: machine timing, audio out
+// and scaling params. Returns 0 if it holds options that are only read at
+// boot, in which case the caller must reboot. The caller resets the
+// machine afterwards.
+int switch_apply_in_place(void) {
+  char line[CONFIG_TXT_LINE_LEN];
+  FILE* fp = fopen("/cmdline.txt","r");
+  if (fp == NULL) {
+     return 0;
+  }
+  char *options = NULL;
+  while (fgets(line, CONFIG_TXT_LINE_LEN - 1, fp)) {
+    char *trimmed = trim(line);
+    if (strlen(trimmed) > 0 && trimmed[0] != '#') {
+      options = trimmed;
+      break;
+    }
+  }
+  fclose(fp);
+  if (options == NULL) {
+     return 0;
+  }
+
+  if (!circle_apply_options(options)) {
+     return 0;
+  }
+
+  emux_set_int(Setting_MachineVideoStandard, is_ntsc());
+  emux_frame_buffer_changed(FB_LAYER_VIC);
+  if (emux_machine_class == BMC64_MACHINE_CLASS_C128) {
+     emux_frame_buffer_changed(FB_LAYER_VDC);
+  }
+  return 1;
+}
+
 void switch_safe() {
   struct machine_entry* entry =
      (struct machine_entry*) malloc(sizeof(struct machine_entry));
@@ -782,5 +853,5 @@ void switch_safe() {
   append_to_section(entry, tmp);
   strcpy (tmp,"machine_timing=ntsc-pal");
 
-  switch_apply_files(entry);
+  switch_apply_files(entry, NULL);
 }
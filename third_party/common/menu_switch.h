@@ -65,7 +65,8 @@ struct machine_entry {
 
 int load_machines(struct machine_entry** head);
 void free_machines(struct machine_entry* head);
-int switch_apply_files(struct machine_entry* ptr);
+int switch_apply_files(struct machine_entry* ptr, int *need_reboot);
+int switch_apply_in_place(void);
 
 // Apply a safe HDMI video mode
 void switch_safe();
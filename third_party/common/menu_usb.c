@@ -234,6 +234,7 @@ static void add_button_choices(struct menu_item *tmp_item) {
   strcpy(tmp_item->choices[BTN_ASSIGN_PIP_SWAP], function_to_string(BTN_ASSIGN_PIP_SWAP));
   strcpy(tmp_item->choices[BTN_ASSIGN_40_80_COLUMN], function_to_string(BTN_ASSIGN_40_80_COLUMN));
   strcpy(tmp_item->choices[BTN_ASSIGN_VKBD_TOGGLE], function_to_string(BTN_ASSIGN_VKBD_TOGGLE));
+  strcpy(tmp_item->choices[BTN_ASSIGN_REWIND], function_to_string(BTN_ASSIGN_REWIND));
 
   char scratch[32];
   for (int n = 0; n < 6; n++) {
@@ -257,9 +258,18 @@ static void add_button_choices(struct menu_item *tmp_item) {
     tmp_item->choice_disabled[BTN_ASSIGN_40_80_COLUMN] = 1;
   }
 
+  // Not handled for USB buttons. Only here because the choices are
+  // indexed by function.
+  tmp_item->choice_disabled[BTN_ASSIGN_RESET_MENU] = 1;
+
   if (emux_machine_class == BMC64_MACHINE_CLASS_PET) {
     tmp_item->choice_disabled[BTN_ASSIGN_VKBD_TOGGLE] = 1;
   }
+
+  if (emux_machine_class == BMC64_MACHINE_CLASS_PET ||
+      emux_machine_class == BMC64_MACHINE_CLASS_PLUS4EMU) {
+    tmp_item->choice_disabled[BTN_ASSIGN_REWIND] = 1;
+  }
 }
 
 void build_usb_menu(int dev, struct menu_item *root) {
@@ -37,6 +37,7 @@
 #include "circle.h"
 #include "keycodes.h"
 #include "kbd.h"
+#include "profile.h"
 
 #define ARGB(a,r,g,b) ((uint32_t)((uint8_t)(a)<<24 | (uint8_t)(r)<<16 | (uint8_t)(g)<<8 | (uint8_t)(b)))
 
@@ -57,6 +58,10 @@
 // below then scaled.
 #define STATUS_BAR_HEIGHT (FONT_ADVANCE + 2 * SCALE_XY)
 
+// Profiler line sits just above the status bar in small text.
+#define PROFILE_LINE_HEIGHT (8 + 2)
+#define PROFILE_LINE_Y (OVERLAY_HEIGHT - STATUS_BAR_HEIGHT - PROFILE_LINE_HEIGHT)
+
 static int drive_x[4];
 static int tape_x;
 static int tape_controls_x;
@@ -180,8 +185,34 @@ static void draw_statusbar() {
 }
 
 static void clear_statusbar() {
-  ui_draw_rect_buf(0, OVERLAY_HEIGHT - STATUS_BAR_HEIGHT,
-                   OVERLAY_WIDTH, STATUS_BAR_HEIGHT,
+  ui_draw_rect_buf(0, PROFILE_LINE_Y,
+                   OVERLAY_WIDTH, STATUS_BAR_HEIGHT + PROFILE_LINE_HEIGHT,
+                   TRANSPARENT_COLOR, 1, overlay_buf, overlay_buf_pitch);
+  overlay_dirty = 1;
+}
+
+// Show a new line of profiler stats. Keeps the status bar up while
+// the profiler is on.
+void overlay_profile_update(const char *text) {
+  if (!overlay_buf)
+    return;
+
+  if (!statusbar_enabled) {
+     overlay_statusbar_enable();
+  }
+
+  ui_draw_rect_buf(0, PROFILE_LINE_Y, OVERLAY_WIDTH, PROFILE_LINE_HEIGHT,
+                   BG_COLOR, 1, overlay_buf, overlay_buf_pitch);
+  ui_draw_text_buf(text, inset_x, PROFILE_LINE_Y + 1, FG_COLOR,
+                   overlay_buf, overlay_buf_pitch, 1);
+  overlay_dirty = 1;
+}
+
+void overlay_profile_clear(void) {
+  if (!overlay_buf)
+    return;
+
+  ui_draw_rect_buf(0, PROFILE_LINE_Y, OVERLAY_WIDTH, PROFILE_LINE_HEIGHT,
                    TRANSPARENT_COLOR, 1, overlay_buf, overlay_buf_pitch);
   overlay_dirty = 1;
 }
@@ -491,7 +522,8 @@ void overlay_joyswap_changed(int swap) {
 // Checks whether a showing overlay due to activity should no longer be showing
 void overlay_check(void) {
   // Rollover safe way of checking duration
-  if (statusbar_enabled && circle_get_ticks() - statusbar_start >= statusbar_delay) {
+  if (statusbar_enabled && !profile_enabled &&
+      circle_get_ticks() - statusbar_start >= statusbar_delay) {
       overlay_statusbar_dismiss();
   }
 }
@@ -61,6 +61,8 @@ void overlay_statusbar_disable(void);
 void overlay_change_padding(int padding);
 void overlay_change_vkbd_transparency(int transparency);
 void overlay_40_80_columns_changed(int value);
+void overlay_profile_update(const char *text);
+void overlay_profile_clear(void);
 void vkbd_nav_up(void);
 void vkbd_nav_down(void);
 void vkbd_nav_left(void);
@@ -0,0 +1,240 @@
+/*
+ * profile.c
+ *
+ * Written by
+ *  Randy Rossi <randy.rossi@gmail.com>
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#include "profile.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// RASPI includes
+#include "circle.h"
+#include "emux_api.h"
+#include "overlay.h"
+
+// About one minute of history at 50hz.
+#define PROFILE_HISTORY 3000
+
+// How many frames are averaged for each overlay update.
+#define PROFILE_OVERLAY_FRAMES 50
+
+// Columns recorded for each frame. All but the last are in
+// microseconds. The last is the percentage of visible raster lines the
+// raster cache did not have to draw.
+enum {
+   COL_FRAME = 0,
+   COL_EMU,
+   COL_RASTER,
+   COL_SOUND,
+   COL_VIDEO,
+   COL_UI,
+   COL_DRIVE,
+   COL_VSYNC,
+   COL_CACHE_HIT,
+   NUM_COLS,
+};
+
+static const char *col_names[NUM_COLS] = {
+   "frame_us", "emu_us", "raster_us", "sound_us", "video_us", "ui_us",
+   "drive_us", "vsync_us", "cache_hit_pct"
+};
+
+int profile_enabled;
+uint32_t profile_section_start;
+uint32_t profile_section_cycles[PROFILE_NUM_SECTIONS];
+
+static uint32_t cycles_per_us;
+static unsigned long frame_start;
+static unsigned long wait_start;
+static unsigned long wait_ticks;
+static unsigned long frame_lines;
+static unsigned long frame_lines_drawn;
+
+static uint16_t history[PROFILE_HISTORY][NUM_COLS];
+static int history_head;
+static int history_count;
+
+static uint32_t window_sum[NUM_COLS];
+static uint32_t window_max_frame;
+static int window_count;
+static unsigned long window_lines;
+
+static void reset_cycle_counter(void) {
+#if defined(__arm__) && __ARM_ARCH >= 7
+  // PMCR: enable counters, reset cycle counter. PMCNTENSET: enable CCNT.
+  asm volatile("mcr p15, 0, %0, c9, c12, 0" : : "r"(1 | 4));
+  asm volatile("mcr p15, 0, %0, c9, c12, 1" : : "r"(0x80000000));
+#elif defined(__arm__)
+  // ARM1176 PMNC: enable counters, reset cycle counter.
+  asm volatile("mcr p15, 0, %0, c15, c12, 0" : : "r"(1 | 4));
+#endif
+}
+
+static void reset_window(void) {
+  memset(window_sum, 0, sizeof(window_sum));
+  window_max_frame = 0;
+  window_count = 0;
+  window_lines = 0;
+}
+
+void profile_enable(int enable) {
+  if (enable) {
+     reset_cycle_counter();
+     cycles_per_us = circle_get_arm_clock() / 1000000;
+     if (cycles_per_us == 0) {
+        cycles_per_us = 1;
+     }
+     memset(profile_section_cycles, 0, sizeof(profile_section_cycles));
+     history_head = 0;
+     history_count = 0;
+     wait_ticks = 0;
+     frame_lines = 0;
+     frame_lines_drawn = 0;
+     reset_window();
+     frame_start = circle_get_ticks();
+  }
+  profile_enabled = enable;
+}
+
+void profile_wait_begin(void) {
+  if (profile_enabled) {
+     wait_start = circle_get_ticks();
+  }
+}
+
+void profile_wait_end(void) {
+  if (profile_enabled) {
+     wait_ticks += circle_get_ticks() - wait_start;
+  }
+}
+
+static uint16_t clamp16(unsigned long v) {
+  return v > 0xffff ? 0xffff : v;
+}
+
+// Format microseconds as milliseconds with one decimal.
+static int format_ms(char *dst, const char *label, uint32_t us) {
+  return sprintf(dst, "%s %2lu.%lu ", label, (unsigned long)(us / 1000),
+                 (unsigned long)((us % 1000) / 100));
+}
+
+static void update_overlay(void) {
+  char line[128];
+  int n = 0;
+
+  n += format_ms(line + n, "FRM", window_sum[COL_FRAME] / window_count);
+  n += format_ms(line + n, "MAX", window_max_frame);
+  n += format_ms(line + n, "EMU", window_sum[COL_EMU] / window_count);
+  n += format_ms(line + n, "RAS", window_sum[COL_RASTER] / window_count);
+  n += format_ms(line + n, "SND", window_sum[COL_SOUND] / window_count);
+  n += format_ms(line + n, "VID", window_sum[COL_VIDEO] / window_count);
+  n += format_ms(line + n, "UI", window_sum[COL_UI] / window_count);
+  n += format_ms(line + n, "DRV", window_sum[COL_DRIVE] / window_count);
+  n += format_ms(line + n, "VS", window_sum[COL_VSYNC] / window_count);
+  // Machines without a raster don't report lines.
+  if (window_lines > 0) {
+     sprintf(line + n, "HIT %3lu%%",
+             (unsigned long)(window_sum[COL_CACHE_HIT] / window_count));
+  }
+
+  overlay_profile_update(line);
+}
+
+void profile_lines(unsigned int lines, unsigned int drawn) {
+  if (profile_enabled) {
+     frame_lines += lines;
+     frame_lines_drawn += drawn;
+  }
+}
+
+void profile_frame_end(void) {
+  if (!profile_enabled) return;
+
+  unsigned long now = circle_get_ticks();
+  unsigned long frame = now - frame_start;
+  frame_start = now;
+
+  uint16_t *rec = history[history_head];
+  unsigned long busy = wait_ticks;
+  rec[COL_FRAME] = clamp16(frame);
+  rec[COL_VSYNC] = clamp16(wait_ticks);
+  for (int s = 0; s < PROFILE_NUM_SECTIONS; s++) {
+     unsigned long us = profile_section_cycles[s] / cycles_per_us;
+     rec[COL_RASTER + s] = clamp16(us);
+     busy += us;
+     profile_section_cycles[s] = 0;
+  }
+  rec[COL_EMU] = clamp16(frame > busy ? frame - busy : 0);
+  wait_ticks = 0;
+  rec[COL_CACHE_HIT] = frame_lines > 0 ?
+     (frame_lines - frame_lines_drawn) * 100 / frame_lines : 0;
+  window_lines += frame_lines;
+  frame_lines = 0;
+  frame_lines_drawn = 0;
+
+  history_head = (history_head + 1) % PROFILE_HISTORY;
+  if (history_count < PROFILE_HISTORY) {
+     history_count++;
+  }
+
+  for (int c = 0; c < NUM_COLS; c++) {
+     window_sum[c] += rec[c];
+  }
+  if (rec[COL_FRAME] > window_max_frame) {
+     window_max_frame = rec[COL_FRAME];
+  }
+  if (++window_count == PROFILE_OVERLAY_FRAMES) {
+     update_overlay();
+     reset_window();
+  }
+}
+
+int profile_dump(const char *path) {
+  FILE *fp = fopen(path, "w");
+  if (fp == NULL) {
+     return -1;
+  }
+
+  fprintf(fp, "# model=%d arm_hz=%u machine_class=%d timing=%d\n",
+          circle_get_model(), circle_get_arm_clock(), emux_machine_class,
+          circle_get_machine_timing());
+  for (int c = 0; c < NUM_COLS; c++) {
+     fprintf(fp, "%s%s", c == 0 ? "" : ",", col_names[c]);
+  }
+  fprintf(fp, "\n");
+
+  int index = (history_head - history_count + PROFILE_HISTORY) %
+     PROFILE_HISTORY;
+  for (int i = 0; i < history_count; i++) {
+     uint16_t *rec = history[index];
+     for (int c = 0; c < NUM_COLS; c++) {
+        fprintf(fp, "%s%u", c == 0 ? "" : ",", rec[c]);
+     }
+     fprintf(fp, "\n");
+     index = (index + 1) % PROFILE_HISTORY;
+  }
+
+  return fclose(fp) == 0 ? 0 : -1;
+}
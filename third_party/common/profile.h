@@ -0,0 +1,104 @@
+/*
+ * profile.h
+ *
+ * Written by
+ *  Randy Rossi <randy.rossi@gmail.com>
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef RASPI_PROFILE_H
+#define RASPI_PROFILE_H
+
+#include <stdint.h>
+
+// Lightweight per frame profiling. Sections are timed with the ARM
+// cycle counter of the emulator core (the TSC on a host build) and
+// accumulated until the end of the frame. Everything not covered by a
+// section (cpu, other chips) is reported as 'emu'. Waiting for vsync
+// is timed separately with the system timer since the core may sleep
+// while waiting.
+//
+// All sections must be entered from the emulator core (1) and must
+// not nest.
+
+typedef enum {
+   PROFILE_RASTER = 0,
+   PROFILE_SOUND,
+   PROFILE_VIDEO,
+   PROFILE_UI,
+   PROFILE_DRIVE,
+   PROFILE_NUM_SECTIONS,
+} ProfileSection;
+
+#define PROFILE_CSV_FILE "/profile.csv"
+
+extern int profile_enabled;
+extern uint32_t profile_section_start;
+extern uint32_t profile_section_cycles[PROFILE_NUM_SECTIONS];
+
+static inline uint32_t profile_cycles(void) {
+  uint32_t cycles;
+#if defined(__arm__) && __ARM_ARCH >= 7
+  asm volatile("mrc p15, 0, %0, c9, c13, 0" : "=r"(cycles));
+#elif defined(__arm__)
+  asm volatile("mrc p15, 0, %0, c15, c12, 1" : "=r"(cycles));
+#elif defined(__x86_64__) || defined(__i386__)
+  cycles = (uint32_t)__builtin_ia32_rdtsc();
+#else
+  cycles = 0;
+#endif
+  return cycles;
+}
+
+#define PROFILE_BEGIN(section) \
+  do { \
+    if (profile_enabled) { \
+      profile_section_start = profile_cycles(); \
+    } \
+  } while (0)
+
+#define PROFILE_END(section) \
+  do { \
+    if (profile_enabled) { \
+      profile_section_cycles[section] += \
+         profile_cycles() - profile_section_start; \
+    } \
+  } while (0)
+
+void profile_enable(int enable);
+
+// Bracket waiting for vsync.
+void profile_wait_begin(void);
+void profile_wait_end(void);
+
+// Report visible raster lines emulated and actually drawn (not found
+// unchanged by the raster cache) this frame. May be called once per
+// display before profile_frame_end.
+void profile_lines(unsigned int lines, unsigned int drawn);
+
+// Called once per emulated frame after the frame has been handed
+// to the display.
+void profile_frame_end(void);
+
+// Write the recorded frame history as CSV. Returns 0 on success.
+int profile_dump(const char *path);
+
+#endif
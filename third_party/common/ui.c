@@ -105,6 +105,14 @@ static int menu_window_bottom[NUM_MENU_ROOTS];
 // The index of the last item + 1. Can't set cursor to this or higher.
 static int max_index[NUM_MENU_ROOTS];
 
+// Rows materialized for a VIRTUAL item, per menu stack index. A menu
+// holds at most one VIRTUAL item. Rows inside the window are always
+// consecutive so row % VIRTUAL_POOL_SIZE never collides while they
+// are showing. A row is only filled again when its slot changes hands.
+#define VIRTUAL_POOL_SIZE 32
+static struct menu_item *virtual_pool[NUM_MENU_ROOTS];
+static int virtual_pool_row[NUM_MENU_ROOTS][VIRTUAL_POOL_SIZE];
+
 static int pending_ui_key_head = 0;
 static int pending_ui_key_tail = 0;
 static long pending_ui_key[16];
@@ -881,6 +889,51 @@ struct menu_item *ui_menu_add_divider(struct menu_item *folder) {
   return new_item;
 }
 
+struct menu_item *ui_menu_add_virtual(int id, struct menu_item *folder,
+                                      int num_rows,
+                                      void (*fill_row)(struct menu_item *,
+                                                       int,
+                                                       struct menu_item *)) {
+  struct menu_item *new_item = ui_new_item(folder, "", id);
+  new_item->type = VIRTUAL;
+  new_item->num_rows = num_rows;
+  new_item->fill_row = fill_row;
+  append(folder, new_item);
+  return new_item;
+}
+
+static void ui_reset_virtual_pool(int stack_index) {
+  int i;
+  for (i = 0; i < VIRTUAL_POOL_SIZE; i++) {
+    virtual_pool_row[stack_index][i] = -1;
+  }
+}
+
+// Get the item standing in for row of a VIRTUAL item, filling it
+// if the slot held some other row.
+static struct menu_item *ui_virtual_row(int stack_index,
+                                        struct menu_item *virt, int row) {
+  if (virtual_pool[stack_index] == NULL) {
+    virtual_pool[stack_index] = (struct menu_item *)malloc(
+        VIRTUAL_POOL_SIZE * sizeof(struct menu_item));
+    ui_reset_virtual_pool(stack_index);
+  }
+
+  int slot = row % VIRTUAL_POOL_SIZE;
+  struct menu_item *item = &virtual_pool[stack_index][slot];
+  if (virtual_pool_row[stack_index][slot] != row) {
+    memset(item, 0, sizeof(struct menu_item));
+    item->id = virt->id;
+    item->menu_width = virt->menu_width;
+    item->menu_height = virt->menu_height;
+    item->menu_top = virt->menu_top;
+    item->menu_left = virt->menu_left;
+    virt->fill_row(virt, row, item);
+    virtual_pool_row[stack_index][slot] = row;
+  }
+  return item;
+}
+
 struct menu_item *ui_menu_add_text_field(int id, struct menu_item *folder,
                                          char *name, char *value_str) {
   struct menu_item *new_item = ui_new_item(folder, name, id);
@@ -891,107 +944,130 @@ struct menu_item *ui_menu_add_text_field(int id, struct menu_item *folder,
   return new_item;
 }
 
+// Draws one row of a menu at the given index which must be inside the
+// window.
+static void ui_render_row(struct menu_item *node,
+                          int stack_index, int index, int indent) {
+  int colour = node->disabled ? DISABLED_COLOR : FG_COLOR;
+
+  int y = (index - menu_window_top[stack_index]) * 8 + node->menu_top;
+  if (index == menu_cursor[stack_index]) {
+    ui_draw_rect(node->menu_left, y, node->menu_width, 8, HILITE_COLOR, 1);
+    menu_cursor_item[stack_index] = node;
+  }
+
+  // Special symbol drawn on left edge
+  if (node->symbol) {
+      ui_draw_char_raw(node->symbol,
+          node->menu_left+indent*8, y, colour, NULL, 0, 1);
+  }
+
+  // Sometimes, we only want to render the current item. Like when we
+  // are adjusting things that affect video and we want to see the display
+  // underneath the menu while we are making changes.
+  if (!ui_render_current_item_only ||
+      index == menu_cursor[stack_index]) {
+
+    ui_draw_text(node->name,
+       node->menu_left + (indent + 1) * 8, y, colour);
+
+    if (node->type == FOLDER) {
+      if (node->is_expanded)
+        ui_draw_text("-", node->menu_left + (indent)*8, y, colour);
+      else
+        ui_draw_text("+", node->menu_left + (indent)*8, y, colour);
+    } else if (node->type == TOGGLE) {
+      if (node->value) {
+        if (node->custom_toggle_label[1][0] == '\0') {
+           ui_draw_text("On",
+                     node->menu_left + node->menu_width -
+                     ui_text_width("On"), y, colour);
+        } else {
+           ui_draw_text(node->custom_toggle_label[1],
+                     node->menu_left + node->menu_width -
+                     ui_text_width(node->custom_toggle_label[1]), y,
+                                   colour);
+        }
+      } else {
+        if (node->custom_toggle_label[0][0] == '\0') {
+           ui_draw_text("Off", node->menu_left + node->menu_width -
+                     ui_text_width("Off"), y, colour);
+        } else {
+           ui_draw_text(node->custom_toggle_label[0],
+                     node->menu_left + node->menu_width -
+                     ui_text_width(node->custom_toggle_label[0]), y,
+                                   colour);
+        }
+      }
+    } else if (node->type == CHECKBOX) {
+      if (node->value)
+        ui_draw_text("True", node->menu_left + node->menu_width -
+                                 ui_text_width("True"),
+                     y, colour);
+      else
+        ui_draw_text("False", node->menu_left + node->menu_width -
+                                  ui_text_width("False"),
+                     y, colour);
+    } else if (node->type == RANGE) {
+      if (node->divisor == 1) {
+         sprintf(node->scratch, "%d", node->value);
+      } else {
+         // TODO: Don't assume 3 decimal places. Use divisor.
+         sprintf(node->scratch, "%.3f",
+            (float)node->value / (float)node->divisor);
+      }
+      ui_draw_text(node->scratch, node->menu_left + node->menu_width -
+                                      ui_text_width(node->scratch),
+                   y, colour);
+    } else if (node->type == MULTIPLE_CHOICE) {
+      ui_draw_text(node->choices[node->value],
+                   node->menu_left + node->menu_width -
+                       ui_text_width(node->choices[node->value]),
+                   y, colour);
+    } else if (node->type == DIVIDER) {
+      ui_draw_rect(node->menu_left, y + 3, node->menu_width, 2, BORDER_COLOR, 1);
+    } else if (node->type == BUTTON) {
+      char *dsp_string = get_button_display_str(node);
+      ui_draw_text(dsp_string, node->menu_left + node->menu_width -
+                                   ui_text_width(dsp_string),
+                   y, colour);
+    } else if (node->type == TEXTFIELD) {
+      // draw cursor underneath text
+      ui_draw_rect(node->menu_left + ui_text_width(node->name) + 8 +
+                       node->value * 8,
+                   y, 8, 8, BORDER_COLOR, 1);
+      ui_draw_text(node->str_value,
+                   node->menu_left + ui_text_width(node->name) + 8, y,
+                   colour);
+    }
+  }
+}
+
 static void ui_render_children(struct menu_item *node,
                                int stack_index, int *index, int indent) {
   while (node != NULL) {
     node->render_index = *index;
 
-    int colour = node->disabled ? DISABLED_COLOR : FG_COLOR;
+    if (node->type == VIRTUAL) {
+      // Only the rows inside the window are materialized.
+      int first = menu_window_top[stack_index] - *index;
+      int last = menu_window_bottom[stack_index] - *index;
+      if (first < 0) first = 0;
+      if (last > node->num_rows) last = node->num_rows;
+      for (int row = first; row < last; row++) {
+        struct menu_item *item = ui_virtual_row(stack_index, node, row);
+        item->render_index = *index + row;
+        ui_render_row(item, stack_index, *index + row, indent);
+      }
+      *index = *index + node->num_rows;
+      node = node->next;
+      continue;
+    }
 
     // Render a row
     if (*index >= menu_window_top[stack_index] &&
         *index < menu_window_bottom[stack_index]) {
-      int y = (*index - menu_window_top[stack_index]) * 8 + node->menu_top;
-      if (*index == menu_cursor[stack_index]) {
-        ui_draw_rect(node->menu_left, y, node->menu_width, 8, HILITE_COLOR, 1);
-        menu_cursor_item[stack_index] = node;
-      }
-
-      // Special symbol drawn on left edge
-      if (node->symbol) {
-          ui_draw_char_raw(node->symbol,
-              node->menu_left+indent*8, y, colour, NULL, 0, 1);
-      }
-
-      // Sometimes, we only want to render the current item. Like when we
-      // are adjusting things that affect video and we want to see the display
-      // underneath the menu while we are making changes.
-      if (!ui_render_current_item_only ||
-          *index == menu_cursor[stack_index]) {
-
-        ui_draw_text(node->name,
-           node->menu_left + (indent + 1) * 8, y, colour);
-
-        if (node->type == FOLDER) {
-          if (node->is_expanded)
-            ui_draw_text("-", node->menu_left + (indent)*8, y, colour);
-          else
-            ui_draw_text("+", node->menu_left + (indent)*8, y, colour);
-        } else if (node->type == TOGGLE) {
-          if (node->value) {
-            if (node->custom_toggle_label[1][0] == '\0') {
-               ui_draw_text("On",
-                         node->menu_left + node->menu_width -
-                         ui_text_width("On"), y, colour);
-            } else {
-               ui_draw_text(node->custom_toggle_label[1],
-                         node->menu_left + node->menu_width -
-                         ui_text_width(node->custom_toggle_label[1]), y,
-                                       colour);
-            }
-          } else {
-            if (node->custom_toggle_label[0][0] == '\0') {
-               ui_draw_text("Off", node->menu_left + node->menu_width -
-                         ui_text_width("Off"), y, colour);
-            } else {
-               ui_draw_text(node->custom_toggle_label[0],
-                         node->menu_left + node->menu_width -
-                         ui_text_width(node->custom_toggle_label[0]), y,
-                                       colour);
-            }
-          }
-        } else if (node->type == CHECKBOX) {
-          if (node->value)
-            ui_draw_text("True", node->menu_left + node->menu_width -
-                                     ui_text_width("True"),
-                         y, colour);
-          else
-            ui_draw_text("False", node->menu_left + node->menu_width -
-                                      ui_text_width("False"),
-                         y, colour);
-        } else if (node->type == RANGE) {
-          if (node->divisor == 1) {
-             sprintf(node->scratch, "%d", node->value);
-          } else {
-             // TODO: Don't assume 3 decimal places. Use divisor.
-             sprintf(node->scratch, "%.3f",
-                (float)node->value / (float)node->divisor);
-          }
-          ui_draw_text(node->scratch, node->menu_left + node->menu_width -
-                                          ui_text_width(node->scratch),
-                       y, colour);
-        } else if (node->type == MULTIPLE_CHOICE) {
-          ui_draw_text(node->choices[node->value],
-                       node->menu_left + node->menu_width -
-                           ui_text_width(node->choices[node->value]),
-                       y, colour);
-        } else if (node->type == DIVIDER) {
-          ui_draw_rect(node->menu_left, y + 3, node->menu_width, 2, BORDER_COLOR, 1);
-        } else if (node->type == BUTTON) {
-          char *dsp_string = get_button_display_str(node);
-          ui_draw_text(dsp_string, node->menu_left + node->menu_width -
-                                       ui_text_width(dsp_string),
-                       y, colour);
-        } else if (node->type == TEXTFIELD) {
-          // draw cursor underneath text
-          ui_draw_rect(node->menu_left + ui_text_width(node->name) + 8 +
-                           node->value * 8,
-                       y, 8, 8, BORDER_COLOR, 1);
-          ui_draw_text(node->str_value,
-                       node->menu_left + ui_text_width(node->name) + 8, y,
-                       colour);
-        }
-      }
+      ui_render_row(node, stack_index, *index, indent);
     }
 
     *index = *index + 1;
@@ -1129,6 +1205,19 @@ static void ui_traverse_children(struct menu_item *node, int *index) {
   while (node != NULL) {
     node->render_index = *index;
 
+    if (node->type == VIRTUAL) {
+      int row = menu_cursor[current_menu] - *index;
+      if (row >= 0 && row < node->num_rows &&
+          menu_cursor[current_menu] >= menu_window_top[current_menu] &&
+          menu_cursor[current_menu] < menu_window_bottom[current_menu]) {
+        menu_cursor_item[current_menu] =
+            ui_virtual_row(current_menu, node, row);
+      }
+      *index = *index + node->num_rows;
+      node = node->next;
+      continue;
+    }
+
     if (*index >= menu_window_top[current_menu] &&
         *index < menu_window_bottom[current_menu]) {
       if (*index == menu_cursor[current_menu]) {
@@ -1179,6 +1268,8 @@ static void ui_clear_menu(int menu_index) {
   struct menu_item *node = &menu_roots[menu_index];
   ui_clear_child_menu(node->first_child);
   node->first_child = NULL;
+  // Items handed out from the pool stay readable until refilled.
+  ui_reset_virtual_pool(menu_index);
 }
 
 struct menu_item *ui_pop_menu(void) {
@@ -49,6 +49,7 @@ typedef enum menu_item_type {
   FOLDER,          // contains sub-items/folders
   DIVIDER,         // just a line
   TEXTFIELD,       // editable text field
+  VIRTUAL,         // a run of rows filled in on demand
 } menu_item_type;
 
 struct menu_item {
@@ -91,6 +92,12 @@ struct menu_item {
   int is_expanded;
   struct menu_item *first_child;
 
+  // For VIRTUAL. Stands in for num_rows items. Only rows that are
+  // visible (or under the cursor) are materialized by fill_row into
+  // a small pool of items owned by the menu stack.
+  int num_rows;
+  void (*fill_row)(struct menu_item *virt, int row, struct menu_item *dest);
+
   // For all
   struct menu_item *next;
 
@@ -160,6 +167,11 @@ struct menu_item *ui_menu_add_folder(struct menu_item *folder, char *name);
 struct menu_item *ui_menu_add_divider(struct menu_item *folder);
 struct menu_item *ui_menu_add_text_field(int id, struct menu_item *folder,
                                          char *name, char *value);
+struct menu_item *ui_menu_add_virtual(int id, struct menu_item *folder,
+                                      int num_rows,
+                                      void (*fill_row)(struct menu_item *,
+                                                       int,
+                                                       struct menu_item *));
 
 // Move ownership of all children from src onto dest
 void ui_add_all(struct menu_item *src, struct menu_item *dest);
@@ -10,10 +10,15 @@
 #include "../common/emux_api.h"
 #include "../common/keycodes.h"
 #include "../common/overlay.h"
+#include "../common/profile.h"
 #include "../common/demo.h"
 #include "../common/menu.h"
 #include "../common/kbd.h"
 
+#define dmb() __asm__ volatile ("dmb" ::: "memory")
+#define sev() __asm__ volatile ("dsb\n\tsev" ::: "memory")
+#define wfe() __asm__ volatile ("wfe")
+
 static Plus4VM            *vm = NULL;
 static Plus4VideoDecoder  *videoDecoder = NULL;
 
@@ -392,11 +397,156 @@ static void vmError(void)
   exit(-1);
 }
 
+// Once core 3 is up, the SID and the audio converter run there (see
+// emu_sid_worker). The samples it produces are handed back through this
+// ring and written out by the emulation core once per frame.
+#define AUDIO_RING_SIZE 8192
+#define AUDIO_RING_MASK (AUDIO_RING_SIZE - 1)
+
+static struct {
+  int16_t buf[AUDIO_RING_SIZE];
+  volatile unsigned head; // written by core 3
+  volatile unsigned tail; // written by core 1
+  volatile int vm_ready;
+  volatile int worker_ready;
+  volatile int enabled;
+} sid_worker;
+
+// Runs on core 3. Never returns.
+void emu_sid_worker(void) {
+  while (!sid_worker.vm_ready) {
+    wfe();
+  }
+  dmb();
+  sid_worker.worker_ready = 1;
+
+  for (;;) {
+    if (!Plus4VM_RunSIDWorker(vm)) {
+      wfe();
+    }
+  }
+}
+
+// Called between Plus4VM_Run calls, never from inside the TED.
+static void sid_worker_check(void) {
+  if (!sid_worker.enabled && sid_worker.worker_ready) {
+    Plus4VM_SetSIDWorker(vm, 1);
+    sid_worker.enabled = 1;
+  }
+}
+
+// Write out what the worker has produced so far.
+static void sid_worker_drain(void) {
+  if (!sid_worker.enabled) {
+    return;
+  }
+  unsigned head = sid_worker.head;
+  unsigned tail = sid_worker.tail;
+  dmb();
+  PROFILE_BEGIN(PROFILE_SOUND);
+  while (tail != head) {
+    unsigned i = tail & AUDIO_RING_MASK;
+    unsigned n = head - tail;
+    if (n > AUDIO_RING_SIZE - i) {
+      n = AUDIO_RING_SIZE - i;
+    }
+    circle_sound_write(&sid_worker.buf[i], n);
+    tail += n;
+  }
+  PROFILE_END(PROFILE_SOUND);
+  dmb();
+  sid_worker.tail = tail;
+}
+
 static void audioOutputCallback(void *userData,
                                 const int16_t *buf, size_t nFrames)
 {
-  if (!ui_warp)
-     circle_sound_write((int16_t*)buf, nFrames);
+  if (ui_warp) {
+    return;
+  }
+  if (sid_worker.enabled) {
+     // On core 3. The ring holds several frames, anything that does
+     // not fit is dropped.
+     unsigned head = sid_worker.head;
+     unsigned space = AUDIO_RING_SIZE - (head - sid_worker.tail);
+     size_t n;
+     dmb();
+     if (nFrames > space) {
+       nFrames = space;
+     }
+     for (n = 0; n < nFrames; n++) {
+       sid_worker.buf[(head + n) & AUDIO_RING_MASK] = buf[n];
+     }
+     dmb();
+     sid_worker.head = head + nFrames;
+     return;
+  }
+  PROFILE_BEGIN(PROFILE_SOUND);
+  circle_sound_write((int16_t*)buf, nFrames);
+  PROFILE_END(PROFILE_SOUND);
+}
+
+// Lines are decoded into the frame buffer by core 2 when it is
+// available (see emu_video_line_worker). The TED's raw line data is
+// copied into this ring and the worker converts it while the emulator
+// carries on. Lines are decoded in order since with raster_skip off,
+// two lines land on the same row and the later one must win.
+#define LINE_QUEUE_SIZE 64
+#define LINE_QUEUE_MASK (LINE_QUEUE_SIZE - 1)
+
+static struct {
+  Plus4VideoLineData *line[LINE_QUEUE_SIZE];
+  uint8_t *dst[LINE_QUEUE_SIZE];
+  volatile unsigned head; // written by core 1
+  volatile unsigned tail; // written by core 2
+  volatile int allocated;
+  volatile int worker_ready;
+} line_queue;
+
+static void line_queue_init(void) {
+  int i;
+  for (i = 0; i < LINE_QUEUE_SIZE; i++) {
+    line_queue.line[i] = Plus4VideoLineData_Create();
+    if (!line_queue.line[i])
+      errorMessage("could not create video line buffer");
+  }
+  dmb();
+  line_queue.allocated = 1;
+  sev();
+}
+
+// Wait for the worker to finish every line queued so far.
+static void line_queue_join(void) {
+  if (!line_queue.worker_ready) {
+    return;
+  }
+  while (line_queue.tail != line_queue.head) {
+    wfe();
+  }
+  dmb();
+}
+
+// Runs on core 2. Never returns.
+void emu_video_line_worker(void) {
+  while (!line_queue.allocated) {
+    wfe();
+  }
+  dmb();
+  line_queue.worker_ready = 1;
+
+  for (;;) {
+    unsigned tail = line_queue.tail;
+    while (tail == line_queue.head) {
+      wfe();
+    }
+    dmb();
+    int i = tail & LINE_QUEUE_MASK;
+    Plus4VideoDecoder_DecodeLine(videoDecoder, line_queue.dst[i], 384,
+                                 line_queue.line[i]);
+    dmb();
+    line_queue.tail = tail + 1;
+    sev();
+  }
 }
 
 static void videoLineCallback(void *userData,
@@ -408,15 +558,35 @@ static void videoLineCallback(void *userData,
       lineNum = lineNum - raster_low;
    }
    if (lineNum >= 0 && lineNum < vertical_res) {
-     Plus4VideoDecoder_DecodeLine(videoDecoder, fb_buf + lineNum * fb_pitch, 384, lineData);
+     PROFILE_BEGIN(PROFILE_RASTER);
+     uint8_t *dst = fb_buf + lineNum * fb_pitch;
+     if (line_queue.worker_ready) {
+       unsigned head = line_queue.head;
+       while (head - line_queue.tail == LINE_QUEUE_SIZE) {
+         wfe();
+       }
+       dmb();
+       int i = head & LINE_QUEUE_MASK;
+       Plus4VideoLineData_Copy(line_queue.line[i], lineData);
+       line_queue.dst[i] = dst;
+       dmb();
+       line_queue.head = head + 1;
+       sev();
+     } else {
+       Plus4VideoDecoder_DecodeLine(videoDecoder, dst, 384, lineData);
+     }
+     PROFILE_END(PROFILE_RASTER);
    }
 }
 
 static void videoFrameCallback(void *userData)
 {
+  line_queue_join();
+  sid_worker_drain();
   circle_frames_ready_fbl(FB_LAYER_VIC,
                           -1 /* no 2nd layer */,
                           !ui_warp /* sync */);
+  profile_frame_end();
 
   // Something is waiting for vsync, ack and return.
   if (wait_vsync) {
@@ -430,7 +600,9 @@ static void videoFrameCallback(void *userData)
   if (ui_enabled) {
     // The only way we can be here and have ui_enabled=1
     // is for an osd to be enabled.
+    PROFILE_BEGIN(PROFILE_UI);
     ui_render_now(-1); // only render top most menu
+    PROFILE_END(PROFILE_UI);
     circle_frames_ready_fbl(FB_LAYER_UI, -1 /* no 2nd layer */,
        0 /* no sync */);
     ui_check_key();
@@ -739,6 +911,7 @@ int main_program(int argc, char **argv)
       Plus4VideoDecoder_Create(&videoLineCallback, &videoFrameCallback, NULL);
   if (!videoDecoder)
     errorMessage("could not create video decoder object");
+  line_queue_init();
   Plus4VM_SetVideoOutputCallback(vm, &Plus4VideoDecoder_VideoCallback,
                                  (void *) videoDecoder);
 
@@ -773,8 +946,13 @@ int main_program(int argc, char **argv)
 
   circle_boot_complete();
 
+  dmb();
+  sid_worker.vm_ready = 1;
+  sev();
+
   assert(time_advance > 0);
   for(;;) {
+    sid_worker_check();
     Plus4VM_Run(vm, time_advance);
   }
 
@@ -1117,6 +1295,8 @@ void emux_add_sound_options(struct menu_item* parent) {
 }
 
 void emux_video_color_setting_changed(int display_num) {
+  // The worker reads the colormap we are about to rebuild.
+  line_queue_join();
   Plus4VideoDecoder_UpdatePalette(videoDecoder);
   // Plus4Emu doesn't use an indexed palette so we have to allow
   // the decoder to draw a frame after we change a color param.
@@ -1340,6 +1520,9 @@ void emux_set_int(IntSetting setting, int value) {
     case Setting_VideoFilter:
        crt_filter = value;
        break;
+    case Setting_MachineVideoStandard:
+       // Only read at start up. circle_apply_options won't change it.
+       break;
     default:
        printf ("Unhandled set int %d\n", setting);
   }
@@ -1367,6 +1550,8 @@ void emux_get_int(IntSetting setting, int* dest) {
           break;
       case Setting_DriveSoundEmulation:
       case Setting_DriveSoundEmulationVolume:
+      case Setting_DriveAsync:
+      case Setting_DriveAsyncLookahead:
           *dest = 0;
           // Not applicable
           break;
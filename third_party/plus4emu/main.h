@@ -3,4 +3,12 @@
 
 int main_program(int argc, char* argv[]);
 
+// Decodes video lines queued by the emulator. Called on a spare core
+// and never returns.
+void emu_video_line_worker(void);
+
+// Runs SID synthesis for the emulator. Called on a spare core and never
+// returns.
+void emu_sid_worker(void);
+
 #endif
@@ -409,6 +409,7 @@ extern "C" PLUS4EMU_EXPORT Plus4Emu_Error Plus4VM_SetAudioOutputQuality(
     Plus4VM *vm, int n)
 {
   try {
+    vm->getVM().syncSIDWorker();
     vm->getVM().setAudioOutputHighQuality(bool(n));
   }
   catch (std::exception& e) {
@@ -424,6 +425,7 @@ extern "C" PLUS4EMU_EXPORT Plus4Emu_Error Plus4VM_SetAudioSampleRate(
     Plus4VM *vm, float sampleRate)
 {
   try {
+    vm->getVM().syncSIDWorker();
     vm->getAudioOutput().setParameters(-1, sampleRate);
   }
   catch (std::exception& e) {
@@ -456,24 +458,28 @@ extern "C" PLUS4EMU_EXPORT Plus4Emu_Error Plus4VM_SetAudioOutputFile(
 extern "C" PLUS4EMU_EXPORT void Plus4VM_SetAudioOutputFilters(
     Plus4VM *vm, float dcBlockFreq1, float dcBlockFreq2)
 {
+  vm->getVM().syncSIDWorker();
   vm->getVM().setAudioOutputFilters(dcBlockFreq1, dcBlockFreq2);
 }
 
 extern "C" PLUS4EMU_EXPORT void Plus4VM_SetAudioOutputEqualizer(
     Plus4VM *vm, int mode, float freq, float level, float q)
 {
+  vm->getVM().syncSIDWorker();
   vm->getVM().setAudioOutputEqualizer(mode, freq, level, q);
 }
 
 extern "C" PLUS4EMU_EXPORT void Plus4VM_SetAudioOutputVolume(
     Plus4VM *vm, float ampScale)
 {
+  vm->getVM().syncSIDWorker();
   vm->getVM().setAudioOutputVolume(ampScale);
 }
 
 extern "C" PLUS4EMU_EXPORT void Plus4VM_SetEnableAudioOutput(
     Plus4VM *vm, int isEnabled)
 {
+  vm->getVM().syncSIDWorker();
   vm->getVM().setEnableAudioOutput(bool(isEnabled));
 }
 
@@ -517,6 +523,22 @@ extern "C" PLUS4EMU_EXPORT void Plus4VM_SetEnableSIDEmulation(
     vm->getVM().disableSIDEmulation();
 }
 
+extern "C" PLUS4EMU_EXPORT void Plus4VM_SetSIDWorker(
+    Plus4VM *vm, int isEnabled)
+{
+  vm->getVM().setSIDWorker(bool(isEnabled));
+}
+
+extern "C" PLUS4EMU_EXPORT int Plus4VM_RunSIDWorker(Plus4VM *vm)
+{
+  return int(vm->getVM().runSIDWorker());
+}
+
+extern "C" PLUS4EMU_EXPORT void Plus4VM_SyncSIDWorker(Plus4VM *vm)
+{
+  vm->getVM().syncSIDWorker();
+}
+
 extern "C" PLUS4EMU_EXPORT Plus4Emu_Error Plus4VM_KeyboardEvent(
     Plus4VM *vm, int keyCode, int isPressed)
 {
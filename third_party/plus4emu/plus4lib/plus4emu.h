@@ -236,6 +236,22 @@ PLUS4EMU_EXPORT void Plus4VM_SetSIDConfiguration(
  * the SID emulation to reduce CPU usage.
  */
 PLUS4EMU_EXPORT void Plus4VM_SetEnableSIDEmulation(Plus4VM *vm, int isEnabled);
+/*!
+ * Move SID synthesis and audio output conversion off the emulation thread
+ * (1) or back (0). When enabled, another thread must call
+ * Plus4VM_RunSIDWorker() in a loop, and the audio output callback is called
+ * from that thread.
+ */
+PLUS4EMU_EXPORT void Plus4VM_SetSIDWorker(Plus4VM *vm, int isEnabled);
+/*!
+ * Process the SID events queued by the emulation thread. Returns zero if
+ * there was nothing to do.
+ */
+PLUS4EMU_EXPORT int Plus4VM_RunSIDWorker(Plus4VM *vm);
+/*!
+ * Wait until the SID worker thread has processed all queued events.
+ */
+PLUS4EMU_EXPORT void Plus4VM_SyncSIDWorker(Plus4VM *vm);
 /*!
  * Set the state of key 'keyCode' (0 to 127) to pressed (1) or released (0).
  * See config/p4_keys.cfg for the list of valid key codes.
@@ -39,6 +39,33 @@
 #include "system.hpp"
 #include "charconv.hpp"
 
+// Memory barriers and events for the SID job queue (see
+// Plus4VM::setSIDWorker()).
+#if defined(__arm__)
+#  define SID_JOB_DMB()     __asm__ volatile ("dmb" ::: "memory")
+#  define SID_JOB_SEV()     __asm__ volatile ("dsb\n\tsev" ::: "memory")
+#  define SID_JOB_WFE()     __asm__ volatile ("wfe")
+#else
+#  define SID_JOB_DMB()     __sync_synchronize()
+#  define SID_JOB_SEV()     do { } while (0)
+#  define SID_JOB_WFE()     do { } while (0)
+#endif
+
+// SID job queue entries are 32-bit words, the event type is in the top
+// two bits:
+//   0: run the SID for the number of clocks in bits 0 to 29
+//   1: run the SID for the number of clocks in bits 16 to 29, then mix
+//      and output the TED sample in bits 0 to 15
+//   2: write the value in bits 0 to 7 to the SID register in bits 8 to 12
+//   3: the next word is tape feedback to be mixed into the next sample
+#define SID_JOB_CLOCK       0x00000000U
+#define SID_JOB_SAMPLE      0x40000000U
+#define SID_JOB_WRITE       0x80000000U
+#define SID_JOB_TAPE        0xC0000000U
+#define SID_JOB_TYPE_MASK   0xC0000000U
+// the queue is published (and the tail updated) at least this often
+#define SID_JOB_BATCH       512U
+
 static void writeDemoTimeCnt(Plus4Emu::File::Buffer& buf, uint64_t n)
 {
   uint64_t  mask = uint64_t(0x7F) << 49;
@@ -98,15 +125,13 @@ namespace Plus4 {
 
   void Plus4VM::TED7360_::playSample(int16_t sampleValue)
   {
-    int32_t tmp = vm.soundOutputAccumulator;
-    if (tmp != 0) {
-      vm.soundOutputAccumulator = 0;
-      tmp = (tmp >= -1048576 ? (tmp < 1048576 ? tmp : 1048576) : -1048576);
-      tmp = int32_t((uint32_t(tmp * vm.sidOutputVolume)
-                     + uint32_t(0x80004000UL)) >> 15) - int32_t(65536);
+    if (vm.sidJobsEnabled) {
+      vm.sidJobSample(sampleValue);
+      return;
     }
-    vm.soundOutputSignal = tmp + int32_t(sampleValue);
-    vm.sendMonoAudioOutput(vm.soundOutputSignal);
+    int32_t tmp = vm.tapeOutputAccumulator;
+    vm.tapeOutputAccumulator = 0;
+    vm.sendSoundOutput(tmp, sampleValue);
   }
 
   void Plus4VM::TED7360_::videoOutputCallback(const uint8_t *buf, size_t nBytes)
@@ -150,6 +175,7 @@ namespace Plus4 {
           ted.dataBusState = ted.vm.digiBlasterOutput;
         }
         else if (!(ted.vm.isRecordingDemo | ted.vm.isPlayingDemo)) {
+          ted.vm.syncSIDWorker();
           int     tmp = ted.vm.soundOutputSignal;
           tmp += 32768;
           tmp = (tmp >= 0 ? (tmp < 65536 ? tmp : 65535) : 0);
@@ -159,8 +185,10 @@ namespace Plus4 {
           ted.dataBusState = 0x80;
         }
       }
-      else
+      else {
+        ted.vm.syncSIDWorker();
         ted.dataBusState = uint8_t(ted.vm.sid_->read(regNum));
+      }
     }
     return ted.dataBusState;
   }
@@ -172,12 +200,15 @@ namespace Plus4 {
     ted.dataBusState = value;
     if (PLUS4EMU_UNLIKELY(!ted.vm.sidEnabled)) {
       ted.vm.sidEnabled = true;
-      if (!(ted.vm.sidFlags & 4))
-        ted.setCallback(&SID::clockCallback, ted.vm.sid_, 1);
-      else
-        ted.setCallback(&(ted.vm.sidCallbackC64), &(ted.vm), 1);
+      ted.vm.updateSIDCallbacks();
     }
     uint8_t regNum = uint8_t(addr & 0x001F);
+    if (ted.vm.sidJobsEnabled) {
+      if (regNum == 0x1E)
+        ted.vm.digiBlasterOutput = value;
+      ted.vm.sidJobWrite(regNum, value);
+      return;
+    }
     if (regNum == 0x1E) {
       ted.vm.digiBlasterOutput = value;
       if (ted.vm.digiBlasterEnabled)
@@ -396,6 +427,8 @@ namespace Plus4 {
 
   void Plus4VM::updateTimingParameters(bool ntscMode_)
   {
+    // the SID worker uses the audio converter and the clock frequency
+    syncSIDWorker();
     size_t  singleClockFreq = tedInputClockFrequency;
     if (!ntscMode_)
       singleClockFreq = ((singleClockFreq + 40) / 80) << 2;
@@ -497,7 +530,7 @@ namespace Plus4 {
       vm.tapeFeedbackSignal = (tapeFeedback ?
                                vm.tapeFeedbackMult : int32_t(0));
     }
-    vm.soundOutputAccumulator += vm.tapeFeedbackSignal;
+    vm.tapeOutputAccumulator += vm.tapeFeedbackSignal;
   }
 
   PLUS4EMU_REGPARM1 void Plus4VM::sidCallbackC64(void *userData)
@@ -517,6 +550,173 @@ namespace Plus4 {
     SID::clockCallback(vm.sid_);
   }
 
+  PLUS4EMU_REGPARM1 void Plus4VM::sidCallbackJob(void *userData)
+  {
+    Plus4VM&  vm = *(reinterpret_cast<Plus4VM *>(userData));
+    vm.sidJobClocks++;
+  }
+
+  void Plus4VM::updateSIDCallbacks()
+  {
+    bool    c64Clock = bool(sidFlags & 4);
+    ted->setCallback(&SID::clockCallback, sid_,
+                     int(sidEnabled && !sidJobsEnabled && !c64Clock));
+    ted->setCallback(&sidCallbackC64, this,
+                     int(sidEnabled && !sidJobsEnabled && c64Clock));
+    ted->setCallback(&sidCallbackJob, this,
+                     int(sidEnabled && sidJobsEnabled));
+  }
+
+  void Plus4VM::sendSoundOutput(int32_t tapeSignal, int16_t tedOutput)
+  {
+    int32_t tmp = soundOutputAccumulator + tapeSignal;
+    if (tmp != 0) {
+      tmp = (tmp >= -1048576 ? (tmp < 1048576 ? tmp : 1048576) : -1048576);
+      tmp = int32_t((uint32_t(tmp * sidOutputVolume)
+                     + uint32_t(0x80004000UL)) >> 15) - int32_t(65536);
+    }
+    soundOutputAccumulator = 0;
+    soundOutputSignal = tmp + int32_t(tedOutput);
+    sendMonoAudioOutput(soundOutputSignal);
+  }
+
+  // --------------------------------------------------------------------------
+
+  void Plus4VM::sidJobWaitSpace()
+  {
+    sidJobPublish();
+    while ((sidJobLimit = sidJobTail + sidJobBufSize) == sidJobPos)
+      SID_JOB_WFE();
+    // the worker is done with the slots we are about to reuse
+    SID_JOB_DMB();
+  }
+
+  void Plus4VM::sidJobPublish()
+  {
+    SID_JOB_DMB();
+    sidJobHead = sidJobPos;
+    SID_JOB_SEV();
+  }
+
+  void Plus4VM::sidJobFlushClocks()
+  {
+    if (sidJobClocks) {
+      sidJobPush(SID_JOB_CLOCK | sidJobClocks);
+      sidJobClocks = 0;
+    }
+  }
+
+  void Plus4VM::sidJobSample(int16_t sampleValue)
+  {
+    if (PLUS4EMU_UNLIKELY(tapeOutputAccumulator != 0)) {
+      sidJobPush(SID_JOB_TAPE);
+      sidJobPush(uint32_t(tapeOutputAccumulator));
+      tapeOutputAccumulator = 0;
+    }
+    if (PLUS4EMU_UNLIKELY(sidJobClocks > 0x3FFFU))
+      sidJobFlushClocks();
+    sidJobPush(SID_JOB_SAMPLE | (sidJobClocks << 16) | uint16_t(sampleValue));
+    sidJobClocks = 0;
+    if ((sidJobPos - sidJobHead) >= SID_JOB_BATCH)
+      sidJobPublish();
+  }
+
+  void Plus4VM::sidJobWrite(uint8_t regNum, uint8_t value)
+  {
+    sidJobFlushClocks();
+    sidJobPush(SID_JOB_WRITE | (uint32_t(regNum) << 8) | value);
+  }
+
+  void Plus4VM::runSIDClocks(uint32_t n)
+  {
+    if (sidFlags & 4) {
+      while (n--)
+        sidCallbackC64(this);
+    }
+    else {
+      while (n--)
+        SID::clockCallback(sid_);
+    }
+  }
+
+  void Plus4VM::setSIDWorker(bool isEnabled)
+  {
+    if (isEnabled == sidJobsEnabled)
+      return;
+    syncSIDWorker();
+    if (isEnabled && !sidJobBuf) {
+      sidJobBuf = new uint32_t[sidJobBufSize];
+      sidJobTapeSignal = 0;
+      SID_JOB_DMB();
+    }
+    sidJobClocks = 0;
+    sidJobLimit = sidJobTail + sidJobBufSize;
+    sidJobsEnabled = isEnabled;
+    updateSIDCallbacks();
+  }
+
+  bool Plus4VM::runSIDWorker()
+  {
+    if (!sidJobBuf)
+      return false;
+    uint32_t  head = sidJobHead;
+    uint32_t  tail = sidJobTail;
+    if (head == tail)
+      return false;
+    SID_JOB_DMB();
+    while (tail != head) {
+      uint32_t  w = sidJobBuf[tail & (sidJobBufSize - 1U)];
+      switch (w & SID_JOB_TYPE_MASK) {
+      case SID_JOB_CLOCK:
+        runSIDClocks(w & 0x3FFFFFFFU);
+        break;
+      case SID_JOB_SAMPLE:
+        runSIDClocks((w >> 16) & 0x3FFFU);
+        sendSoundOutput(sidJobTapeSignal, int16_t(w & 0xFFFFU));
+        sidJobTapeSignal = 0;
+        break;
+      case SID_JOB_WRITE:
+        {
+          uint8_t regNum = uint8_t((w >> 8) & 0x1F);
+          uint8_t value = uint8_t(w & 0xFF);
+          if (regNum == 0x1E && digiBlasterEnabled)
+            sid_->input((int(value) << 8) - 32768);
+          sid_->write(regNum, value);
+        }
+        break;
+      default:
+        // the value may not have been published yet
+        if ((tail + 1U) == head)
+          goto done;
+        tail++;
+        sidJobTapeSignal = int32_t(sidJobBuf[tail & (sidJobBufSize - 1U)]);
+        break;
+      }
+      tail++;
+      if (!(tail & (SID_JOB_BATCH - 1U))) {
+        SID_JOB_DMB();
+        sidJobTail = tail;
+        SID_JOB_SEV();
+      }
+    }
+  done:
+    SID_JOB_DMB();
+    sidJobTail = tail;
+    SID_JOB_SEV();
+    return true;
+  }
+
+  void Plus4VM::syncSIDWorker()
+  {
+    if (!sidJobsEnabled)
+      return;
+    sidJobFlushClocks();
+    sidJobPublish();
+    while (sidJobTail != sidJobHead)
+      SID_JOB_WFE();
+    SID_JOB_DMB();
+  }
+
   PLUS4EMU_REGPARM1 void Plus4VM::demoPlayCallback(void *userData)
   {
     Plus4VM&  vm = *(reinterpret_cast<Plus4VM *>(userData));
@@ -831,6 +1031,15 @@ namespace Plus4 {
       digiBlasterOutput(0x80),
       sidCycleCnt(4),
       sidFlags(0),
+      tapeOutputAccumulator(0),
+      sidJobBuf((uint32_t *) 0),
+      sidJobHead(0U),
+      sidJobTail(0U),
+      sidJobPos(0U),
+      sidJobLimit(0U),
+      sidJobClocks(0U),
+      sidJobTapeSignal(0),
+      sidJobsEnabled(false),
       is1541HighAccuracy(true),
       serialBusDelayOffset(0),
       floppyROM_1541((uint8_t *) 0),
@@ -932,6 +1141,8 @@ namespace Plus4 {
     delete iecDrive8;
     delete iecDrive9;
     delete sid_;
+    if (sidJobBuf)
+      delete[] sidJobBuf;
     if (videoBreakPoints)
       delete[] videoBreakPoints;
   }
@@ -974,6 +1185,7 @@ namespace Plus4 {
     stopDemoPlayback();         // TODO: should be recorded as an event ?
     stopDemoRecording(false);
     removePasteTextCallback();
+    syncSIDWorker();
     ted->reset(isColdReset);
     setTapeMotorState(false);
     sid_->reset();
@@ -981,8 +1193,7 @@ namespace Plus4 {
     sid_->input(0);
     if (isColdReset) {
       sidEnabled = false;
-      ted->setCallback(&SID::clockCallback, sid_, 0);
-      ted->setCallback(&sidCallbackC64, this, 0);
+      updateSIDCallbacks();
       disableUnusedFloppyDrives();
     }
     resetFloppyDrive(-1);
@@ -1143,6 +1354,7 @@ namespace Plus4 {
       return;
     stopDemoPlayback();         // changing configuration implies stopping
     stopDemoRecording(false);   // any demo playback or recording
+    syncSIDWorker();
     tedInputClockFrequency = freq;
     updateTimingParameters(ted->getIsNTSCMode());
   }
@@ -1160,6 +1372,7 @@ namespace Plus4 {
   void Plus4VM::setSIDConfiguration(uint8_t sidFlags_, bool enableDigiBlaster,
                                     int outputVolume)
   {
+    syncSIDWorker();
     sidFlags_ = sidFlags_ & 7;
     if (sidFlags_ != sidFlags) {
       uint8_t changeMask = sidFlags_ ^ sidFlags;
@@ -1173,10 +1386,8 @@ namespace Plus4 {
         stopDemoRecording(false);
         if (changeMask & 2)
           ted->setEnableC64CompatibleSID(bool(sidFlags_ & 2));
-        if (sidEnabled && (changeMask & 4) != 0) {
-          ted->setCallback(&SID::clockCallback, sid_, int(!(sidFlags_ & 4)));
-          ted->setCallback(&sidCallbackC64, this, int(bool(sidFlags_ & 4)));
-        }
+        if (sidEnabled && (changeMask & 4) != 0)
+          updateSIDCallbacks();
       }
     }
     digiBlasterEnabled = enableDigiBlaster;
@@ -1200,12 +1411,12 @@ namespace Plus4 {
     if (sidEnabled) {
       stopDemoPlayback();
       stopDemoRecording(false);
+      syncSIDWorker();
       sid_->reset();
       digiBlasterOutput = 0x80;
       sid_->input(0);
       sidEnabled = false;
-      ted->setCallback(&SID::clockCallback, sid_, 0);
-      ted->setCallback(&sidCallbackC64, this, 0);
+      updateSIDCallbacks();
     }
   }
 
@@ -2349,6 +2560,7 @@ namespace Plus4 {
 
   void Plus4VM::saveState(Plus4Emu::File& f)
   {
+    syncSIDWorker();
     ted->saveState(f);
     sid_->saveState(f);
     {
@@ -2459,6 +2671,7 @@ namespace Plus4 {
     setTapeMotorState(false);
     stopDemo();
     removePasteTextCallback();
+    syncSIDWorker();
     snapshotLoadFlag = true;
     disableUnusedFloppyDrives();
     resetFloppyDrive(-1);
@@ -2496,10 +2709,7 @@ namespace Plus4 {
         sid_->input((int(digiBlasterOutput) << 8) - 32768);
       else
         sid_->input(0);
-      ted->setCallback(&SID::clockCallback, sid_,
-                       int(sidEnabled) & int(!(sidFlags & 4)));
-      ted->setCallback(&sidCallbackC64, this,
-                       int(sidEnabled) & int(bool(sidFlags & 4)));
+      updateSIDCallbacks();
       aciaEnabled = (ted->getRAMSize() >= 64);
       resetACIA();
       if (version >= 0x01000002) {
@@ -74,6 +74,7 @@ namespace Plus4 {
     };
     // ----------------
     static const int  printerDeviceNumber = 4;  // TODO: make it configurable ?
+    static const uint32_t sidJobBufSize = 16384;  // must be a power of two
     TED7360_  *ted;
     size_t    cpuClockFrequency;        // defaults to 1
     size_t    tedInputClockFrequency;   // defaults to 17734475 Hz
@@ -119,6 +120,18 @@ namespace Plus4 {
     // bit 1 = enable write access at $D400-$D41F
     // bit 2 = run SID emulation at C64 clock frequency
     uint8_t   sidFlags;
+    // tape feedback, added to the SID output in playSample()
+    int32_t   tapeOutputAccumulator;
+    // SID clock counts, register writes and TED samples queued for
+    // runSIDWorker() on another thread; see setSIDWorker()
+    uint32_t  *sidJobBuf;
+    volatile uint32_t sidJobHead;       // published by the emulation thread
+    volatile uint32_t sidJobTail;       // advanced by the SID thread
+    uint32_t  sidJobPos;                // next slot, not published yet
+    uint32_t  sidJobLimit;              // sidJobTail + buffer size, cached
+    uint32_t  sidJobClocks;             // SID clocks since the last event
+    int32_t   sidJobTapeSignal;         // SID thread only
+    bool      sidJobsEnabled;
     bool      is1541HighAccuracy;
     int16_t   serialBusDelayOffset;
     SerialDevice  *serialDevices[12];
@@ -167,6 +180,23 @@ namespace Plus4 {
     static PLUS4EMU_REGPARM1 void tapeCallback(void *userData);
     // run SID emulation at 10/9 * TED single clock frequency
     static PLUS4EMU_REGPARM1 void sidCallbackC64(void *userData);
+    // counts SID clocks when the SID is emulated by runSIDWorker()
+    static PLUS4EMU_REGPARM1 void sidCallbackJob(void *userData);
+    void updateSIDCallbacks();
+    void sendSoundOutput(int32_t tapeSignal, int16_t tedOutput);
+    inline void sidJobPush(uint32_t w)
+    {
+      if (PLUS4EMU_UNLIKELY(sidJobPos == sidJobLimit))
+        sidJobWaitSpace();
+      sidJobBuf[sidJobPos & (sidJobBufSize - 1U)] = w;
+      sidJobPos++;
+    }
+    void sidJobWaitSpace();
+    void sidJobPublish();
+    void sidJobFlushClocks();
+    void sidJobSample(int16_t sampleValue);
+    void sidJobWrite(uint8_t regNum, uint8_t value);
+    void runSIDClocks(uint32_t n);
     static PLUS4EMU_REGPARM1 void demoPlayCallback(void *userData);
     static PLUS4EMU_REGPARM1 void demoRecordCallback(void *userData);
     static PLUS4EMU_REGPARM1 void videoBreakPointCheckCallback(void *userData);
@@ -252,6 +282,23 @@ namespace Plus4 {
      * any of the SID registers) to reduce CPU usage.
      */
     virtual void disableSIDEmulation();
+    /*!
+     * If 'isEnabled' is true, SID synthesis and the audio output conversion
+     * are moved off the emulation thread: SID clocks, register writes and
+     * TED sound samples are queued, and another thread is expected to call
+     * runSIDWorker() in a loop. Audio output callbacks are then made from
+     * that thread.
+     */
+    void setSIDWorker(bool isEnabled);
+    /*!
+     * Process the queued SID events. Returns false if there was nothing to
+     * do. Should only be called from the SID worker thread.
+     */
+    bool runSIDWorker();
+    /*!
+     * Wait until the SID worker has processed everything queued so far.
+     */
+    void syncSIDWorker();
     /*!
      * Set state of key 'keyCode' (0 to 127).
      */
@@ -98,6 +98,33 @@
 #define REWIND_FETCH_OPCODE(clock) clock -= 2
 #endif
 
+/* ------------------------------------------------------------------------- */
+/* BMC64: Threaded dispatch.  Instead of going round the main loop after
+   every instruction, each opcode checks for a due alarm or a pending
+   interrupt itself and, if there is neither, fetches the next opcode and
+   jumps straight to it through a table of labels.  Each opcode then ends
+   in its own indirect branch, which predicts far better than the single
+   shared branch of the switch.  Nothing else at the top of the loop has
+   any effect in that case, so timing is exactly as before.
+
+   Needs computed goto, so only with GCC.  Left out for the C128, whose
+   refresh and delay hooks run at the top of the loop, and for debug
+   builds.  The caller defines OPCODE_EPILOGUE() to do what its loop does
+   after every instruction.  Opcodes that can't go straight on jump back
+   to the top of this block, so the epilogue runs once either way.  */
+
+#if defined(CPU_THREADED_DISPATCH) && defined(__GNUC__) \
+    && !defined(DRIVE_CPU) && !defined(C64DTV) \
+    && !defined(CPU_DELAY_CLK) && !defined(CPU_REFRESH_CLK) \
+    && !defined(CYCLE_EXACT_ALARM) \
+    && !defined(DEBUG) && !defined(FEATURE_CPUMEMHISTORY)
+#define CPU_THREADED
+#endif
+
+#ifndef OPCODE_EPILOGUE
+#define OPCODE_EPILOGUE()
+#endif
+
 /* ------------------------------------------------------------------------- */
 /* Hook for additional delay.  */
 
@@ -1968,6 +1995,42 @@ static const uint8_t rewind_fetch_tab[] = {
 
 /* Here, the CPU is emulated. */
 
+#ifdef CPU_THREADED
+
+#define OPCODE(n) case n: op_##n
+
+#define OPCODE_ROW(h)                                                 \
+    &&op_0x##h##0, &&op_0x##h##1, &&op_0x##h##2, &&op_0x##h##3,       \
+    &&op_0x##h##4, &&op_0x##h##5, &&op_0x##h##6, &&op_0x##h##7,       \
+    &&op_0x##h##8, &&op_0x##h##9, &&op_0x##h##a, &&op_0x##h##b,       \
+    &&op_0x##h##c, &&op_0x##h##d, &&op_0x##h##e, &&op_0x##h##f
+
+#ifdef CHECK_AND_RUN_ALTERNATE_CPU
+#define OPCODE_ALTERNATE_CPU CHECK_AND_RUN_ALTERNATE_CPU
+#else
+#define OPCODE_ALTERNATE_CPU
+#endif
+
+#define NEXT_OPCODE                                                   \
+    OPCODE_EPILOGUE();                                                \
+    OPCODE_ALTERNATE_CPU                                              \
+    if (CLK < alarm_context_next_pending_clk(ALARM_CONTEXT)           \
+        && CPU_INT_STATUS->global_pending_int == IK_NONE              \
+        && ((int)reg_pc) < bank_limit) {                              \
+        FETCH_OPCODE(opcode);                                         \
+        SET_LAST_ADDR(reg_pc);                                        \
+        SET_LAST_OPCODE(p0);                                          \
+        goto *opcode_labels[p0];                                      \
+    }                                                                 \
+    goto opcode_loop
+
+#else
+
+#define OPCODE(n) case n
+#define NEXT_OPCODE break
+
+#endif
+
 {
     /* handle 8502 fast mode refresh cycles */
     CPU_REFRESH_CLK
@@ -1977,6 +2040,11 @@ static const uint8_t rewind_fetch_tab[] = {
     CHECK_AND_RUN_ALTERNATE_CPU
 #endif
 
+#ifdef CPU_THREADED
+    /* Opcodes that can't go straight on come back here, the epilogue
+       and alternate CPU check already done.  */
+opcode_loop:
+#endif
     CPU_DELAY_CLK
 
     PROCESS_ALARMS
@@ -2005,6 +2073,14 @@ static const uint8_t rewind_fetch_tab[] = {
 
     {
         opcode_t opcode;
+#ifdef CPU_THREADED
+        static const void *const opcode_labels[256] = {
+            OPCODE_ROW(0), OPCODE_ROW(1), OPCODE_ROW(2), OPCODE_ROW(3),
+            OPCODE_ROW(4), OPCODE_ROW(5), OPCODE_ROW(6), OPCODE_ROW(7),
+            OPCODE_ROW(8), OPCODE_ROW(9), OPCODE_ROW(a), OPCODE_ROW(b),
+            OPCODE_ROW(c), OPCODE_ROW(d), OPCODE_ROW(e), OPCODE_ROW(f)
+        };
+#endif
 #ifdef DEBUG
         CLOCK debug_clk;
 #ifdef DRIVE_CPU
@@ -2079,74 +2155,74 @@ trap_skipped:
         SET_LAST_OPCODE(p0);
 
         switch (p0) {
-            case 0x00:          /* BRK */
+            OPCODE(0x00):       /* BRK */
                 BRK();
-                break;
+                NEXT_OPCODE;
 
-            case 0x01:          /* ORA ($nn,X) */
+            OPCODE(0x01):       /* ORA ($nn,X) */
                 ORA(LOAD_IND_X(p1), 1, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0x02:          /* JAM - also used for traps */
+            OPCODE(0x02):       /* JAM - also used for traps */
                 STATIC_ASSERT(TRAP_OPCODE == 0x02);
                 JAM_02();
-                break;
-
-            case 0x22:          /* JAM */
-            case 0x52:          /* JAM */
-            case 0x62:          /* JAM */
-            case 0x72:          /* JAM */
-            case 0x92:          /* JAM */
-            case 0xb2:          /* JAM */
-            case 0xd2:          /* JAM */
-            case 0xf2:          /* JAM */
+                NEXT_OPCODE;
+
+            OPCODE(0x22):       /* JAM */
+            OPCODE(0x52):       /* JAM */
+            OPCODE(0x62):       /* JAM */
+            OPCODE(0x72):       /* JAM */
+            OPCODE(0x92):       /* JAM */
+            OPCODE(0xb2):       /* JAM */
+            OPCODE(0xd2):       /* JAM */
+            OPCODE(0xf2):       /* JAM */
 #ifndef C64DTV
-            case 0x12:          /* JAM */
-            case 0x32:          /* JAM */
-            case 0x42:          /* JAM */
+            OPCODE(0x12):       /* JAM */
+            OPCODE(0x32):       /* JAM */
+            OPCODE(0x42):       /* JAM */
 #endif
                 REWIND_FETCH_OPCODE(CLK);
                 JAM();
-                break;
+                NEXT_OPCODE;
 
 #ifdef C64DTV
             /* These opcodes are defined in c64/c64dtvcpu.c */
-            case 0x12:          /* BRA */
+            OPCODE(0x12):       /* BRA */
                 BRANCH(1, p1);
-                break;
+                NEXT_OPCODE;
 
-            case 0x32:          /* SAC */
+            OPCODE(0x32):       /* SAC */
                 SAC(p1);
-                break;
+                NEXT_OPCODE;
 
-            case 0x42:          /* SIR */
+            OPCODE(0x42):       /* SIR */
                 SIR(p1);
-                break;
+                NEXT_OPCODE;
 #endif
 
-            case 0x03:          /* SLO ($nn,X) */
+            OPCODE(0x03):       /* SLO ($nn,X) */
                 SLO(LOAD_ZERO_ADDR(p1 + reg_x_read), 3, CLK_IND_X_RMW, 2, LOAD_ABS, STORE_ABS);
-                break;
+                NEXT_OPCODE;
 
-            case 0x04:          /* NOOP $nn */
-            case 0x44:          /* NOOP $nn */
-            case 0x64:          /* NOOP $nn */
+            OPCODE(0x04):       /* NOOP $nn */
+            OPCODE(0x44):       /* NOOP $nn */
+            OPCODE(0x64):       /* NOOP $nn */
                 NOOP(1, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0x05:          /* ORA $nn */
+            OPCODE(0x05):       /* ORA $nn */
                 ORA(LOAD_ZERO(p1), 1, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0x06:          /* ASL $nn */
+            OPCODE(0x06):       /* ASL $nn */
                 ASL(p1, CLK_ZERO_RMW, 2, LOAD_ZERO, STORE_ABS);
-                break;
+                NEXT_OPCODE;
 
-            case 0x07:          /* SLO $nn */
+            OPCODE(0x07):       /* SLO $nn */
                 SLO(p1, 0, CLK_ZERO_RMW, 2, LOAD_ZERO, STORE_ABS);
-                break;
+                NEXT_OPCODE;
 
-            case 0x08:          /* PHP */
+            OPCODE(0x08):       /* PHP */
 #ifdef DRIVE_CPU
                 drivecpu_rotate();
                 if (drivecpu_byte_ready()) {
@@ -2155,273 +2231,273 @@ trap_skipped:
                 }
 #endif
                 PHP();
-                break;
+                NEXT_OPCODE;
 
-            case 0x09:          /* ORA #$nn */
+            OPCODE(0x09):       /* ORA #$nn */
                 ORA(p1, 0, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0x0a:          /* ASL A */
+            OPCODE(0x0a):       /* ASL A */
                 ASL_A();
-                break;
+                NEXT_OPCODE;
 
-            case 0x0b:          /* ANC #$nn */
-            case 0x2b:          /* ANC #$nn */
+            OPCODE(0x0b):       /* ANC #$nn */
+            OPCODE(0x2b):       /* ANC #$nn */
                 ANC(p1, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0x0c:          /* NOOP $nnnn */
+            OPCODE(0x0c):       /* NOOP $nnnn */
                 NOOP_ABS();
-                break;
+                NEXT_OPCODE;
 
-            case 0x0d:          /* ORA $nnnn */
+            OPCODE(0x0d):       /* ORA $nnnn */
                 ORA(LOAD(p2), 1, 3);
-                break;
+                NEXT_OPCODE;
 
-            case 0x0e:          /* ASL $nnnn */
+            OPCODE(0x0e):       /* ASL $nnnn */
                 ASL(p2, CLK_ABS_RMW2, 3, LOAD_ABS, STORE_ABS);
-                break;
+                NEXT_OPCODE;
 
-            case 0x0f:          /* SLO $nnnn */
+            OPCODE(0x0f):       /* SLO $nnnn */
                 SLO(p2, 0, CLK_ABS_RMW2, 3, LOAD_ABS, STORE_ABS);
-                break;
+                NEXT_OPCODE;
 
-            case 0x10:          /* BPL $nnnn */
+            OPCODE(0x10):       /* BPL $nnnn */
                 BRANCH(!LOCAL_SIGN(), p1);
-                break;
+                NEXT_OPCODE;
 
-            case 0x11:          /* ORA ($nn),Y */
+            OPCODE(0x11):       /* ORA ($nn),Y */
                 ORA(LOAD_IND_Y(p1), 1, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0x13:          /* SLO ($nn),Y */
+            OPCODE(0x13):       /* SLO ($nn),Y */
                 SLO_IND_Y(p1);
-                break;
-
-            case 0x14:          /* NOOP $nn,X */
-            case 0x34:          /* NOOP $nn,X */
-            case 0x54:          /* NOOP $nn,X */
-            case 0x74:          /* NOOP $nn,X */
-            case 0xd4:          /* NOOP $nn,X */
-            case 0xf4:          /* NOOP $nn,X */
+                NEXT_OPCODE;
+
+            OPCODE(0x14):       /* NOOP $nn,X */
+            OPCODE(0x34):       /* NOOP $nn,X */
+            OPCODE(0x54):       /* NOOP $nn,X */
+            OPCODE(0x74):       /* NOOP $nn,X */
+            OPCODE(0xd4):       /* NOOP $nn,X */
+            OPCODE(0xf4):       /* NOOP $nn,X */
                 NOOP(CLK_NOOP_ZERO_X, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0x15:          /* ORA $nn,X */
+            OPCODE(0x15):       /* ORA $nn,X */
                 ORA(LOAD_ZERO_X(p1), CLK_ZERO_I2, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0x16:          /* ASL $nn,X */
+            OPCODE(0x16):       /* ASL $nn,X */
                 ASL((p1 + reg_x_read) & 0xff, CLK_ZERO_I_RMW, 2, LOAD_ZERO, STORE_ABS);
-                break;
+                NEXT_OPCODE;
 
-            case 0x17:          /* SLO $nn,X */
+            OPCODE(0x17):       /* SLO $nn,X */
                 SLO((p1 + reg_x_read) & 0xff, 0, CLK_ZERO_I_RMW, 2, LOAD_ZERO, STORE_ABS);
-                break;
+                NEXT_OPCODE;
 
-            case 0x18:          /* CLC */
+            OPCODE(0x18):       /* CLC */
                 CLC();
-                break;
+                NEXT_OPCODE;
 
-            case 0x19:          /* ORA $nnnn,Y */
+            OPCODE(0x19):       /* ORA $nnnn,Y */
                 ORA(LOAD_ABS_Y(p2), 1, 3);
-                break;
-
-            case 0x1a:          /* NOOP */
-            case 0x3a:          /* NOOP */
-            case 0x5a:          /* NOOP */
-            case 0x7a:          /* NOOP */
-            case 0xda:          /* NOOP */
-            case 0xfa:          /* NOOP */
+                NEXT_OPCODE;
+
+            OPCODE(0x1a):       /* NOOP */
+            OPCODE(0x3a):       /* NOOP */
+            OPCODE(0x5a):       /* NOOP */
+            OPCODE(0x7a):       /* NOOP */
+            OPCODE(0xda):       /* NOOP */
+            OPCODE(0xfa):       /* NOOP */
                 NOOP_IMM(1);
-                break;
+                NEXT_OPCODE;
 
-            case 0x1b:          /* SLO $nnnn,Y */
+            OPCODE(0x1b):       /* SLO $nnnn,Y */
                 SLO(p2, 0, CLK_ABS_I_RMW2, 3, LOAD_ABS_Y_RMW, STORE_ABS_Y_RMW);
-                break;
-
-            case 0x1c:          /* NOOP $nnnn,X */
-            case 0x3c:          /* NOOP $nnnn,X */
-            case 0x5c:          /* NOOP $nnnn,X */
-            case 0x7c:          /* NOOP $nnnn,X */
-            case 0xdc:          /* NOOP $nnnn,X */
-            case 0xfc:          /* NOOP $nnnn,X */
+                NEXT_OPCODE;
+
+            OPCODE(0x1c):       /* NOOP $nnnn,X */
+            OPCODE(0x3c):       /* NOOP $nnnn,X */
+            OPCODE(0x5c):       /* NOOP $nnnn,X */
+            OPCODE(0x7c):       /* NOOP $nnnn,X */
+            OPCODE(0xdc):       /* NOOP $nnnn,X */
+            OPCODE(0xfc):       /* NOOP $nnnn,X */
                 NOOP_ABS_X();
-                break;
+                NEXT_OPCODE;
 
-            case 0x1d:          /* ORA $nnnn,X */
+            OPCODE(0x1d):       /* ORA $nnnn,X */
                 ORA(LOAD_ABS_X(p2), 1, 3);
-                break;
+                NEXT_OPCODE;
 
-            case 0x1e:          /* ASL $nnnn,X */
+            OPCODE(0x1e):       /* ASL $nnnn,X */
                 ASL(p2, CLK_ABS_I_RMW2, 3, LOAD_ABS_X_RMW, STORE_ABS_X_RMW);
-                break;
+                NEXT_OPCODE;
 
-            case 0x1f:          /* SLO $nnnn,X */
+            OPCODE(0x1f):       /* SLO $nnnn,X */
                 SLO(p2, 0, CLK_ABS_I_RMW2, 3, LOAD_ABS_X_RMW, STORE_ABS_X_RMW);
-                break;
+                NEXT_OPCODE;
 
-            case 0x20:          /* JSR $nnnn */
+            OPCODE(0x20):       /* JSR $nnnn */
                 JSR();
-                break;
+                NEXT_OPCODE;
 
-            case 0x21:          /* AND ($nn,X) */
+            OPCODE(0x21):       /* AND ($nn,X) */
                 AND(LOAD_IND_X(p1), 1, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0x23:          /* RLA ($nn,X) */
+            OPCODE(0x23):       /* RLA ($nn,X) */
                 RLA(LOAD_ZERO_ADDR(p1 + reg_x_read), 3, CLK_IND_X_RMW, 2, LOAD_ABS, STORE_ABS);
-                break;
+                NEXT_OPCODE;
 
-            case 0x24:          /* BIT $nn */
+            OPCODE(0x24):       /* BIT $nn */
                 BIT(LOAD_ZERO(p1), 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0x25:          /* AND $nn */
+            OPCODE(0x25):       /* AND $nn */
                 AND(LOAD_ZERO(p1), 1, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0x26:          /* ROL $nn */
+            OPCODE(0x26):       /* ROL $nn */
                 ROL(p1, CLK_ZERO_RMW, 2, LOAD_ZERO, STORE_ABS);
-                break;
+                NEXT_OPCODE;
 
-            case 0x27:          /* RLA $nn */
+            OPCODE(0x27):       /* RLA $nn */
                 RLA(p1, 0, CLK_ZERO_RMW, 2, LOAD_ZERO, STORE_ABS);
-                break;
+                NEXT_OPCODE;
 
-            case 0x28:          /* PLP */
+            OPCODE(0x28):       /* PLP */
                 PLP();
-                break;
+                NEXT_OPCODE;
 
-            case 0x29:          /* AND #$nn */
+            OPCODE(0x29):       /* AND #$nn */
                 AND(p1, 0, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0x2a:          /* ROL A */
+            OPCODE(0x2a):       /* ROL A */
                 ROL_A();
-                break;
+                NEXT_OPCODE;
 
-            case 0x2c:          /* BIT $nnnn */
+            OPCODE(0x2c):       /* BIT $nnnn */
                 BIT(LOAD(p2), 3);
-                break;
+                NEXT_OPCODE;
 
-            case 0x2d:          /* AND $nnnn */
+            OPCODE(0x2d):       /* AND $nnnn */
                 AND(LOAD(p2), 1, 3);
-                break;
+                NEXT_OPCODE;
 
-            case 0x2e:          /* ROL $nnnn */
+            OPCODE(0x2e):       /* ROL $nnnn */
                 ROL(p2, CLK_ABS_RMW2, 3, LOAD_ABS, STORE_ABS);
-                break;
+                NEXT_OPCODE;
 
-            case 0x2f:          /* RLA $nnnn */
+            OPCODE(0x2f):       /* RLA $nnnn */
                 RLA(p2, 0, CLK_ABS_RMW2, 3, LOAD_ABS, STORE_ABS);
-                break;
+                NEXT_OPCODE;
 
-            case 0x30:          /* BMI $nnnn */
+            OPCODE(0x30):       /* BMI $nnnn */
                 BRANCH(LOCAL_SIGN(), p1);
-                break;
+                NEXT_OPCODE;
 
-            case 0x31:          /* AND ($nn),Y */
+            OPCODE(0x31):       /* AND ($nn),Y */
                 AND(LOAD_IND_Y(p1), 1, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0x33:          /* RLA ($nn),Y */
+            OPCODE(0x33):       /* RLA ($nn),Y */
                 RLA_IND_Y(p1);
-                break;
+                NEXT_OPCODE;
 
-            case 0x35:          /* AND $nn,X */
+            OPCODE(0x35):       /* AND $nn,X */
                 AND(LOAD_ZERO_X(p1), CLK_ZERO_I2, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0x36:          /* ROL $nn,X */
+            OPCODE(0x36):       /* ROL $nn,X */
                 ROL((p1 + reg_x_read) & 0xff, CLK_ZERO_I_RMW, 2, LOAD_ZERO, STORE_ABS);
-                break;
+                NEXT_OPCODE;
 
-            case 0x37:          /* RLA $nn,X */
+            OPCODE(0x37):       /* RLA $nn,X */
                 RLA((p1 + reg_x_read) & 0xff, 0, CLK_ZERO_I_RMW, 2, LOAD_ZERO, STORE_ABS);
-                break;
+                NEXT_OPCODE;
 
-            case 0x38:          /* SEC */
+            OPCODE(0x38):       /* SEC */
                 SEC();
-                break;
+                NEXT_OPCODE;
 
-            case 0x39:          /* AND $nnnn,Y */
+            OPCODE(0x39):       /* AND $nnnn,Y */
                 AND(LOAD_ABS_Y(p2), 1, 3);
-                break;
+                NEXT_OPCODE;
 
-            case 0x3b:          /* RLA $nnnn,Y */
+            OPCODE(0x3b):       /* RLA $nnnn,Y */
                 RLA(p2, 0, CLK_ABS_I_RMW2, 3, LOAD_ABS_Y_RMW, STORE_ABS_Y_RMW);
-                break;
+                NEXT_OPCODE;
 
-            case 0x3d:          /* AND $nnnn,X */
+            OPCODE(0x3d):       /* AND $nnnn,X */
                 AND(LOAD_ABS_X(p2), 1, 3);
-                break;
+                NEXT_OPCODE;
 
-            case 0x3e:          /* ROL $nnnn,X */
+            OPCODE(0x3e):       /* ROL $nnnn,X */
                 ROL(p2, CLK_ABS_I_RMW2, 3, LOAD_ABS_X_RMW, STORE_ABS_X_RMW);
-                break;
+                NEXT_OPCODE;
 
-            case 0x3f:          /* RLA $nnnn,X */
+            OPCODE(0x3f):       /* RLA $nnnn,X */
                 RLA(p2, 0, CLK_ABS_I_RMW2, 3, LOAD_ABS_X_RMW, STORE_ABS_X_RMW);
-                break;
+                NEXT_OPCODE;
 
-            case 0x40:          /* RTI */
+            OPCODE(0x40):       /* RTI */
                 RTI();
-                break;
+                NEXT_OPCODE;
 
-            case 0x41:          /* EOR ($nn,X) */
+            OPCODE(0x41):       /* EOR ($nn,X) */
                 EOR(LOAD_IND_X(p1), 1, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0x43:          /* SRE ($nn,X) */
+            OPCODE(0x43):       /* SRE ($nn,X) */
                 SRE(LOAD_ZERO_ADDR(p1 + reg_x_read), 3, CLK_IND_X_RMW, 2, LOAD_ABS, STORE_ABS);
-                break;
+                NEXT_OPCODE;
 
-            case 0x45:          /* EOR $nn */
+            OPCODE(0x45):       /* EOR $nn */
                 EOR(LOAD_ZERO(p1), 1, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0x46:          /* LSR $nn */
+            OPCODE(0x46):       /* LSR $nn */
                 LSR(p1, CLK_ZERO_RMW, 2, LOAD_ZERO, STORE_ABS);
-                break;
+                NEXT_OPCODE;
 
-            case 0x47:          /* SRE $nn */
+            OPCODE(0x47):       /* SRE $nn */
                 SRE(p1, 0, CLK_ZERO_RMW, 2, LOAD_ZERO, STORE_ABS);
-                break;
+                NEXT_OPCODE;
 
-            case 0x48:          /* PHA */
+            OPCODE(0x48):       /* PHA */
                 PHA();
-                break;
+                NEXT_OPCODE;
 
-            case 0x49:          /* EOR #$nn */
+            OPCODE(0x49):       /* EOR #$nn */
                 EOR(p1, 0, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0x4a:          /* LSR A */
+            OPCODE(0x4a):       /* LSR A */
                 LSR_A();
-                break;
+                NEXT_OPCODE;
 
-            case 0x4b:          /* ASR #$nn */
+            OPCODE(0x4b):       /* ASR #$nn */
                 ASR(p1, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0x4c:          /* JMP $nnnn */
+            OPCODE(0x4c):       /* JMP $nnnn */
                 JMP(p2);
-                break;
+                NEXT_OPCODE;
 
-            case 0x4d:          /* EOR $nnnn */
+            OPCODE(0x4d):       /* EOR $nnnn */
                 EOR(LOAD(p2), 1, 3);
-                break;
+                NEXT_OPCODE;
 
-            case 0x4e:          /* LSR $nnnn */
+            OPCODE(0x4e):       /* LSR $nnnn */
                 LSR(p2, CLK_ABS_RMW2, 3, LOAD_ABS, STORE_ABS);
-                break;
+                NEXT_OPCODE;
 
-            case 0x4f:          /* SRE $nnnn */
+            OPCODE(0x4f):       /* SRE $nnnn */
                 SRE(p2, 0, CLK_ABS_RMW2, 3, LOAD_ABS, STORE_ABS);
-                break;
+                NEXT_OPCODE;
 
-            case 0x50:          /* BVC $nnnn */
+            OPCODE(0x50):       /* BVC $nnnn */
 #ifdef DRIVE_CPU
                 CLK_ADD(CLK, -1);
                 drivecpu_rotate();
@@ -2432,109 +2508,109 @@ trap_skipped:
                 CLK_ADD(CLK, 1);
 #endif
                 BRANCH(!LOCAL_OVERFLOW(), p1);
-                break;
+                NEXT_OPCODE;
 
-            case 0x51:          /* EOR ($nn),Y */
+            OPCODE(0x51):       /* EOR ($nn),Y */
                 EOR(LOAD_IND_Y(p1), 1, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0x53:          /* SRE ($nn),Y */
+            OPCODE(0x53):       /* SRE ($nn),Y */
                 SRE_IND_Y(p1);
-                break;
+                NEXT_OPCODE;
 
-            case 0x55:          /* EOR $nn,X */
+            OPCODE(0x55):       /* EOR $nn,X */
                 EOR(LOAD_ZERO_X(p1), CLK_ZERO_I2, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0x56:          /* LSR $nn,X */
+            OPCODE(0x56):       /* LSR $nn,X */
                 LSR((p1 + reg_x_read) & 0xff, CLK_ZERO_I_RMW, 2, LOAD_ZERO, STORE_ABS);
-                break;
+                NEXT_OPCODE;
 
-            case 0x57:          /* SRE $nn,X */
+            OPCODE(0x57):       /* SRE $nn,X */
                 SRE((p1 + reg_x_read) & 0xff, 0, CLK_ZERO_I_RMW, 2, LOAD_ZERO, STORE_ABS);
-                break;
+                NEXT_OPCODE;
 
-            case 0x58:          /* CLI */
+            OPCODE(0x58):       /* CLI */
                 CLI();
-                break;
+                NEXT_OPCODE;
 
-            case 0x59:          /* EOR $nnnn,Y */
+            OPCODE(0x59):       /* EOR $nnnn,Y */
                 EOR(LOAD_ABS_Y(p2), 1, 3);
-                break;
+                NEXT_OPCODE;
 
-            case 0x5b:          /* SRE $nnnn,Y */
+            OPCODE(0x5b):       /* SRE $nnnn,Y */
                 SRE(p2, 0, CLK_ABS_I_RMW2, 3, LOAD_ABS_Y_RMW, STORE_ABS_Y_RMW);
-                break;
+                NEXT_OPCODE;
 
-            case 0x5d:          /* EOR $nnnn,X */
+            OPCODE(0x5d):       /* EOR $nnnn,X */
                 EOR(LOAD_ABS_X(p2), 1, 3);
-                break;
+                NEXT_OPCODE;
 
-            case 0x5e:          /* LSR $nnnn,X */
+            OPCODE(0x5e):       /* LSR $nnnn,X */
                 LSR(p2, CLK_ABS_I_RMW2, 3, LOAD_ABS_X_RMW, STORE_ABS_X_RMW);
-                break;
+                NEXT_OPCODE;
 
-            case 0x5f:          /* SRE $nnnn,X */
+            OPCODE(0x5f):       /* SRE $nnnn,X */
                 SRE(p2, 0, CLK_ABS_I_RMW2, 3, LOAD_ABS_X_RMW, STORE_ABS_X_RMW);
-                break;
+                NEXT_OPCODE;
 
-            case 0x60:          /* RTS */
+            OPCODE(0x60):       /* RTS */
                 RTS();
-                break;
+                NEXT_OPCODE;
 
-            case 0x61:          /* ADC ($nn,X) */
+            OPCODE(0x61):       /* ADC ($nn,X) */
                 ADC(LOAD_IND_X(p1), 1, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0x63:          /* RRA ($nn,X) */
+            OPCODE(0x63):       /* RRA ($nn,X) */
                 RRA(LOAD_ZERO_ADDR(p1 + reg_x_read), 3, CLK_IND_X_RMW, 2, LOAD_ABS, STORE_ABS);
-                break;
+                NEXT_OPCODE;
 
-            case 0x65:          /* ADC $nn */
+            OPCODE(0x65):       /* ADC $nn */
                 ADC(LOAD_ZERO(p1), 1, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0x66:          /* ROR $nn */
+            OPCODE(0x66):       /* ROR $nn */
                 ROR(p1, CLK_ZERO_RMW, 2, LOAD_ZERO, STORE_ABS);
-                break;
+                NEXT_OPCODE;
 
-            case 0x67:          /* RRA $nn */
+            OPCODE(0x67):       /* RRA $nn */
                 RRA(p1, 0, CLK_ZERO_RMW, 2, LOAD_ZERO, STORE_ABS);
-                break;
+                NEXT_OPCODE;
 
-            case 0x68:          /* PLA */
+            OPCODE(0x68):       /* PLA */
                 PLA();
-                break;
+                NEXT_OPCODE;
 
-            case 0x69:          /* ADC #$nn */
+            OPCODE(0x69):       /* ADC #$nn */
                 ADC(p1, 0, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0x6a:          /* ROR A */
+            OPCODE(0x6a):       /* ROR A */
                 ROR_A();
-                break;
+                NEXT_OPCODE;
 
-            case 0x6b:          /* ARR #$nn */
+            OPCODE(0x6b):       /* ARR #$nn */
                 ARR(p1, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0x6c:          /* JMP ($nnnn) */
+            OPCODE(0x6c):       /* JMP ($nnnn) */
                 JMP_IND();
-                break;
+                NEXT_OPCODE;
 
-            case 0x6d:          /* ADC $nnnn */
+            OPCODE(0x6d):       /* ADC $nnnn */
                 ADC(LOAD(p2), 1, 3);
-                break;
+                NEXT_OPCODE;
 
-            case 0x6e:          /* ROR $nnnn */
+            OPCODE(0x6e):       /* ROR $nnnn */
                 ROR(p2, CLK_ABS_RMW2, 3, LOAD_ABS, STORE_ABS);
-                break;
+                NEXT_OPCODE;
 
-            case 0x6f:          /* RRA $nnnn */
+            OPCODE(0x6f):       /* RRA $nnnn */
                 RRA(p2, 0, CLK_ABS_RMW2, 3, LOAD_ABS, STORE_ABS);
-                break;
+                NEXT_OPCODE;
 
-            case 0x70:          /* BVS $nnnn */
+            OPCODE(0x70):       /* BVS $nnnn */
 #ifdef DRIVE_CPU
                 CLK_ADD(CLK, -1);
                 drivecpu_rotate();
@@ -2545,515 +2621,515 @@ trap_skipped:
                 CLK_ADD(CLK, 1);
 #endif
                 BRANCH(LOCAL_OVERFLOW(), p1);
-                break;
+                NEXT_OPCODE;
 
-            case 0x71:          /* ADC ($nn),Y */
+            OPCODE(0x71):       /* ADC ($nn),Y */
                 ADC(LOAD_IND_Y(p1), 1, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0x73:          /* RRA ($nn),Y */
+            OPCODE(0x73):       /* RRA ($nn),Y */
                 RRA_IND_Y(p1);
-                break;
+                NEXT_OPCODE;
 
-            case 0x75:          /* ADC $nn,X */
+            OPCODE(0x75):       /* ADC $nn,X */
                 ADC(LOAD_ZERO_X(p1), CLK_ZERO_I2, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0x76:          /* ROR $nn,X */
+            OPCODE(0x76):       /* ROR $nn,X */
                 ROR((p1 + reg_x_read) & 0xff, CLK_ZERO_I_RMW, 2, LOAD_ZERO, STORE_ABS);
-                break;
+                NEXT_OPCODE;
 
-            case 0x77:          /* RRA $nn,X */
+            OPCODE(0x77):       /* RRA $nn,X */
                 RRA((p1 + reg_x_read) & 0xff, 0, CLK_ZERO_I_RMW, 2, LOAD_ZERO, STORE_ABS);
-                break;
+                NEXT_OPCODE;
 
-            case 0x78:          /* SEI */
+            OPCODE(0x78):       /* SEI */
                 SEI();
-                break;
+                NEXT_OPCODE;
 
-            case 0x79:          /* ADC $nnnn,Y */
+            OPCODE(0x79):       /* ADC $nnnn,Y */
                 ADC(LOAD_ABS_Y(p2), 1, 3);
-                break;
+                NEXT_OPCODE;
 
-            case 0x7b:          /* RRA $nnnn,Y */
+            OPCODE(0x7b):       /* RRA $nnnn,Y */
                 RRA(p2, 0, CLK_ABS_I_RMW2, 3, LOAD_ABS_Y_RMW, STORE_ABS_Y_RMW);
-                break;
+                NEXT_OPCODE;
 
-            case 0x7d:          /* ADC $nnnn,X */
+            OPCODE(0x7d):       /* ADC $nnnn,X */
                 ADC(LOAD_ABS_X(p2), 1, 3);
-                break;
+                NEXT_OPCODE;
 
-            case 0x7e:          /* ROR $nnnn,X */
+            OPCODE(0x7e):       /* ROR $nnnn,X */
                 ROR(p2, CLK_ABS_I_RMW2, 3, LOAD_ABS_X_RMW, STORE_ABS_X_RMW);
-                break;
+                NEXT_OPCODE;
 
-            case 0x7f:          /* RRA $nnnn,X */
+            OPCODE(0x7f):       /* RRA $nnnn,X */
                 RRA(p2, 0, CLK_ABS_I_RMW2, 3, LOAD_ABS_X_RMW, STORE_ABS_X_RMW);
-                break;
+                NEXT_OPCODE;
 
-            case 0x80:          /* NOOP #$nn */
-            case 0x82:          /* NOOP #$nn */
-            case 0x89:          /* NOOP #$nn */
-            case 0xc2:          /* NOOP #$nn */
-            case 0xe2:          /* NOOP #$nn */
+            OPCODE(0x80):       /* NOOP #$nn */
+            OPCODE(0x82):       /* NOOP #$nn */
+            OPCODE(0x89):       /* NOOP #$nn */
+            OPCODE(0xc2):       /* NOOP #$nn */
+            OPCODE(0xe2):       /* NOOP #$nn */
                 NOOP_IMM(2);
-                break;
+                NEXT_OPCODE;
 
-            case 0x81:          /* STA ($nn,X) */
+            OPCODE(0x81):       /* STA ($nn,X) */
                 STA(LOAD_ZERO_ADDR(p1 + reg_x_read), 3, 1, 2, STORE_ABS);
-                break;
+                NEXT_OPCODE;
 
-            case 0x83:          /* SAX ($nn,X) */
+            OPCODE(0x83):       /* SAX ($nn,X) */
                 SAX(LOAD_ZERO_ADDR(p1 + reg_x_read), 3, 1, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0x84:          /* STY $nn */
+            OPCODE(0x84):       /* STY $nn */
                 STY_ZERO(p1, 1, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0x85:          /* STA $nn */
+            OPCODE(0x85):       /* STA $nn */
                 STA_ZERO(p1, 1, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0x86:          /* STX $nn */
+            OPCODE(0x86):       /* STX $nn */
                 STX_ZERO(p1, 1, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0x87:          /* SAX $nn */
+            OPCODE(0x87):       /* SAX $nn */
                 SAX_ZERO(p1, 1, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0x88:          /* DEY */
+            OPCODE(0x88):       /* DEY */
                 DEY();
-                break;
+                NEXT_OPCODE;
 
-            case 0x8a:          /* TXA */
+            OPCODE(0x8a):       /* TXA */
                 TXA();
-                break;
+                NEXT_OPCODE;
 
-            case 0x8b:          /* ANE #$nn */
+            OPCODE(0x8b):       /* ANE #$nn */
                 ANE(p1, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0x8c:          /* STY $nnnn */
+            OPCODE(0x8c):       /* STY $nnnn */
                 STY(p2, 1, 3);
-                break;
+                NEXT_OPCODE;
 
-            case 0x8d:          /* STA $nnnn */
+            OPCODE(0x8d):       /* STA $nnnn */
                 STA(p2, 0, 1, 3, STORE_ABS);
-                break;
+                NEXT_OPCODE;
 
-            case 0x8e:          /* STX $nnnn */
+            OPCODE(0x8e):       /* STX $nnnn */
                 STX(p2, 1, 3);
-                break;
+                NEXT_OPCODE;
 
-            case 0x8f:          /* SAX $nnnn */
+            OPCODE(0x8f):       /* SAX $nnnn */
                 SAX(p2, 0, 1, 3);
-                break;
+                NEXT_OPCODE;
 
-            case 0x90:          /* BCC $nnnn */
+            OPCODE(0x90):       /* BCC $nnnn */
                 BRANCH(!LOCAL_CARRY(), p1);
-                break;
+                NEXT_OPCODE;
 
-            case 0x91:          /* STA ($nn),Y */
+            OPCODE(0x91):       /* STA ($nn),Y */
                 STA_IND_Y(p1);
-                break;
+                NEXT_OPCODE;
 
-            case 0x93:          /* SHA ($nn),Y */
+            OPCODE(0x93):       /* SHA ($nn),Y */
                 SHA_IND_Y(p1);
-                break;
+                NEXT_OPCODE;
 
-            case 0x94:          /* STY $nn,X */
+            OPCODE(0x94):       /* STY $nn,X */
                 STY_ZERO(p1 + reg_x_read, CLK_ZERO_I_STORE, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0x95:          /* STA $nn,X */
+            OPCODE(0x95):       /* STA $nn,X */
                 STA_ZERO(p1 + reg_x_read, CLK_ZERO_I_STORE, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0x96:          /* STX $nn,Y */
+            OPCODE(0x96):       /* STX $nn,Y */
                 STX_ZERO(p1 + reg_y_read, CLK_ZERO_I_STORE, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0x97:          /* SAX $nn,Y */
+            OPCODE(0x97):       /* SAX $nn,Y */
                 SAX((p1 + reg_y_read) & 0xff, 0, CLK_ZERO_I_STORE, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0x98:          /* TYA */
+            OPCODE(0x98):       /* TYA */
                 TYA();
-                break;
+                NEXT_OPCODE;
 
-            case 0x99:          /* STA $nnnn,Y */
+            OPCODE(0x99):       /* STA $nnnn,Y */
                 STA(p2, 0, CLK_ABS_I_STORE2, 3, STORE_ABS_Y);
-                break;
+                NEXT_OPCODE;
 
-            case 0x9a:          /* TXS */
+            OPCODE(0x9a):       /* TXS */
                 TXS();
-                break;
+                NEXT_OPCODE;
 
-            case 0x9b:          /* SHS $nnnn,Y */
+            OPCODE(0x9b):       /* SHS $nnnn,Y */
 #ifdef C64DTV
                 NOOP_ABS_Y();
 #else
                 SHS_ABS_Y(p2);
 #endif
-                break;
+                NEXT_OPCODE;
 
-            case 0x9c:          /* SHY $nnnn,X */
+            OPCODE(0x9c):       /* SHY $nnnn,X */
                 SHY_ABS_X(p2);
-                break;
+                NEXT_OPCODE;
 
-            case 0x9d:          /* STA $nnnn,X */
+            OPCODE(0x9d):       /* STA $nnnn,X */
                 STA(p2, 0, CLK_ABS_I_STORE2, 3, STORE_ABS_X);
-                break;
+                NEXT_OPCODE;
 
-            case 0x9e:          /* SHX $nnnn,Y */
+            OPCODE(0x9e):       /* SHX $nnnn,Y */
                 SHX_ABS_Y(p2);
-                break;
+                NEXT_OPCODE;
 
-            case 0x9f:          /* SHA $nnnn,Y */
+            OPCODE(0x9f):       /* SHA $nnnn,Y */
                 SHA_ABS_Y(p2);
-                break;
+                NEXT_OPCODE;
 
-            case 0xa0:          /* LDY #$nn */
+            OPCODE(0xa0):       /* LDY #$nn */
                 LDY(p1, 0, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0xa1:          /* LDA ($nn,X) */
+            OPCODE(0xa1):       /* LDA ($nn,X) */
                 LDA(LOAD_IND_X(p1), 1, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0xa2:          /* LDX #$nn */
+            OPCODE(0xa2):       /* LDX #$nn */
                 LDX(p1, 0, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0xa3:          /* LAX ($nn,X) */
+            OPCODE(0xa3):       /* LAX ($nn,X) */
                 LAX(LOAD_IND_X(p1), 1, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0xa4:          /* LDY $nn */
+            OPCODE(0xa4):       /* LDY $nn */
                 LDY(LOAD_ZERO(p1), 1, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0xa5:          /* LDA $nn */
+            OPCODE(0xa5):       /* LDA $nn */
                 LDA(LOAD_ZERO(p1), 1, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0xa6:          /* LDX $nn */
+            OPCODE(0xa6):       /* LDX $nn */
                 LDX(LOAD_ZERO(p1), 1, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0xa7:          /* LAX $nn */
+            OPCODE(0xa7):       /* LAX $nn */
                 LAX(LOAD_ZERO(p1), 1, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0xa8:          /* TAY */
+            OPCODE(0xa8):       /* TAY */
                 TAY();
-                break;
+                NEXT_OPCODE;
 
-            case 0xa9:          /* LDA #$nn */
+            OPCODE(0xa9):       /* LDA #$nn */
                 LDA(p1, 0, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0xaa:          /* TAX */
+            OPCODE(0xaa):       /* TAX */
                 TAX();
-                break;
+                NEXT_OPCODE;
 
-            case 0xab:          /* LXA #$nn */
+            OPCODE(0xab):       /* LXA #$nn */
                 LXA(p1, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0xac:          /* LDY $nnnn */
+            OPCODE(0xac):       /* LDY $nnnn */
                 LDY(LOAD(p2), 1, 3);
-                break;
+                NEXT_OPCODE;
 
-            case 0xad:          /* LDA $nnnn */
+            OPCODE(0xad):       /* LDA $nnnn */
                 LDA(LOAD(p2), 1, 3);
-                break;
+                NEXT_OPCODE;
 
-            case 0xae:          /* LDX $nnnn */
+            OPCODE(0xae):       /* LDX $nnnn */
                 LDX(LOAD(p2), 1, 3);
-                break;
+                NEXT_OPCODE;
 
-            case 0xaf:          /* LAX $nnnn */
+            OPCODE(0xaf):       /* LAX $nnnn */
                 LAX(LOAD(p2), 1, 3);
-                break;
+                NEXT_OPCODE;
 
-            case 0xb0:          /* BCS $nnnn */
+            OPCODE(0xb0):       /* BCS $nnnn */
                 BRANCH(LOCAL_CARRY(), p1);
-                break;
+                NEXT_OPCODE;
 
-            case 0xb1:          /* LDA ($nn),Y */
+            OPCODE(0xb1):       /* LDA ($nn),Y */
                 LDA(LOAD_IND_Y_BANK(p1), 1, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0xb3:          /* LAX ($nn),Y */
+            OPCODE(0xb3):       /* LAX ($nn),Y */
                 LAX(LOAD_IND_Y(p1), 1, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0xb4:          /* LDY $nn,X */
+            OPCODE(0xb4):       /* LDY $nn,X */
                 LDY(LOAD_ZERO_X(p1), CLK_ZERO_I2, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0xb5:          /* LDA $nn,X */
+            OPCODE(0xb5):       /* LDA $nn,X */
                 LDA(LOAD_ZERO_X(p1), CLK_ZERO_I2, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0xb6:          /* LDX $nn,Y */
+            OPCODE(0xb6):       /* LDX $nn,Y */
                 LDX(LOAD_ZERO_Y(p1), CLK_ZERO_I2, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0xb7:          /* LAX $nn,Y */
+            OPCODE(0xb7):       /* LAX $nn,Y */
                 LAX(LOAD_ZERO_Y(p1), CLK_ZERO_I2, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0xb8:          /* CLV */
+            OPCODE(0xb8):       /* CLV */
                 CLV();
-                break;
+                NEXT_OPCODE;
 
-            case 0xb9:          /* LDA $nnnn,Y */
+            OPCODE(0xb9):       /* LDA $nnnn,Y */
                 LDA(LOAD_ABS_Y(p2), 1, 3);
-                break;
+                NEXT_OPCODE;
 
-            case 0xba:          /* TSX */
+            OPCODE(0xba):       /* TSX */
                 TSX();
-                break;
+                NEXT_OPCODE;
 
-            case 0xbb:          /* LAS $nnnn,Y */
+            OPCODE(0xbb):       /* LAS $nnnn,Y */
                 LAS(LOAD_ABS_Y(p2), 1, 3);
-                break;
+                NEXT_OPCODE;
 
-            case 0xbc:          /* LDY $nnnn,X */
+            OPCODE(0xbc):       /* LDY $nnnn,X */
                 LDY(LOAD_ABS_X(p2), 1, 3);
-                break;
+                NEXT_OPCODE;
 
-            case 0xbd:          /* LDA $nnnn,X */
+            OPCODE(0xbd):       /* LDA $nnnn,X */
                 LDA(LOAD_ABS_X(p2), 1, 3);
-                break;
+                NEXT_OPCODE;
 
-            case 0xbe:          /* LDX $nnnn,Y */
+            OPCODE(0xbe):       /* LDX $nnnn,Y */
                 LDX(LOAD_ABS_Y(p2), 1, 3);
-                break;
+                NEXT_OPCODE;
 
-            case 0xbf:          /* LAX $nnnn,Y */
+            OPCODE(0xbf):       /* LAX $nnnn,Y */
                 LAX(LOAD_ABS_Y(p2), 1, 3);
-                break;
+                NEXT_OPCODE;
 
-            case 0xc0:          /* CPY #$nn */
+            OPCODE(0xc0):       /* CPY #$nn */
                 CPY(p1, 0, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0xc1:          /* CMP ($nn,X) */
+            OPCODE(0xc1):       /* CMP ($nn,X) */
                 CMP(LOAD_IND_X(p1), 1, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0xc3:          /* DCP ($nn,X) */
+            OPCODE(0xc3):       /* DCP ($nn,X) */
                 DCP(LOAD_ZERO_ADDR(p1 + reg_x_read), 3, CLK_IND_X_RMW, 2, LOAD_ABS, STORE_ABS);
-                break;
+                NEXT_OPCODE;
 
-            case 0xc4:          /* CPY $nn */
+            OPCODE(0xc4):       /* CPY $nn */
                 CPY(LOAD_ZERO(p1), 1, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0xc5:          /* CMP $nn */
+            OPCODE(0xc5):       /* CMP $nn */
                 CMP(LOAD_ZERO(p1), 1, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0xc6:          /* DEC $nn */
+            OPCODE(0xc6):       /* DEC $nn */
                 DEC(p1, CLK_ZERO_RMW, 2, LOAD_ZERO, STORE_ABS);
-                break;
+                NEXT_OPCODE;
 
-            case 0xc7:          /* DCP $nn */
+            OPCODE(0xc7):       /* DCP $nn */
                 DCP(p1, 0, CLK_ZERO_RMW, 2, LOAD_ZERO, STORE_ABS);
-                break;
+                NEXT_OPCODE;
 
-            case 0xc8:          /* INY */
+            OPCODE(0xc8):       /* INY */
                 INY();
-                break;
+                NEXT_OPCODE;
 
-            case 0xc9:          /* CMP #$nn */
+            OPCODE(0xc9):       /* CMP #$nn */
                 CMP(p1, 0, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0xca:          /* DEX */
+            OPCODE(0xca):       /* DEX */
                 DEX();
-                break;
+                NEXT_OPCODE;
 
-            case 0xcb:          /* SBX #$nn */
+            OPCODE(0xcb):       /* SBX #$nn */
                 SBX(p1, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0xcc:          /* CPY $nnnn */
+            OPCODE(0xcc):       /* CPY $nnnn */
                 CPY(LOAD(p2), 1, 3);
-                break;
+                NEXT_OPCODE;
 
-            case 0xcd:          /* CMP $nnnn */
+            OPCODE(0xcd):       /* CMP $nnnn */
                 CMP(LOAD(p2), 1, 3);
-                break;
+                NEXT_OPCODE;
 
-            case 0xce:          /* DEC $nnnn */
+            OPCODE(0xce):       /* DEC $nnnn */
                 DEC(p2, CLK_ABS_RMW2, 3, LOAD_ABS, STORE_ABS);
-                break;
+                NEXT_OPCODE;
 
-            case 0xcf:          /* DCP $nnnn */
+            OPCODE(0xcf):       /* DCP $nnnn */
                 DCP(p2, 0, CLK_ABS_RMW2, 3, LOAD_ABS, STORE_ABS);
-                break;
+                NEXT_OPCODE;
 
-            case 0xd0:          /* BNE $nnnn */
+            OPCODE(0xd0):       /* BNE $nnnn */
                 BRANCH(!LOCAL_ZERO(), p1);
-                break;
+                NEXT_OPCODE;
 
-            case 0xd1:          /* CMP ($nn),Y */
+            OPCODE(0xd1):       /* CMP ($nn),Y */
                 CMP(LOAD_IND_Y(p1), 1, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0xd3:          /* DCP ($nn),Y */
+            OPCODE(0xd3):       /* DCP ($nn),Y */
                 DCP_IND_Y(p1);
-                break;
+                NEXT_OPCODE;
 
-            case 0xd5:          /* CMP $nn,X */
+            OPCODE(0xd5):       /* CMP $nn,X */
                 CMP(LOAD_ZERO_X(p1), CLK_ZERO_I2, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0xd6:          /* DEC $nn,X */
+            OPCODE(0xd6):       /* DEC $nn,X */
                 DEC((p1 + reg_x_read) & 0xff, CLK_ZERO_I_RMW, 2, LOAD_ABS, STORE_ABS);
-                break;
+                NEXT_OPCODE;
 
-            case 0xd7:          /* DCP $nn,X */
+            OPCODE(0xd7):       /* DCP $nn,X */
                 DCP((p1 + reg_x_read) & 0xff, 0, CLK_ZERO_I_RMW, 2, LOAD_ABS, STORE_ABS);
-                break;
+                NEXT_OPCODE;
 
-            case 0xd8:          /* CLD */
+            OPCODE(0xd8):       /* CLD */
                 CLD();
-                break;
+                NEXT_OPCODE;
 
-            case 0xd9:          /* CMP $nnnn,Y */
+            OPCODE(0xd9):       /* CMP $nnnn,Y */
                 CMP(LOAD_ABS_Y(p2), 1, 3);
-                break;
+                NEXT_OPCODE;
 
-            case 0xdb:          /* DCP $nnnn,Y */
+            OPCODE(0xdb):       /* DCP $nnnn,Y */
                 DCP(p2, 0, CLK_ABS_I_RMW2, 3, LOAD_ABS_Y_RMW, STORE_ABS_Y_RMW);
-                break;
+                NEXT_OPCODE;
 
-            case 0xdd:          /* CMP $nnnn,X */
+            OPCODE(0xdd):       /* CMP $nnnn,X */
                 CMP(LOAD_ABS_X(p2), 1, 3);
-                break;
+                NEXT_OPCODE;
 
-            case 0xde:          /* DEC $nnnn,X */
+            OPCODE(0xde):       /* DEC $nnnn,X */
                 DEC(p2, CLK_ABS_I_RMW2, 3, LOAD_ABS_X_RMW, STORE_ABS_X_RMW);
-                break;
+                NEXT_OPCODE;
 
-            case 0xdf:          /* DCP $nnnn,X */
+            OPCODE(0xdf):       /* DCP $nnnn,X */
                 DCP(p2, 0, CLK_ABS_I_RMW2, 3, LOAD_ABS_X_RMW, STORE_ABS_X_RMW);
-                break;
+                NEXT_OPCODE;
 
-            case 0xe0:          /* CPX #$nn */
+            OPCODE(0xe0):       /* CPX #$nn */
                 CPX(p1, 0, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0xe1:          /* SBC ($nn,X) */
+            OPCODE(0xe1):       /* SBC ($nn,X) */
                 SBC(LOAD_IND_X(p1), 1, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0xe3:          /* ISB ($nn,X) */
+            OPCODE(0xe3):       /* ISB ($nn,X) */
                 ISB(LOAD_ZERO_ADDR(p1 + reg_x_read), 3, CLK_IND_X_RMW, 2, LOAD_ABS, STORE_ABS);
-                break;
+                NEXT_OPCODE;
 
-            case 0xe4:          /* CPX $nn */
+            OPCODE(0xe4):       /* CPX $nn */
                 CPX(LOAD_ZERO(p1), 1, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0xe5:          /* SBC $nn */
+            OPCODE(0xe5):       /* SBC $nn */
                 SBC(LOAD_ZERO(p1), 1, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0xe6:          /* INC $nn */
+            OPCODE(0xe6):       /* INC $nn */
                 INC(p1, CLK_ZERO_RMW, 2, LOAD_ZERO, STORE_ABS);
-                break;
+                NEXT_OPCODE;
 
-            case 0xe7:          /* ISB $nn */
+            OPCODE(0xe7):       /* ISB $nn */
                 ISB(p1, 0, CLK_ZERO_RMW, 2, LOAD_ZERO, STORE_ABS);
-                break;
+                NEXT_OPCODE;
 
-            case 0xe8:          /* INX */
+            OPCODE(0xe8):       /* INX */
                 INX();
-                break;
+                NEXT_OPCODE;
 
-            case 0xe9:          /* SBC #$nn */
+            OPCODE(0xe9):       /* SBC #$nn */
                 SBC(p1, 0, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0xea:          /* NOP */
+            OPCODE(0xea):       /* NOP */
                 NOP();
-                break;
+                NEXT_OPCODE;
 
-            case 0xeb:          /* USBC #$nn (same as SBC) */
+            OPCODE(0xeb):       /* USBC #$nn (same as SBC) */
                 SBC(p1, 0, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0xec:          /* CPX $nnnn */
+            OPCODE(0xec):       /* CPX $nnnn */
                 CPX(LOAD(p2), 1, 3);
-                break;
+                NEXT_OPCODE;
 
-            case 0xed:          /* SBC $nnnn */
+            OPCODE(0xed):       /* SBC $nnnn */
                 SBC(LOAD(p2), 1, 3);
-                break;
+                NEXT_OPCODE;
 
-            case 0xee:          /* INC $nnnn */
+            OPCODE(0xee):       /* INC $nnnn */
                 INC(p2, CLK_ABS_RMW2, 3, LOAD_ABS, STORE_ABS);
-                break;
+                NEXT_OPCODE;
 
-            case 0xef:          /* ISB $nnnn */
+            OPCODE(0xef):       /* ISB $nnnn */
                 ISB(p2, 0, CLK_ABS_RMW2, 3, LOAD_ABS, STORE_ABS);
-                break;
+                NEXT_OPCODE;
 
-            case 0xf0:          /* BEQ $nnnn */
+            OPCODE(0xf0):       /* BEQ $nnnn */
                 BRANCH(LOCAL_ZERO(), p1);
-                break;
+                NEXT_OPCODE;
 
-            case 0xf1:          /* SBC ($nn),Y */
+            OPCODE(0xf1):       /* SBC ($nn),Y */
                 SBC(LOAD_IND_Y(p1), 1, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0xf3:          /* ISB ($nn),Y */
+            OPCODE(0xf3):       /* ISB ($nn),Y */
                 ISB_IND_Y(p1);
-                break;
+                NEXT_OPCODE;
 
-            case 0xf5:          /* SBC $nn,X */
+            OPCODE(0xf5):       /* SBC $nn,X */
                 SBC(LOAD_ZERO_X(p1), CLK_ZERO_I2, 2);
-                break;
+                NEXT_OPCODE;
 
-            case 0xf6:          /* INC $nn,X */
+            OPCODE(0xf6):       /* INC $nn,X */
                 INC((p1 + reg_x_read) & 0xff, CLK_ZERO_I_RMW, 2, LOAD_ZERO, STORE_ABS);
-                break;
+                NEXT_OPCODE;
 
-            case 0xf7:          /* ISB $nn,X */
+            OPCODE(0xf7):       /* ISB $nn,X */
                 ISB((p1 + reg_x_read) & 0xff, 0, CLK_ZERO_I_RMW, 2, LOAD_ZERO, STORE_ABS);
-                break;
+                NEXT_OPCODE;
 
-            case 0xf8:          /* SED */
+            OPCODE(0xf8):       /* SED */
                 SED();
-                break;
+                NEXT_OPCODE;
 
-            case 0xf9:          /* SBC $nnnn,Y */
+            OPCODE(0xf9):       /* SBC $nnnn,Y */
                 SBC(LOAD_ABS_Y(p2), 1, 3);
-                break;
+                NEXT_OPCODE;
 
-            case 0xfb:          /* ISB $nnnn,Y */
+            OPCODE(0xfb):       /* ISB $nnnn,Y */
                 ISB(p2, 0, CLK_ABS_I_RMW2, 3, LOAD_ABS_Y_RMW, STORE_ABS_Y_RMW);
-                break;
+                NEXT_OPCODE;
 
-            case 0xfd:          /* SBC $nnnn,X */
+            OPCODE(0xfd):       /* SBC $nnnn,X */
                 SBC(LOAD_ABS_X(p2), 1, 3);
-                break;
+                NEXT_OPCODE;
 
-            case 0xfe:          /* INC $nnnn,X */
+            OPCODE(0xfe):       /* INC $nnnn,X */
                 INC(p2, CLK_ABS_I_RMW2, 3, LOAD_ABS_X_RMW, STORE_ABS_X_RMW);
-                break;
+                NEXT_OPCODE;
 
-            case 0xff:          /* ISB $nnnn,X */
+            OPCODE(0xff):       /* ISB $nnnn,X */
                 ISB(p2, 0, CLK_ABS_I_RMW2, 3, LOAD_ABS_X_RMW, STORE_ABS_X_RMW);
-                break;
+                NEXT_OPCODE;
         }
     }
 }
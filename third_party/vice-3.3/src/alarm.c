@@ -54,6 +54,7 @@ void alarm_context_init(alarm_context_t *context, const char *name)
 
     context->num_pending_alarms = 0;
     context->next_pending_alarm_clk = (CLOCK) ~0L;
+    context->next_pending_alarm_idx = -1;
 }
 
 void alarm_context_destroy(alarm_context_t *context)
@@ -98,6 +99,14 @@ void alarm_context_time_warp(alarm_context_t *context, CLOCK warp_amount,
     } else {
         context->next_pending_alarm_clk -= warp_amount;
     }
+
+#ifdef ALARM_TRACE
+    /* Replayed as a set of every pending alarm to its new clock.  */
+    for (i = 0; i < context->num_pending_alarms; i++) {
+        alarm_trace('s', context->pending_alarms[i].alarm,
+                    context->pending_alarms[i].clk);
+    }
+#endif
 }
 
 /* ------------------------------------------------------------------------ */
@@ -112,6 +121,15 @@ static void alarm_init(alarm_t *alarm, alarm_context_t *context,
 
     alarm->pending_idx = -1;      /* Not pending.  */
 
+#ifdef ALARM_TRACE
+    {
+        static int trace_ids = 0;
+
+        alarm->trace_id = trace_ids++;
+        alarm_trace('n', alarm, 0);
+    }
+#endif
+
     /* Add to the head of the alarm list of the alarm context.  */
     if (context->alarms == NULL) {
         context->alarms = alarm;
@@ -167,7 +185,7 @@ void alarm_destroy(alarm_t *alarm)
 void alarm_unset(alarm_t *alarm)
 {
     alarm_context_t *context;
-    int idx;
+    int idx, last;
 
     idx = alarm->pending_idx;
 
@@ -176,33 +194,29 @@ void alarm_unset(alarm_t *alarm)
     }
     context = alarm->context;
 
-    if (context->num_pending_alarms > 1) {
-        int last;
+    alarm_trace('u', alarm, 0);
 
-        last = --context->num_pending_alarms;
+    last = --context->num_pending_alarms;
 
-        if (last != idx) {
-            /* Let's copy the struct by hand to make sure stupid compilers
-               don't do stupid things.  */
-            context->pending_alarms[idx].alarm
-                = context->pending_alarms[last].alarm;
-            context->pending_alarms[idx].clk
-                = context->pending_alarms[last].clk;
+    if (last != idx) {
+        /* Fill the hole with the last alarm of the heap and move it to
+           wherever it belongs from there.  */
+        CLOCK clk = context->pending_alarms[last].clk;
 
-            context->pending_alarms[idx].alarm->pending_idx = idx;
-        }
+        context->pending_alarms[idx].alarm
+            = context->pending_alarms[last].alarm;
+        context->pending_alarms[idx].clk = clk;
+        context->pending_alarms[idx].alarm->pending_idx = idx;
 
-        if (context->next_pending_alarm_idx == idx) {
-            alarm_context_update_next_pending(context);
-        } else if (context->next_pending_alarm_idx == last) {
-            context->next_pending_alarm_idx = idx;
+        if (idx > 0 && clk < context->pending_alarms[(idx - 1) >> 1].clk) {
+            alarm_context_sift_up(context, (unsigned int)idx);
+        } else {
+            alarm_context_sift_down(context, (unsigned int)idx);
         }
-    } else {
-        context->num_pending_alarms = 0;
-        context->next_pending_alarm_clk = (CLOCK) ~0L;
-        context->next_pending_alarm_idx = -1;
     }
 
+    alarm_context_update_next_pending(context);
+
     alarm->pending_idx = -1;
 }
 
@@ -210,3 +224,27 @@ void alarm_log_too_many_alarms(void)
 {
     log_error(LOG_DEFAULT, "alarm_set(): Too many alarms set!");
 }
+
+#ifdef ALARM_TRACE
+void alarm_trace(char op, alarm_t *alarm, CLOCK clk)
+{
+    static FILE *trace_file = NULL;
+
+    if (trace_file == NULL) {
+        trace_file = fopen("alarm-trace.txt", "w");
+        if (trace_file == NULL) {
+            return;
+        }
+    }
+
+    if (op == 'n') {
+        fprintf(trace_file, "n %d %s\n", alarm->trace_id,
+                alarm->context->name);
+    } else if (op == 'u') {
+        fprintf(trace_file, "u %d\n", alarm->trace_id);
+    } else {
+        fprintf(trace_file, "%c %d %lu\n", op, alarm->trace_id,
+                (unsigned long)clk);
+    }
+}
+#endif
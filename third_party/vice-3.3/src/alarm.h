@@ -45,10 +45,15 @@ struct alarm_s {
     /* Callback to be called when the alarm is dispatched.  */
     alarm_callback_t callback;
 
-    /* Index into the pending alarm list.  If < 0, the alarm is not
+    /* Index into the pending alarm heap.  If < 0, the alarm is not
        pending.  */
     int pending_idx;
 
+#ifdef ALARM_TRACE
+    /* Identifies the alarm in the trace.  */
+    int trace_id;
+#endif
+
     /* Call data */
     void *data;
 
@@ -74,15 +79,17 @@ struct alarm_context_s {
     /* Alarm list.  */
     struct alarm_s *alarms;
 
-    /* Pending alarm array.  Statically allocated because it's slightly
+    /* Pending alarms, kept as a binary min-heap on clk so the next one
+       is always at index 0.  Statically allocated because it's slightly
        faster this way.  */
     pending_alarms_t pending_alarms[ALARM_CONTEXT_MAX_PENDING_ALARMS];
     unsigned int num_pending_alarms;
 
-    /* Clock tick for the next pending alarm.  */
+    /* Clock tick for the next pending alarm.  Mirrors the top of the
+       heap so the CPU loop only has to read one field.  */
     CLOCK next_pending_alarm_clk;
 
-    /* Pending alarm number.  */
+    /* Pending alarm number: 0, or -1 if nothing is pending.  */
     int next_pending_alarm_idx;
 };
 typedef struct alarm_context_s alarm_context_t;
@@ -100,6 +107,14 @@ extern void alarm_destroy(alarm_t *alarm);
 extern void alarm_unset(alarm_t *alarm);
 extern void alarm_log_too_many_alarms(void);
 
+#ifdef ALARM_TRACE
+/* Records every new alarm with its context, and every set, unset and
+   dispatch, to alarm-trace.txt for tools/alarm_bench.  */
+extern void alarm_trace(char op, alarm_t *alarm, CLOCK clk);
+#else
+#define alarm_trace(op, alarm, clk)
+#endif
+
 /* ------------------------------------------------------------------------- */
 
 /* Inline functions.  */
@@ -109,39 +124,94 @@ inline static CLOCK alarm_context_next_pending_clk(alarm_context_t *context)
     return context->next_pending_alarm_clk;
 }
 
-inline static void alarm_context_update_next_pending(alarm_context_t *context)
+/* Pending alarms are kept in a binary min-heap ordered by clk.  An
+   alarm's pending_idx is its position in the heap.  Setting, moving and
+   unsetting an alarm cost O(log n) and finding the next one is free,
+   where the old unsorted array needed an O(n) scan for every change to
+   the earliest alarm.  Alarms due at the same clock are dispatched in
+   no particular order, as before.  */
+
+inline static void alarm_context_heap_put(alarm_context_t *context,
+                                          unsigned int idx,
+                                          alarm_t *alarm, CLOCK clk)
 {
-    CLOCK next_pending_alarm_clk = (CLOCK)~0L;
-    int next_pending_alarm_idx;
-    unsigned int i;
+    context->pending_alarms[idx].alarm = alarm;
+    context->pending_alarms[idx].clk = clk;
+    alarm->pending_idx = (int)idx;
+}
 
-    next_pending_alarm_idx = context->next_pending_alarm_idx;
+/* Move the alarm at idx towards the top until its parent is earlier.  */
+inline static void alarm_context_sift_up(alarm_context_t *context,
+                                         unsigned int idx)
+{
+    pending_alarms_t *heap = context->pending_alarms;
+    alarm_t *alarm = heap[idx].alarm;
+    CLOCK clk = heap[idx].clk;
 
-    for (i = 0; i < context->num_pending_alarms; i++) {
-        CLOCK pending_clk = context->pending_alarms[i].clk;
+    while (idx > 0) {
+        unsigned int parent = (idx - 1) >> 1;
 
-        if (pending_clk <= next_pending_alarm_clk) {
-            next_pending_alarm_clk = pending_clk;
-            next_pending_alarm_idx = (int)i;
+        if (heap[parent].clk <= clk) {
+            break;
         }
+        alarm_context_heap_put(context, idx, heap[parent].alarm,
+                               heap[parent].clk);
+        idx = parent;
     }
+    alarm_context_heap_put(context, idx, alarm, clk);
+}
+
+/* Move the alarm at idx towards the bottom until its children are
+   later.  */
+inline static void alarm_context_sift_down(alarm_context_t *context,
+                                           unsigned int idx)
+{
+    pending_alarms_t *heap = context->pending_alarms;
+    unsigned int n = context->num_pending_alarms;
+    alarm_t *alarm = heap[idx].alarm;
+    CLOCK clk = heap[idx].clk;
 
-    context->next_pending_alarm_clk = next_pending_alarm_clk;
-    context->next_pending_alarm_idx = next_pending_alarm_idx;
+    for (;;) {
+        unsigned int child = 2 * idx + 1;
+
+        if (child >= n) {
+            break;
+        }
+        if (child + 1 < n && heap[child + 1].clk < heap[child].clk) {
+            child++;
+        }
+        if (clk <= heap[child].clk) {
+            break;
+        }
+        alarm_context_heap_put(context, idx, heap[child].alarm,
+                               heap[child].clk);
+        idx = child;
+    }
+    alarm_context_heap_put(context, idx, alarm, clk);
+}
+
+inline static void alarm_context_update_next_pending(alarm_context_t *context)
+{
+    if (context->num_pending_alarms > 0) {
+        context->next_pending_alarm_clk = context->pending_alarms[0].clk;
+        context->next_pending_alarm_idx = 0;
+    } else {
+        context->next_pending_alarm_clk = (CLOCK)~0L;
+        context->next_pending_alarm_idx = -1;
+    }
 }
 
 inline static void alarm_context_dispatch(alarm_context_t *context,
                                           CLOCK cpu_clk)
 {
     CLOCK offset;
-    int idx;
     alarm_t *alarm;
 
     offset = (CLOCK)(cpu_clk - context->next_pending_alarm_clk);
 
-    idx = context->next_pending_alarm_idx;
-    alarm = context->pending_alarms[idx].alarm;
+    alarm = context->pending_alarms[0].alarm;
 
+    alarm_trace('d', alarm, context->next_pending_alarm_clk);
     (alarm->callback)(offset, alarm->data);
 }
 
@@ -153,37 +223,37 @@ inline static void alarm_set(alarm_t *alarm, CLOCK cpu_clk)
     context = alarm->context;
     idx = alarm->pending_idx;
 
+    alarm_trace('s', alarm, cpu_clk);
+
     if (idx < 0) {
-        int new_idx;
+        unsigned int new_idx;
 
         /* Not pending yet: add.  */
 
-        new_idx = (int)(context->num_pending_alarms);
-        if (new_idx >= (int)ALARM_CONTEXT_MAX_PENDING_ALARMS) {
+        new_idx = context->num_pending_alarms;
+        if (new_idx >= ALARM_CONTEXT_MAX_PENDING_ALARMS) {
             alarm_log_too_many_alarms();
             return;
         }
 
-        context->pending_alarms[new_idx].alarm = alarm;
-        context->pending_alarms[new_idx].clk = cpu_clk;
-
         context->num_pending_alarms++;
-
-        if (cpu_clk < context->next_pending_alarm_clk) {
-            context->next_pending_alarm_clk = cpu_clk;
-            context->next_pending_alarm_idx = new_idx;
-        }
-
-        alarm->pending_idx = new_idx;
+        alarm_context_heap_put(context, new_idx, alarm, cpu_clk);
+        alarm_context_sift_up(context, new_idx);
     } else {
         /* Already pending: modify.  */
 
+        CLOCK old_clk = context->pending_alarms[idx].clk;
+
         context->pending_alarms[idx].clk = cpu_clk;
-        if (context->next_pending_alarm_clk > cpu_clk
-            || idx == context->next_pending_alarm_idx) {
-            alarm_context_update_next_pending(context);
+        if (cpu_clk < old_clk) {
+            alarm_context_sift_up(context, (unsigned int)idx);
+        } else {
+            alarm_context_sift_down(context, (unsigned int)idx);
         }
     }
+
+    context->next_pending_alarm_clk = context->pending_alarms[0].clk;
+    context->next_pending_alarm_idx = 0;
 }
 
 #endif
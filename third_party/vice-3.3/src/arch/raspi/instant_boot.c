@@ -0,0 +1,232 @@
+/*
+ * instant_boot.c
+ *
+ * Written by
+ *  Randy Rossi <randy.rossi@gmail.com>
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#include "instant_boot.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "archdep.h"
+#include "autostart.h"
+#include "ioutil.h"
+#include "lib.h"
+#include "machine.h"
+#include "resources.h"
+#include "snapshot.h"
+#include "sysfile.h"
+#include "util.h"
+
+// RASPI includes
+#include "emux_api.h"
+#include "menu.h"
+
+// Anything that names a ROM for one of the machines or drives. Names
+// that don't exist for the current machine are skipped.
+static const char *rom_resources[] = {
+  "KernalName", "BasicName", "ChargenName",
+  "KernalIntName", "KernalDEName", "KernalFIName", "KernalFRName",
+  "KernalITName", "KernalNOName", "KernalSEName", "KernalCHName",
+  "BasicLoName", "BasicHiName", "Kernal64Name", "Basic64Name",
+  "ChargenIntName", "ChargenDEName", "ChargenFRName", "ChargenSEName",
+  "ChargenCHName", "ChargenNOName",
+  "FunctionLowName", "FunctionHighName",
+  "c1loName", "c1hiName", "c2loName", "c2hiName",
+  "DosName1541", "DosName1541ii", "DosName1551", "DosName1570",
+  "DosName1571", "DosName1581", "DosName2000", "DosName4000",
+  NULL
+};
+
+static int boot_key_valid;
+static uint32_t boot_key;
+
+static uint32_t hash_bytes(uint32_t h, const uint8_t *p, size_t len) {
+  while (len--) {
+    h = (h ^ *p++) * 16777619u;
+  }
+  return h;
+}
+
+static uint32_t hash_int(uint32_t h, int value) {
+  return hash_bytes(h, (const uint8_t *)&value, sizeof(value));
+}
+
+static uint32_t hash_file(uint32_t h, const char *path) {
+  uint8_t buf[1024];
+  size_t n;
+  FILE *fp = fopen(path, "r");
+  if (fp == NULL) {
+    // Missing is a state too.
+    return hash_int(h, -1);
+  }
+  while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+    h = hash_bytes(h, buf, n);
+  }
+  fclose(fp);
+  return h;
+}
+
+static uint32_t compute_key(void) {
+  uint32_t h = 2166136261u;
+  const char *name = machine_get_name();
+  int i;
+  int value;
+  char *path;
+
+  h = hash_bytes(h, (const uint8_t *)name, strlen(name));
+
+  path = archdep_default_resource_file_name();
+  h = hash_file(h, path);
+  lib_free(path);
+
+  h = hash_file(h, menu_settings_file());
+  h = hash_file(h, "/cmdline.txt");
+
+  if (resources_get_int("MachineVideoStandard", &value) == 0) {
+    h = hash_int(h, value);
+  }
+
+  for (i = 0; rom_resources[i]; i++) {
+    const char *rom_name;
+    if (resources_get_string(rom_resources[i], &rom_name) != 0 ||
+        rom_name == NULL || *rom_name == '\0') {
+      continue;
+    }
+    h = hash_bytes(h, (const uint8_t *)rom_name, strlen(rom_name));
+    if (sysfile_locate(rom_name, &path) == 0) {
+      h = hash_file(h, path);
+      lib_free(path);
+    } else {
+      h = hash_int(h, -1);
+    }
+  }
+  return h;
+}
+
+static char *snapshot_name(const char *ext) {
+  return util_concat(archdep_boot_path(), "/instant-", machine_get_name(),
+                     ext, NULL);
+}
+
+static int read_key(uint32_t *key) {
+  char *path = snapshot_name(".key");
+  FILE *fp = fopen(path, "r");
+  int ok = 0;
+  lib_free(path);
+  if (fp != NULL) {
+    ok = fscanf(fp, "%x", (unsigned int *)key) == 1;
+    fclose(fp);
+  }
+  return ok ? 0 : -1;
+}
+
+static int enabled(void) {
+  // PET snapshots are disabled.
+  return menu_instant_boot_enabled() && machine_class != VICE_MACHINE_PET;
+}
+
+int instant_boot_load(void) {
+  uint32_t key;
+  char *path;
+  int status;
+
+  if (!enabled()) {
+    return -1;
+  }
+
+  // Autostart hooks into the reset sequence so let that run normally.
+  if (autostart_in_progress()) {
+    return -1;
+  }
+
+  boot_key = compute_key();
+  boot_key_valid = 1;
+
+  if (read_key(&key) != 0 || key != boot_key) {
+    return -1;
+  }
+
+  path = snapshot_name(".vsf");
+  status = emux_load_state(path);
+  lib_free(path);
+
+  if (status < 0) {
+    // A half read snapshot leaves the machine in no useful state. Start
+    // over and leave boot_key_valid set so a new one gets written.
+    emux_reset(0);
+    return -1;
+  }
+  boot_key_valid = 0;
+  return 0;
+}
+
+// Only a complete snapshot gets a key, so a power cut while it is being
+// written leaves no key and the next boot simply makes a new one.
+static void write_key(int failed) {
+  char *path;
+  FILE *fp;
+
+  if (failed) {
+    return;
+  }
+  path = snapshot_name(".key");
+  fp = fopen(path, "w");
+  lib_free(path);
+  if (fp != NULL) {
+    fprintf(fp, "%08x\n", (unsigned int)boot_key);
+    fclose(fp);
+  }
+}
+
+void instant_boot_save(void) {
+  char *path;
+  snapshot_mem_t *mem;
+
+  // Only when we tried to load and the snapshot was stale or missing.
+  if (!enabled() || !boot_key_valid) {
+    return;
+  }
+  boot_key_valid = 0;
+
+  // Leave the ROMs and disks out. The key covers the ROMs and whatever
+  // is attached at boot gets attached again anyway.
+  // Capture to memory and let the file trickle out over the next few
+  // frames so the first frame after boot doesn't stall on the SD card.
+  mem = snapshot_mem_new();
+  if (machine_write_snapshot_mem(mem, 0, 0, 0) < 0) {
+    snapshot_mem_free(mem);
+    return;
+  }
+  // The old key may be for the snapshot about to be overwritten.
+  path = snapshot_name(".key");
+  ioutil_remove(path);
+  lib_free(path);
+
+  path = snapshot_name(".vsf");
+  snapshot_mem_save_async(mem, path, write_key);
+  lib_free(path);
+}
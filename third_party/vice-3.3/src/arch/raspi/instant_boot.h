@@ -0,0 +1,46 @@
+/*
+ * instant_boot.h
+ *
+ * Written by
+ *  Randy Rossi <randy.rossi@gmail.com>
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef RASPI_INSTANT_BOOT_H
+#define RASPI_INSTANT_BOOT_H
+
+// Instant boot skips the reset warp by restoring a snapshot taken the
+// last time the machine finished booting. The snapshot is paired with
+// a key computed from everything that can change what the machine
+// looks like after a reset (ROMs, vice.ini, BMC64 settings, cmdline).
+// A key mismatch means the snapshot is stale and we boot normally,
+// then replace it once the boot warp is done.
+
+// Try to restore the boot snapshot. Returns 0 if the machine is now
+// in its post-reset state.
+int instant_boot_load(void);
+
+// Take the boot snapshot for next time. Called when the boot warp
+// finishes. Does nothing unless instant_boot_load found the snapshot
+// missing or stale.
+void instant_boot_save(void);
+
+#endif
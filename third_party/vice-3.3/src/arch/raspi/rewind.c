@@ -0,0 +1,496 @@
+/*
+ * rewind.c
+ *
+ * Written by
+ *  Randy Rossi <randy.rossi@gmail.com>
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#include "rewind.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lib.h"
+#include "log.h"
+#include "machine.h"
+#include "resources.h"
+#include "snapshot.h"
+
+// RASPI includes
+#include "circle.h"
+#include "menu.h"
+
+#define REWIND_MAX_ENTRIES 512
+
+// Deltas are always against the last keyframe, so restoring any state
+// is at most one copy and one patch. Take a new keyframe this often to
+// keep the deltas small.
+#define REWIND_KEYFRAME_EVERY 16
+
+// A changed run absorbs runs of unchanged bytes shorter than this.
+// Cheaper than starting a new run.
+#define REWIND_MIN_GAP 8
+
+// Taking the snapshot is one pass over the machine's state and can't
+// be split. If it takes longer than this, captures get spread further
+// apart so the frame still makes it to vsync.
+#define REWIND_CAPTURE_BUDGET_US 3000
+#define REWIND_MAX_BACKOFF 8
+
+// Encoding and storing the snapshot is spread over the following
+// frames. Each frame compares or copies at most this many bytes of it.
+#define REWIND_BYTES_PER_FRAME 32768
+
+// Rewinding to a state younger than this would hardly be noticed.
+#define REWIND_MIN_STEP_FRAMES 25
+
+struct rewind_entry {
+  // Where the stored bytes are in the arena and how many.
+  uint32_t off;
+  uint32_t len;
+  // Size of the snapshot it decodes to.
+  uint32_t size;
+  uint32_t frame;
+  int is_key;
+};
+
+static uint8_t *arena;
+static uint32_t arena_size;
+static int arena_mb;
+
+// Ring of entries, oldest first.
+static struct rewind_entry entries[REWIND_MAX_ENTRIES];
+static int first;
+static int count;
+
+// Slot of the keyframe new deltas are taken against or -1.
+static int key_slot = -1;
+static int since_key;
+
+enum {
+  CAPTURE_NONE,
+  CAPTURE_DELTA,
+  CAPTURE_KEY,
+};
+
+static snapshot_mem_t *capture;
+static int capture_state;
+static uint32_t capture_frame;
+// How far into the snapshot we got.
+static uint32_t capture_pos;
+// Delta bytes encoded so far or where the keyframe goes in the arena.
+static uint32_t capture_len;
+static uint32_t capture_off;
+static uint8_t *delta_buf;
+static uint32_t delta_buf_size;
+
+static uint32_t frame;
+static int frames_to_capture;
+static int backoff = 1;
+static unsigned long max_cost_us;
+static int too_big_logged;
+
+static int slot_of(int i) {
+  return (first + i) % REWIND_MAX_ENTRIES;
+}
+
+static void clear(void) {
+  first = 0;
+  count = 0;
+  key_slot = -1;
+  capture_state = CAPTURE_NONE;
+}
+
+// Deltas are useless without their keyframe so the whole group goes.
+static void evict_oldest(void) {
+  do {
+    if (first == key_slot) {
+      key_slot = -1;
+    }
+    first = slot_of(1);
+    count--;
+  } while (count > 0 && !entries[first].is_key);
+}
+
+static void drop_newest(void) {
+  if (slot_of(count - 1) == key_slot) {
+    key_slot = -1;
+  }
+  count--;
+}
+
+// Find room for len bytes, evicting the oldest groups as needed. Won't
+// evict the current keyframe if keep_key is set.
+static int arena_alloc(uint32_t len, int keep_key, uint32_t *off) {
+  if (len > arena_size) {
+    return -1;
+  }
+  for (;;) {
+    if (count == 0) {
+      *off = 0;
+      return 0;
+    }
+    if (count < REWIND_MAX_ENTRIES) {
+      struct rewind_entry *oldest = &entries[first];
+      struct rewind_entry *newest = &entries[slot_of(count - 1)];
+      uint32_t head = newest->off + newest->len;
+      uint32_t tail = oldest->off;
+      if (head > tail) {
+        // Not wrapped. Room at the end or else at the start.
+        if (arena_size - head >= len) {
+          *off = head;
+          return 0;
+        }
+        if (tail >= len) {
+          *off = 0;
+          return 0;
+        }
+      } else if (tail - head >= len) {
+        *off = head;
+        return 0;
+      }
+    }
+    if (keep_key && first == key_slot) {
+      return -1;
+    }
+    evict_oldest();
+  }
+}
+
+static void add_entry(uint32_t off, uint32_t len, uint32_t size,
+                      int is_key) {
+  struct rewind_entry *e = &entries[slot_of(count)];
+
+  e->off = off;
+  e->len = len;
+  e->size = size;
+  e->frame = capture_frame;
+  e->is_key = is_key;
+  if (is_key) {
+    key_slot = slot_of(count);
+    since_key = 0;
+  } else {
+    since_key++;
+  }
+  count++;
+}
+
+static uint32_t put_varint(uint8_t *p, uint32_t v) {
+  uint32_t n = 0;
+  while (v >= 0x80) {
+    p[n++] = (v & 0x7f) | 0x80;
+    v >>= 7;
+  }
+  p[n++] = v;
+  return n;
+}
+
+static uint32_t get_varint(const uint8_t *p, uint32_t *v) {
+  uint32_t n = 0;
+  int shift = 0;
+  *v = 0;
+  do {
+    *v |= (uint32_t)(p[n] & 0x7f) << shift;
+    shift += 7;
+  } while (p[n++] & 0x80);
+  return n;
+}
+
+// Deltas are a list of (unchanged count, changed count, changed bytes).
+// Returns the encoded length or 0 if it would not fit in out_size.
+static uint32_t encode_delta(const uint8_t *cur, const uint8_t *key,
+                             uint32_t n, uint8_t *out, uint32_t out_size) {
+  uint32_t i = 0;
+  uint32_t o = 0;
+
+  while (i < n) {
+    uint32_t skip_start = i;
+    uint32_t copy_start;
+    uint32_t j;
+
+    while (i < n && cur[i] == key[i]) {
+      i++;
+    }
+    copy_start = i;
+
+    j = i;
+    while (j < n) {
+      if (cur[j] != key[j]) {
+        i = ++j;
+      } else {
+        uint32_t k = j;
+        while (k < n && cur[k] == key[k] && k - j < REWIND_MIN_GAP) {
+          k++;
+        }
+        if (k == n || k - j >= REWIND_MIN_GAP) {
+          break;
+        }
+        j = k;
+      }
+    }
+
+    if (o + 10 + (i - copy_start) > out_size) {
+      return 0;
+    }
+    o += put_varint(out + o, copy_start - skip_start);
+    o += put_varint(out + o, i - copy_start);
+    memcpy(out + o, cur + copy_start, i - copy_start);
+    o += i - copy_start;
+  }
+  return o;
+}
+
+static int apply_delta(uint8_t *dst, uint32_t n, const uint8_t *d,
+                       uint32_t len) {
+  uint32_t i = 0;
+  uint32_t o = 0;
+
+  while (o < len) {
+    uint32_t skip, copy;
+    o += get_varint(d + o, &skip);
+    o += get_varint(d + o, &copy);
+    i += skip;
+    if (i + copy > n || o + copy > len) {
+      return -1;
+    }
+    memcpy(dst + i, d + o, copy);
+    o += copy;
+    i += copy;
+  }
+  return 0;
+}
+
+static void account(unsigned long start) {
+  unsigned long cost = circle_get_ticks() - start;
+
+  if (cost > max_cost_us) {
+    max_cost_us = cost;
+  }
+  if (cost > REWIND_CAPTURE_BUDGET_US && backoff < REWIND_MAX_BACKOFF) {
+    backoff *= 2;
+    log_message(LOG_DEFAULT, "Rewind: capture took %luus, every %d frames now",
+                cost, menu_rewind_interval() * backoff);
+  } else if (cost < REWIND_CAPTURE_BUDGET_US / 2 && backoff > 1) {
+    backoff /= 2;
+  }
+}
+
+// Reserve room for the capture as a keyframe. It is copied in over the
+// next frames.
+static void begin_key(uint32_t size) {
+  if (arena_alloc(size, 0, &capture_off) != 0) {
+    capture_state = CAPTURE_NONE;
+    return;
+  }
+  capture_state = CAPTURE_KEY;
+  capture_pos = 0;
+}
+
+// Store it as a delta if we can, as a keyframe otherwise.
+static void begin_store(void) {
+  uint32_t size = snapshot_mem_size(capture);
+
+  // Need room for at least a keyframe and something to go with it.
+  if (size > arena_size / 2) {
+    if (!too_big_logged) {
+      log_error(LOG_DEFAULT, "Rewind: %u byte state is too big for %dMB",
+                (unsigned int)size, arena_mb);
+      too_big_logged = 1;
+    }
+    return;
+  }
+
+  capture_frame = frame;
+  if (key_slot >= 0 && since_key < REWIND_KEYFRAME_EVERY &&
+      entries[key_slot].size == size) {
+    // Not worth it if it's over half the size of a keyframe.
+    if (delta_buf_size < size / 2) {
+      delta_buf_size = size / 2;
+      delta_buf = lib_realloc(delta_buf, delta_buf_size);
+    }
+    capture_state = CAPTURE_DELTA;
+    capture_pos = 0;
+    capture_len = 0;
+  } else {
+    begin_key(size);
+  }
+}
+
+// First half. Snapshot the machine into the capture buffer.
+static void take_snapshot(void) {
+  unsigned long start = circle_get_ticks();
+
+  // Disks are not part of it. Neither are ROMs since we never leave
+  // this session.
+  if (machine_write_snapshot_mem(capture, 0, 0, 0) == 0) {
+    begin_store();
+  }
+  account(start);
+}
+
+// Second half. Encode or copy the next REWIND_BYTES_PER_FRAME bytes.
+// Deltas of consecutive pieces simply follow each other.
+static void store_step(void) {
+  const uint8_t *data = snapshot_mem_data(capture);
+  uint32_t size = snapshot_mem_size(capture);
+  uint32_t n = size - capture_pos;
+
+  if (n > REWIND_BYTES_PER_FRAME) {
+    n = REWIND_BYTES_PER_FRAME;
+  }
+
+  if (capture_state == CAPTURE_DELTA) {
+    uint32_t len = encode_delta(data + capture_pos,
+                                arena + entries[key_slot].off + capture_pos,
+                                n, delta_buf + capture_len,
+                                size / 2 - capture_len);
+    if (len == 0) {
+      begin_key(size);
+      return;
+    }
+    capture_len += len;
+    capture_pos += n;
+    if (capture_pos < size) {
+      return;
+    }
+    if (arena_alloc(capture_len, 1, &capture_off) != 0) {
+      begin_key(size);
+      return;
+    }
+    memcpy(arena + capture_off, delta_buf, capture_len);
+    add_entry(capture_off, capture_len, size, 0);
+  } else {
+    memcpy(arena + capture_off + capture_pos, data + capture_pos, n);
+    capture_pos += n;
+    if (capture_pos < size) {
+      return;
+    }
+    add_entry(capture_off, size, size, 1);
+  }
+  capture_state = CAPTURE_NONE;
+}
+
+// Allocate or free the ring to match the settings. Returns 1 if rewind
+// is on.
+static int configure(void) {
+  int mb = 0;
+
+  // PET snapshots are disabled.
+  if (menu_rewind_enabled() && machine_class != VICE_MACHINE_PET) {
+    mb = menu_rewind_memory();
+  }
+
+  if (mb != arena_mb) {
+    clear();
+    free(arena);
+    arena = NULL;
+    arena_size = 0;
+    arena_mb = mb;
+    too_big_logged = 0;
+    if (mb > 0) {
+      // Plain malloc. A budget that doesn't fit is not fatal.
+      arena = malloc((size_t)mb * 1024 * 1024);
+      if (arena == NULL) {
+        log_error(LOG_DEFAULT, "Rewind: can't allocate %dMB", mb);
+        return 0;
+      }
+      arena_size = (uint32_t)mb * 1024 * 1024;
+      if (capture == NULL) {
+        capture = snapshot_mem_new();
+      }
+    }
+  }
+  return arena != NULL;
+}
+
+void rewind_frame(void) {
+  int warp;
+
+  frame++;
+  if (!configure()) {
+    return;
+  }
+
+  if (capture_state != CAPTURE_NONE) {
+    store_step();
+    return;
+  }
+
+  // Warp frames come too fast to be worth keeping.
+  resources_get_int("WarpMode", &warp);
+  if (warp) {
+    return;
+  }
+
+  if (--frames_to_capture > 0) {
+    return;
+  }
+  frames_to_capture = menu_rewind_interval() * backoff;
+  take_snapshot();
+}
+
+int rewind_step_back(void) {
+  struct rewind_entry *e;
+  uint8_t *dst;
+  int i;
+
+  if (arena == NULL) {
+    return -1;
+  }
+  capture_state = CAPTURE_NONE;
+
+  while (count > 1 && frame - entries[slot_of(count - 1)].frame <
+                          REWIND_MIN_STEP_FRAMES) {
+    drop_newest();
+  }
+  if (count == 0) {
+    return -1;
+  }
+
+  e = &entries[slot_of(count - 1)];
+  dst = snapshot_mem_resize(capture, e->size);
+  if (e->is_key) {
+    memcpy(dst, arena + e->off, e->size);
+  } else {
+    // The oldest entry is always a keyframe so this finds one.
+    for (i = count - 1; !entries[slot_of(i)].is_key; i--) {
+    }
+    memcpy(dst, arena + entries[slot_of(i)].off, e->size);
+    if (apply_delta(dst, e->size, arena + e->off, e->len) != 0) {
+      clear();
+      return -1;
+    }
+  }
+
+  frame = e->frame;
+  drop_newest();
+  frames_to_capture = menu_rewind_interval();
+
+  if (machine_read_snapshot_mem(capture, 0) != 0) {
+    // Whatever is left in the ring may not match the machine anymore.
+    clear();
+    return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,45 @@
+/*
+ * rewind.h
+ *
+ * Written by
+ *  Randy Rossi <randy.rossi@gmail.com>
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef RASPI_REWIND_H
+#define RASPI_REWIND_H
+
+// Rewind keeps a ring of machine states in RAM, captured every few
+// frames. A full snapshot (keyframe) is followed by a number of deltas
+// that only hold the bytes that changed since that keyframe. The ring
+// lives in one block sized by the rewind memory setting. When it is
+// full, the oldest keyframe and its deltas are dropped.
+
+// Called once per frame from vsyncarch_postsync. Takes care of
+// capturing states and of (re)allocating the ring when the rewind
+// settings change.
+void rewind_frame(void);
+
+// Restore the most recent state that is noticeably in the past and
+// drop everything newer. Returns 0 on success.
+int rewind_step_back(void);
+
+#endif
@@ -60,6 +60,7 @@
 // RASPI includes
 #include "circle.h"
 #include "keycodes.h"
+#include "rewind.h"
 
 struct menu_item *sid_dual_item;
 struct menu_item *sid_base_address_item;
@@ -213,8 +214,8 @@ int emux_save_state(char *filename) {
   return machine_write_snapshot(filename, 1, 1, 0);
 }
 
-int emux_load_state(char *filename) {
-  int status = machine_read_snapshot(filename, 0);
+// Things to put right after any snapshot load.
+static void state_loaded(void) {
   // Somehow, this gets turned off. Vice bug?
   resources_set_int("Datasette", 1);
 
@@ -244,14 +245,17 @@ int emux_load_state(char *filename) {
      }
   }
 
-  resources_get_int("SidStereo", &tmp);
-  sid_dual_item->value = tmp;
+  // Only there for machines that support a second SID.
+  if (sid_dual_item) {
+     resources_get_int("SidStereo", &tmp);
+     sid_dual_item->value = tmp;
 
-  resources_get_int("SidStereoAddressStart", &tmp);
-  for (int i=0;i<sid_base_address_item->num_choices;i=i+1) {
-     if (sid_base_address_item->choice_ints[i] == tmp) {
-        sid_base_address_item->value = i;
-        break;
+     resources_get_int("SidStereoAddressStart", &tmp);
+     for (int i=0;i<sid_base_address_item->num_choices;i=i+1) {
+        if (sid_base_address_item->choice_ints[i] == tmp) {
+           sid_base_address_item->value = i;
+           break;
+        }
      }
   }
 
@@ -261,8 +265,11 @@ int emux_load_state(char *filename) {
   //   KeymapIndex, SidEngine, SidModel, SidFilters, DriveSoundEmulation
   //   DriveSoundEmulationVolume, C128ColumnKey, DatasetteResetWithCPU
   //   IECDevice%i, FSDevice%iDir
-  
+}
 
+int emux_load_state(char *filename) {
+  int status = machine_read_snapshot(filename, 0);
+  state_loaded();
   return status;
 }
 
@@ -761,8 +768,10 @@ void emux_add_sound_options(struct menu_item* parent) {
 
   resources_get_int("SidModel", &tmp_value);
   sid_model_item[0]->value = viceSidModelToBmcChoice(tmp_value);
-  resources_get_int("Sid2Model", &tmp_value);
-  sid_model_item[1]->value = viceSidModelToBmcChoice(tmp_value);
+  if (supports_dual_sid) {
+     resources_get_int("Sid2Model", &tmp_value);
+     sid_model_item[1]->value = viceSidModelToBmcChoice(tmp_value);
+  }
 
   resources_get_int("SidFilters", &tmp_value);
   sid_filter_item->value = tmp_value;
@@ -849,6 +858,12 @@ void emux_set_int(IntSetting setting, int value) {
    case Setting_DriveSoundEmulationVolume:
      resources_set_int("DriveSoundEmulationVolume", value);
      break;
+   case Setting_DriveAsync:
+     resources_set_int("DriveAsync", value);
+     break;
+   case Setting_DriveAsyncLookahead:
+     resources_set_int("DriveAsyncLookahead", value);
+     break;
    case Setting_Mouse:
      resources_set_int("Mouse", value);
      break;
@@ -873,6 +888,10 @@ void emux_set_int(IntSetting setting, int value) {
    case Setting_AutostartWarp:
      resources_set_int("AutostartWarp", value);
      break;
+   case Setting_MachineVideoStandard:
+     resources_set_int("MachineVideoStandard",
+                       value ? MACHINE_SYNC_NTSC : MACHINE_SYNC_PAL);
+     break;
    default:
      assert(0);
  }
@@ -908,6 +927,12 @@ void emux_get_int(IntSetting setting, int* dest) {
     case Setting_DriveSoundEmulationVolume:
       resources_get_int("DriveSoundEmulationVolume", dest);
       break;
+    case Setting_DriveAsync:
+      resources_get_int("DriveAsync", dest);
+      break;
+    case Setting_DriveAsyncLookahead:
+      resources_get_int("DriveAsyncLookahead", dest);
+      break;
     case Setting_C128ColumnKey:
       resources_get_int("C128ColumnKey", dest);
       break;
@@ -1030,6 +1055,11 @@ int emux_handle_quick_func(int button_func) {
     case BTN_ASSIGN_CART_FREEZE:
        cartridge_freeze();
        return 1;
+    case BTN_ASSIGN_REWIND:
+       if (rewind_step_back() == 0) {
+          state_loaded();
+       }
+       return 1;
     default:
        break;
   }
@@ -34,27 +34,36 @@
 #include <sys/time.h>
 
 // VICE includes
+#include "alarm.h"
 #include "joyport/joystick.h"
 #include "kbdbuf.h"
 #include "keyboard.h"
+#include "lib.h"
 #include "machine.h"
+#include "maincpu.h"
 #include "mem.h"
 #include "monitor.h"
 #include "resources.h"
 #include "sid.h"
+#include "snapshot.h"
+#include "sound.h"
 #include "video.h"
 #include "viewport.h"
 
 // RASPI includes
 #include "emux_api.h"
 #include "demo.h"
+#include "instant_boot.h"
 #include "joy.h"
 #include "kbd.h"
 #include "menu.h"
 #include "menu_usb.h"
 #include "menu_tape_osd.h"
 #include "overlay.h"
+#include "avsync.h"
+#include "profile.h"
 #include "raspi_machine.h"
+#include "rewind.h"
 #include "ui.h"
 
 struct video_canvas_s *vdc_canvas;
@@ -85,6 +94,13 @@ unsigned long video_frame_count;
 
 static int raspi_boot_warp = 1;
 
+// Mid frame input polling. See input_band_alarm_handler.
+static alarm_t *input_band_alarm;
+static int input_bands;
+static int input_band;
+static CLOCK input_band_cycles;
+static int input_band_seen;
+
 // Should be set only when raster_skip=true is present
 // in the kernel args.
 int raster_lines;
@@ -196,6 +212,29 @@ static void check_dimensions(struct video_canvas_s* canvas,
    canvas->raster_lines |= raster_lines;
 }
 
+// Start dirty line tracking for a freshly allocated frame buffer. The
+// first frame is uploaded in full by the fbl regardless.
+static void reset_dirty_lines(struct video_canvas_s *canvas, int layer,
+                              unsigned int fb_height) {
+   canvas->num_lines = fb_height;
+   canvas->dirty_y0 = 0;
+   canvas->dirty_y1 = 0;
+   circle_track_dirty_fbl(layer, 1);
+}
+
+// Hand the rows changed this frame to the fbl and the raster cache
+// hits to the profiler.
+static void flush_dirty_lines(struct video_canvas_s *canvas, int layer) {
+   if (canvas->dirty_y0 < canvas->dirty_y1) {
+      circle_dirty_fbl(layer, canvas->dirty_y0, canvas->dirty_y1);
+   }
+   canvas->dirty_y0 = 0;
+   canvas->dirty_y1 = 0;
+   profile_lines(canvas->frame_lines, canvas->frame_lines_drawn);
+   canvas->frame_lines = 0;
+   canvas->frame_lines_drawn = 0;
+}
+
 // Draw buffer bridge functions back to kernel
 static int draw_buffer_alloc(struct video_canvas_s *canvas,
                              uint8_t **draw_buffer,
@@ -208,6 +247,9 @@ static int draw_buffer_alloc(struct video_canvas_s *canvas,
       status = circle_alloc_fbl(FB_LAYER_VDC, 0 /* indexed */, draw_buffer,
                               fb_width, fb_height * canvas->raster_skip,
                               fb_pitch);
+      if (status == 0) {
+         reset_dirty_lines(canvas, FB_LAYER_VDC, fb_height);
+      }
       emux_frame_buffer_changed(FB_LAYER_VDC);
    } else {
       check_dimensions(canvas, VIC_INDEX, fb_width,
@@ -215,6 +257,9 @@ static int draw_buffer_alloc(struct video_canvas_s *canvas,
       status = circle_alloc_fbl(FB_LAYER_VIC, 0 /* indexed */, draw_buffer,
                               fb_width, fb_height * canvas->raster_skip,
                               fb_pitch);
+      if (status == 0) {
+         reset_dirty_lines(canvas, FB_LAYER_VIC, fb_height);
+      }
       emux_frame_buffer_changed(FB_LAYER_VIC);
    }
 
@@ -347,52 +392,11 @@ void vsyncarch_init(void) {
 
 void vsyncarch_presync(void) { kbdbuf_flush(); }
 
-void vsyncarch_postsync(void) {
-  emux_ensure_video();
-
-  // This render will handle any OSDs we have. ODSs don't pause emulation.
-  if (ui_enabled) {
-    // The only way we can be here and have ui_enabled=1
-    // is for an osd to be enabled.
-    ui_render_now(-1); // only render top most menu
-    circle_frames_ready_fbl(FB_LAYER_UI, -1 /* no 2nd layer */, 0 /* no sync */);
-    ui_check_key();
-  }
-
-  if (statusbar_showing || vkbd_showing) {
-    overlay_check();
-    if (overlay_dirty) {
-       circle_frames_ready_fbl(FB_LAYER_STATUS,
-                               -1 /* no 2nd layer */,
-                               0 /* no sync */);
-       overlay_dirty = 0;
-    }
-  }
-
-  video_ticks += video_tick_inc;
-
-  // This yield is important to let the fake kernel 'threads' run.
-  circle_yield();
-
-  video_frame_count++;
-  if (raspi_boot_warp && video_frame_count > 120) {
-    raspi_boot_warp = 0;
-    circle_boot_complete();
-    resources_set_int("WarpMode", 0);
-  }
-
-  // Hold for vsync unless warping or in boot warp.
-  int raspi_warp;
-  resources_get_int("WarpMode", &raspi_warp);
-  circle_frames_ready_fbl(FB_LAYER_VIC,
-                         machine_class == VICE_MACHINE_C128 ? FB_LAYER_VDC : -1,
-                         !raspi_boot_warp && !raspi_warp);
-
-  circle_check_gpio();
-
+// Do key press/releases and joy latches queued by USB and GPIO.
+// Returns non-zero if there were any.
+static int drain_input(void) {
   int reset_demo = 0;
 
-  // Do key press/releases and joy latches on the main loop.
   circle_lock_acquire();
   while (pending_emu_key.head != pending_emu_key.tail) {
     int i = pending_emu_key.head & 0xf;
@@ -484,10 +488,143 @@ void vsyncarch_postsync(void) {
     pending_emu_joy.head++;
   }
   circle_lock_release();
+  return reset_demo;
+}
+
+// Hands input to the machine at evenly spaced raster lines as well as
+// at vsync, menu_input_polls() times per frame in all. The first band
+// starts at vsync. Cuts up to a frame of latency for programs that
+// read the keyboard or joystick more than once per frame or that
+// happen to read it just before vsync.
+static void input_band_alarm_handler(CLOCK offset, void *data) {
+  alarm_unset(input_band_alarm);
+
+  // The virtual keyboard steers the UI and is only handled at vsync.
+  if (!vkbd_enabled) {
+    circle_check_gpio();
+    if (drain_input()) {
+      input_band_seen = 1;
+    }
+  }
+
+  if (++input_band < input_bands) {
+    alarm_set(input_band_alarm,
+              maincpu_clk - offset + input_band_cycles);
+  }
+}
+
+static void input_band_start(int enable) {
+  if (!input_band_alarm) {
+    input_band_alarm = alarm_new(maincpu_alarm_context, "RaspiInput",
+                                 input_band_alarm_handler, NULL);
+  }
+
+  input_bands = enable ? menu_input_polls() : 1;
+  if (input_bands <= 1) {
+    alarm_unset(input_band_alarm);
+    return;
+  }
+
+  input_band = 1;
+  input_band_cycles = machine_get_cycles_per_frame() / input_bands;
+  alarm_set(input_band_alarm, maincpu_clk + input_band_cycles);
+}
+
+// Turbo warp only draws and shows one frame in TURBO_WARP_FRAMES while
+// warping and doesn't have the SIDs make samples that would be thrown
+// away. Decided at vsync for the next frame.
+#define TURBO_WARP_FRAMES 10
+
+static int turbo_frame;
+
+static void turbo_warp_update(int warping) {
+  int turbo = warping && menu_turbo_warp();
+  int skip;
+
+  turbo_frame = turbo ? (turbo_frame + 1) % TURBO_WARP_FRAMES : 0;
+  skip = turbo_frame != 0;
+
+  vic_canvas->skip_drawing = skip;
+  if (vdc_canvas) {
+    vdc_canvas->skip_drawing = skip;
+  }
+  sound_set_turbo(turbo);
+}
+
+void vsyncarch_postsync(void) {
+  emux_ensure_video();
+
+  // This render will handle any OSDs we have. ODSs don't pause emulation.
+  if (ui_enabled) {
+    // The only way we can be here and have ui_enabled=1
+    // is for an osd to be enabled.
+    PROFILE_BEGIN(PROFILE_UI);
+    ui_render_now(-1); // only render top most menu
+    PROFILE_END(PROFILE_UI);
+    circle_frames_ready_fbl(FB_LAYER_UI, -1 /* no 2nd layer */, 0 /* no sync */);
+    ui_check_key();
+  }
+
+  if (statusbar_showing || vkbd_showing) {
+    overlay_check();
+    if (overlay_dirty) {
+       circle_frames_ready_fbl(FB_LAYER_STATUS,
+                               -1 /* no 2nd layer */,
+                               0 /* no sync */);
+       overlay_dirty = 0;
+    }
+  }
+
+  video_ticks += video_tick_inc;
+
+  // This yield is important to let the fake kernel 'threads' run.
+  circle_yield();
+
+  video_frame_count++;
+  if (raspi_boot_warp && video_frame_count == 1 && instant_boot_load() == 0) {
+    // Restored a post reset snapshot. Nothing left to warp through.
+    raspi_boot_warp = 0;
+    circle_boot_complete();
+    resources_set_int("WarpMode", 0);
+  } else if (raspi_boot_warp && video_frame_count > 120) {
+    raspi_boot_warp = 0;
+    circle_boot_complete();
+    resources_set_int("WarpMode", 0);
+    instant_boot_save();
+  }
+
+  // Trickle out any snapshot being saved in the background.
+  snapshot_mem_flush_step();
+
+  rewind_frame();
+
+  // Hold for vsync unless warping or in boot warp.
+  int raspi_warp;
+  resources_get_int("WarpMode", &raspi_warp);
+  flush_dirty_lines(vic_canvas, FB_LAYER_VIC);
+  if (machine_class == VICE_MACHINE_C128) {
+    flush_dirty_lines(vdc_canvas, FB_LAYER_VDC);
+  }
+  // Nothing to show for frames turbo warp didn't draw.
+  if (!vic_canvas->skip_drawing) {
+    circle_frames_ready_fbl(FB_LAYER_VIC,
+                           machine_class == VICE_MACHINE_C128 ? FB_LAYER_VDC : -1,
+                           !raspi_boot_warp && !raspi_warp);
+  }
+  turbo_warp_update(raspi_boot_warp || raspi_warp);
+  if (!raspi_boot_warp && !raspi_warp) {
+    avsync_vsync();
+  }
+  profile_frame_end();
+
+  circle_check_gpio();
+  int reset_demo = drain_input();
+  input_band_start(!raspi_boot_warp && !raspi_warp);
 
   ui_handle_toggle_or_quick_func();
 
-  if (reset_demo) {
+  if (reset_demo || input_band_seen) {
+    input_band_seen = 0;
     demo_reset_timeout();
   }
 
@@ -58,6 +58,27 @@ struct video_canvas_s {
 
   // When non zero, simulates scanlines. Only applicable is raster_lines = 2
   int raster_lines;
+
+  // Lines in the draw buffer (before raster_skip doubling). Rows of
+  // lines drawn this frame are marked dirty so only those are uploaded.
+  // See raster_draw_buffer_mark_line.
+  unsigned int num_lines;
+
+  // Frame buffer rows changed during this frame. dirty_y1 is
+  // exclusive. Empty when dirty_y0 >= dirty_y1.
+  int dirty_y0;
+  int dirty_y1;
+
+  // Visible lines emulated and actually drawn this frame. Lines the
+  // raster cache finds unchanged are left as they are in the frame
+  // buffer. line_drawn is set when the line being emulated was drawn.
+  unsigned int frame_lines;
+  unsigned int frame_lines_drawn;
+  int line_drawn;
+
+  // Set for frames turbo warp won't show. Lines without sprites are
+  // then not drawn at all. See raster-line.c.
+  int skip_drawing;
 };
 
 typedef struct video_canvas_s video_canvas_t;
@@ -126,6 +126,7 @@
 #include "userport_rtc_ds1307.h"
 #include "vdc.h"
 #include "vdc-mem.h"
+#include "vdc-render.h"
 #include "vice-event.h"
 #include "vicii.h"
 #include "vicii-mem.h"
@@ -1257,6 +1258,11 @@ static void machine_vsync_hook(void)
 {
     CLOCK sub;
 
+#ifdef VDC_RENDER_ASYNC
+    /* The VDC frame buffer must be complete before it is shown. */
+    vdc_render_join();
+#endif
+
     drive_vsync_hook();
 
     autostart_advance();
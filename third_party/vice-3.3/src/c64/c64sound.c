@@ -130,7 +130,10 @@ static sound_chip_t sid_sound_chip = {
     sid_sound_machine_reset,
     sid_sound_machine_cycle_based,
     sid_sound_machine_channels,
-    1 /* chip enabled */
+    1, /* chip enabled */
+#ifdef RASPI_COMPILE
+    sid_sound_machine_advance
+#endif
 };
 
 static uint16_t sid_sound_chip_offset = 0;
@@ -0,0 +1,404 @@
+/*
+ * drive-async.c
+ *
+ * Written by
+ *  Randy Rossi <randy.rossi@gmail.com>
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#include "vice.h"
+
+#include "drive-async.h"
+
+#ifdef DRIVE_ASYNC
+
+#include <string.h>
+
+#include "drive.h"
+#include "drivetypes.h"
+#include "iecbus.h"
+#include "log.h"
+#include "machine.h"
+#include "maincpu.h"
+#include "resources.h"
+#include "types.h"
+
+/* Must be a power of 2. */
+#define DRIVE_ASYNC_QUEUE_SIZE 64
+
+#define DRIVE_ASYNC_MAX_LOOKAHEAD 1000
+
+/* Anything further back than this is not just write offset jitter. */
+#define DRIVE_ASYNC_MAX_JUMP 10000
+
+#define dmb() __asm__ volatile ("dmb" ::: "memory")
+#define sev() __asm__ volatile ("dsb\n\tsev" ::: "memory")
+
+typedef struct drive_async_event_s {
+    CLOCK clk;
+    void (*func)(uint8_t data, CLOCK clk);
+    uint8_t data;
+} drive_async_event_t;
+
+int drive_async_active;
+CLOCK drive_async_published;
+
+static int async_enabled;
+static int async_lookahead;
+
+/* How far the drive core may run. Written by the main core. */
+static volatile CLOCK target_clk;
+/* How far the drive core got. Written by the drive core. */
+static volatile CLOCK done_clk;
+
+/* Bus writes not yet applied. Head is written by the main core, tail by
+   the drive core. */
+static drive_async_event_t queue[DRIVE_ASYNC_QUEUE_SIZE];
+static volatile unsigned int queue_head;
+static volatile unsigned int queue_tail;
+
+/* Dirty GCR tracks the drive core left the head from. File I/O only
+   happens on the main core so these are written back at the next vsync. */
+static uint8_t writeback[DRIVE_NUM][2][DRIVE_HALFTRACKS_1571 + 1];
+static int writeback_pending[DRIVE_NUM];
+
+static log_t drive_async_log = LOG_DEFAULT;
+
+/* ------------------------------------------------------------------------- */
+
+static int set_drive_async(int val, void *param)
+{
+    async_enabled = val ? 1 : 0;
+    return 0;
+}
+
+static int set_drive_async_lookahead(int val, void *param)
+{
+    if (val < 0 || val > DRIVE_ASYNC_MAX_LOOKAHEAD) {
+        return -1;
+    }
+    async_lookahead = val;
+    return 0;
+}
+
+static const resource_int_t resources_int[] = {
+    { "DriveAsync", 0, RES_EVENT_NO, NULL,
+      &async_enabled, set_drive_async, NULL },
+    { "DriveAsyncLookahead", 0, RES_EVENT_NO, NULL,
+      &async_lookahead, set_drive_async_lookahead, NULL },
+    RESOURCE_INT_LIST_END
+};
+
+int drive_async_resources_init(void)
+{
+    drive_async_log = log_open("DriveAsync");
+    return resources_register_int(resources_int);
+}
+
+/* ------------------------------------------------------------------------- */
+
+int drive_async_on_worker(void)
+{
+    uint32_t mpidr;
+
+    __asm__ volatile ("mrc p15, 0, %0, c0, c0, 5" : "=r" (mpidr));
+    return (mpidr & 3) == DRIVE_ASYNC_CORE;
+}
+
+static int worker_idle(void)
+{
+    return queue_tail == queue_head && (int)(done_clk - target_clk) >= 0;
+}
+
+void drive_async_publish(CLOCK clk)
+{
+    drive_async_published = clk;
+    if ((int)(clk - target_clk) > 0) {
+        /* Queued writes must be visible before the new target. */
+        dmb();
+        target_clk = clk;
+        sev();
+    } else if ((int)(target_clk - clk) > DRIVE_ASYNC_MAX_JUMP
+               && worker_idle()) {
+        /* The main clock went back, i.e. a snapshot was loaded. The drive
+           core stays idle until we move the target so this is safe. */
+        done_clk = target_clk = clk;
+        dmb();
+    }
+}
+
+void drive_async_sync(CLOCK clk)
+{
+    drive_async_publish(clk);
+    while (!worker_idle()) {
+    }
+    dmb();
+}
+
+void drive_async_catch_up(CLOCK clk)
+{
+    CLOCK need = clk - async_lookahead;
+
+    drive_async_publish(clk);
+
+    /* Our own writes have to be on the bus before we read it back. */
+    while (queue_tail != queue_head || (int)(done_clk - need) < 0) {
+    }
+    dmb();
+}
+
+void drive_async_queue_write(void (*func)(uint8_t, CLOCK), uint8_t data,
+                             CLOCK clk)
+{
+    unsigned int head = queue_head;
+    drive_async_event_t *event;
+
+    while (head - queue_tail >= DRIVE_ASYNC_QUEUE_SIZE) {
+    }
+
+    event = &queue[head & (DRIVE_ASYNC_QUEUE_SIZE - 1)];
+    event->clk = clk;
+    event->func = func;
+    event->data = data;
+    dmb();
+    queue_head = head + 1;
+    sev();
+}
+
+/* ------------------------------------------------------------------------- */
+
+int drive_async_defer_writeback(struct drive_s *drive)
+{
+    unsigned int dnr = drive->mynumber;
+
+    if (!drive_async_on_worker()) {
+        return 0;
+    }
+    if (drive->current_half_track > DRIVE_HALFTRACKS_1571 || drive->side > 1) {
+        /* Can't record it. Writing it from here is still better than
+           losing it. */
+        return 0;
+    }
+    writeback[dnr][drive->side][drive->current_half_track] = 1;
+    writeback_pending[dnr] = 1;
+    drive->GCR_dirty_track = 0;
+    return 1;
+}
+
+static void flush_writebacks(void)
+{
+    unsigned int dnr, side;
+    int half_track;
+
+    for (dnr = 0; dnr < DRIVE_NUM; dnr++) {
+        drive_t *drive = drive_context[dnr]->drive;
+        int cur_half_track, cur_dirty;
+        unsigned int cur_side;
+
+        if (!writeback_pending[dnr]) {
+            continue;
+        }
+        writeback_pending[dnr] = 0;
+
+        cur_half_track = drive->current_half_track;
+        cur_side = drive->side;
+        cur_dirty = drive->GCR_dirty_track;
+
+        for (side = 0; side < 2; side++) {
+            for (half_track = 0; half_track <= DRIVE_HALFTRACKS_1571;
+                 half_track++) {
+                if (!writeback[dnr][side][half_track]) {
+                    continue;
+                }
+                writeback[dnr][side][half_track] = 0;
+                drive->current_half_track = half_track;
+                drive->side = side;
+                drive->GCR_dirty_track = 1;
+                drive_gcr_data_writeback(drive);
+            }
+        }
+
+        drive->current_half_track = cur_half_track;
+        drive->side = cur_side;
+        drive->GCR_dirty_track = cur_dirty;
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* GCR drives only. The 1581 and friends read and write sectors of the
+   image file directly. */
+static int drive_type_ok(int type)
+{
+    switch (type) {
+        case DRIVE_TYPE_1541:
+        case DRIVE_TYPE_1541II:
+        case DRIVE_TYPE_1570:
+        case DRIVE_TYPE_1571:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static int get_int(const char *name)
+{
+    int value = 0;
+
+    if (resources_get_int(name, &value) < 0) {
+        return 0;
+    }
+    return value;
+}
+
+/* Whether the current setup can run on the drive core. */
+static int eligible(void)
+{
+    unsigned int dnr;
+    int num_enabled = 0;
+
+    if (!async_enabled) {
+        return 0;
+    }
+
+    if (machine_class != VICE_MACHINE_C64
+        && machine_class != VICE_MACHINE_C64SC
+        && machine_class != VICE_MACHINE_VIC20) {
+        return 0;
+    }
+
+    /* These call into the main machine from the drive. */
+    if (get_int("DriveSoundEmulation") || get_int("BurstMod")) {
+        return 0;
+    }
+
+    for (dnr = 0; dnr < DRIVE_NUM; dnr++) {
+        drive_t *drive = drive_context[dnr]->drive;
+        if (!drive->enable) {
+            continue;
+        }
+        if (!drive_type_ok(drive->type)
+            || drive->parallel_cable != DRIVE_PC_NONE) {
+            return 0;
+        }
+        num_enabled++;
+    }
+
+    return num_enabled > 0;
+}
+
+/* Called at the start of every vsync. Leaves the drive core idle until the
+   main CPU runs again so the rest of the frame's housekeeping (UI, image
+   attach, snapshots, resource changes) can touch drive state. */
+void drive_async_vsync(void)
+{
+    int want;
+
+    if (drive_async_active) {
+        drive_async_sync(maincpu_clk);
+        flush_writebacks();
+    }
+
+    want = eligible();
+    if (want == drive_async_active) {
+        if (want) {
+            iecbus_async_enable(1);
+        }
+        return;
+    }
+
+    if (want) {
+        /* Drives run lazily so they may be well behind. Catch them up here
+           so the drive core starts from where the main CPU is. */
+        drive_cpu_execute_all(maincpu_clk);
+        queue_head = queue_tail = 0;
+        done_clk = target_clk = drive_async_published = maincpu_clk;
+        dmb();
+        drive_async_active = 1;
+        sev();
+        iecbus_async_enable(1);
+        log_message(drive_async_log, "Drives now run on core %d.",
+                    DRIVE_ASYNC_CORE);
+    } else {
+        iecbus_async_enable(0);
+        drive_async_active = 0;
+        dmb();
+        log_message(drive_async_log, "Drives now run inline.");
+    }
+}
+
+/* The caller has already synced so the drive core is idle. */
+void drive_async_prevent_clk_overflow(CLOCK sub)
+{
+    if (!drive_async_active || sub == 0) {
+        return;
+    }
+    done_clk -= sub;
+    target_clk -= sub;
+    drive_async_published -= sub;
+    dmb();
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* One step of the drive core's work. Returns non-zero if there was
+   something to do. */
+int drive_async_step(void)
+{
+    unsigned int tail;
+    CLOCK target;
+
+    if (!drive_async_active) {
+        return 0;
+    }
+
+    /* Read the target before the queue. Writes are queued before the
+       target that covers them is published. */
+    target = target_clk;
+    dmb();
+
+    tail = queue_tail;
+    if (tail != queue_head) {
+        drive_async_event_t *event;
+
+        dmb();
+        event = &queue[tail & (DRIVE_ASYNC_QUEUE_SIZE - 1)];
+        drive_cpu_execute_all(event->clk);
+        if ((int)(event->clk - done_clk) > 0) {
+            done_clk = event->clk;
+        }
+        event->func(event->data, event->clk);
+        dmb();
+        queue_tail = tail + 1;
+        return 1;
+    }
+
+    if ((int)(target - done_clk) > 0) {
+        drive_cpu_execute_all(target);
+        dmb();
+        done_clk = target;
+        return 1;
+    }
+
+    return 0;
+}
+
+#endif
@@ -0,0 +1,87 @@
+/*
+ * drive-async.h
+ *
+ * Written by
+ *  Randy Rossi <randy.rossi@gmail.com>
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef VICE_DRIVE_ASYNC_H
+#define VICE_DRIVE_ASYNC_H
+
+#include "types.h"
+
+/* BMC64: Optionally run the true drive CPUs on core 3 instead of inline on
+   the emulation core.
+
+   The drive core chases the main CPU clock but never passes it. The main
+   CPU publishes its clock every DRIVE_ASYNC_PUBLISH_CYCLES cycles and at
+   every bus access. Writes to the IEC bus are queued with the clock they
+   happened at and applied by the drive core once the drives get there.
+   Reads of the IEC bus wait until every queued write has been applied and
+   the drives are no more than DriveAsyncLookahead cycles behind. With a
+   lookahead of 0 this is exactly what VICE does inline.
+
+   Anything else the main side does to drive state (resets, image changes,
+   snapshots, clock overflow) first waits for the drive core to go idle.
+   Setups where the drives reach back into main machine state (parallel
+   cables, burst mods, C128 fast serial, drive sound) or do file I/O
+   (1581 and other sector based drives) run inline as before. */
+
+struct drive_s;
+
+#if defined(RASPI_COMPILE) && !defined(RASPI_LITE)
+#define DRIVE_ASYNC
+
+#define DRIVE_ASYNC_CORE 3
+#define DRIVE_ASYNC_PUBLISH_CYCLES 64
+
+/* Only changed on the main core while the drive core is idle. */
+extern int drive_async_active;
+extern CLOCK drive_async_published;
+
+extern int drive_async_resources_init(void);
+
+/* Main core side. */
+extern void drive_async_publish(CLOCK clk);
+extern void drive_async_sync(CLOCK clk);
+extern void drive_async_catch_up(CLOCK clk);
+extern void drive_async_queue_write(void (*func)(uint8_t, CLOCK),
+                                    uint8_t data, CLOCK clk);
+extern void drive_async_vsync(void);
+extern void drive_async_prevent_clk_overflow(CLOCK sub);
+
+/* Drive core side. */
+extern int drive_async_on_worker(void);
+extern int drive_async_defer_writeback(struct drive_s *drive);
+extern int drive_async_step(void);
+
+#define drive_async_tick(clk)                                          \
+    do {                                                               \
+        if (drive_async_active                                         \
+            && (clk) - drive_async_published >= DRIVE_ASYNC_PUBLISH_CYCLES) { \
+            drive_async_publish(clk);                                  \
+        }                                                              \
+    } while (0)
+
+#endif
+
+#endif
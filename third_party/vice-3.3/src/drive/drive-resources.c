@@ -28,6 +28,7 @@
 
 #include <stdio.h>
 
+#include "drive-async.h"
 #include "drive-check.h"
 #include "drive-resources.h"
 #include "drive.h"
@@ -418,6 +419,11 @@ int drive_resources_init(void)
     if (resources_register_int(resources_int) < 0) {
         return -1;
     }
+#ifdef DRIVE_ASYNC
+    if (drive_async_resources_init() < 0) {
+        return -1;
+    }
+#endif
     /* make sure machine_drive_resources_init() is called last here, as that
        will also initialize the default drive type and if it fails to do that
        because other drive related resources are not initialized yet then we
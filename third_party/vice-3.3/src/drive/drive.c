@@ -47,6 +47,7 @@
 #include "attach.h"
 #include "diskconstants.h"
 #include "diskimage.h"
+#include "drive-async.h"
 #include "drive-check.h"
 #include "drive-overflow.h"
 #include "drive.h"
@@ -73,6 +74,10 @@
 #include "p64.h"
 #include "monitor.h"
 
+#ifdef RASPI_COMPILE
+#include "profile.h"
+#endif
+
 static int drive_init_was_called = 0;
 
 drive_context_t *drive_context[DRIVE_NUM];
@@ -511,11 +516,22 @@ void drive_cpu_prevent_clk_overflow_all(CLOCK sub)
             drivecpu_prevent_clk_overflow(drive_context[dnr], sub);
         }
     }
+
+#ifdef DRIVE_ASYNC
+    /* Only after the drives, which may still need the old clocks. */
+    drive_async_prevent_clk_overflow(sub);
+#endif
 }
 
 void drive_cpu_trigger_reset(unsigned int dnr)
 {
     drive_t *drive = drive_context[dnr]->drive;
+
+#ifdef DRIVE_ASYNC
+    if (drive_async_active) {
+        drive_async_sync(maincpu_clk);
+    }
+#endif
     if (drive->type == DRIVE_TYPE_2000 || drive->type == DRIVE_TYPE_4000) {
         drivecpu65c02_trigger_reset(dnr);
     } else {
@@ -529,6 +545,12 @@ void drive_reset(void)
     unsigned int dnr;
     drive_t *drive;
 
+#ifdef DRIVE_ASYNC
+    if (drive_async_active) {
+        drive_async_sync(maincpu_clk);
+    }
+#endif
+
     for (dnr = 0; dnr < DRIVE_NUM; dnr++) {
         drive = drive_context[dnr]->drive;
 
@@ -623,6 +645,12 @@ void drive_gcr_data_writeback(drive_t *drive)
         return;
     }
 
+#ifdef DRIVE_ASYNC
+    if (drive_async_active && drive_async_defer_writeback(drive)) {
+        return;
+    }
+#endif
+
     if ((drive->image->type == DISK_IMAGE_TYPE_G64)
         || (drive->image->type == DISK_IMAGE_TYPE_G71)) {
         disk_image_write_half_track(drive->image, half_track,
@@ -797,12 +825,35 @@ int drive_num_leds(unsigned int dnr)
 void drive_cpu_execute_one(drive_context_t *drv, CLOCK clk_value)
 {
     drive_t *drive = drv->drive;
+#ifdef RASPI_COMPILE
+    /* The profiler only times drives run inline on the emulator core. */
+    int profile = 1;
+#endif
+
+#ifdef DRIVE_ASYNC
+    /* The drive core does the actual work. */
+    if (drive_async_active && !drive_async_on_worker()) {
+        drive_async_sync(clk_value);
+        return;
+    }
+    profile = !drive_async_active;
+#endif
 
+#ifdef RASPI_COMPILE
+    if (profile) {
+        PROFILE_BEGIN(PROFILE_DRIVE);
+    }
+#endif
     if (drive->type == DRIVE_TYPE_2000 || drive->type == DRIVE_TYPE_4000) {
         drivecpu65c02_execute(drv, clk_value);
     } else {
         drivecpu_execute(drv, clk_value);
     }
+#ifdef RASPI_COMPILE
+    if (profile) {
+        PROFILE_END(PROFILE_DRIVE);
+    }
+#endif
 }
 
 void drive_cpu_execute_all(CLOCK clk_value)
@@ -810,6 +861,13 @@ void drive_cpu_execute_all(CLOCK clk_value)
     unsigned int dnr;
     drive_t *drive;
 
+#ifdef DRIVE_ASYNC
+    if (drive_async_active && !drive_async_on_worker()) {
+        drive_async_sync(clk_value);
+        return;
+    }
+#endif
+
     for (dnr = 0; dnr < DRIVE_NUM; dnr++) {
         drive = drive_context[dnr]->drive;
         if (drive->enable) {
@@ -834,6 +892,10 @@ void drive_vsync_hook(void)
 {
     unsigned int dnr;
 
+#ifdef DRIVE_ASYNC
+    drive_async_vsync();
+#endif
+
     drive_update_ui_status();
 
     for (dnr = 0; dnr < DRIVE_NUM; dnr++) {
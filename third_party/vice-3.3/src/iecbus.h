@@ -96,6 +96,7 @@ extern void iecbus_status_set(unsigned int type, unsigned int unit,
 
 extern uint8_t (*iecbus_callback_read)(CLOCK);
 extern void (*iecbus_callback_write)(uint8_t, CLOCK);
+extern void iecbus_async_enable(int enable);
 
 extern uint8_t iecbus_device_read(void);
 extern int  iecbus_device_write(unsigned int unit, uint8_t data);
@@ -30,6 +30,7 @@
 #include <string.h>
 
 #include "cia.h"
+#include "drive-async.h"
 #include "drive.h"
 #include "drivetypes.h"
 #include "iecbus.h"
@@ -434,6 +435,56 @@ static void calculate_callback_index(void)
     }
 }
 
+#ifdef DRIVE_ASYNC
+/* The callbacks calculate_callback_index() picked. The drive core calls
+   the write one when the drives get to the clock of a queued write. */
+static uint8_t (*iecbus_sync_read)(CLOCK) = NULL;
+static void (*iecbus_sync_write)(uint8_t, CLOCK) = NULL;
+
+static uint8_t iecbus_cpu_read_async(CLOCK clock)
+{
+    drive_async_catch_up(clock);
+
+    DEBUG_IEC_CPU_READ(iecbus.cpu_port);
+
+    return iecbus.cpu_port;
+}
+
+static void iecbus_cpu_write_async(uint8_t data, CLOCK clock)
+{
+    drive_async_queue_write(iecbus_sync_write, data, clock);
+}
+
+/* Switch to (or back from) the queued callbacks while the drives run on
+   the drive core. Only done with nothing but true drives on the bus. */
+void iecbus_async_enable(int enable)
+{
+    unsigned int dev;
+
+    if (iecbus_callback_write == iecbus_cpu_write_async) {
+        if (!enable) {
+            iecbus_callback_read = iecbus_sync_read;
+            iecbus_callback_write = iecbus_sync_write;
+        }
+        return;
+    }
+
+    if (!enable || iecbus_callback_write == iecbus_cpu_write_conf0) {
+        return;
+    }
+    for (dev = 0; dev < IECBUS_NUM; dev++) {
+        if (iecbus_device[dev] == IECBUS_DEVICE_IECDEVICE) {
+            return;
+        }
+    }
+
+    iecbus_sync_read = iecbus_callback_read;
+    iecbus_sync_write = iecbus_callback_write;
+    iecbus_callback_read = iecbus_cpu_read_async;
+    iecbus_callback_write = iecbus_cpu_write_async;
+}
+#endif
+
 /*
 
 iecbus_status_set() sets IEC bus devices according to the following table:
@@ -59,6 +59,7 @@
 #include "resources.h"
 #include "romset.h"
 #include "screenshot.h"
+#include "snapshot.h"
 #include "sound.h"
 #include "sysfile.h"
 #include "tape.h"
@@ -209,6 +210,32 @@ void machine_reset(void)
     vsync_suspend_speed_eval();
 }
 
+/* The machine snapshot code only deals in file names. Point it at the
+   buffer instead for the duration of the call.  */
+#define MACHINE_SNAPSHOT_MEM_NAME "(memory)"
+
+int machine_write_snapshot_mem(snapshot_mem_t *mem, int save_roms,
+                               int save_disks, int event_mode)
+{
+    int retval;
+
+    snapshot_set_mem_target(mem);
+    retval = machine_write_snapshot(MACHINE_SNAPSHOT_MEM_NAME, save_roms,
+                                    save_disks, event_mode);
+    snapshot_set_mem_target(NULL);
+    return retval;
+}
+
+int machine_read_snapshot_mem(snapshot_mem_t *mem, int event_mode)
+{
+    int retval;
+
+    snapshot_set_mem_target(mem);
+    retval = machine_read_snapshot(MACHINE_SNAPSHOT_MEM_NAME, event_mode);
+    snapshot_set_mem_target(NULL);
+    return retval;
+}
+
 static void machine_maincpu_clk_overflow_callback(CLOCK sub, void *data)
 {
     alarm_context_time_warp(maincpu_alarm_context, sub, -1);
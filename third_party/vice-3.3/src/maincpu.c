@@ -35,6 +35,7 @@
 #include "archdep.h"
 #include "clkguard.h"
 #include "debug.h"
+#include "drive-async.h"
 #include "interrupt.h"
 #include "log.h"
 #include "machine.h"
@@ -51,6 +52,11 @@
 #include "traps.h"
 #include "types.h"
 
+#ifdef RASPI_COMPILE
+/* BMC64: Let 6510core.c dispatch opcodes through a table of labels.  */
+#define CPU_THREADED_DISPATCH
+#endif
+
 #ifndef EXIT_FAILURE
 #define EXIT_FAILURE 1
 #endif
@@ -508,14 +514,30 @@ void maincpu_mainloop(void)
 
 #define GLOBAL_REGS maincpu_regs
 
-#include "6510core.c"
+#ifdef DRIVE_ASYNC
+/* Let the drive core run up to here. */
+#define OPCODE_DRIVE_ASYNC_TICK() drive_async_tick(maincpu_clk)
+#else
+#define OPCODE_DRIVE_ASYNC_TICK()
+#endif
+
+/* Done after every instruction, also by the threaded dispatch.  */
+#define OPCODE_EPILOGUE()                                                   \
+    do {                                                                    \
+        maincpu_int_status->num_dma_per_opcode = 0;                         \
+        OPCODE_DRIVE_ASYNC_TICK();                                          \
+        if (maincpu_clk_limit && (maincpu_clk > maincpu_clk_limit)) {       \
+            log_error(LOG_DEFAULT, "cycle limit reached.");                 \
+            archdep_vice_exit(EXIT_FAILURE);                                \
+        }                                                                   \
+    } while (0)
 
-        maincpu_int_status->num_dma_per_opcode = 0;
+#include "6510core.c"
 
-        if (maincpu_clk_limit && (maincpu_clk > maincpu_clk_limit)) {
-            log_error(LOG_DEFAULT, "cycle limit reached.");
-            archdep_vice_exit(EXIT_FAILURE);
-        }
+#ifndef CPU_THREADED
+        /* The threaded dispatch does this in every opcode.  */
+        OPCODE_EPILOGUE();
+#endif
 #if 0
         if (CLK > 246171754) {
             debug.maincpu_traceflg = 1;
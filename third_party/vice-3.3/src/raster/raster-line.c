@@ -43,6 +43,11 @@
 #include "raster.h"
 #include "viewport.h"
 
+#ifdef RASPI_COMPILE
+#include "profile.h"
+#include "videoarch.h"
+#endif
+
 
 unsigned int raster_line_get_real_mode(raster_t *raster)
 {
@@ -80,6 +85,17 @@ inline void raster_line_draw_blank(raster_t *raster, unsigned int start,
 /* This kludge updates the sprite-sprite collisions without writing to the
    real frame buffer.  We might write a function that actually checks for
    collisions only, but we are lazy.  */
+#ifdef RASPI_COMPILE
+/* True if drawing the line can't be skipped because sprites on it may
+   collide with the graphics.  */
+inline static int sprites_on_line(raster_t *raster)
+{
+    return raster->sprite_status != NULL
+           && (raster->sprite_status->dma_msk
+               || raster->sprite_status->new_dma_msk);
+}
+#endif
+
 inline static void update_sprite_collisions(raster_t *raster)
 {
     uint8_t *fake_draw_buffer_ptr;
@@ -105,6 +121,18 @@ inline static int map_current_line_to_area(raster_t *raster)
             : raster->current_line);
 }
 
+/* Add [xs; xe] of the current line to the area to update.  Only called
+   for lines that were (re)drawn.  */
+inline static void update_current_line(raster_t *raster,
+                                       unsigned int xs, unsigned int xe)
+{
+    add_line_to_area(raster->update_area, map_current_line_to_area(raster),
+                     xs, xe);
+#ifdef RASPI_COMPILE
+    raster->canvas->line_drawn = 1;
+#endif
+}
+
 inline static void handle_blank_line_cached(raster_t *raster)
 {
     if (raster->dont_cache
@@ -121,9 +149,7 @@ inline static void handle_blank_line_cached(raster_t *raster)
 
         raster_line_draw_blank(raster, 0,
                                raster->geometry->screen_size.width - 1);
-        add_line_to_area(raster->update_area,
-                         map_current_line_to_area(raster),
-                         0, raster->geometry->screen_size.width - 1);
+        update_current_line(raster, 0, raster->geometry->screen_size.width - 1);
     }
 }
 
@@ -164,8 +190,8 @@ static void handle_blank_line(raster_t *raster)
 
             raster_changes_remove_all(border_changes);
 
-            add_line_to_area(raster->update_area, map_current_line_to_area(raster),
-                             0, raster->geometry->screen_size.width - 1);
+            update_current_line(raster,
+                                0, raster->geometry->screen_size.width - 1);
         } else {
             handle_blank_line_cached(raster);
         }
@@ -390,8 +416,7 @@ static void handle_visible_line_with_cache(raster_t *raster)
     }
 
     if (needs_update) {
-        add_line_to_area(raster->update_area, map_current_line_to_area(raster),
-                         changed_start, changed_end);
+        update_current_line(raster, changed_start, changed_end);
     }
 
     cache->is_dirty = 0;
@@ -434,15 +459,14 @@ static void handle_visible_line_without_cache(raster_t *raster)
         cache->xsmooth_color = raster->xsmooth_color;
         cache->idle_background_color = raster->idle_background_color;
 
-        add_line_to_area(raster->update_area, map_current_line_to_area(raster),
-                         0, raster->geometry->screen_size.width - 1);
+        update_current_line(raster, 0, raster->geometry->screen_size.width - 1);
     } else {
         /* Still do some minimal caching anyway.  */
         /* Only update the part between the borders.  */
-        add_line_to_area(raster->update_area, map_current_line_to_area(raster),
-                         geometry->gfx_position.x,
-                         geometry->gfx_position.x
-                         + geometry->gfx_size.width - 1);
+        update_current_line(raster,
+                            geometry->gfx_position.x,
+                            geometry->gfx_position.x
+                            + geometry->gfx_size.width - 1);
     }
 }
 
@@ -625,8 +649,7 @@ static void handle_visible_line_with_changes(raster_t *raster)
     /* Do not cache this line at all.  */
     raster->cache[raster->current_line].is_dirty = 1;
 
-    add_line_to_area(raster->update_area, map_current_line_to_area(raster),
-                     0, raster->geometry->screen_size.width - 1);
+    update_current_line(raster, 0, raster->geometry->screen_size.width - 1);
 }
 
 inline static void handle_visible_line(raster_t *raster)
@@ -648,9 +671,12 @@ inline static void handle_visible_line(raster_t *raster)
     }
 }
 
-void raster_line_emulate(raster_t *raster)
+inline static void line_emulate(raster_t *raster)
 {
     raster_draw_buffer_ptr_update(raster);
+#ifdef RASPI_COMPILE
+    raster->canvas->line_drawn = 0;
+#endif
 
     /* Emulate the vertical blank flip-flops.  (Well, sort of.)  */
     if (raster->current_line == raster->display_ystart && (!raster->blank || raster->blank_off)) {
@@ -666,6 +692,23 @@ void raster_line_emulate(raster_t *raster)
         || (raster->current_line <= raster->geometry->last_displayed_line - raster->geometry->screen_size.height
             && raster->geometry->screen_size.height <= raster->geometry->last_displayed_line)
         ) {
+#ifdef RASPI_COMPILE
+        /* Turbo warp: this frame won't be shown, so only the register
+           changes have to happen.  The frame buffer and the cache still
+           agree on what was drawn last.  */
+        if (raster->canvas->skip_drawing && !sprites_on_line(raster)) {
+            if (raster->changes->have_on_this_line) {
+                raster_changes_apply_all(raster->changes->background);
+                raster_changes_apply_all(raster->changes->foreground);
+                raster_changes_apply_all(raster->changes->border);
+                raster_changes_apply_all(raster->changes->sprites);
+                raster->changes->have_on_this_line = 0;
+            }
+            if (raster->draw_idle_state) {
+                raster->xsmooth_color = raster->idle_background_color;
+            }
+        } else
+#endif
         /* handle lines with no border or with changes that may affect
            the border as visible lines */
         if (raster->can_disable_border && (raster->border_disable || raster->changes->have_on_this_line)) {
@@ -679,6 +722,10 @@ void raster_line_emulate(raster_t *raster)
             }
         }
 
+#ifdef RASPI_COMPILE
+        raster->canvas->frame_lines++;
+#endif
+
         if (++raster->num_cached_lines == (1
                                            + raster->geometry->last_displayed_line
                                            - raster->geometry->first_displayed_line)) {
@@ -708,7 +755,14 @@ void raster_line_emulate(raster_t *raster)
     }
 
 #ifdef RASPI_COMPILE
-    raster_draw_buffer_clone_line(raster);
+    /* Lines the cache found unchanged are still in the frame buffer,
+       already doubled and uploaded, from the last time they were
+       drawn.  */
+    if (raster->canvas->line_drawn) {
+        raster->canvas->frame_lines_drawn++;
+        raster_draw_buffer_clone_line(raster);
+        raster_draw_buffer_mark_line(raster);
+    }
 #endif
 
     raster->current_line++;
@@ -740,3 +794,22 @@ void raster_line_emulate(raster_t *raster)
 
     raster->blank_this_line = 0;
 }
+
+void raster_line_emulate(raster_t *raster)
+{
+#ifdef RASPI_COMPILE
+    PROFILE_BEGIN(PROFILE_RASTER);
+#endif
+    line_emulate(raster);
+#ifdef RASPI_COMPILE
+    PROFILE_END(PROFILE_RASTER);
+#endif
+}
+
+#ifdef RASPI_COMPILE
+/* For rasters drawn on another core. The profiler only times core 1. */
+void raster_line_emulate_unprofiled(raster_t *raster)
+{
+    line_emulate(raster);
+}
+#endif
@@ -35,5 +35,8 @@ extern void raster_line_fill_xsmooth_region(struct raster_s *raster);
 extern void raster_line_draw_blank(struct raster_s *raster, unsigned int start,
                                    unsigned int end);
 extern void raster_line_emulate(struct raster_s *raster);
+#ifdef RASPI_COMPILE
+extern void raster_line_emulate_unprofiled(struct raster_s *raster);
+#endif
 
 #endif
@@ -133,10 +133,38 @@ void raster_draw_buffer_clone_line(raster_t *raster)
 {
   if (raster->canvas->raster_skip == 2 && !raster->canvas->raster_lines) {
      int width = raster_calc_frame_buffer_width(raster);
+     // Plain memcpy on purpose. A NEON copy loop was tried here but was
+     // never shown to beat libc's.
      memcpy(raster->draw_buffer_ptr + width,
          raster->draw_buffer_ptr, width);
   }
 }
+
+/* Adds the frame buffer rows of the line just drawn to the rows to be
+   uploaded this frame.  */
+void raster_draw_buffer_mark_line(raster_t *raster)
+{
+  video_canvas_t *canvas = raster->canvas;
+  unsigned int stride =
+     raster_calc_frame_buffer_width(raster) * canvas->raster_skip;
+  unsigned int row;
+  int y0, y1;
+
+  row = (raster->draw_buffer_ptr - canvas->draw_buffer->draw_buffer) / stride;
+  if (row >= canvas->num_lines) {
+     return;
+  }
+
+  y0 = row * canvas->raster_skip;
+  y1 = y0 + canvas->raster_skip;
+  if (canvas->dirty_y0 >= canvas->dirty_y1) {
+     canvas->dirty_y0 = y0;
+     canvas->dirty_y1 = y1;
+  } else {
+     if (y0 < canvas->dirty_y0) canvas->dirty_y0 = y0;
+     if (y1 > canvas->dirty_y1) canvas->dirty_y1 = y1;
+  }
+}
 #endif
 
 static int raster_realize_frame_buffer(raster_t *raster)
@@ -162,6 +190,10 @@ static int raster_realize_frame_buffer(raster_t *raster)
 
         raster_draw_buffer_clear(raster->canvas, 0, fb_width, fb_height,
                                  fb_pitch);
+#ifdef RASPI_COMPILE
+        /* Lines the cache thinks are up to date are not drawn again. */
+        raster_force_repaint(raster);
+#endif
     }
 
     raster->fake_draw_buffer_line = lib_realloc(raster->fake_draw_buffer_line,
@@ -0,0 +1,81 @@
+//  ---------------------------------------------------------------------------
+//  This file is part of reSID, a MOS6581 SID emulator engine.
+//  Copyright (C) 2010  Dag Lem <resid@nimrod.no>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 2 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+//  ---------------------------------------------------------------------------
+
+#ifndef RESID_CONVOLVE_H
+#define RESID_CONVOLVE_H
+
+// Added for BMC64. The FIR dot product is the hottest part of the
+// resampling paths. It is kept free of other reSID headers so that
+// tools/fir_bench can build it on the host and compare it against
+// convolve_scalar.
+//
+// All variants accumulate in 32 bits and wrap on overflow exactly like
+// the original loop, so the results are bit-exact regardless of the
+// order in which the products are summed.
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define RESID_CONVOLVE_NEON 1
+#endif
+
+namespace reSID
+{
+
+// The original reSID inner loop. Used as the reference.
+static inline int convolve_scalar(const short* a, const short* b, int n)
+{
+  int out = 0;
+  for (int i = 0; i < n; i++) {
+    out += a[i]*b[i];
+  }
+  return out;
+}
+
+static inline int convolve(const short* a, const short* b, int n)
+{
+  int i = 0;
+#ifdef RESID_CONVOLVE_NEON
+  int32x4_t acc0 = vdupq_n_s32(0);
+  int32x4_t acc1 = vdupq_n_s32(0);
+
+  for (; i + 8 <= n; i += 8) {
+    int16x8_t va = vld1q_s16(a + i);
+    int16x8_t vb = vld1q_s16(b + i);
+    acc0 = vmlal_s16(acc0, vget_low_s16(va), vget_low_s16(vb));
+    acc1 = vmlal_s16(acc1, vget_high_s16(va), vget_high_s16(vb));
+  }
+
+  int32x4_t acc = vaddq_s32(acc0, acc1);
+  int32x2_t sum = vadd_s32(vget_low_s32(acc), vget_high_s32(acc));
+  int out = vget_lane_s32(vpadd_s32(sum, sum), 0);
+#else
+  // Without NEON, leave it to the compiler's auto-vectorizer which
+  // recognizes this form of the loop (e.g. pmaddwd on x86).
+  int out = 0;
+#endif
+
+  for (; i < n; i++) {
+    out += a[i]*b[i];
+  }
+  return out;
+}
+
+} // namespace reSID
+
+#endif // not RESID_CONVOLVE_H
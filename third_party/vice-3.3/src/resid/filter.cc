@@ -246,6 +246,9 @@ static double log1p(double x)
 
 Filter::model_filter_t* Filter::model_filter[2];
 
+static bool class_init_0;
+static bool class_init_1;
+
 Filter::Filter() : Filter(-1) {
 }
 
@@ -254,9 +257,6 @@ Filter::Filter() : Filter(-1) {
 // ----------------------------------------------------------------------------
 Filter::Filter(int model)
 {
-  static bool class_init_0;
-  static bool class_init_1;
-
   if (!class_init_0 || !class_init_1) {
     // BMC64: Technically this isn't right.  Core 1 is on its way to this
     // method with a -1 argument.  Core 1 will skip over the init because
@@ -569,6 +569,73 @@ Filter::Filter(int model)
 }
 
 
+// ----------------------------------------------------------------------------
+// BMC64: Model table cache support.
+// ----------------------------------------------------------------------------
+#define TABLE_PART(x) { &(x), sizeof(x) }
+
+int Filter::GetModelTables(table_part_t* parts, int max)
+{
+  int n = 0;
+
+  for (int m = 0; m < 2; m++) {
+    if (!model_filter[m]) {
+      model_filter[m] = (model_filter_t*) malloc(sizeof(model_filter_t));
+      memset(model_filter[m], 0, sizeof(model_filter_t));
+    }
+    model_filter_t& mf = *model_filter[m];
+    const table_part_t model_parts[] = {
+      TABLE_PART(mf.kVddt),
+      TABLE_PART(mf.voice_scale_s14),
+      TABLE_PART(mf.voice_DC),
+      TABLE_PART(mf.ak),
+      TABLE_PART(mf.bk),
+      TABLE_PART(mf.vc_min),
+      TABLE_PART(mf.vc_max),
+      TABLE_PART(mf.vo_N16),
+      TABLE_PART(mf.opamp_rev),
+      TABLE_PART(mf.summer),
+      TABLE_PART(mf.gain),
+      TABLE_PART(mf.mixer),
+      TABLE_PART(mf.f0_dac),
+    };
+    int num = sizeof(model_parts) / sizeof(model_parts[0]);
+    if (n + num > max) {
+      return -1;
+    }
+    memcpy(parts + n, model_parts, sizeof(model_parts));
+    n += num;
+  }
+
+  const table_part_t common_parts[] = {
+    TABLE_PART(resonance),
+    TABLE_PART(vcr_kVg),
+    TABLE_PART(vcr_n_Ids_term),
+    TABLE_PART(n_snake),
+    TABLE_PART(n_param),
+  };
+  int num = sizeof(common_parts) / sizeof(common_parts[0]);
+  if (n + num > max) {
+    return -1;
+  }
+  memcpy(parts + n, common_parts, sizeof(common_parts));
+  return n + num;
+}
+
+#undef TABLE_PART
+
+bool Filter::ModelTablesComputed()
+{
+  return class_init_0 && class_init_1;
+}
+
+void Filter::SetModelTablesComputed()
+{
+  class_init_0 = true;
+  class_init_1 = true;
+}
+
+
 // ----------------------------------------------------------------------------
 // Enable filter.
 // ----------------------------------------------------------------------------
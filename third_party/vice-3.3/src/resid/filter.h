@@ -25,6 +25,13 @@
 namespace reSID
 {
 
+// Added for BMC64. One plain array or value of the tables cached on the
+// SD card.
+typedef struct {
+  void* data;
+  int size;
+} table_part_t;
+
 // ----------------------------------------------------------------------------
 // The SID filter is modeled with a two-integrator-loop biquadratic filter,
 // which has been confirmed by Bob Yannes to be the actual circuit used in
@@ -548,6 +555,15 @@ public:
   // SID audio output (16 bits).
   short output();
 
+  // Added for BMC64. Lists the model tables built by the constructor,
+  // field by field, so they can be cached on the SD card rather than
+  // being recomputed on every boot. Allocates the per model tables if
+  // they aren't yet. Returns the number of parts or -1 if max is too
+  // small. Call SetModelTablesComputed once they have been filled.
+  static int GetModelTables(table_part_t* parts, int max);
+  static bool ModelTablesComputed();
+  static void SetModelTablesComputed();
+
 protected:
   void set_sum_mix();
   void set_w0();
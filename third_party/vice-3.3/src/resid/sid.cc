@@ -25,6 +25,7 @@
 #endif
 
 #include "sid.h"
+#include "convolve.h"
 #include <math.h>
 
 #include <string.h>
@@ -35,6 +36,7 @@
 #endif
 
 static short* fir_cached[4]; // one for each method
+static int fir_cached_size[4];
 
 namespace reSID
 {
@@ -719,7 +721,10 @@ void SID::ComputeSamplingTable(double clock_freq, sampling_method method,
   //delete[] fir;
 
   if (partition == 0) {
+     // Called again when the clock changes in place.
+     delete[] fir_cached[method];
      fir_cached[method] = new short[fir_N*fir_RES];
+     fir_cached_size[method] = fir_N*fir_RES;
      return;
   }
 
@@ -751,6 +756,18 @@ void SID::ComputeSamplingTable(double clock_freq, sampling_method method,
   //return true;
 }
 
+// A sampling table previously allocated by ComputeSamplingTable with
+// partition = 0. Its size depends on the parameters it was computed for.
+bool SID::GetSamplingTable(sampling_method method, table_part_t* part)
+{
+  if (!fir_cached[method]) {
+    return false;
+  }
+  part->data = fir_cached[method];
+  part->size = fir_cached_size[method] * sizeof(short);
+  return true;
+}
+
 // ----------------------------------------------------------------------------
 // Adjustment of SID sampling frequency.
 //
@@ -1034,10 +1051,7 @@ int SID::clock_resample(cycle_count& delta_t, short* buf, int n, int interleave)
     short* sample_start = sample + sample_index - fir_N - 1 + RINGSIZE;
 
     // Convolution with filter impulse response.
-    int v1 = 0;
-    for (int j = 0; j < fir_N; j++) {
-      v1 += sample_start[j]*fir_start[j];
-    }
+    int v1 = convolve(sample_start, fir_start, fir_N);
 
     // Use next FIR table, wrap around to first FIR table using
     // next sample.
@@ -1048,10 +1062,7 @@ int SID::clock_resample(cycle_count& delta_t, short* buf, int n, int interleave)
     fir_start = fir + fir_offset*fir_N;
 
     // Convolution with filter impulse response.
-    int v2 = 0;
-    for (int k = 0; k < fir_N; k++) {
-      v2 += sample_start[k]*fir_start[k];
-    }
+    int v2 = convolve(sample_start, fir_start, fir_N);
 
     // Linear interpolation.
     // fir_offset_rmd is equal for all samples, it can thus be factorized out:
@@ -1109,10 +1120,7 @@ int SID::clock_resample_fastmem(cycle_count& delta_t, short* buf, int n, int int
     short* sample_start = sample + sample_index - fir_N + RINGSIZE;
 
     // Convolution with filter impulse response.
-    int v = 0;
-    for (int j = 0; j < fir_N; j++) {
-      v += sample_start[j]*fir_start[j];
-    }
+    int v = convolve(sample_start, fir_start, fir_N);
 
     v >>= FIR_SHIFT;
 
@@ -61,6 +61,11 @@ public:
                                    double sample_freq, double pass_freq,
                                    double filter_scale, int partition);
 
+  // Added for BMC64. Lets the tables populated above be cached on the SD
+  // card and restored on later boots. Returns false if the table wasn't
+  // allocated by ComputeSamplingTable.
+  static bool GetSamplingTable(sampling_method method, table_part_t* part);
+
   void adjust_sampling_frequency(double sample_freq);
 
   void clock();
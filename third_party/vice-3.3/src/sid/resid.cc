@@ -306,6 +306,13 @@ static int resid_calculate_samples(sound_t *psid, short *pbuf, int nr,
     return retval;
 }
 
+#ifdef RASPI_COMPILE
+static void resid_advance(sound_t *psid, int delta_t)
+{
+    psid->sid->clock(delta_t);
+}
+#endif
+
 static void resid_prevent_clk_overflow(sound_t *psid, CLOCK sub)
 {
 }
@@ -402,7 +409,10 @@ sid_engine_t resid_hooks =
     resid_prevent_clk_overflow,
     resid_dump_state,
     resid_state_read,
-    resid_state_write
+    resid_state_write,
+#ifdef RASPI_COMPILE
+    resid_advance
+#endif
 };
 
 } // extern "C"
@@ -50,14 +50,10 @@
 #include "types.h"
 
 #ifdef RASPI_COMPILE
-int (*sid_job_func)(struct sound_s *psid, short *pbuf,
-                     int nr, int interleave, int *delta_t);
-struct sound_s *sid_job_psid;
-int16_t *sid_job_pbuf;
-int sid_job_nr;
-int sid_job_delta_t;
-uint32_t sid_job;
-uint32_t sid_done;
+sid_job_queue_t sid_job_queue[SID_JOB_NUM_CORES];
+
+/* Number of jobs handed out since the last sid_job_wait(). */
+static int sid_job_count;
 #endif
 
 #ifdef HAVE_MOUSE
@@ -464,6 +460,83 @@ void sid_sound_machine_reset(sound_t *psid, CLOCK cpu_clk)
     sid_engine.reset(psid, cpu_clk);
 }
 
+/* Calculate the samples of one SID into pbuf. On BMC64, the job is handed
+   to one of the idle cores (see ViceEmulatorCore::Run) so that the SIDs of
+   a multi-SID setup are computed in parallel. The result is only valid
+   after sid_job_wait(). Each job gets its own copy of delta_t; only the
+   SID calculated by the caller advances the real one. */
+static void sid_job_submit(sound_t *psid, int16_t *pbuf, int nr,
+                           int interleave, int delta_t)
+{
+#if defined(RASPI_COMPILE) && !defined(RASPI_LITE)
+    sid_job_queue_t *queue = &sid_job_queue[sid_job_count % SID_JOB_NUM_CORES];
+    sid_job_t *job = &queue->jobs[queue->head];
+
+    job->psid = psid;
+    job->pbuf = pbuf;
+    job->nr = nr;
+    job->interleave = interleave;
+    job->delta_t = delta_t;
+    queue->head = (queue->head + 1) % SID_JOB_QUEUE_SIZE;
+    sid_job_count++;
+    sem_inc(&queue->pending);
+#else
+    sid_engine.calculate_samples(psid, pbuf, nr, interleave, &delta_t);
+#endif
+}
+
+/* Block until every job submitted by sid_job_submit() has completed. */
+static void sid_job_wait(void)
+{
+#if defined(RASPI_COMPILE) && !defined(RASPI_LITE)
+    int i;
+
+    for (i = 0; i < sid_job_count; i++) {
+        sem_dec(&sid_job_queue[i % SID_JOB_NUM_CORES].done);
+    }
+    sid_job_count = 0;
+#endif
+}
+
+#ifdef RASPI_COMPILE
+static void sid_job_run(sid_job_queue_t *queue)
+{
+    sid_job_t *job = &queue->jobs[queue->tail];
+
+    sid_engine.calculate_samples(job->psid, job->pbuf, job->nr,
+                                 job->interleave, &job->delta_t);
+    queue->tail = (queue->tail + 1) % SID_JOB_QUEUE_SIZE;
+    sem_inc(&queue->done);
+}
+
+/* Worker loop for the helper cores. Jobs are taken from the core's
+   queue in the order they were submitted. Never returns. */
+void sid_job_worker(int core)
+{
+    sid_job_queue_t *queue = &sid_job_queue[core - SID_JOB_FIRST_CORE];
+
+    for (;;) {
+        sem_dec(&queue->pending);
+        sid_job_run(queue);
+    }
+}
+
+/* Run one job if there is one, without blocking. For a helper core that
+   has other work to do as well. Returns non-zero if a job was run. */
+int sid_job_poll(int core)
+{
+    sid_job_queue_t *queue = &sid_job_queue[core - SID_JOB_FIRST_CORE];
+
+    if (*(volatile uint32_t *)&queue->pending == 0) {
+        return 0;
+    }
+    /* Only this core takes from the queue so this won't block. */
+    sem_dec(&queue->pending);
+    sid_job_run(queue);
+    return 1;
+}
+#endif
+
 int sid_sound_machine_calculate_samples(sound_t **psid, int16_t *pbuf, int nr, int soc, int scc, int *delta_t)
 {
     int i;
@@ -471,15 +544,15 @@ int sid_sound_machine_calculate_samples(sound_t **psid, int16_t *pbuf, int nr, i
     int16_t *tmp_buf2;
     int16_t *tmp_buf3;
     int tmp_nr = 0;
-    int tmp_delta_t = *delta_t;
 
     if (soc == 1 && scc == 1) {
         return sid_engine.calculate_samples(psid[0], pbuf, nr, 1, delta_t);
     }
     if (soc == 1 && scc == 2) {
         tmp_buf1 = getbuf1(2 * nr);
-        tmp_nr = sid_engine.calculate_samples(psid[0], tmp_buf1, nr, 1, &tmp_delta_t);
+        sid_job_submit(psid[0], tmp_buf1, nr, 1, *delta_t);
         tmp_nr = sid_engine.calculate_samples(psid[1], pbuf, nr, 1, delta_t);
+        sid_job_wait();
         for (i = 0; i < tmp_nr; i++) {
             pbuf[i] = sound_audio_mix(pbuf[i], tmp_buf1[i]);
         }
@@ -488,10 +561,10 @@ int sid_sound_machine_calculate_samples(sound_t **psid, int16_t *pbuf, int nr, i
     if (soc == 1 && scc == 3) {
         tmp_buf1 = getbuf1(2 * nr);
         tmp_buf2 = getbuf2(2 * nr);
-        tmp_nr = sid_engine.calculate_samples(psid[0], tmp_buf1, nr, 1, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[2], tmp_buf2, nr, 1, &tmp_delta_t);
+        sid_job_submit(psid[0], tmp_buf1, nr, 1, *delta_t);
+        sid_job_submit(psid[2], tmp_buf2, nr, 1, *delta_t);
         tmp_nr = sid_engine.calculate_samples(psid[1], pbuf, nr, 1, delta_t);
+        sid_job_wait();
         for (i = 0; i < tmp_nr; i++) {
             pbuf[i] = sound_audio_mix(pbuf[i], tmp_buf1[i]);
             pbuf[i] = sound_audio_mix(pbuf[i], tmp_buf2[i]);
@@ -502,12 +575,11 @@ int sid_sound_machine_calculate_samples(sound_t **psid, int16_t *pbuf, int nr, i
         tmp_buf1 = getbuf1(2 * nr);
         tmp_buf2 = getbuf2(2 * nr);
         tmp_buf3 = getbuf3(2 * nr);
-        tmp_nr = sid_engine.calculate_samples(psid[0], tmp_buf1, nr, 1, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[2], tmp_buf2, nr, 1, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[3], tmp_buf3, nr, 1, &tmp_delta_t);
+        sid_job_submit(psid[0], tmp_buf1, nr, 1, *delta_t);
+        sid_job_submit(psid[2], tmp_buf2, nr, 1, *delta_t);
+        sid_job_submit(psid[3], tmp_buf3, nr, 1, *delta_t);
         tmp_nr = sid_engine.calculate_samples(psid[1], pbuf, nr, 1, delta_t);
+        sid_job_wait();
         for (i = 0; i < tmp_nr; i++) {
             pbuf[i] = sound_audio_mix(pbuf[i], tmp_buf1[i]);
             pbuf[i] = sound_audio_mix(pbuf[i], tmp_buf2[i]);
@@ -523,32 +595,21 @@ int sid_sound_machine_calculate_samples(sound_t **psid, int16_t *pbuf, int nr, i
         return tmp_nr;
     }
     if (soc == 2 && scc == 2) {
-#ifdef RASPI_COMPILE
         // For BMC64, we're going to use an idle core to calculate the 2nd SID
         // stream. This will result in virtually no performance penalty and
         // prevents some stuttering on the Pi2 which is already very close to
         // the edge in terms of CPU utilization
-        // Setup the job
-        sid_job_func = sid_engine.calculate_samples;
-        sid_job_psid = psid[1];
-        sid_job_pbuf = pbuf + 1;
-        sid_job_nr = nr;
-        sid_job_delta_t = tmp_delta_t;
-        sem_inc(&sid_job);
+        sid_job_submit(psid[1], pbuf + 1, nr, 2, *delta_t);
         tmp_nr = sid_engine.calculate_samples(psid[0], pbuf, nr, 2, delta_t);
-        sem_dec(&sid_done);
-#else
-        tmp_nr = sid_engine.calculate_samples(psid[0], pbuf, nr, 2, &tmp_delta_t);
-        tmp_nr = sid_engine.calculate_samples(psid[1], pbuf + 1, nr, 2, delta_t);
-#endif
+        sid_job_wait();
         return tmp_nr;
     }
     if (soc == 2 && scc == 3) {
         tmp_buf1 = getbuf1(2 * nr);
-        tmp_nr = sid_engine.calculate_samples(psid[2], tmp_buf1, nr, 1, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[0], pbuf, nr, 2, &tmp_delta_t);
-        tmp_nr = sid_engine.calculate_samples(psid[1], pbuf + 1, nr, 2, delta_t);
+        sid_job_submit(psid[2], tmp_buf1, nr, 1, *delta_t);
+        sid_job_submit(psid[1], pbuf + 1, nr, 2, *delta_t);
+        tmp_nr = sid_engine.calculate_samples(psid[0], pbuf, nr, 2, delta_t);
+        sid_job_wait();
         for (i = 0; i < tmp_nr; i++) {
             pbuf[i * 2] = sound_audio_mix(pbuf[i * 2], tmp_buf1[i]);
             pbuf[(i * 2) + 1] = sound_audio_mix(pbuf[(i * 2) + 1], tmp_buf1[i]);
@@ -556,12 +617,11 @@ int sid_sound_machine_calculate_samples(sound_t **psid, int16_t *pbuf, int nr, i
     }
     if (soc == 2 && scc == 4) {
         tmp_buf1 = getbuf1(2 * nr);
-        tmp_nr = sid_engine.calculate_samples(psid[2], tmp_buf1, nr, 2, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[3], tmp_buf1 + 1, nr, 2, &tmp_delta_t);
-        tmp_delta_t = *delta_t;
-        tmp_nr = sid_engine.calculate_samples(psid[0], pbuf, nr, 2, &tmp_delta_t);
-        tmp_nr = sid_engine.calculate_samples(psid[1], pbuf + 1, nr, 2, delta_t);
+        sid_job_submit(psid[2], tmp_buf1, nr, 2, *delta_t);
+        sid_job_submit(psid[3], tmp_buf1 + 1, nr, 2, *delta_t);
+        sid_job_submit(psid[1], pbuf + 1, nr, 2, *delta_t);
+        tmp_nr = sid_engine.calculate_samples(psid[0], pbuf, nr, 2, delta_t);
+        sid_job_wait();
         for (i = 0; i < tmp_nr; i++) {
             pbuf[i * 2] = sound_audio_mix(pbuf[i * 2], tmp_buf1[i * 2]);
             pbuf[(i * 2) + 1] = sound_audio_mix(pbuf[(i * 2) + 1], tmp_buf1[(i * 2) + 1]);
@@ -610,6 +670,23 @@ int sid_sound_machine_cycle_based(void)
     return 0;
 }
 
+#ifdef RASPI_COMPILE
+/* Runs every SID delta_t cycles without making samples.  Returns 0 if
+   the engine can only do that by making them.  */
+int sid_sound_machine_advance(sound_t **psid, int sound_chip_channels, int delta_t)
+{
+    int i;
+
+    if (sid_engine.advance == NULL) {
+        return 0;
+    }
+    for (i = 0; i < sound_chip_channels; i++) {
+        sid_engine.advance(psid[i], delta_t);
+    }
+    return 1;
+}
+#endif
+
 int sid_sound_machine_channels(void)
 {
     int channels = 0;
@@ -37,15 +37,32 @@
 #define SID_SETTINGS_DIALOG
 
 #ifdef RASPI_COMPILE
-extern int (*sid_job_func)(struct sound_s *psid, short *pbuf,
-                           int nr, int interleave, int *delta_t);
-extern struct sound_s *sid_job_psid;
-extern int16_t *sid_job_pbuf;
-extern int sid_job_nr;
-extern int sid_job_delta_t;
-
-extern uint32_t sid_job;
-extern uint32_t sid_done;
+/* BMC64 hands SID sample calculation to the otherwise idle cores 2 and 3.
+   Each core owns a small ring of jobs guarded by a pair of semaphores. */
+#define SID_JOB_FIRST_CORE 2
+#define SID_JOB_NUM_CORES 2
+#define SID_JOB_QUEUE_SIZE 4
+
+typedef struct sid_job_s {
+    struct sound_s *psid;
+    int16_t *pbuf;
+    int nr;
+    int interleave;
+    int delta_t;
+} sid_job_t;
+
+typedef struct sid_job_queue_s {
+    sid_job_t jobs[SID_JOB_QUEUE_SIZE];
+    int head;
+    int tail;
+    uint32_t pending;
+    uint32_t done;
+} sid_job_queue_t;
+
+extern sid_job_queue_t sid_job_queue[SID_JOB_NUM_CORES];
+extern void sid_job_worker(int core);
+extern int sid_job_poll(int core);
+
 extern void sem_inc(uint32_t* semaphore);
 extern void sem_dec(uint32_t* semaphore);
 
@@ -133,6 +150,11 @@ struct sid_engine_s {
                        struct sid_snapshot_state_s *sid_state);
     void (*state_write)(struct sound_s *psid,
                         struct sid_snapshot_state_s *sid_state);
+#ifdef RASPI_COMPILE
+    /* Runs the chip delta_t cycles without making samples.  NULL if the
+       engine can't.  */
+    void (*advance)(struct sound_s *psid, int delta_t);
+#endif
 };
 typedef struct sid_engine_s sid_engine_t;
 
@@ -154,6 +176,9 @@ extern void sid_sound_machine_prevent_clk_overflow(sound_t *psid, CLOCK sub);
 extern char *sid_sound_machine_dump_state(sound_t *psid);
 extern int sid_sound_machine_cycle_based(void);
 extern int sid_sound_machine_channels(void);
+#ifdef RASPI_COMPILE
+extern int sid_sound_machine_advance(sound_t **psid, int sound_chip_channels, int delta_t);
+#endif
 extern void sid_sound_machine_enable(int enable);
 extern sid_engine_model_t **sid_get_engine_model_list(void);
 extern int sid_set_engine_model(int engine, int model);
@@ -57,9 +57,32 @@ char snapshot_version_magic_string[] = "VICE Version\032";
 #define SNAPSHOT_MAGIC_LEN              19
 #define SNAPSHOT_VERSION_MAGIC_LEN      13
 
+/* Added for BMC64. Snapshots are always built in and read from a memory
+   buffer. File backed snapshots are read in one go when opened and
+   written in one go when closed instead of going through stdio a byte
+   at a time, which is very slow on the SD card. The buffer can also be
+   the final destination (see snapshot_set_mem_target) so states can be
+   captured without touching the file system at all.  */
+struct snapshot_mem_s {
+    uint8_t *data;
+
+    /* Bytes used.  */
+    size_t len;
+
+    /* Bytes allocated.  */
+    size_t size;
+};
+
+typedef struct snapshot_stream_s {
+    snapshot_mem_t *mem;
+
+    /* Current read/write position.  */
+    size_t pos;
+} snapshot_stream_t;
+
 struct snapshot_module_s {
-    /* File descriptor.  */
-    FILE *file;
+    /* Stream of the snapshot this module belongs to.  */
+    snapshot_stream_t *stream;
 
     /* Flag: are we writing it?  */
     int write_mode;
@@ -75,9 +98,15 @@ struct snapshot_module_s {
 };
 
 struct snapshot_s {
-    /* File descriptor.  */
+    snapshot_stream_t stream;
+
+    /* File the buffer is written to on close, NULL if the snapshot only
+       lives in memory.  */
     FILE *file;
 
+    /* Flag: did we allocate the buffer ourselves?  */
+    int own_mem;
+
     /* Offset of the first module.  */
     long first_module_offset;
 
@@ -85,11 +114,109 @@ struct snapshot_s {
     int write_mode;
 };
 
+/* Buffer snapshot_create and snapshot_open use instead of the file.  */
+static snapshot_mem_t *mem_target = NULL;
+
+#define SNAPSHOT_MEM_INITIAL_SIZE (64 * 1024)
+
+/* How much of a pending asynchronous save is written per step.  */
+#define SNAPSHOT_FLUSH_CHUNK (16 * 1024)
+
+static struct {
+    snapshot_mem_t *mem;
+    FILE *file;
+    char *filename;
+    size_t pos;
+    snapshot_mem_done_t done;
+} flush;
+
+/* ------------------------------------------------------------------------- */
+
+static int snapshot_mem_reserve(snapshot_mem_t *mem, size_t len)
+{
+    size_t size;
+
+    if (len <= mem->size) {
+        return 0;
+    }
+
+    size = mem->size ? mem->size : SNAPSHOT_MEM_INITIAL_SIZE;
+    while (size < len) {
+        size *= 2;
+    }
+
+    mem->data = lib_realloc(mem->data, size);
+    mem->size = size;
+    return 0;
+}
+
+static int stream_write(snapshot_stream_t *f, const void *data, size_t num)
+{
+    snapshot_mem_t *mem = f->mem;
+
+    if (snapshot_mem_reserve(mem, f->pos + num) < 0) {
+        return -1;
+    }
+    memcpy(mem->data + f->pos, data, num);
+    f->pos += num;
+    if (f->pos > mem->len) {
+        mem->len = f->pos;
+    }
+    return 0;
+}
+
+static int stream_putc(snapshot_stream_t *f, uint8_t c)
+{
+    snapshot_mem_t *mem = f->mem;
+
+    if (f->pos >= mem->size) {
+        return stream_write(f, &c, 1) < 0 ? EOF : c;
+    }
+    mem->data[f->pos++] = c;
+    if (f->pos > mem->len) {
+        mem->len = f->pos;
+    }
+    return c;
+}
+
+static int stream_read(snapshot_stream_t *f, void *data, size_t num)
+{
+    if (num > f->mem->len - f->pos) {
+        f->pos = f->mem->len;
+        return -1;
+    }
+    memcpy(data, f->mem->data + f->pos, num);
+    f->pos += num;
+    return 0;
+}
+
+static int stream_getc(snapshot_stream_t *f)
+{
+    if (f->pos >= f->mem->len) {
+        return EOF;
+    }
+    return f->mem->data[f->pos++];
+}
+
+static int stream_seek(snapshot_stream_t *f, long offset)
+{
+    if (offset < 0 || (size_t)offset > f->mem->len) {
+        return -1;
+    }
+    f->pos = (size_t)offset;
+    return 0;
+}
+
+static long stream_tell(snapshot_stream_t *f)
+{
+    return (long)f->pos;
+}
+
 /* ------------------------------------------------------------------------- */
 
-static int snapshot_write_byte(FILE *f, uint8_t data)
+static int snapshot_write_byte(snapshot_stream_t *f, uint8_t data)
 {
-    if (fputc(data, f) == EOF) {
+    if (stream_putc(f, data) == EOF) {
         snapshot_error = SNAPSHOT_WRITE_EOF_ERROR;
         return -1;
     }
@@ -97,7 +224,7 @@ static int snapshot_write_byte(FILE *f, uint8_t data)
     return 0;
 }
 
-static int snapshot_write_word(FILE *f, uint16_t data)
+static int snapshot_write_word(snapshot_stream_t *f, uint16_t data)
 {
     if (snapshot_write_byte(f, (uint8_t)(data & 0xff)) < 0
         || snapshot_write_byte(f, (uint8_t)(data >> 8)) < 0) {
@@ -107,7 +234,7 @@ static int snapshot_write_word(FILE *f, uint16_t data)
     return 0;
 }
 
-static int snapshot_write_dword(FILE *f, uint32_t data)
+static int snapshot_write_dword(snapshot_stream_t *f, uint32_t data)
 {
     if (snapshot_write_word(f, (uint16_t)(data & 0xffff)) < 0
         || snapshot_write_word(f, (uint16_t)(data >> 16)) < 0) {
@@ -117,7 +244,7 @@ static int snapshot_write_dword(FILE *f, uint32_t data)
     return 0;
 }
 
-static int snapshot_write_double(FILE *f, double data)
+static int snapshot_write_double(snapshot_stream_t *f, double data)
 {
     uint8_t *byte_data = (uint8_t *)&data;
     int i;
@@ -130,7 +257,7 @@ static int snapshot_write_double(FILE *f, double data)
     return 0;
 }
 
-static int snapshot_write_padded_string(FILE *f, const char *s, uint8_t pad_char,
+static int snapshot_write_padded_string(snapshot_stream_t *f, const char *s, uint8_t pad_char,
                                         int len)
 {
     int i, found_zero;
@@ -149,9 +276,9 @@ static int snapshot_write_padded_string(FILE *f, const char *s, uint8_t pad_char
     return 0;
 }
 
-static int snapshot_write_byte_array(FILE *f, const uint8_t *data, unsigned int num)
+static int snapshot_write_byte_array(snapshot_stream_t *f, const uint8_t *data, unsigned int num)
 {
-    if (num > 0 && fwrite(data, (size_t)num, 1, f) < 1) {
+    if (num > 0 && stream_write(f, data, (size_t)num) < 0) {
         snapshot_error = SNAPSHOT_WRITE_BYTE_ARRAY_ERROR;
         return -1;
     }
@@ -159,7 +286,7 @@ static int snapshot_write_byte_array(FILE *f, const uint8_t *data, unsigned int
     return 0;
 }
 
-static int snapshot_write_word_array(FILE *f, const uint16_t *data, unsigned int num)
+static int snapshot_write_word_array(snapshot_stream_t *f, const uint16_t *data, unsigned int num)
 {
     unsigned int i;
 
@@ -172,7 +299,7 @@ static int snapshot_write_word_array(FILE *f, const uint16_t *data, unsigned int
     return 0;
 }
 
-static int snapshot_write_dword_array(FILE *f, const uint32_t *data, unsigned int num)
+static int snapshot_write_dword_array(snapshot_stream_t *f, const uint32_t *data, unsigned int num)
 {
     unsigned int i;
 
@@ -186,7 +313,7 @@ static int snapshot_write_dword_array(FILE *f, const uint32_t *data, unsigned in
 }
 
 
-static int snapshot_write_string(FILE *f, const char *s)
+static int snapshot_write_string(snapshot_stream_t *f, const char *s)
 {
     size_t len, i;
 
@@ -205,11 +332,11 @@ static int snapshot_write_string(FILE *f, const char *s)
     return (int)(len + sizeof(uint16_t));
 }
 
-static int snapshot_read_byte(FILE *f, uint8_t *b_return)
+static int snapshot_read_byte(snapshot_stream_t *f, uint8_t *b_return)
 {
     int c;
 
-    c = fgetc(f);
+    c = stream_getc(f);
     if (c == EOF) {
         snapshot_error = SNAPSHOT_READ_EOF_ERROR;
         return -1;
@@ -218,7 +345,7 @@ static int snapshot_read_byte(FILE *f, uint8_t *b_return)
     return 0;
 }
 
-static int snapshot_read_word(FILE *f, uint16_t *w_return)
+static int snapshot_read_word(snapshot_stream_t *f, uint16_t *w_return)
 {
     uint8_t lo, hi;
 
@@ -230,7 +357,7 @@ static int snapshot_read_word(FILE *f, uint16_t *w_return)
     return 0;
 }
 
-static int snapshot_read_dword(FILE *f, uint32_t *dw_return)
+static int snapshot_read_dword(snapshot_stream_t *f, uint32_t *dw_return)
 {
     uint16_t lo, hi;
 
@@ -242,7 +369,7 @@ static int snapshot_read_dword(FILE *f, uint32_t *dw_return)
     return 0;
 }
 
-static int snapshot_read_double(FILE *f, double *d_return)
+static int snapshot_read_double(snapshot_stream_t *f, double *d_return)
 {
     int i;
     int c;
@@ -250,7 +377,7 @@ static int snapshot_read_double(FILE *f, double *d_return)
     uint8_t *byte_val = (uint8_t *)&val;
 
     for (i = 0; i < sizeof(double); i++) {
-        c = fgetc(f);
+        c = stream_getc(f);
         if (c == EOF) {
             snapshot_error = SNAPSHOT_READ_EOF_ERROR;
             return -1;
@@ -261,9 +388,9 @@ static int snapshot_read_double(FILE *f, double *d_return)
     return 0;
 }
 
-static int snapshot_read_byte_array(FILE *f, uint8_t *b_return, unsigned int num)
+static int snapshot_read_byte_array(snapshot_stream_t *f, uint8_t *b_return, unsigned int num)
 {
-    if (num > 0 && fread(b_return, (size_t)num, 1, f) < 1) {
+    if (num > 0 && stream_read(f, b_return, (size_t)num) < 0) {
         snapshot_error = SNAPSHOT_READ_BYTE_ARRAY_ERROR;
         return -1;
     }
@@ -271,7 +398,7 @@ static int snapshot_read_byte_array(FILE *f, uint8_t *b_return, unsigned int num
     return 0;
 }
 
-static int snapshot_read_word_array(FILE *f, uint16_t *w_return, unsigned int num)
+static int snapshot_read_word_array(snapshot_stream_t *f, uint16_t *w_return, unsigned int num)
 {
     unsigned int i;
 
@@ -284,7 +411,7 @@ static int snapshot_read_word_array(FILE *f, uint16_t *w_return, unsigned int nu
     return 0;
 }
 
-static int snapshot_read_dword_array(FILE *f, uint32_t *dw_return, unsigned int num)
+static int snapshot_read_dword_array(snapshot_stream_t *f, uint32_t *dw_return, unsigned int num)
 {
     unsigned int i;
 
@@ -297,7 +424,7 @@ static int snapshot_read_dword_array(FILE *f, uint32_t *dw_return, unsigned int
     return 0;
 }
 
-static int snapshot_read_string(FILE *f, char **s)
+static int snapshot_read_string(snapshot_stream_t *f, char **s)
 {
     int i, len;
     uint16_t w;
@@ -332,7 +459,7 @@ static int snapshot_read_string(FILE *f, char **s)
 
 int snapshot_module_write_byte(snapshot_module_t *m, uint8_t b)
 {
-    if (snapshot_write_byte(m->file, b) < 0) {
+    if (snapshot_write_byte(m->stream, b) < 0) {
         return -1;
     }
 
@@ -342,7 +469,7 @@ int snapshot_module_write_byte(snapshot_module_t *m, uint8_t b)
 
 int snapshot_module_write_word(snapshot_module_t *m, uint16_t w)
 {
-    if (snapshot_write_word(m->file, w) < 0) {
+    if (snapshot_write_word(m->stream, w) < 0) {
         return -1;
     }
 
@@ -352,7 +479,7 @@ int snapshot_module_write_word(snapshot_module_t *m, uint16_t w)
 
 int snapshot_module_write_dword(snapshot_module_t *m, uint32_t dw)
 {
-    if (snapshot_write_dword(m->file, dw) < 0) {
+    if (snapshot_write_dword(m->stream, dw) < 0) {
         return -1;
     }
 
@@ -362,7 +489,7 @@ int snapshot_module_write_dword(snapshot_module_t *m, uint32_t dw)
 
 int snapshot_module_write_double(snapshot_module_t *m, double db)
 {
-    if (snapshot_write_double(m->file, db) < 0) {
+    if (snapshot_write_double(m->stream, db) < 0) {
         return -1;
     }
 
@@ -372,7 +499,7 @@ int snapshot_module_write_double(snapshot_module_t *m, double db)
 
 int snapshot_module_write_padded_string(snapshot_module_t *m, const char *s, uint8_t pad_char, int len)
 {
-    if (snapshot_write_padded_string(m->file, s, (uint8_t)pad_char, len) < 0) {
+    if (snapshot_write_padded_string(m->stream, s, (uint8_t)pad_char, len) < 0) {
         return -1;
     }
 
@@ -382,7 +509,7 @@ int snapshot_module_write_padded_string(snapshot_module_t *m, const char *s, uin
 
 int snapshot_module_write_byte_array(snapshot_module_t *m, const uint8_t *b, unsigned int num)
 {
-    if (snapshot_write_byte_array(m->file, b, num) < 0) {
+    if (snapshot_write_byte_array(m->stream, b, num) < 0) {
         return -1;
     }
 
@@ -392,7 +519,7 @@ int snapshot_module_write_byte_array(snapshot_module_t *m, const uint8_t *b, uns
 
 int snapshot_module_write_word_array(snapshot_module_t *m, const uint16_t *w, unsigned int num)
 {
-    if (snapshot_write_word_array(m->file, w, num) < 0) {
+    if (snapshot_write_word_array(m->stream, w, num) < 0) {
         return -1;
     }
 
@@ -402,7 +529,7 @@ int snapshot_module_write_word_array(snapshot_module_t *m, const uint16_t *w, un
 
 int snapshot_module_write_dword_array(snapshot_module_t *m, const uint32_t *dw, unsigned int num)
 {
-    if (snapshot_write_dword_array(m->file, dw, num) < 0) {
+    if (snapshot_write_dword_array(m->stream, dw, num) < 0) {
         return -1;
     }
 
@@ -413,7 +540,7 @@ int snapshot_module_write_dword_array(snapshot_module_t *m, const uint32_t *dw,
 int snapshot_module_write_string(snapshot_module_t *m, const char *s)
 {
     int len;
-    len = snapshot_write_string(m->file, s);
+    len = snapshot_write_string(m->stream, s);
     if (len < 0) {
         snapshot_error = SNAPSHOT_ILLEGAL_STRING_LENGTH_ERROR;
         return -1;
@@ -427,82 +554,82 @@ int snapshot_module_write_string(snapshot_module_t *m, const char *s)
 
 int snapshot_module_read_byte(snapshot_module_t *m, uint8_t *b_return)
 {
-    if (ftell(m->file) + sizeof(uint8_t) > m->offset + m->size) {
+    if (stream_tell(m->stream) + sizeof(uint8_t) > m->offset + m->size) {
         snapshot_error = SNAPSHOT_READ_OUT_OF_BOUNDS_ERROR;
         return -1;
     }
 
-    return snapshot_read_byte(m->file, b_return);
+    return snapshot_read_byte(m->stream, b_return);
 }
 
 int snapshot_module_read_word(snapshot_module_t *m, uint16_t *w_return)
 {
-    if (ftell(m->file) + sizeof(uint16_t) > m->offset + m->size) {
+    if (stream_tell(m->stream) + sizeof(uint16_t) > m->offset + m->size) {
         snapshot_error = SNAPSHOT_READ_OUT_OF_BOUNDS_ERROR;
         return -1;
     }
 
-    return snapshot_read_word(m->file, w_return);
+    return snapshot_read_word(m->stream, w_return);
 }
 
 int snapshot_module_read_dword(snapshot_module_t *m, uint32_t *dw_return)
 {
-    if (ftell(m->file) + sizeof(uint32_t) > m->offset + m->size) {
+    if (stream_tell(m->stream) + sizeof(uint32_t) > m->offset + m->size) {
         snapshot_error = SNAPSHOT_READ_OUT_OF_BOUNDS_ERROR;
         return -1;
     }
 
-    return snapshot_read_dword(m->file, dw_return);
+    return snapshot_read_dword(m->stream, dw_return);
 }
 
 int snapshot_module_read_double(snapshot_module_t *m, double *db_return)
 {
-    if (ftell(m->file) + sizeof(double) > m->offset + m->size) {
+    if (stream_tell(m->stream) + sizeof(double) > m->offset + m->size) {
         snapshot_error = SNAPSHOT_READ_OUT_OF_BOUNDS_ERROR;
         return -1;
     }
 
-    return snapshot_read_double(m->file, db_return);
+    return snapshot_read_double(m->stream, db_return);
 }
 
 int snapshot_module_read_byte_array(snapshot_module_t *m, uint8_t *b_return, unsigned int num)
 {
-    if ((long)(ftell(m->file) + num) > (long)(m->offset + m->size)) {
+    if ((long)(stream_tell(m->stream) + num) > (long)(m->offset + m->size)) {
         snapshot_error = SNAPSHOT_READ_OUT_OF_BOUNDS_ERROR;
         return -1;
     }
 
-    return snapshot_read_byte_array(m->file, b_return, num);
+    return snapshot_read_byte_array(m->stream, b_return, num);
 }
 
 int snapshot_module_read_word_array(snapshot_module_t *m, uint16_t *w_return, unsigned int num)
 {
-    if ((long)(ftell(m->file) + num * sizeof(uint16_t)) > (long)(m->offset + m->size)) {
+    if ((long)(stream_tell(m->stream) + num * sizeof(uint16_t)) > (long)(m->offset + m->size)) {
         snapshot_error = SNAPSHOT_READ_OUT_OF_BOUNDS_ERROR;
         return -1;
     }
 
-    return snapshot_read_word_array(m->file, w_return, num);
+    return snapshot_read_word_array(m->stream, w_return, num);
 }
 
 int snapshot_module_read_dword_array(snapshot_module_t *m, uint32_t *dw_return, unsigned int num)
 {
-    if ((long)(ftell(m->file) + num * sizeof(uint32_t)) > (long)(m->offset + m->size)) {
+    if ((long)(stream_tell(m->stream) + num * sizeof(uint32_t)) > (long)(m->offset + m->size)) {
         snapshot_error = SNAPSHOT_READ_OUT_OF_BOUNDS_ERROR;
         return -1;
     }
 
-    return snapshot_read_dword_array(m->file, dw_return, num);
+    return snapshot_read_dword_array(m->stream, dw_return, num);
 }
 
 int snapshot_module_read_string(snapshot_module_t *m, char **charp_return)
 {
-    if (ftell(m->file) + sizeof(uint16_t) > m->offset + m->size) {
+    if (stream_tell(m->stream) + sizeof(uint16_t) > m->offset + m->size) {
         snapshot_error = SNAPSHOT_READ_OUT_OF_BOUNDS_ERROR;
         return -1;
     }
 
-    return snapshot_read_string(m->file, charp_return);
+    return snapshot_read_string(m->stream, charp_return);
 }
 
 int snapshot_module_read_byte_into_int(snapshot_module_t *m, int *value_return)
@@ -569,24 +696,19 @@ snapshot_module_t *snapshot_module_create(snapshot_t *s, const char *name, uint8
     current_module = (char *)name;
 
     m = lib_malloc(sizeof(snapshot_module_t));
-    m->file = s->file;
-    m->offset = ftell(s->file);
-    if (m->offset == -1) {
-        snapshot_error = SNAPSHOT_ILLEGAL_OFFSET_ERROR;
-        lib_free(m);
-        return NULL;
-    }
+    m->stream = &s->stream;
+    m->offset = stream_tell(&s->stream);
     m->write_mode = 1;
 
-    if (snapshot_write_padded_string(s->file, name, (uint8_t)0, SNAPSHOT_MODULE_NAME_LEN) < 0
-        || snapshot_write_byte(s->file, major_version) < 0
-        || snapshot_write_byte(s->file, minor_version) < 0
-        || snapshot_write_dword(s->file, 0) < 0) {
+    if (snapshot_write_padded_string(&s->stream, name, (uint8_t)0, SNAPSHOT_MODULE_NAME_LEN) < 0
+        || snapshot_write_byte(&s->stream, major_version) < 0
+        || snapshot_write_byte(&s->stream, minor_version) < 0
+        || snapshot_write_dword(&s->stream, 0) < 0) {
         return NULL;
     }
 
-    m->size = ftell(s->file) - m->offset;
-    m->size_offset = ftell(s->file) - sizeof(uint32_t);
+    m->size = stream_tell(&s->stream) - m->offset;
+    m->size_offset = stream_tell(&s->stream) - sizeof(uint32_t);
 
     return m;
 }
@@ -599,13 +721,13 @@ snapshot_module_t *snapshot_module_open(snapshot_t *s, const char *name, uint8_t
 
     current_module = (char *)name;
 
-    if (fseek(s->file, s->first_module_offset, SEEK_SET) < 0) {
+    if (stream_seek(&s->stream, s->first_module_offset) < 0) {
         snapshot_error = SNAPSHOT_FIRST_MODULE_NOT_FOUND_ERROR;
         return NULL;
     }
 
     m = lib_malloc(sizeof(snapshot_module_t));
-    m->file = s->file;
+    m->stream = &s->stream;
     m->write_mode = 0;
 
     m->offset = s->first_module_offset;
@@ -613,11 +735,11 @@ snapshot_module_t *snapshot_module_open(snapshot_t *s, const char *name, uint8_t
     /* Search for the module name.  This is quite inefficient, but I don't
        think we care.  */
     while (1) {
-        if (snapshot_read_byte_array(s->file, (uint8_t *)n,
+        if (snapshot_read_byte_array(&s->stream, (uint8_t *)n,
                                      SNAPSHOT_MODULE_NAME_LEN) < 0
-            || snapshot_read_byte(s->file, major_version_return) < 0
-            || snapshot_read_byte(s->file, minor_version_return) < 0
-            || snapshot_read_dword(s->file, &m->size)) {
+            || snapshot_read_byte(&s->stream, major_version_return) < 0
+            || snapshot_read_byte(&s->stream, minor_version_return) < 0
+            || snapshot_read_dword(&s->stream, &m->size)) {
             snapshot_error = SNAPSHOT_MODULE_HEADER_READ_ERROR;
             goto fail;
         }
@@ -629,18 +751,18 @@ snapshot_module_t *snapshot_module_open(snapshot_t *s, const char *name, uint8_t
         }
 
         m->offset += m->size;
-        if (fseek(s->file, m->offset, SEEK_SET) < 0) {
+        if (stream_seek(&s->stream, m->offset) < 0) {
             snapshot_error = SNAPSHOT_MODULE_NOT_FOUND_ERROR;
             goto fail;
         }
     }
 
-    m->size_offset = ftell(s->file) - sizeof(uint32_t);
+    m->size_offset = stream_tell(&s->stream) - sizeof(uint32_t);
 
     return m;
 
 fail:
-    fseek(s->file, s->first_module_offset, SEEK_SET);
+    stream_seek(&s->stream, s->first_module_offset);
     lib_free(m);
     return NULL;
 }
@@ -649,14 +771,14 @@ int snapshot_module_close(snapshot_module_t *m)
 {
     /* Backpatch module size if writing.  */
     if (m->write_mode
-        && (fseek(m->file, m->size_offset, SEEK_SET) < 0
-            || snapshot_write_dword(m->file, m->size) < 0)) {
+        && (stream_seek(m->stream, m->size_offset) < 0
+            || snapshot_write_dword(m->stream, m->size) < 0)) {
         snapshot_error = SNAPSHOT_MODULE_CLOSE_ERROR;
         return -1;
     }
 
     /* Skip module.  */
-    if (fseek(m->file, m->offset + m->size, SEEK_SET) < 0) {
+    if (stream_seek(m->stream, m->offset + m->size) < 0) {
         snapshot_error = SNAPSHOT_MODULE_SKIP_ERROR;
         return -1;
     }
@@ -667,19 +789,205 @@ int snapshot_module_close(snapshot_module_t *m)
 
 /* ------------------------------------------------------------------------- */
 
-snapshot_t *snapshot_create(const char *filename, uint8_t major_version, uint8_t minor_version, const char *snapshot_machine_name)
+snapshot_mem_t *snapshot_mem_new(void)
+{
+    return lib_calloc(1, sizeof(snapshot_mem_t));
+}
+
+void snapshot_mem_free(snapshot_mem_t *mem)
+{
+    if (mem == NULL) {
+        return;
+    }
+    lib_free(mem->data);
+    lib_free(mem);
+}
+
+const uint8_t *snapshot_mem_data(const snapshot_mem_t *mem)
+{
+    return mem->data;
+}
+
+size_t snapshot_mem_size(const snapshot_mem_t *mem)
+{
+    return mem->len;
+}
+
+uint8_t *snapshot_mem_resize(snapshot_mem_t *mem, size_t len)
+{
+    snapshot_mem_reserve(mem, len);
+    mem->len = len;
+    return mem->data;
+}
+
+void snapshot_set_mem_target(snapshot_mem_t *mem)
+{
+    mem_target = mem;
+}
+
+int snapshot_mem_load(snapshot_mem_t *mem, const char *filename)
+{
+    FILE *f;
+    size_t n;
+
+    /* A pending save may be of this very file.  */
+    snapshot_mem_flush_wait();
+
+    f = zfile_fopen(filename, MODE_READ);
+    if (f == NULL) {
+        return -1;
+    }
+
+    mem->len = 0;
+    do {
+        snapshot_mem_reserve(mem, mem->len + SNAPSHOT_FLUSH_CHUNK);
+        n = fread(mem->data + mem->len, 1, mem->size - mem->len, f);
+        mem->len += n;
+    } while (n > 0);
+
+    if (ferror(f)) {
+        zfile_fclose(f);
+        return -1;
+    }
+    zfile_fclose(f);
+    return 0;
+}
+
+static int snapshot_mem_write_file(const snapshot_mem_t *mem, FILE *f)
+{
+    if (mem->len > 0 && fwrite(mem->data, mem->len, 1, f) < 1) {
+        return -1;
+    }
+    return 0;
+}
+
+int snapshot_mem_save(const snapshot_mem_t *mem, const char *filename)
 {
     FILE *f;
+    int retval;
+
+    snapshot_mem_flush_wait();
+
+    f = fopen(filename, MODE_WRITE);
+    if (f == NULL) {
+        return -1;
+    }
+    retval = snapshot_mem_write_file(mem, f);
+    if (fclose(f) == EOF) {
+        retval = -1;
+    }
+    if (retval < 0) {
+        ioutil_remove(filename);
+    }
+    return retval;
+}
+
+static void snapshot_mem_flush_done(int failed)
+{
+    snapshot_mem_done_t done = flush.done;
+
+    if (fclose(flush.file) == EOF) {
+        failed = 1;
+    }
+    if (failed) {
+        log_error(LOG_DEFAULT, "Cannot write snapshot %s", flush.filename);
+        ioutil_remove(flush.filename);
+    }
+    snapshot_mem_free(flush.mem);
+    lib_free(flush.filename);
+    flush.mem = NULL;
+    flush.file = NULL;
+    flush.filename = NULL;
+    flush.done = NULL;
+
+    if (done != NULL) {
+        done(failed);
+    }
+}
+
+int snapshot_mem_save_async(snapshot_mem_t *mem, const char *filename,
+                            snapshot_mem_done_t done)
+{
+    snapshot_mem_flush_wait();
+
+    flush.file = fopen(filename, MODE_WRITE);
+    if (flush.file == NULL) {
+        snapshot_mem_free(mem);
+        return -1;
+    }
+    flush.mem = mem;
+    flush.filename = lib_stralloc(filename);
+    flush.pos = 0;
+    flush.done = done;
+    return 0;
+}
+
+void snapshot_mem_flush_step(void)
+{
+    size_t n;
+
+    if (flush.mem == NULL) {
+        return;
+    }
+
+    n = flush.mem->len - flush.pos;
+    if (n > SNAPSHOT_FLUSH_CHUNK) {
+        n = SNAPSHOT_FLUSH_CHUNK;
+    }
+    if (n > 0 && fwrite(flush.mem->data + flush.pos, n, 1, flush.file) < 1) {
+        snapshot_mem_flush_done(1);
+        return;
+    }
+    flush.pos += n;
+
+    if (flush.pos == flush.mem->len) {
+        snapshot_mem_flush_done(0);
+    }
+}
+
+void snapshot_mem_flush_wait(void)
+{
+    while (flush.mem != NULL) {
+        snapshot_mem_flush_step();
+    }
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* Drop a snapshot that failed to open or is being closed.  */
+static void snapshot_free(snapshot_t *s)
+{
+    if (s->own_mem) {
+        snapshot_mem_free(s->stream.mem);
+    }
+    lib_free(s);
+}
+
+snapshot_t *snapshot_create(const char *filename, uint8_t major_version, uint8_t minor_version, const char *snapshot_machine_name)
+{
+    snapshot_stream_t *f;
     snapshot_t *s;
     unsigned char viceversion[4] = { VERSION_RC_NUMBER };
 
     current_filename = (char *)filename;
 
-    f = fopen(filename, MODE_WRITE);
-    if (f == NULL) {
-        snapshot_error = SNAPSHOT_CANNOT_CREATE_SNAPSHOT_ERROR;
-        return NULL;
+    s = lib_calloc(1, sizeof(snapshot_t));
+    if (mem_target != NULL) {
+        s->stream.mem = mem_target;
+        mem_target->len = 0;
+    } else {
+        /* Don't race a pending save of the same file.  */
+        snapshot_mem_flush_wait();
+        s->file = fopen(filename, MODE_WRITE);
+        if (s->file == NULL) {
+            snapshot_error = SNAPSHOT_CANNOT_CREATE_SNAPSHOT_ERROR;
+            lib_free(s);
+            return NULL;
+        }
+        s->stream.mem = snapshot_mem_new();
+        s->own_mem = 1;
     }
+    f = &s->stream;
 
     /* Magic string.  */
     if (snapshot_write_padded_string(f, snapshot_magic_string, (uint8_t)0, SNAPSHOT_MAGIC_LEN) < 0) {
@@ -719,16 +1027,17 @@ snapshot_t *snapshot_create(const char *filename, uint8_t major_version, uint8_t
         goto fail;
     }
 
-    s = lib_malloc(sizeof(snapshot_t));
-    s->file = f;
-    s->first_module_offset = ftell(f);
+    s->first_module_offset = stream_tell(f);
     s->write_mode = 1;
 
     return s;
 
 fail:
-    fclose(f);
-    ioutil_remove(filename);
+    if (s->file != NULL) {
+        fclose(s->file);
+        ioutil_remove(filename);
+    }
+    snapshot_free(s);
     return NULL;
 }
 
@@ -738,7 +1047,7 @@ static uint32_t snapshot_vicerevision;
 
 snapshot_t *snapshot_open(const char *filename, uint8_t *major_version_return, uint8_t *minor_version_return, const char *snapshot_machine_name)
 {
-    FILE *f;
+    snapshot_stream_t *f;
     char magic[SNAPSHOT_MAGIC_LEN];
     snapshot_t *s = NULL;
     int machine_name_len;
@@ -748,11 +1057,19 @@ snapshot_t *snapshot_open(const char *filename, uint8_t *major_version_return, u
     current_filename = (char *)filename;
     current_module = NULL;
 
-    f = zfile_fopen(filename, MODE_READ);
-    if (f == NULL) {
-        snapshot_error = SNAPSHOT_CANNOT_OPEN_FOR_READ_ERROR;
-        return NULL;
+    s = lib_calloc(1, sizeof(snapshot_t));
+    if (mem_target != NULL) {
+        s->stream.mem = mem_target;
+    } else {
+        s->stream.mem = snapshot_mem_new();
+        s->own_mem = 1;
+        if (snapshot_mem_load(s->stream.mem, filename) < 0) {
+            snapshot_error = SNAPSHOT_CANNOT_OPEN_FOR_READ_ERROR;
+            snapshot_free(s);
+            return NULL;
+        }
     }
+    f = &s->stream;
 
     /* Magic string.  */
     if (snapshot_read_byte_array(f, (uint8_t *)magic, SNAPSHOT_MAGIC_LEN) < 0
@@ -786,12 +1103,12 @@ snapshot_t *snapshot_open(const char *filename, uint8_t *major_version_return, u
     /* VICE version and revision */
     memset(snapshot_viceversion, 0, 4);
     snapshot_vicerevision = 0;
-    offs = ftell(f);
+    offs = stream_tell(f);
 
     if (snapshot_read_byte_array(f, (uint8_t *)magic, SNAPSHOT_VERSION_MAGIC_LEN) < 0
         || memcmp(magic, snapshot_version_magic_string, SNAPSHOT_VERSION_MAGIC_LEN) != 0) {
         /* old snapshots do not contain VICE version */
-        fseek(f, offs, SEEK_SET);
+        stream_seek(f, offs);
         log_warning(LOG_DEFAULT, "attempting to load pre 2.4.30 snapshot");
     } else {
         /* actually read the version */
@@ -805,40 +1122,34 @@ snapshot_t *snapshot_open(const char *filename, uint8_t *major_version_return, u
         }
     }
 
-    s = lib_malloc(sizeof(snapshot_t));
-    s->file = f;
-    s->first_module_offset = ftell(f);
+    s->first_module_offset = stream_tell(f);
     s->write_mode = 0;
 
     vsync_suspend_speed_eval();
     return s;
 
 fail:
-    fclose(f);
+    snapshot_free(s);
     return NULL;
 }
 
 int snapshot_close(snapshot_t *s)
 {
-    int retval;
+    int retval = 0;
 
-    if (!s->write_mode) {
-        if (zfile_fclose(s->file) == EOF) {
-            snapshot_error = SNAPSHOT_READ_CLOSE_EOF_ERROR;
+    if (s->file != NULL) {
+        if (snapshot_mem_write_file(s->stream.mem, s->file) < 0) {
             retval = -1;
-        } else {
-            retval = 0;
         }
-    } else {
         if (fclose(s->file) == EOF) {
-            snapshot_error = SNAPSHOT_WRITE_CLOSE_EOF_ERROR;
             retval = -1;
-        } else {
-            retval = 0;
+        }
+        if (retval < 0) {
+            snapshot_error = SNAPSHOT_WRITE_CLOSE_EOF_ERROR;
         }
     }
 
-    lib_free(s);
+    snapshot_free(s);
     return retval;
 }
 
@@ -28,6 +28,8 @@
 #ifndef SNAPSHOT_H
 #define SNAPSHOT_H
 
+#include <stddef.h>
+
 #include "types.h"
 
 #define SNAPSHOT_MACHINE_NAME_LEN       16
@@ -62,6 +64,7 @@
 
 typedef struct snapshot_module_s snapshot_module_t;
 typedef struct snapshot_s snapshot_t;
+typedef struct snapshot_mem_s snapshot_mem_t;
 
 extern void snapshot_display_error(void);
 
@@ -147,6 +150,36 @@ extern int snapshot_close(snapshot_t *s);
 
 extern void snapshot_set_error(int error);
 
+/* Memory buffers holding a whole snapshot. The storage grows as needed
+   and is kept when a buffer is written again, so capturing the same
+   machine repeatedly does not allocate.  */
+extern snapshot_mem_t *snapshot_mem_new(void);
+extern void snapshot_mem_free(snapshot_mem_t *mem);
+extern const uint8_t *snapshot_mem_data(const snapshot_mem_t *mem);
+extern size_t snapshot_mem_size(const snapshot_mem_t *mem);
+
+/* Sets the size of the buffer and returns it for the caller to fill.  */
+extern uint8_t *snapshot_mem_resize(snapshot_mem_t *mem, size_t len);
+
+/* While set, snapshot_create and snapshot_open use this buffer instead
+   of the file they are given.  */
+extern void snapshot_set_mem_target(snapshot_mem_t *mem);
+
+extern int snapshot_mem_load(snapshot_mem_t *mem, const char *filename);
+extern int snapshot_mem_save(const snapshot_mem_t *mem, const char *filename);
+
+/* Called when an asynchronous save is over. failed is set if the file
+   could not be written, in which case it has been removed.  */
+typedef void (*snapshot_mem_done_t)(int failed);
+
+/* Writes the buffer out a chunk at a time on each
+   snapshot_mem_flush_step call. The buffer is freed and done, if not
+   NULL, is called once the file is complete.  */
+extern int snapshot_mem_save_async(snapshot_mem_t *mem, const char *filename,
+                                   snapshot_mem_done_t done);
+extern void snapshot_mem_flush_step(void);
+extern void snapshot_mem_flush_wait(void);
+
 extern int snapshot_version_at_least(uint8_t major_version, uint8_t minor_version, uint8_t major_version_required, uint8_t minor_version_required);
 
 #define SNAPVAL snapshot_version_at_least
@@ -59,6 +59,10 @@
 #include "math.h"
 #include "ui.h"
 
+#ifdef RASPI_COMPILE
+#include "avsync.h"
+#endif
+
 
 static log_t sound_log = LOG_ERR;
 
@@ -289,6 +293,25 @@ static void sound_machine_reset(sound_t *psid, CLOCK cpu_clk)
     }
 }
 
+#ifdef RASPI_COMPILE
+/* Runs the sound chips delta_t cycles without making samples, if the
+   first chip can and no other one is enabled.  */
+static int sound_machine_advance(sound_t **psid, int scc, int delta_t)
+{
+    int i;
+
+    for (i = 1; i < (offset >> 5); i++) {
+        if (sound_calls[i]->chip_enabled) {
+            return 0;
+        }
+    }
+    if (sound_calls[0]->advance == NULL) {
+        return 0;
+    }
+    return sound_calls[0]->advance(psid, scc, delta_t);
+}
+#endif
+
 static int sound_machine_cycle_based(void)
 {
     int i;
@@ -685,6 +708,11 @@ static int speed_percent;
 /* Flag: Is warp mode enabled?  */
 static int warp_mode_enabled;
 
+#ifdef RASPI_COMPILE
+/* Whether warp may skip making samples.  */
+static int turbo_enabled;
+#endif
+
 typedef struct {
     /* Number of sound output channels */
     int sound_output_channels;
@@ -918,6 +946,10 @@ static int sid_init(void)
     snddata.wclk = maincpu_clk;
     snddata.lastclk = maincpu_clk;
 
+#ifdef RASPI_COMPILE
+    avsync_reset();
+#endif
+
     return 0;
 }
 
@@ -1206,6 +1238,16 @@ static int sound_run_sound(void)
     /* Handling of cycle based sound engines. */
     if (cycle_based) {
         delta_t = maincpu_clk - snddata.lastclk;
+#ifdef RASPI_COMPILE
+        /* Turbo warp: sound_flush throws the samples away.  Only bring
+           the chips up to now so their registers read back right.  */
+        if (turbo_enabled && warp_mode_enabled && snddata.recdev == NULL
+            && sound_machine_advance(snddata.psid,
+                                     snddata.sound_chip_channels, delta_t)) {
+            snddata.lastclk = maincpu_clk;
+            return 0;
+        }
+#endif
         bufferptr = snddata.buffer + snddata.bufptr * snddata.sound_output_channels;
         nr = sound_machine_calculate_samples(snddata.psid,
                                              bufferptr,
@@ -1420,11 +1462,21 @@ double sound_flush()
 
         if (!cycle_based && speed_adjustment_setting != SOUND_ADJUST_EXACT
             && snddata.recdev == NULL) {
+#ifdef RASPI_COMPILE
+            /* Small, smooth corrections for the difference between the
+               display's refresh and the machine's instead of up to 10%
+               jumps on every flush. Aim for a half full buffer. */
+            snddata.clkfactor = SOUNDCLK_MULT(snddata.clkfactor,
+                                              SOUNDCLK_CONSTANT(
+                                                  avsync_ratio(rfsh_per_sec,
+                                                      snddata.bufsize / 2)));
+#else
             snddata.clkfactor = SOUNDCLK_MULT(snddata.clkfactor,
                                               SOUNDCLK_CONSTANT(0.9)
                                               + ((used + nr)
                                                  * SOUNDCLK_CONSTANT(0.12))
                                               / snddata.bufsize);
+#endif
         }
         snddata.clkstep = SOUNDCLK_MULT(snddata.origclkstep,
                                         snddata.clkfactor);
@@ -1650,6 +1702,13 @@ void sound_set_relative_speed(int value)
     speed_percent = value;
 }
 
+#ifdef RASPI_COMPILE
+void sound_set_turbo(int value)
+{
+    turbo_enabled = value;
+}
+#endif
+
 void sound_set_warp_mode(int value)
 {
     warp_mode_enabled = value;
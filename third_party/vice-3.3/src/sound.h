@@ -167,6 +167,9 @@ extern int sound_open(void);
 extern void sound_close(void);
 extern void sound_set_relative_speed(int value);
 extern void sound_set_warp_mode(int value);
+#ifdef RASPI_COMPILE
+extern void sound_set_turbo(int value);
+#endif
 extern void sound_set_machine_parameter(long clock_rate, long ticks_per_frame);
 extern void sound_snapshot_prepare(void);
 extern void sound_snapshot_finish(void);
@@ -244,6 +247,11 @@ typedef struct sound_chip_s {
     int (*cycle_based)(void);
     int (*channels)(void);
     int chip_enabled;
+#ifdef RASPI_COMPILE
+    /* Runs the chip delta_t cycles without making samples.  Optional,
+       returns 0 if it can't.  */
+    int (*advance)(sound_t **psid, int sound_chip_channels, int delta_t);
+#endif
 } sound_chip_t;
 
 extern uint16_t sound_chip_register(sound_chip_t *chip);
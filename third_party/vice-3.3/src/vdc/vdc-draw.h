@@ -29,6 +29,10 @@
 #ifndef VICE_VDC_DRAW_H
 #define VICE_VDC_DRAW_H
 
+struct vdc_s;
+
+extern struct vdc_s *vdc_src;
+
 extern void vdc_draw_init(void);
 
 #endif
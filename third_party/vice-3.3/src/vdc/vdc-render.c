@@ -0,0 +1,264 @@
+/*
+ * vdc-render.c
+ *
+ * Written by
+ *  Randy Rossi <randy.rossi@gmail.com>
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#include "vice.h"
+
+#include "vdc-render.h"
+
+#ifdef VDC_RENDER_ASYNC
+
+#include <stddef.h>
+#include <string.h>
+
+#include "raster-line.h"
+#include "raster.h"
+#include "types.h"
+#include "vdc-draw.h"
+#include "vdctypes.h"
+#include "viewport.h"
+
+/* Must be a power of 2. */
+#define VDC_RENDER_QUEUE_SIZE 64
+
+#define dmb() __asm__ volatile ("dmb" ::: "memory")
+#define sev() __asm__ volatile ("dsb\n\tsev" ::: "memory")
+#define wfe() __asm__ volatile ("wfe" ::: "memory")
+
+/* Everything vdc.c and vdc-mem.c change between lines that drawing a
+   line depends on. */
+typedef struct vdc_render_line_s {
+    uint8_t regs[64];
+    unsigned int screen_text_cols;
+    unsigned int screen_adr;
+    unsigned int attribute_adr;
+    unsigned int chargen_adr;
+    unsigned int mem_counter;
+    unsigned int bitmap_counter;
+    unsigned int bytes_per_char;
+    unsigned int mem_counter_inc;
+    unsigned int border_width;
+    unsigned int attribute_offset;
+    unsigned int xsmooth;
+    int frame_counter;
+    int attribute_blink;
+    int crsrpos;
+
+    int video_mode;
+    unsigned int ycounter;
+    unsigned int display_ystart;
+    unsigned int display_ystop;
+    unsigned int border_color;
+    int idle_background_color;
+    int xsmooth_color;
+    int raster_xsmooth;
+    int skip_frame;
+} vdc_render_line_t;
+
+int vdc_render_active;
+
+/* The chip as of the start of the frame being drawn. The render core
+   applies each queued line to it before drawing that line. */
+static vdc_t vdc_render;
+
+/* Head is written by the main core, tail by the render core. */
+static vdc_render_line_t queue[VDC_RENDER_QUEUE_SIZE];
+static volatile unsigned int queue_head;
+static volatile unsigned int queue_tail;
+
+/* Set once the render core is polling. */
+static volatile int worker_ready;
+
+/* ------------------------------------------------------------------------- */
+
+static void capture_line(vdc_render_line_t *line, const vdc_t *chip)
+{
+    memcpy(line->regs, chip->regs, sizeof(line->regs));
+    line->screen_text_cols = chip->screen_text_cols;
+    line->screen_adr = chip->screen_adr;
+    line->attribute_adr = chip->attribute_adr;
+    line->chargen_adr = chip->chargen_adr;
+    line->mem_counter = chip->mem_counter;
+    line->bitmap_counter = chip->bitmap_counter;
+    line->bytes_per_char = chip->bytes_per_char;
+    line->mem_counter_inc = chip->mem_counter_inc;
+    line->border_width = chip->border_width;
+    line->attribute_offset = chip->attribute_offset;
+    line->xsmooth = chip->xsmooth;
+    line->frame_counter = chip->frame_counter;
+    line->attribute_blink = chip->attribute_blink;
+    line->crsrpos = chip->crsrpos;
+
+    line->video_mode = chip->raster.video_mode;
+    line->ycounter = chip->raster.ycounter;
+    line->display_ystart = chip->raster.display_ystart;
+    line->display_ystop = chip->raster.display_ystop;
+    line->border_color = chip->raster.border_color;
+    line->idle_background_color = chip->raster.idle_background_color;
+    line->xsmooth_color = chip->raster.xsmooth_color;
+    line->raster_xsmooth = chip->raster.xsmooth;
+    line->skip_frame = chip->raster.skip_frame;
+}
+
+static void apply_line(vdc_t *chip, const vdc_render_line_t *line)
+{
+    memcpy(chip->regs, line->regs, sizeof(chip->regs));
+    chip->screen_text_cols = line->screen_text_cols;
+    chip->screen_adr = line->screen_adr;
+    chip->attribute_adr = line->attribute_adr;
+    chip->chargen_adr = line->chargen_adr;
+    chip->mem_counter = line->mem_counter;
+    chip->bitmap_counter = line->bitmap_counter;
+    chip->bytes_per_char = line->bytes_per_char;
+    chip->mem_counter_inc = line->mem_counter_inc;
+    chip->border_width = line->border_width;
+    chip->attribute_offset = line->attribute_offset;
+    chip->xsmooth = line->xsmooth;
+    chip->frame_counter = line->frame_counter;
+    chip->attribute_blink = line->attribute_blink;
+    chip->crsrpos = line->crsrpos;
+
+    chip->raster.video_mode = line->video_mode;
+    chip->raster.ycounter = line->ycounter;
+    chip->raster.display_ystart = line->display_ystart;
+    chip->raster.display_ystop = line->display_ystop;
+    chip->raster.border_color = line->border_color;
+    chip->raster.idle_background_color = line->idle_background_color;
+    chip->raster.xsmooth_color = line->xsmooth_color;
+    chip->raster.xsmooth = line->raster_xsmooth;
+    chip->raster.skip_frame = line->skip_frame;
+}
+
+/* ------------------------------------------------------------------------- */
+
+/* Called at the first line of a frame after the frame setup is done. */
+void vdc_render_start(void)
+{
+    if (vdc_render_active || !worker_ready
+        || !vdc.initialized) {
+        return;
+    }
+
+    /* The render core is idle so it has seen all there is to see of the
+       last copy. */
+    memcpy(&vdc_render, &vdc, offsetof(vdc_t, ram));
+    memcpy(vdc_render.ram, vdc.ram, vdc.vdc_address_mask + 1);
+
+    /* The copy now owns any pending repaint. */
+    vdc.raster.dont_cache = 0;
+
+    vdc_src = &vdc_render;
+    vdc_render_active = 1;
+}
+
+void vdc_render_join(void)
+{
+    if (!vdc_render_active) {
+        return;
+    }
+    while (queue_tail != queue_head) {
+        wfe();
+    }
+    dmb();
+}
+
+void vdc_render_stop(void)
+{
+    vdc_render_line_t line;
+    int dont_cache;
+
+    if (!vdc_render_active) {
+        return;
+    }
+
+    vdc_render_join();
+
+    /* Take back what drawing did to the raster (blanking, caching, draw
+       buffer position) but keep what the chip emulation changed since
+       the last line was queued. */
+    capture_line(&line, &vdc);
+    dont_cache = vdc.raster.dont_cache;
+    vdc.raster = vdc_render.raster;
+    apply_line(&vdc, &line);
+
+    /* A repaint asked for while drawing was offloaded. */
+    if (dont_cache) {
+        vdc.raster.dont_cache = 1;
+        vdc.raster.num_cached_lines = 0;
+    }
+
+    vdc_src = &vdc;
+    vdc_render_active = 0;
+}
+
+/* Queue the current line in place of raster_line_emulate(). */
+void vdc_render_line(void)
+{
+    unsigned int head = queue_head;
+
+    while (head - queue_tail == VDC_RENDER_QUEUE_SIZE) {
+        wfe();
+    }
+
+    capture_line(&queue[head & (VDC_RENDER_QUEUE_SIZE - 1)], &vdc);
+    /* The line must be visible before the new head. */
+    dmb();
+    queue_head = head + 1;
+    sev();
+
+    /* The alarm handler and register reads still look at the line
+       count. The render core's raster wraps at the same line. */
+    vdc.raster.current_line++;
+    if (vdc.raster.current_line == vdc.raster.geometry->screen_size.height) {
+        vdc.raster.current_line = 0;
+    }
+}
+
+/* Draw one queued line if there is one. Returns non-zero if it did. */
+int vdc_render_step(void)
+{
+    unsigned int tail = queue_tail;
+
+    if (!worker_ready) {
+        worker_ready = 1;
+    }
+
+    if (tail == queue_head) {
+        return 0;
+    }
+    dmb();
+
+    apply_line(&vdc_render, &queue[tail & (VDC_RENDER_QUEUE_SIZE - 1)]);
+    raster_line_emulate_unprofiled(&vdc_render.raster);
+
+    /* The line must be in the frame buffer before the main core sees
+       the new tail. */
+    dmb();
+    queue_tail = tail + 1;
+    sev();
+    return 1;
+}
+
+#endif
@@ -0,0 +1,64 @@
+/*
+ * vdc-render.h
+ *
+ * Written by
+ *  Randy Rossi <randy.rossi@gmail.com>
+ *
+ * This file is part of VICE, the Versatile Commodore Emulator.
+ * See README for copyright notice.
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+ *  02111-1307  USA.
+ *
+ */
+
+#ifndef VICE_VDC_RENDER_H
+#define VICE_VDC_RENDER_H
+
+/* BMC64: Draw the VDC raster on core 2 instead of inline on the emulation
+   core.
+
+   At the first raster line of every VDC frame, the chip (registers, VDC
+   RAM and raster state) is copied once. The raster alarm then keeps
+   running the VDC's counters on the emulation core but, instead of
+   drawing, queues the handful of values each line is drawn from. The
+   render core draws the lines from the copy as they come in.
+
+   Drawing reads VDC RAM as it was at the start of the frame. Everything
+   else is exact. The emulation core waits for the render core at every
+   vsync (before the frame is handed to the display) and at the start of
+   every VDC frame. Anything else that touches the VDC raster (reset,
+   screenshots, refresh changes) stops the offload until the next
+   frame. A repaint asked for while the offload is running is passed on
+   to the render core's raster at the next start. */
+
+#if defined(RASPI_COMPILE) && !defined(RASPI_LITE)
+#define VDC_RENDER_ASYNC
+
+/* Only changed on the main core while the render core is idle. */
+extern int vdc_render_active;
+
+/* Main core side. */
+extern void vdc_render_start(void);
+extern void vdc_render_stop(void);
+extern void vdc_render_line(void);
+extern void vdc_render_join(void);
+
+/* Render core side. */
+extern int vdc_render_step(void);
+
+#endif
+
+#endif
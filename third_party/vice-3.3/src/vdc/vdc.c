@@ -47,6 +47,7 @@
 #include "vdc-cmdline-options.h"
 #include "vdc-color.h"
 #include "vdc-draw.h"
+#include "vdc-render.h"
 #include "vdc-resources.h"
 #include "vdc-snapshot.h"
 #include "vdc.h"
@@ -313,6 +314,10 @@ static void vdc_update_geometry(void)
 /* Reset the VDC chip */
 void vdc_reset(void)
 {
+#ifdef VDC_RENDER_ASYNC
+    vdc_render_stop();
+#endif
+
     if (vdc.initialized) {
         raster_reset(&vdc.raster);
     }
@@ -470,6 +475,11 @@ static void vdc_raster_draw_alarm_handler(CLOCK offset, void *data)
     }
 
     if (vdc.raster.current_line == 0) { /* We are on the first raster line, so go reset and/or handle everything for a new frame */
+#ifdef VDC_RENDER_ASYNC
+        /* The frame setup below may change the raster. */
+        vdc_render_stop();
+#endif
+
         /* The top border position is based on the position of the vertical
            sync pulse [7] in relation to the total height of the screen [4]
            and the width of the sync pulse [3] */
@@ -600,6 +610,10 @@ static void vdc_raster_draw_alarm_handler(CLOCK offset, void *data)
             vdc.force_repaint = 0;
             raster_force_repaint(&vdc.raster);
         }
+
+#ifdef VDC_RENDER_ASYNC
+        vdc_render_start();
+#endif
     }
 
     /* If in_idle_state then we are not drawing anything on the current raster line */
@@ -614,7 +628,15 @@ static void vdc_raster_draw_alarm_handler(CLOCK offset, void *data)
     }
 
     /* actually draw the current raster line */
+#ifdef VDC_RENDER_ASYNC
+    if (vdc_render_active) {
+        vdc_render_line();
+    } else {
+        raster_line_emulate(&vdc.raster);
+    }
+#else
     raster_line_emulate(&vdc.raster);
+#endif
 
     /* see if we still should be drawing things - if we haven't drawn more than regs[6] rows since the top border */
     if (!in_idle_state) {
@@ -653,6 +675,9 @@ void vdc_calculate_xsync(void)
 
 void vdc_set_canvas_refresh(int enable)
 {
+#ifdef VDC_RENDER_ASYNC
+    vdc_render_stop();
+#endif
     raster_set_canvas_refresh(&vdc.raster, enable);
 }
 
@@ -668,6 +693,9 @@ int vdc_read_snapshot_module(snapshot_t *s)
 
 void vdc_screenshot(screenshot_t *screenshot)
 {
+#ifdef VDC_RENDER_ASYNC
+    vdc_render_stop();
+#endif
     raster_screenshot(&vdc.raster, screenshot);
     screenshot->chipid = "VDC";
     screenshot->video_regs = vdc.regs;
@@ -681,10 +709,16 @@ void vdc_screenshot(screenshot_t *screenshot)
 
 void vdc_async_refresh(struct canvas_refresh_s *refresh)
 {
+#ifdef VDC_RENDER_ASYNC
+    vdc_render_stop();
+#endif
     raster_async_refresh(&vdc.raster, refresh);
 }
 
 void vdc_shutdown(void)
 {
+#ifdef VDC_RENDER_ASYNC
+    vdc_render_stop();
+#endif
     raster_shutdown(&vdc.raster);
 }
@@ -67,6 +67,10 @@ int vsync_frame_counter;
 #include "vsync.h"
 #include "vsyncapi.h"
 
+#ifdef RASPI_COMPILE
+#include "profile.h"
+#endif
+
 /* ------------------------------------------------------------------------- */
 
 static int set_timer_speed(int speed);
@@ -408,7 +412,13 @@ int vsync_do_vsync(struct video_canvas_s *c, int been_skipped)
     }
 
     /* Flush sound buffer, get delay in seconds. */
+#ifdef RASPI_COMPILE
+    PROFILE_BEGIN(PROFILE_SOUND);
+#endif
     sound_delay = sound_flush();
+#ifdef RASPI_COMPILE
+    PROFILE_END(PROFILE_SOUND);
+#endif
 
     /* Get current time, directly after getting the sound delay. */
     now = vsyncarch_gettime();
@@ -0,0 +1,485 @@
+// Replays an alarm trace through the heap scheduler in alarm.[ch] and
+// through a copy of the linear scan it replaced, checking that both
+// agree on when the next alarm is due and comparing their speed.
+//
+// A trace is one operation per line, as written by alarm_trace() when
+// VICE is built with -DALARM_TRACE:
+//   n <id> <ctx>   alarm_new in the alarm context named ctx
+//   s <id> <clk>   alarm_set
+//   u <id>         alarm_unset
+//   d <id> <clk>   dispatch of the alarm due at clk
+// Each context (the main CPU and every true drive) has its own clock and
+// is replayed into its own scheduler. record_trace.sh records one from a
+// disk load. Without a trace file, synthetic traces modelled on a C64
+// with a busy cartridge and drive are generated instead.
+//
+// Usage: alarm_bench [trace-file] [iterations]
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "vice.h"
+#include "alarm.h"
+#include "lib.h"
+#include "log.h"
+
+#define MAX_ALARMS ALARM_CONTEXT_MAX_PENDING_ALARMS
+#define MAX_CONTEXTS 8
+
+// Stand-ins for the VICE functions alarm.c uses.
+void *lib_malloc(size_t size) {
+   return malloc(size);
+}
+
+void lib_free(const void *ptr) {
+   free((void *)ptr);
+}
+
+char *lib_stralloc(const char *str) {
+   return strcpy((char *)malloc(strlen(str) + 1), str);
+}
+
+int log_error(log_t log, const char *format, ...) {
+   va_list ap;
+   va_start(ap, format);
+   vprintf(format, ap);
+   va_end(ap);
+   printf("\n");
+   return 0;
+}
+
+static double now(void) {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// ---------------------------------------------------------------------
+// The unsorted pending array with a linear scan for the next alarm, as
+// alarm.[ch] did it before.
+
+typedef struct {
+   int pending_idx;
+} ref_alarm_t;
+
+typedef struct {
+   struct {
+      ref_alarm_t *alarm;
+      CLOCK clk;
+   } pending_alarms[MAX_ALARMS];
+   unsigned int num_pending_alarms;
+   CLOCK next_pending_alarm_clk;
+   int next_pending_alarm_idx;
+} ref_context_t;
+
+static void ref_update_next_pending(ref_context_t *context) {
+   CLOCK next_pending_alarm_clk = (CLOCK)~0L;
+   unsigned int next_pending_alarm_idx = 0;
+   unsigned int i;
+
+   for (i = 0; i < context->num_pending_alarms; i++) {
+      CLOCK pending_clk = context->pending_alarms[i].clk;
+      if (pending_clk <= next_pending_alarm_clk) {
+         next_pending_alarm_clk = pending_clk;
+         next_pending_alarm_idx = i;
+      }
+   }
+
+   context->next_pending_alarm_clk = next_pending_alarm_clk;
+   context->next_pending_alarm_idx = next_pending_alarm_idx;
+}
+
+static void ref_set(ref_context_t *context, ref_alarm_t *alarm, CLOCK clk) {
+   int idx = alarm->pending_idx;
+
+   if (idx < 0) {
+      unsigned int new_idx = context->num_pending_alarms;
+      context->num_pending_alarms++;
+      context->pending_alarms[new_idx].alarm = alarm;
+      context->pending_alarms[new_idx].clk = clk;
+      alarm->pending_idx = new_idx;
+      if (clk < context->next_pending_alarm_clk) {
+         context->next_pending_alarm_clk = clk;
+         context->next_pending_alarm_idx = new_idx;
+      }
+   } else {
+      context->pending_alarms[idx].clk = clk;
+      if (context->next_pending_alarm_clk > clk
+          || idx == context->next_pending_alarm_idx) {
+         ref_update_next_pending(context);
+      }
+   }
+}
+
+static void ref_unset(ref_context_t *context, ref_alarm_t *alarm) {
+   int idx = alarm->pending_idx;
+
+   if (idx < 0) {
+      return;
+   }
+
+   if (context->num_pending_alarms > 1) {
+      int last = --context->num_pending_alarms;
+      if (last != idx) {
+         context->pending_alarms[idx].alarm
+            = context->pending_alarms[last].alarm;
+         context->pending_alarms[idx].clk
+            = context->pending_alarms[last].clk;
+         context->pending_alarms[idx].alarm->pending_idx = idx;
+      }
+      if (context->next_pending_alarm_idx == idx) {
+         ref_update_next_pending(context);
+      } else if (context->next_pending_alarm_idx == last) {
+         context->next_pending_alarm_idx = idx;
+      }
+   } else {
+      context->num_pending_alarms = 0;
+      context->next_pending_alarm_clk = (CLOCK)~0L;
+      context->next_pending_alarm_idx = -1;
+   }
+
+   alarm->pending_idx = -1;
+}
+
+// ---------------------------------------------------------------------
+// Traces.
+
+typedef struct {
+   char op;
+   int id;
+   CLOCK clk;
+} trace_op_t;
+
+typedef struct {
+   trace_op_t *ops;
+   int num_ops;
+   int max_ops;
+   int num_alarms;
+   // The context of each alarm, 0 unless the trace said otherwise.
+   int *alarm_context;
+   int max_alarms;
+   int num_contexts;
+   char context_names[MAX_CONTEXTS][32];
+} trace_t;
+
+static void trace_grow_alarms(trace_t *trace, int id) {
+   if (id >= trace->max_alarms) {
+      int old_max = trace->max_alarms;
+      trace->max_alarms = id + 64;
+      trace->alarm_context = (int *)realloc(trace->alarm_context,
+                                            trace->max_alarms * sizeof(int));
+      memset(trace->alarm_context + old_max, 0,
+             (trace->max_alarms - old_max) * sizeof(int));
+   }
+   if (id >= trace->num_alarms) {
+      trace->num_alarms = id + 1;
+   }
+}
+
+static int trace_context(trace_t *trace, const char *name) {
+   int i;
+
+   for (i = 0; i < trace->num_contexts; i++) {
+      if (!strcmp(trace->context_names[i], name)) {
+         return i;
+      }
+   }
+   if (trace->num_contexts == MAX_CONTEXTS) {
+      return 0;
+   }
+   snprintf(trace->context_names[i], sizeof(trace->context_names[i]), "%s",
+            name);
+   return trace->num_contexts++;
+}
+
+static void trace_add(trace_t *trace, char op, int id, CLOCK clk) {
+   if (trace->num_ops == trace->max_ops) {
+      trace->max_ops = trace->max_ops ? trace->max_ops * 2 : 4096;
+      trace->ops = (trace_op_t *)realloc(trace->ops,
+                                         trace->max_ops * sizeof(trace_op_t));
+   }
+   trace->ops[trace->num_ops].op = op;
+   trace->ops[trace->num_ops].id = id;
+   trace->ops[trace->num_ops].clk = clk;
+   trace->num_ops++;
+   trace_grow_alarms(trace, id);
+}
+
+static int trace_load(trace_t *trace, const char *path) {
+   FILE *fp = fopen(path, "r");
+   char line[64];
+   char name[32];
+   char op;
+   int id;
+   unsigned long clk;
+
+   if (fp == NULL) {
+      printf("can't open %s\n", path);
+      return -1;
+   }
+   trace->num_contexts = 0;
+   while (fgets(line, sizeof(line), fp)) {
+      if (sscanf(line, "n %d %31s", &id, name) == 2 && id >= 0) {
+         trace_grow_alarms(trace, id);
+         trace->alarm_context[id] = trace_context(trace, name);
+         continue;
+      }
+      clk = 0;
+      if (sscanf(line, "%c %d %lu", &op, &id, &clk) < 2 || id < 0
+          || (op != 's' && op != 'u' && op != 'd')) {
+         continue;
+      }
+      trace_add(trace, op, id, (CLOCK)clk);
+   }
+   fclose(fp);
+   return 0;
+}
+
+// Alarms of a synthetic machine. Each one fires every period cycles
+// give or take jitter and is sometimes rescheduled early or turned off
+// by the CPU, like a CIA timer being rewritten.
+typedef struct {
+   CLOCK period;
+   CLOCK jitter;
+   int pending;
+   CLOCK clk;
+} synth_alarm_t;
+
+static unsigned int synth_rand(unsigned int *seed) {
+   *seed = *seed * 1103515245u + 12345u;
+   return (*seed >> 16) & 0x7fff;
+}
+
+static void synth_trace(trace_t *trace, int num_alarms, int num_ops) {
+   // Raster, CIA timers, drive sync, datasette, then cartridge, RS232
+   // and expansion port alarms with longer periods.
+   static const CLOCK periods[] = { 63, 19656, 985, 1200, 4096, 300, 2200,
+                                    63 * 8, 9852, 70000 };
+   synth_alarm_t *alarms = (synth_alarm_t *)calloc(num_alarms,
+                                                   sizeof(synth_alarm_t));
+   unsigned int seed = 6510;
+   CLOCK clk = 0;
+   int i;
+
+   for (i = 0; i < num_alarms; i++) {
+      alarms[i].period = periods[i % 10] + (CLOCK)(i / 10) * 37;
+      alarms[i].jitter = alarms[i].period / 4 + 1;
+      // Start with about three quarters of them armed.
+      if (i % 4 != 3) {
+         alarms[i].pending = 1;
+         alarms[i].clk = 1 + synth_rand(&seed) % alarms[i].period;
+         trace_add(trace, 's', i, alarms[i].clk);
+      }
+   }
+
+   while (trace->num_ops < num_ops) {
+      int next = -1;
+      CLOCK cpu_clk;
+
+      // The CPU runs a few instructions and pokes at an alarm.
+      cpu_clk = clk + 20 + synth_rand(&seed) % 200;
+      for (i = 0; i < num_alarms; i++) {
+         if (alarms[i].pending
+             && (next < 0 || alarms[i].clk < alarms[next].clk)) {
+            next = i;
+         }
+      }
+      if (next >= 0 && alarms[next].clk <= cpu_clk) {
+         synth_alarm_t *a = &alarms[next];
+         clk = a->clk;
+         trace_add(trace, 'd', next, clk);
+         if (synth_rand(&seed) % 16 == 0) {
+            a->pending = 0;
+            trace_add(trace, 'u', next, 0);
+         } else {
+            a->clk = clk + a->period - a->jitter / 2
+                     + synth_rand(&seed) % a->jitter;
+            trace_add(trace, 's', next, a->clk);
+         }
+         continue;
+      }
+
+      clk = cpu_clk;
+      i = synth_rand(&seed) % num_alarms;
+      if (alarms[i].pending && synth_rand(&seed) % 4 == 0) {
+         alarms[i].pending = 0;
+         trace_add(trace, 'u', i, 0);
+      } else {
+         alarms[i].pending = 1;
+         alarms[i].clk = clk + 1 + synth_rand(&seed) % alarms[i].period;
+         trace_add(trace, 's', i, alarms[i].clk);
+      }
+   }
+
+   free(alarms);
+}
+
+// ---------------------------------------------------------------------
+// Replay. A 'd' is checked against the scheduler's idea of the next
+// clock; which of several alarms due at the same clock comes first is
+// left to the scheduler. The callbacks do nothing since the sets and
+// unsets they made are in the trace.
+
+static void nop_callback(CLOCK offset, void *data) {
+}
+
+static int replay_ref(const trace_t *trace) {
+   ref_context_t *contexts = (ref_context_t *)calloc(trace->num_contexts,
+                                                     sizeof(ref_context_t));
+   ref_alarm_t *alarms = (ref_alarm_t *)malloc(trace->num_alarms
+                                               * sizeof(ref_alarm_t));
+   int mismatches = 0;
+   int i;
+
+   for (i = 0; i < trace->num_contexts; i++) {
+      contexts[i].next_pending_alarm_clk = (CLOCK)~0L;
+      contexts[i].next_pending_alarm_idx = -1;
+   }
+   for (i = 0; i < trace->num_alarms; i++) {
+      alarms[i].pending_idx = -1;
+   }
+
+   for (i = 0; i < trace->num_ops; i++) {
+      const trace_op_t *op = &trace->ops[i];
+      ref_context_t *context = &contexts[trace->alarm_context[op->id]];
+      switch (op->op) {
+         case 's':
+            ref_set(context, &alarms[op->id], op->clk);
+            break;
+         case 'u':
+            ref_unset(context, &alarms[op->id]);
+            break;
+         default:
+            if (context->next_pending_alarm_clk != op->clk) {
+               mismatches++;
+            }
+            break;
+      }
+   }
+
+   free(alarms);
+   free(contexts);
+   return mismatches;
+}
+
+static int replay_heap(const trace_t *trace) {
+   alarm_context_t *contexts[MAX_CONTEXTS];
+   alarm_t **alarms = (alarm_t **)malloc(trace->num_alarms
+                                         * sizeof(alarm_t *));
+   int mismatches = 0;
+   int i;
+
+   for (i = 0; i < trace->num_contexts; i++) {
+      contexts[i] = alarm_context_new("bench");
+   }
+   for (i = 0; i < trace->num_alarms; i++) {
+      alarms[i] = alarm_new(contexts[trace->alarm_context[i]], "bench",
+                            nop_callback, NULL);
+   }
+
+   for (i = 0; i < trace->num_ops; i++) {
+      const trace_op_t *op = &trace->ops[i];
+      alarm_context_t *context = contexts[trace->alarm_context[op->id]];
+      switch (op->op) {
+         case 's':
+            alarm_set(alarms[op->id], op->clk);
+            break;
+         case 'u':
+            alarm_unset(alarms[op->id]);
+            break;
+         default:
+            if (context->next_pending_alarm_clk != op->clk) {
+               mismatches++;
+            }
+            if (context->num_pending_alarms > 0) {
+               alarm_context_dispatch(context, op->clk);
+            }
+            break;
+      }
+   }
+
+   for (i = 0; i < trace->num_contexts; i++) {
+      alarm_context_destroy(contexts[i]);
+   }
+   free(alarms);
+   return mismatches;
+}
+
+static int bench(const char *name, const trace_t *trace, int iterations) {
+   int failed = 0;
+   int mismatches;
+   double t0, t1, t2;
+   int i;
+
+   if (trace->num_alarms > MAX_ALARMS) {
+      printf("%s: more than %d alarms\n", name, MAX_ALARMS);
+      return 1;
+   }
+
+   if ((mismatches = replay_ref(trace))) {
+      printf("%s: linear scan disagrees with the trace %d times\n",
+             name, mismatches);
+      failed = 1;
+   }
+   if ((mismatches = replay_heap(trace))) {
+      printf("MISMATCH %s: heap disagrees with the trace %d times\n",
+             name, mismatches);
+      failed = 1;
+   }
+
+   t0 = now();
+   for (i = 0; i < iterations; i++) {
+      replay_ref(trace);
+   }
+   t1 = now();
+   for (i = 0; i < iterations; i++) {
+      replay_heap(trace);
+   }
+   t2 = now();
+
+   printf("%-20s alarms %3d ctx %d  linear %6.1f ns/op  heap %6.1f ns/op  "
+          "speedup %.2fx\n", name, trace->num_alarms, trace->num_contexts,
+          (t1 - t0) * 1e9 / iterations / trace->num_ops,
+          (t2 - t1) * 1e9 / iterations / trace->num_ops,
+          (t1 - t0) / (t2 - t1));
+   return failed;
+}
+
+int main(int argc, char *argv[]) {
+   trace_t trace;
+   int failed = 0;
+
+   memset(&trace, 0, sizeof(trace));
+
+   if (argc > 1) {
+      int iterations = argc > 2 ? atoi(argv[2]) : 10;
+      if (trace_load(&trace, argv[1])) {
+         return 1;
+      }
+      failed |= bench(argv[1], &trace, iterations);
+      free(trace.ops);
+      free(trace.alarm_context);
+      return failed;
+   }
+
+   // A stock C64 keeps around 10 alarms pending on the main CPU; carts,
+   // true drive emulation and the userport devices add to that.
+   {
+      static const int sizes[] = { 8, 16, 32, 64, 128 };
+      int i;
+      for (i = 0; i < 5; i++) {
+         trace.num_ops = 0;
+         trace.num_alarms = 0;
+         trace.num_contexts = 1;
+         synth_trace(&trace, sizes[i], 2000000);
+         failed |= bench("synthetic", &trace, 5);
+      }
+   }
+
+   free(trace.ops);
+   free(trace.alarm_context);
+   return failed;
+}
@@ -0,0 +1,9 @@
+/* Just enough of VICE's configure output to build alarm.c on the host. */
+#define HAVE_STDINT_H 1
+#define HAVE_INTTYPES_H 1
+#define HAVE_STRING_H 1
+#define HAVE_STDLIB_H 1
+#define HAVE_UNISTD_H 1
+#define SIZEOF_UNSIGNED_INT 4
+#define SIZEOF_UNSIGNED_SHORT 2
+#define SIZEOF_INT 4
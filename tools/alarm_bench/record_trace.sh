@@ -0,0 +1,97 @@
+#!/bin/bash
+
+# Records an alarm trace from a real workload and replays it through
+# alarm_bench. The workload is host_x64 (see tools/host_x64) with true
+# drive emulation loading a 64 block program from a D64, then running
+# it. The disk is generated here so the trace can be recorded again on
+# any machine:
+#   ./record_trace.sh [frames]
+# leaves disk-load.trace in this directory.
+
+set -e
+
+FRAMES=${1:-3000}
+BENCH_DIR=`pwd`
+HOST_DIR="$BENCH_DIR/../host_x64"
+TRACE="$BENCH_DIR/disk-load.trace"
+
+make
+make -C "$HOST_DIR" ALARM_TRACE=1
+
+cd "$HOST_DIR"
+
+# A BASIC stub that SYSes into a loop poking the screen, border and SID,
+# padded to 64 blocks, as the only file on an otherwise empty disk.
+python3 - trace.d64 <<'EOF'
+import sys
+
+code = bytes([
+    0x78,                          # sei
+    0xa9, 0x0f, 0x8d, 0x18, 0xd4,  # lda #$0f, sta $d418
+    0xa9, 0x21, 0x8d, 0x04, 0xd4,  # lda #$21, sta $d404
+    0xa2, 0x00,                    # loop: ldx #0
+    0x8a,                          # fill: txa
+    0x6d, 0x12, 0xd0,              # adc $d012
+    0x9d, 0x00, 0x04,              # sta $0400,x
+    0x9d, 0x00, 0xd8,              # sta $d800,x
+    0xe8,                          # inx
+    0xd0, 0xf3,                    # bne fill
+    0x8d, 0x20, 0xd0,              # sta $d020
+    0x8d, 0x01, 0xd4,              # sta $d401
+    0x4c, 0x18, 0x08,              # jmp loop
+])
+stub = bytes([0x0b, 0x08, 0x0a, 0x00, 0x9e]) + b"2061" + bytes([0, 0, 0])
+prg = bytearray(bytes([0x01, 0x08]) + stub + code)
+seed = 1541
+while len(prg) < 64 * 254:
+    seed = (seed * 1103515245 + 12345) & 0x7fffffff
+    prg.append(seed >> 16 & 0xff)
+
+sectors = [21] * 17 + [19] * 7 + [18] * 6 + [17] * 5
+image = bytearray(sum(sectors) * 256)
+
+def offset(track, sector):
+    return (sum(sectors[:track - 1]) + sector) * 256
+
+# The file's blocks, on tracks 1 to 4.
+blocks = [(t, s) for t in range(1, 5) for s in range(sectors[t - 1])]
+blocks = blocks[:(len(prg) + 253) // 254]
+for i, (t, s) in enumerate(blocks):
+    chunk = prg[i * 254:(i + 1) * 254]
+    o = offset(t, s)
+    if i + 1 < len(blocks):
+        image[o], image[o + 1] = blocks[i + 1]
+    else:
+        image[o], image[o + 1] = 0, len(chunk) + 1
+    image[o + 2:o + 2 + len(chunk)] = chunk
+
+bam = offset(18, 0)
+image[bam:bam + 3] = bytes([18, 1, 0x41])
+for t in range(1, 36):
+    free = set(range(sectors[t - 1]))
+    if t == 18:
+        free -= {0, 1}
+    free -= {s for (bt, s) in blocks if bt == t}
+    bits = sum(1 << s for s in free)
+    e = bam + 4 * t
+    image[e:e + 4] = bytes([len(free), bits & 0xff, bits >> 8 & 0xff,
+                            bits >> 16 & 0xff])
+image[bam + 0x90:bam + 0xab] = (b"TRACE".ljust(16, b"\xa0") + b"\xa0\xa0"
+                                + b"01\xa02A\xa0\xa0\xa0\xa0")
+
+d = offset(18, 1)
+image[d:d + 2] = bytes([0, 0xff])
+image[d + 2:d + 5] = bytes([0x82, blocks[0][0], blocks[0][1]])
+image[d + 5:d + 21] = b"LOADER".ljust(16, b"\xa0")
+image[d + 30:d + 32] = bytes([len(blocks) & 0xff, len(blocks) >> 8])
+
+open(sys.argv[1], "wb").write(image)
+EOF
+
+rm -f alarm-trace.txt
+./host_x64-trace -frames "$FRAMES" trace.d64
+mv alarm-trace.txt "$TRACE"
+rm -f trace.d64
+
+cd "$BENCH_DIR"
+./alarm_bench "$TRACE"
@@ -0,0 +1,117 @@
+// Compares the kernels in blit.h against their reference loops for
+// exactness and speed. The frame is the size of a PAL VIC-II draw
+// buffer with the visible region used by the default C64 src rect.
+//
+// Usage: blit_bench [iterations]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "blit.h"
+
+#define FB_WIDTH 416
+#define FB_HEIGHT 312
+#define SRC_X 16
+#define SRC_Y 16
+#define SRC_W 384
+#define SRC_H 272
+
+static double now(void) {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Fills the frame with runs of colors below ncolors, like a real screen.
+static void fill_frame(uint8_t *fb, int ncolors) {
+   int i = 0;
+   while (i < FB_WIDTH * FB_HEIGHT) {
+      int run = 1 + (rand() & 15);
+      uint8_t c = (uint8_t)(rand() % ncolors);
+      for (; run > 0 && i < FB_WIDTH * FB_HEIGHT; run--) {
+         fb[i++] = c;
+      }
+   }
+}
+
+static void crop_expand_scalar(uint16_t *dst, const uint8_t *fb,
+                               const uint16_t *pal) {
+   for (int y = 0; y < SRC_H; y++) {
+      blit_expand_565_scalar(dst + y * SRC_W,
+                             fb + (SRC_Y + y) * FB_WIDTH + SRC_X, pal, SRC_W);
+   }
+}
+
+static int bench_expand(int ncolors, int iterations, const uint16_t *pal) {
+   uint8_t *fb = (uint8_t*) malloc(FB_WIDTH * FB_HEIGHT);
+   uint16_t *a = (uint16_t*) malloc(SRC_W * SRC_H * sizeof(uint16_t));
+   uint16_t *b = (uint16_t*) malloc(SRC_W * SRC_H * sizeof(uint16_t));
+   const uint8_t *src = fb + SRC_Y * FB_WIDTH + SRC_X;
+   int failed = 0;
+
+   fill_frame(fb, ncolors);
+
+   crop_expand_scalar(a, fb, pal);
+   blit_crop_expand_565(b, SRC_W, src, FB_WIDTH, pal, SRC_W, SRC_H);
+   if (memcmp(a, b, SRC_W * SRC_H * sizeof(uint16_t))) {
+      printf ("MISMATCH expand colors=%d\n", ncolors);
+      failed = 1;
+   }
+
+   // Odd widths exercise the tails.
+   for (int w = 1; w < 80; w++) {
+      memset(a, 0, w * sizeof(uint16_t));
+      memset(b, 0, w * sizeof(uint16_t));
+      blit_expand_565_scalar(a, src + w, pal, w);
+      blit_expand_565(b, src + w, pal, w);
+      if (memcmp(a, b, w * sizeof(uint16_t))) {
+         printf ("MISMATCH expand colors=%d w=%d\n", ncolors, w);
+         failed = 1;
+         break;
+      }
+   }
+
+   double t0 = now();
+   for (int i = 0; i < iterations; i++) {
+      crop_expand_scalar(a, fb, pal);
+   }
+   double t1 = now();
+   for (int i = 0; i < iterations; i++) {
+      blit_crop_expand_565(b, SRC_W, src, FB_WIDTH, pal, SRC_W, SRC_H);
+   }
+   double t2 = now();
+
+   printf ("crop_expand colors=%3d scalar %8.1f us  kernel %8.1f us  "
+           "speedup %.2fx\n", ncolors,
+           (t1 - t0) * 1e6 / iterations, (t2 - t1) * 1e6 / iterations,
+           (t1 - t0) / (t2 - t1));
+
+   free(fb);
+   free(a);
+   free(b);
+   return failed;
+}
+
+int main(int argc, char *argv[]) {
+   int iterations = argc > 1 ? atoi(argv[1]) : 2000;
+   uint16_t pal[256];
+   int failed = 0;
+
+   srand(64);
+   for (int i = 0; i < 256; i++) {
+      pal[i] = (uint16_t)(rand() & 0xffff);
+   }
+
+#ifdef BLIT_NEON
+   printf ("NEON kernels\n");
+#else
+   printf ("portable kernels\n");
+#endif
+
+   // 16 colors is every VICE machine but the Plus/4 (128).
+   failed |= bench_expand(16, iterations, pal);
+   failed |= bench_expand(128, iterations, pal);
+   return failed;
+}
@@ -0,0 +1,429 @@
+// Runs VICE's main CPU loop (maincpu.c and 6510core.c) on the host for
+// a number of PAL frames as fast as it can and reports the throughput.
+//
+// The machine is 64K of flat RAM with a raster alarm every line and an
+// IRQ at the start of every frame. There is no video or sound: the
+// raster alarm only copies the current line of screen RAM into a null
+// draw buffer. Time spent in the alarm callbacks is reported apart from
+// the time spent in the CPU core.
+//
+// Without a file, a built-in loop of loads, stores, arithmetic and
+// subroutine calls is run. A PRG is loaded at its load address and
+// started there, or at the given hex address. It runs without ROMs, so
+// it must not call into the KERNAL or BASIC. Its IRQ handler, if any,
+// must be installed at $FFFE and acknowledge the IRQ by writing $D019.
+//
+// The RAM and the clock are checksummed at the end so builds
+// with different dispatch can be checked against each other.
+//
+// Usage: cpu_bench [frames] [file.prg [start]]
+
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "vice.h"
+#include "alarm.h"
+#include "interrupt.h"
+#include "lib.h"
+#include "log.h"
+#include "machine.h"
+#include "maincpu.h"
+#include "mem.h"
+#include "monitor.h"
+#include "snapshot.h"
+#include "traps.h"
+
+#define CYCLES_PER_LINE 63
+#define LINES_PER_FRAME 312
+#define CYCLES_PER_SEC 985248
+#define SCREEN_COLS 40
+
+// The built-in workload, at $1000. Its IRQ handler counts frames at $FE.
+static const uint8_t builtin_code[] = {
+   0x58,             // 1000 CLI
+   0xa0, 0x00,       // 1001 LDY #$00
+   0xa9, 0x00,       // 1003 LDA #$00
+   0x85, 0xfb,       // 1005 STA $FB
+   0xa9, 0x20,       // 1007 LDA #$20
+   0x85, 0xfc,       // 1009 STA $FC
+   0xa2, 0x00,       // 100B LDX #$00
+   0xbd, 0x00, 0x20, // 100D LDA $2000,X
+   0x7d, 0x00, 0x21, // 1010 ADC $2100,X
+   0x9d, 0x00, 0x22, // 1013 STA $2200,X
+   0x51, 0xfb,       // 1016 EOR ($FB),Y
+   0x2a,             // 1018 ROL A
+   0x9d, 0x00, 0x21, // 1019 STA $2100,X
+   0xc8,             // 101C INY
+   0xe8,             // 101D INX
+   0xd0, 0xed,       // 101E BNE $100D
+   0x20, 0x28, 0x10, // 1020 JSR $1028
+   0xe6, 0xfd,       // 1023 INC $FD
+   0x4c, 0x0b, 0x10, // 1025 JMP $100B
+   0xa0, 0x08,       // 1028 LDY #$08
+   0x88,             // 102A DEY
+   0xd0, 0xfd,       // 102B BNE $102A
+   0x60,             // 102D RTS
+   0x48,             // 102E PHA
+   0xe6, 0xfe,       // 102F INC $FE
+   0x8d, 0x19, 0xd0, // 1031 STA $D019
+   0x68,             // 1034 PLA
+   0x40,             // 1035 RTI
+};
+#define BUILTIN_START 0x1000
+#define BUILTIN_IRQ 0x102e
+
+// Default IRQ handler for PRGs that don't install one.
+static const uint8_t default_irq_code[] = {
+   0x8d, 0x19, 0xd0, // FFF0 STA $D019
+   0x40,             // FFF3 RTI
+};
+#define DEFAULT_IRQ 0xfff0
+
+// Room for the 32 bit opcode fetch at the top of RAM.
+uint8_t mem_ram[0x10000 + 4];
+
+static read_func_ptr_t read_tab[0x101];
+static store_func_ptr_t write_tab[0x101];
+read_func_ptr_t *_mem_read_tab_ptr = read_tab;
+store_func_ptr_t *_mem_write_tab_ptr = write_tab;
+
+static alarm_t *raster_alarm;
+static alarm_t *frame_alarm;
+static unsigned int irq_num;
+static CLOCK raster_clk;
+static CLOCK frame_clk;
+static int raster_line;
+static int frames;
+static int frames_to_run;
+static uint8_t draw_buffer[LINES_PER_FRAME][SCREEN_COLS];
+static double alarm_time;
+static jmp_buf done;
+
+static double now(void) {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint8_t ram_read(uint16_t addr) {
+   return mem_ram[addr];
+}
+
+static void ram_store(uint16_t addr, uint8_t value) {
+   mem_ram[addr] = value;
+}
+
+static void io_store(uint16_t addr, uint8_t value) {
+   if (addr == 0xd019) {
+      interrupt_set_irq(maincpu_int_status, irq_num, 0, maincpu_clk);
+   }
+   mem_ram[addr] = value;
+}
+
+void mem_mmu_translate(unsigned int addr, uint8_t **base, int *start,
+                       int *limit) {
+   if (addr < 0xfffd) {
+      *base = mem_ram;
+      *start = 0;
+      *limit = 0xfffd;
+   } else {
+      *base = NULL;
+      *start = 0;
+      *limit = -1;
+   }
+}
+
+// Draws one line of screen RAM into the null draw buffer, like the
+// raster code does once per line.
+static void raster_alarm_handler(CLOCK offset, void *data) {
+   double t = now();
+   int row = raster_line >> 3;
+   if (row < 25) {
+      memcpy(draw_buffer[raster_line], mem_ram + 0x400 + row * SCREEN_COLS,
+             SCREEN_COLS);
+   }
+   raster_line = (raster_line + 1) % LINES_PER_FRAME;
+   raster_clk += CYCLES_PER_LINE;
+   alarm_set(raster_alarm, raster_clk);
+   alarm_time += now() - t;
+}
+
+static void frame_alarm_handler(CLOCK offset, void *data) {
+   double t = now();
+   frames++;
+   if (frames == frames_to_run) {
+      longjmp(done, 1);
+   }
+   interrupt_set_irq(maincpu_int_status, irq_num, IK_IRQ, maincpu_clk);
+   frame_clk += CYCLES_PER_LINE * LINES_PER_FRAME;
+   alarm_set(frame_alarm, frame_clk);
+   alarm_time += now() - t;
+}
+
+// Called from the CPU's reset, with the clock already reset.
+void machine_reset(void) {
+   raster_line = 0;
+   raster_clk = maincpu_clk + CYCLES_PER_LINE;
+   frame_clk = maincpu_clk + CYCLES_PER_LINE * LINES_PER_FRAME;
+   alarm_set(raster_alarm, raster_clk);
+   alarm_set(frame_alarm, frame_clk);
+}
+
+void machine_trigger_reset(const unsigned int mode) {
+   interrupt_trigger_reset(maincpu_int_status, maincpu_clk);
+}
+
+static int load_prg(const char *name, int start) {
+   FILE *fp = fopen(name, "rb");
+   if (fp == NULL) {
+      perror(name);
+      return -1;
+   }
+   int lo = fgetc(fp);
+   int hi = fgetc(fp);
+   if (hi == EOF) {
+      fclose(fp);
+      return -1;
+   }
+   int addr = lo | (hi << 8);
+   size_t len = fread(mem_ram + addr, 1, 0x10000 - addr, fp);
+   fclose(fp);
+   printf ("loaded %s at $%04X-$%04X\n", name, addr,
+           (unsigned int)(addr + len - 1));
+   return start >= 0 ? start : addr;
+}
+
+static uint32_t checksum(void) {
+   uint32_t sum = 2166136261u;
+   for (int i = 0; i < 0x10000; i++) {
+      sum = (sum ^ mem_ram[i]) * 16777619u;
+   }
+   sum = (sum ^ (uint32_t)maincpu_clk) * 16777619u;
+   return sum;
+}
+
+int main(int argc, char *argv[]) {
+   int start = BUILTIN_START;
+
+   frames_to_run = argc > 1 ? atoi(argv[1]) : 3000;
+   if (frames_to_run < 1) {
+      frames_to_run = 1;
+   }
+
+   for (int i = 0; i < 0x101; i++) {
+      read_tab[i] = ram_read;
+      write_tab[i] = ram_store;
+   }
+   write_tab[0xd0] = io_store;
+
+   memcpy(mem_ram + DEFAULT_IRQ, default_irq_code, sizeof(default_irq_code));
+   mem_ram[0xfffe] = DEFAULT_IRQ & 0xff;
+   mem_ram[0xffff] = DEFAULT_IRQ >> 8;
+   if (argc > 2) {
+      start = load_prg(argv[2], argc > 3 ? (int)strtol(argv[3], NULL, 16) : -1);
+      if (start < 0) {
+         return 1;
+      }
+   } else {
+      memcpy(mem_ram + BUILTIN_START, builtin_code, sizeof(builtin_code));
+      mem_ram[0xfffe] = BUILTIN_IRQ & 0xff;
+      mem_ram[0xffff] = BUILTIN_IRQ >> 8;
+   }
+   mem_ram[0xfffc] = start & 0xff;
+   mem_ram[0xfffd] = start >> 8;
+
+   maincpu_alarm_context = alarm_context_new("MainCPU");
+   maincpu_early_init();
+   maincpu_init();
+   irq_num = interrupt_cpu_status_int_new(maincpu_int_status, "Frame");
+   raster_alarm = alarm_new(maincpu_alarm_context, "Raster",
+                            raster_alarm_handler, NULL);
+   frame_alarm = alarm_new(maincpu_alarm_context, "Frame",
+                           frame_alarm_handler, NULL);
+
+#ifdef CPU_THREADED_DISPATCH
+   printf ("threaded dispatch\n");
+#else
+   printf ("switch dispatch\n");
+#endif
+
+   double t0 = now();
+   if (!setjmp(done)) {
+      maincpu_mainloop();
+   }
+   double total = now() - t0;
+
+   double cpu = total - alarm_time;
+   double emulated = (double)maincpu_clk / CYCLES_PER_SEC;
+   printf ("frames %d  cycles %lu\n", frames, (unsigned long)maincpu_clk);
+   printf ("total %.3f s  cpu %.3f s  alarms %.3f s\n", total, cpu,
+           alarm_time);
+   printf ("%.1f Mcycles/s  %.0f frames/s  %.1fx real time\n",
+           maincpu_clk / total / 1e6, frames / total, emulated / total);
+   printf ("checksum %08x\n", checksum());
+   return 0;
+}
+
+// ---------------------------------------------------------------------
+// Stand-ins for the rest of VICE. None of these are reached unless the
+// program jams or a monitor, trap or snapshot is requested.
+
+void *lib_malloc(size_t size) {
+   return malloc(size);
+}
+
+void *lib_calloc(size_t nmemb, size_t size) {
+   return calloc(nmemb, size);
+}
+
+void *lib_realloc(void *p, size_t size) {
+   return realloc(p, size);
+}
+
+void lib_free(const void *ptr) {
+   free((void *)ptr);
+}
+
+char *lib_stralloc(const char *str) {
+   return strcpy((char *)malloc(strlen(str) + 1), str);
+}
+
+int log_error(log_t log, const char *format, ...) {
+   va_list ap;
+   va_start(ap, format);
+   vprintf(format, ap);
+   va_end(ap);
+   printf("\n");
+   return 0;
+}
+
+void archdep_vice_exit(int excode) {
+   exit(excode);
+}
+
+unsigned int machine_jam(const char *format, ...) {
+   va_list ap;
+   va_start(ap, format);
+   vprintf(format, ap);
+   va_end(ap);
+   printf("\n");
+   exit(1);
+}
+
+void machine_get_line_cycle(unsigned int *line, unsigned int *cycle,
+                            int *half_cycle) {
+   *line = raster_line;
+   *cycle = 0;
+   *half_cycle = -1;
+}
+
+void mem_powerup(void) {
+}
+
+int mem_rom_trap_allowed(uint16_t addr) {
+   return 0;
+}
+
+void mem_toggle_watchpoints(int flag, void *context) {
+}
+
+const char **mem_bank_list(void) {
+   return NULL;
+}
+
+int mem_bank_from_name(const char *name) {
+   return -1;
+}
+
+uint8_t mem_bank_read(int bank, uint16_t addr, void *context) {
+   return mem_ram[addr];
+}
+
+uint8_t mem_bank_peek(int bank, uint16_t addr, void *context) {
+   return mem_ram[addr];
+}
+
+void mem_bank_write(int bank, uint16_t addr, uint8_t byte, void *context) {
+   mem_ram[addr] = byte;
+}
+
+mem_ioreg_list_t *mem_ioreg_list_get(void *context) {
+   return NULL;
+}
+
+uint32_t traps_handler(void) {
+   return (uint32_t)-1;
+}
+
+unsigned monitor_mask[NUM_MEMSPACES];
+
+void monitor_startup(MEMSPACE mem) {
+}
+
+int monitor_force_import(MEMSPACE mem) {
+   return 0;
+}
+
+void monitor_check_icount(uint16_t a) {
+}
+
+void monitor_check_icount_interrupt(void) {
+}
+
+void monitor_check_watchpoints(unsigned int lastpc, unsigned int pc) {
+}
+
+int monitor_check_breakpoints(MEMSPACE mem, uint16_t addr) {
+   return 0;
+}
+
+snapshot_module_t *snapshot_module_create(snapshot_t *s, const char *name,
+                                          uint8_t major, uint8_t minor) {
+   return NULL;
+}
+
+snapshot_module_t *snapshot_module_open(snapshot_t *s, const char *name,
+                                        uint8_t *major, uint8_t *minor) {
+   return NULL;
+}
+
+int snapshot_module_close(snapshot_module_t *m) {
+   return -1;
+}
+
+int snapshot_module_read_byte(snapshot_module_t *m, uint8_t *b) {
+   return -1;
+}
+
+int snapshot_module_read_word(snapshot_module_t *m, uint16_t *w) {
+   return -1;
+}
+
+int snapshot_module_read_dword(snapshot_module_t *m, uint32_t *dw) {
+   return -1;
+}
+
+int snapshot_module_read_dword_into_int(snapshot_module_t *m, int *v) {
+   return -1;
+}
+
+int snapshot_module_read_dword_into_uint(snapshot_module_t *m,
+                                         unsigned int *v) {
+   return -1;
+}
+
+int snapshot_module_write_byte(snapshot_module_t *m, uint8_t data) {
+   return -1;
+}
+
+int snapshot_module_write_word(snapshot_module_t *m, uint16_t data) {
+   return -1;
+}
+
+int snapshot_module_write_dword(snapshot_module_t *m, uint32_t data) {
+   return -1;
+}
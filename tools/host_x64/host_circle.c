@@ -0,0 +1,285 @@
+// Stands in for the Circle kernel (kernel.cpp) on the host: everything
+// circle.h says VICE and third_party/common may call, less the userport
+// which vice_api.c has. The frame buffer layers are plain memory that
+// is never shown, sound is accepted and dropped, and ticks are the
+// host's monotonic clock in microseconds like the Pi's system timer.
+// There is no GPIO, USB or second core.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "circle.h"
+#include "crc32.h"
+#include "defs.h"
+#include "profile.h"
+#include "host_x64.h"
+
+// As in vicesound.h.
+#define FRAG_SIZE 256
+#define NUM_FRAGS 16
+
+#define NUM_LAYERS (FB_LAYER_UI + 1)
+
+struct host_fbl {
+  uint8_t *pixels;
+  int width;
+  int height;
+  int pitch;
+  int zlayer;
+};
+
+static struct host_fbl fbl[NUM_LAYERS];
+
+int raspi_userport_enabled;
+
+uint32_t host_frame_crc(void) {
+  struct host_fbl *l = &fbl[FB_LAYER_VIC];
+  if (l->pixels == NULL) {
+     return 0;
+  }
+  return crc32_buf((const char *)l->pixels, l->pitch * l->height);
+}
+
+int circle_get_machine_timing() {
+  return host_ntsc ? MACHINE_TIMING_NTSC_HDMI : MACHINE_TIMING_PAL_HDMI;
+}
+
+// Never wait. The host runs as fast as it can.
+void circle_sleep(long delay) {}
+
+unsigned long circle_get_ticks() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000UL + ts.tv_nsec / 1000;
+}
+
+// Called once a frame by the emulator.
+void circle_yield() {
+  host_frame();
+}
+
+void circle_check_gpio() {}
+
+void circle_reset_gpio(int gpio_config) {}
+
+int circle_alloc_fbl(int layer, int pixelmode, uint8_t **pixels,
+                     int width, int height, int *pitch) {
+  struct host_fbl *l = &fbl[layer];
+  // Indexed layers are a byte per pixel, the rest 32 bits.
+  int bpp = pixelmode == 0 ? 1 : 4;
+
+  free(l->pixels);
+  l->pixels = calloc(width * height, bpp);
+  if (l->pixels == NULL) {
+     return -1;
+  }
+  l->width = width;
+  l->height = height;
+  l->pitch = width * bpp;
+  *pixels = l->pixels;
+  *pitch = l->pitch;
+  return 0;
+}
+
+int circle_realloc_fbl(int layer, int shader) {
+  return 0;
+}
+
+void circle_free_fbl(int layer) {
+  free(fbl[layer].pixels);
+  memset(&fbl[layer], 0, sizeof(fbl[layer]));
+}
+
+void circle_clear_fbl(int layer) {
+  if (fbl[layer].pixels) {
+     memset(fbl[layer].pixels, 0, fbl[layer].pitch * fbl[layer].height);
+  }
+}
+
+void circle_show_fbl(int layer) {}
+
+void circle_hide_fbl(int layer) {}
+
+void circle_frames_ready_fbl(int layer1, int layer2, int sync) {
+  // Nothing to upload, but keep the section so the report lines up
+  // with the Pi's.
+  PROFILE_BEGIN(PROFILE_VIDEO);
+  PROFILE_END(PROFILE_VIDEO);
+}
+
+void circle_track_dirty_fbl(int layer, int enable) {}
+
+void circle_dirty_fbl(int layer, int y0, int y1) {}
+
+void circle_set_palette_fbl(int layer, uint8_t index, uint16_t rgb565) {}
+
+void circle_set_palette32_fbl(int layer, uint8_t index, uint32_t argb) {}
+
+void circle_update_palette_fbl(int layer) {}
+
+void circle_set_stretch_fbl(int layer, double hstretch, double vstretch,
+                            int hintstr, int vintstr, int use_hintstr,
+                            int use_vintstr) {}
+
+void circle_set_src_rect_fbl(int layer, int x, int y, int w, int h) {}
+
+void circle_set_center_offset(int layer, int cx, int cy) {}
+
+void circle_set_valign_fbl(int layer, int align, int padding) {}
+
+void circle_set_halign_fbl(int layer, int align, int padding) {}
+
+void circle_set_padding_fbl(int layer, double lpad, double rpad,
+                            double tpad, double bpad) {}
+
+void circle_set_zlayer_fbl(int layer, int zlayer) {
+  fbl[layer].zlayer = zlayer;
+}
+
+int circle_get_zlayer_fbl(int layer) {
+  return fbl[layer].zlayer;
+}
+
+void circle_lock_acquire() {}
+
+void circle_lock_release() {}
+
+void circle_boot_complete() {
+  host_boot_complete();
+}
+
+int circle_cycles_per_sec() {
+  // As ViceApp::CyclesPerSecond for HDMI timing.
+  return host_ntsc ? 1025700 : 982800;
+}
+
+void circle_find_usb(int (*usb)[3]) {
+  memset(usb, 0, sizeof(*usb));
+}
+
+int circle_mount_usb(int usb) {
+  return -1;
+}
+
+int circle_unmount_usb(int usb) {
+  return -1;
+}
+
+void circle_set_volume(int value) {}
+
+// Switching machines always reboots, which the host can't do.
+int circle_apply_options(const char *cmdline) {
+  return 0;
+}
+
+// Like a single core Pi, which is what the RASPI_LITE build is for.
+int circle_get_model() {
+  return 1;
+}
+
+// The profiler counts TSC ticks here, so report their rate.
+unsigned circle_get_arm_clock() {
+  static unsigned hz;
+
+  if (hz == 0) {
+     uint32_t c0 = profile_cycles();
+     unsigned long t0 = circle_get_ticks();
+     unsigned long us;
+     while ((us = circle_get_ticks() - t0) < 20000) {
+     }
+     hz = (unsigned)((uint64_t)(profile_cycles() - c0) * 1000000 / us);
+  }
+  return hz;
+}
+
+int circle_gpio_enabled() {
+  return 0;
+}
+
+int circle_gpio_outputs_enabled() {
+  return 0;
+}
+
+int circle_sound_init(const char *param, int *speed, int *fragsize,
+                      int *fragnr, int *channels) {
+  *speed = SAMPLE_RATE;
+  *fragsize = FRAG_SIZE;
+  *fragnr = NUM_FRAGS;
+  return 0;
+}
+
+int circle_sound_write(int16_t *pbuf, size_t nr) {
+  return 0;
+}
+
+void circle_sound_close(void) {}
+
+int circle_sound_suspend(void) {
+  return 0;
+}
+
+int circle_sound_resume(void) {
+  return 0;
+}
+
+// Always half full, so VICE neither drains the buffer nor waits for
+// room in it.
+int circle_sound_bufferspace(void) {
+  return FRAG_SIZE * NUM_FRAGS / 2;
+}
+
+void circle_sound_stats(unsigned *fill, unsigned *underruns,
+                        unsigned *overruns) {
+  *fill = 0;
+  *underruns = 0;
+  *overruns = 0;
+}
+
+void circle_kernel_core_init_complete(int core) {}
+
+void circle_get_fbl_dimensions(int layer,
+                               int *display_w, int *display_h,
+                               int *fb_w, int *fb_h,
+                               int *src_w, int *src_h,
+                               int *dst_w, int *dst_h) {
+  *display_w = 1920;
+  *display_h = 1080;
+  *fb_w = fbl[layer].width;
+  *fb_h = fbl[layer].height;
+  *src_w = fbl[layer].width;
+  *src_h = fbl[layer].height;
+  *dst_w = fbl[layer].width;
+  *dst_h = fbl[layer].height;
+}
+
+void circle_get_scaling_params(int display,
+                               int *fbw, int *fbh,
+                               int *sx, int *sy) {
+  *fbw = 0;
+  *fbh = 0;
+  *sx = 0;
+  *sy = 0;
+}
+
+void circle_set_interpolation(int enable) {}
+
+void circle_set_use_shader(int enable) {}
+
+void circle_set_shader_params(int curvature,
+                              float curvature_x,
+                              float curvature_y,
+                              int mask,
+                              float mask_brightness,
+                              int gamma,
+                              int fake_gamma,
+                              int scanlines,
+                              int multisample,
+                              float scanline_weight,
+                              float scanline_gap_brightness,
+                              float bloom_factor,
+                              float input_gamma,
+                              float output_gamma,
+                              int sharper,
+                              int bilinear_interpolation) {}
@@ -0,0 +1,82 @@
+// Puts the Pi's SD card on a host directory. On the Pi, the emulator
+// opens its files by absolute path on the FAT volume ("/C64/kernal",
+// "/settings.txt", "/instant-C64.vsf" ...). Here those go to the same
+// path under the root directory. Relative paths are left alone so
+// media can be given as on any command line.
+//
+// Each call is linked with -Wl,--wrap=<call>.
+
+#include <dirent.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "host_x64.h"
+
+static char root[PATH_MAX];
+
+int host_file_init(const char *dir) {
+  if (realpath(dir, root) == NULL) {
+     return -1;
+  }
+  // "/" is the root itself.
+  if (strcmp(root, "/") == 0) {
+     root[0] = '\0';
+  }
+  return 0;
+}
+
+static const char *host_path(const char *path, char *buf) {
+  if (path[0] != '/') {
+     return path;
+  }
+  snprintf(buf, PATH_MAX, "%s%s", root, path);
+  return buf;
+}
+
+FILE *__real_fopen(const char *path, const char *mode);
+DIR *__real_opendir(const char *path);
+int __real_stat(const char *path, struct stat *st);
+int __real_access(const char *path, int mode);
+int __real_remove(const char *path);
+int __real_rename(const char *from, const char *to);
+int __real_unlink(const char *path);
+
+FILE *__wrap_fopen(const char *path, const char *mode) {
+  char buf[PATH_MAX];
+  return __real_fopen(host_path(path, buf), mode);
+}
+
+DIR *__wrap_opendir(const char *path) {
+  char buf[PATH_MAX];
+  return __real_opendir(host_path(path, buf));
+}
+
+int __wrap_stat(const char *path, struct stat *st) {
+  char buf[PATH_MAX];
+  return __real_stat(host_path(path, buf), st);
+}
+
+int __wrap_access(const char *path, int mode) {
+  char buf[PATH_MAX];
+  return __real_access(host_path(path, buf), mode);
+}
+
+int __wrap_remove(const char *path) {
+  char buf[PATH_MAX];
+  return __real_remove(host_path(path, buf));
+}
+
+int __wrap_rename(const char *from, const char *to) {
+  char buf_from[PATH_MAX];
+  char buf_to[PATH_MAX];
+  return __real_rename(host_path(from, buf_from), host_path(to, buf_to));
+}
+
+int __wrap_unlink(const char *path) {
+  char buf[PATH_MAX];
+  return __real_unlink(host_path(path, buf));
+}
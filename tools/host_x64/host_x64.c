@@ -0,0 +1,190 @@
+// Runs the real x64 on the host: the same VICE objects and
+// third_party/common the C64 kernel links, built like the Pi Zero's
+// (RASPI_LITE, single core) with the host compiler. host_circle.c
+// stands in for the Circle kernel and host_file.c for the SD card.
+//
+// VICE is started the way ViceEmulatorCore::RunMainVice starts it and
+// runs unthrottled. Once boot is complete (see circle_boot_complete),
+// the profiler is switched on and the given number of frames is run.
+// Then the time spent per frame in each profiler section is printed:
+// raster (VIC-II line drawing), sound (SID), drive (true drive CPUs),
+// video and ui, with everything else (main CPU, CIAs, alarms) as emu.
+// The per frame history is left in profile.csv in the root directory.
+//
+// A CRC of the last frame drawn is printed so builds can be checked
+// against each other. The machine can be saved to a snapshot at the
+// end, to be autostarted by a later run.
+//
+// Usage: host_x64 [-root dir] [-frames n] [-ntsc] [-save file.vsf]
+//                 [file.prg|file.d64|file.vsf]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "vice.h"
+#include "machine.h"
+#include "main.h"
+
+#include "circle.h"
+#include "emux_api.h"
+#include "profile.h"
+#include "host_x64.h"
+
+#define CSV_FILE "/profile.csv"
+
+int host_ntsc;
+
+static int frames_to_run = 1000;
+static const char *save_name;
+
+static int booted;
+static int frames;
+static unsigned long start_ticks;
+
+static const char *section_names[] = {
+   "emu", "raster", "sound", "video", "ui", "drive", "vsync"
+};
+#define NUM_SECTIONS (sizeof(section_names) / sizeof(section_names[0]))
+
+// Averages the CSV profile_dump wrote. The first frame was only
+// partly profiled and is skipped.
+static void report_sections(double frame_us) {
+  FILE *fp = fopen(CSV_FILE, "r");
+  char line[256];
+  double sum[NUM_SECTIONS] = { 0 };
+  int rows = 0;
+
+  if (fp == NULL) {
+     printf("can't read %s\n", CSV_FILE);
+     return;
+  }
+
+  while (fgets(line, sizeof(line), fp)) {
+     unsigned col[NUM_SECTIONS + 2];
+     // frame_us, then the sections in the order of section_names.
+     if (sscanf(line, "%u,%u,%u,%u,%u,%u,%u,%u", &col[0], &col[1],
+                &col[2], &col[3], &col[4], &col[5], &col[6],
+                &col[7]) != 8) {
+        continue;
+     }
+     if (rows++ == 0) {
+        continue;
+     }
+     for (int s = 0; s < NUM_SECTIONS; s++) {
+        sum[s] += col[s + 1];
+     }
+  }
+  fclose(fp);
+  rows--;
+
+  if (rows <= 0) {
+     return;
+  }
+  for (int s = 0; s < NUM_SECTIONS; s++) {
+     double us = sum[s] / rows;
+     printf("%-7s %8.1f us/frame %5.1f%%\n", section_names[s], us,
+            us * 100 / frame_us);
+  }
+}
+
+static void report(void) {
+  unsigned long us = circle_get_ticks() - start_ticks;
+  double frame_us = (double)us / frames_to_run;
+  double real_fps = (double)machine_get_cycles_per_second() /
+     machine_get_cycles_per_frame();
+
+  printf("%d frames in %.3f s, %.1f fps, %.0f%% of real time\n",
+         frames_to_run, us / 1e6, 1e6 / frame_us,
+         1e6 / frame_us * 100 / real_fps);
+
+  if (profile_dump(CSV_FILE) == 0) {
+     report_sections(frame_us);
+  } else {
+     printf("can't write %s\n", CSV_FILE);
+  }
+
+  printf("frame crc %08x\n", host_frame_crc());
+}
+
+// Between instructions, as the menu saves from its pause trap.
+static void save_trap(uint16_t addr, void *data) {
+  if (emux_save_state((char *)save_name) < 0) {
+     printf("can't save %s\n", save_name);
+     exit(1);
+  }
+  printf("saved %s\n", save_name);
+  exit(0);
+}
+
+void host_boot_complete(void) {
+  booted = 1;
+}
+
+void host_frame(void) {
+  if (!booted) {
+     return;
+  }
+  if (frames == 0) {
+     profile_enable(1);
+     start_ticks = circle_get_ticks();
+  }
+  // Past the end, a save is waiting for its trap.
+  if (frames++ != frames_to_run) {
+     return;
+  }
+  report();
+  if (save_name == NULL) {
+     exit(0);
+  }
+  emux_trap_main_loop(save_trap, NULL);
+}
+
+static void usage(void) {
+  fprintf(stderr, "usage: host_x64 [-root dir] [-frames n] [-ntsc] "
+          "[-save file.vsf] [file]\n");
+  exit(1);
+}
+
+int main(int argc, char **argv) {
+  const char *root = "root";
+  const char *file = NULL;
+
+  for (int i = 1; i < argc; i++) {
+     if (strcmp(argv[i], "-root") == 0 && i + 1 < argc) {
+        root = argv[++i];
+     } else if (strcmp(argv[i], "-frames") == 0 && i + 1 < argc) {
+        frames_to_run = atoi(argv[++i]);
+     } else if (strcmp(argv[i], "-ntsc") == 0) {
+        host_ntsc = 1;
+     } else if (strcmp(argv[i], "-save") == 0 && i + 1 < argc) {
+        save_name = argv[++i];
+     } else if (argv[i][0] != '-' && file == NULL) {
+        file = argv[i];
+     } else {
+        usage();
+     }
+  }
+  if (frames_to_run <= 0) {
+     usage();
+  }
+
+  if (host_file_init(root) < 0) {
+     fprintf(stderr, "no root directory %s\n", root);
+     return 1;
+  }
+
+  // As ViceEmulatorCore::RunMainVice. Autostart isn't warped so every
+  // frame measured is drawn.
+  int vice_argc = 8;
+  char *vice_argv[] = {
+      "vice", host_ntsc ? "-ntsc" : "-pal", "-sounddev", "raspi",
+      "-soundsync", "0", "-refresh", "1",
+      "+autostart-warp", "-autostart", (char *)file, NULL};
+  if (file) {
+     vice_argc = 11;
+  }
+
+  emu_machine_init(0);
+  return main_program(vice_argc, vice_argv);
+}
@@ -0,0 +1,20 @@
+// Shared between the pieces of the host x64 build. See host_x64.c.
+
+#ifndef HOST_X64_H
+#define HOST_X64_H
+
+#include <stdint.h>
+
+extern int host_ntsc;
+
+// host_x64.c: called by the kernel stand in.
+void host_boot_complete(void);
+void host_frame(void);
+
+// host_circle.c
+uint32_t host_frame_crc(void);
+
+// host_file.c
+int host_file_init(const char *root);
+
+#endif
@@ -60,18 +60,18 @@ int ViceApp::circle_get_machine_timing() {
 }
 
 #if defined(RASPI_PLUS4) | defined(RASPI_PLUS4EMU)
-int ViceApp::circle_cycles_per_second() {
-  int timing = circle_get_machine_timing();
+int ViceApp::CyclesPerSecond(const ViceOptions &options) {
+  int timing = options.GetMachineTiming();
   if (timing == MACHINE_TIMING_NTSC_HDMI || timing == MACHINE_TIMING_NTSC_DPI) {
     // 60hz
     return 1792080;
-  } else if (circle_get_machine_timing() == MACHINE_TIMING_NTSC_COMPOSITE) {
+  } else if (timing == MACHINE_TIMING_NTSC_COMPOSITE) {
     // Actual C64's NTSC Composite frequency is 59.826 but the Pi's vertical
     // sync frequency on composite is 60.053. See c64.h for how this is
     // calculated. This keeps audio buffer to a minimum using ReSid.
     return 1793672;
   } else if (timing == MACHINE_TIMING_NTSC_CUSTOM_HDMI || timing == MACHINE_TIMING_NTSC_CUSTOM_DPI) {
-    return mViceOptions.GetCyclesPerSecond();
+    return options.GetCyclesPerSecond();
   } else if (timing == MACHINE_TIMING_PAL_HDMI) {
     // 50hz
     return 1778400;
@@ -81,14 +81,14 @@ int ViceApp::circle_cycles_per_second() {
     // calculated.  This keep audio buffer to a minimum using ReSid.
     return 1781245;
   } else if (timing == MACHINE_TIMING_PAL_CUSTOM_HDMI || timing == MACHINE_TIMING_PAL_CUSTOM_DPI) {
-    return mViceOptions.GetCyclesPerSecond();
+    return options.GetCyclesPerSecond();
   } else {
     return 1778400;
   }
 }
 #elif defined(RASPI_VIC20)
-int ViceApp::circle_cycles_per_second() {
-  int timing = circle_get_machine_timing();
+int ViceApp::CyclesPerSecond(const ViceOptions &options) {
+  int timing = options.GetMachineTiming();
   if (timing == MACHINE_TIMING_NTSC_HDMI) {
     // 60hz
     return 1017900;
@@ -98,7 +98,7 @@ int ViceApp::circle_cycles_per_second() {
     // calculated. This keeps audio buffer to a minimum using ReSid.
     return 1018804;
   } else if (timing == MACHINE_TIMING_NTSC_CUSTOM_HDMI || timing == MACHINE_TIMING_NTSC_CUSTOM_DPI) {
-    return mViceOptions.GetCyclesPerSecond();
+    return options.GetCyclesPerSecond();
   } else if (timing == MACHINE_TIMING_PAL_HDMI) {
     // 50hz
     return 1107600;
@@ -108,14 +108,14 @@ int ViceApp::circle_cycles_per_second() {
     // calculated.  This keep audio buffer to a minimum using ReSid.
     return 1109372;
   } else if (timing == MACHINE_TIMING_PAL_CUSTOM_HDMI || timing == MACHINE_TIMING_PAL_CUSTOM_DPI) {
-    return mViceOptions.GetCyclesPerSecond();
+    return options.GetCyclesPerSecond();
   } else {
     return 1017900;
   }
 }
 #elif defined(RASPI_C64) | defined(RASPI_C128)
-int ViceApp::circle_cycles_per_second() {
-  int timing = circle_get_machine_timing();
+int ViceApp::CyclesPerSecond(const ViceOptions &options) {
+  int timing = options.GetMachineTiming();
   if (timing == MACHINE_TIMING_NTSC_HDMI) {
     // 60hz
     return 1025700;
@@ -125,7 +125,7 @@ int ViceApp::circle_cycles_per_second() {
     // calculated. This keeps audio buffer to a minimum using ReSid.
     return 1026611;
   } else if (timing == MACHINE_TIMING_NTSC_CUSTOM_HDMI || timing == MACHINE_TIMING_NTSC_CUSTOM_DPI) {
-    return mViceOptions.GetCyclesPerSecond();
+    return options.GetCyclesPerSecond();
   } else if (timing == MACHINE_TIMING_PAL_HDMI) {
     // 50hz
     return 982800;
@@ -135,14 +135,14 @@ int ViceApp::circle_cycles_per_second() {
     // calculated.  This keep audio buffer to a minimum using ReSid.
     return 984404;
   } else if (timing == MACHINE_TIMING_PAL_CUSTOM_HDMI || timing == MACHINE_TIMING_PAL_CUSTOM_DPI) {
-    return mViceOptions.GetCyclesPerSecond();
+    return options.GetCyclesPerSecond();
   } else {
     return 982800;
   }
 }
 #elif defined(RASPI_PET)
-int ViceApp::circle_cycles_per_second() {
-  int timing = circle_get_machine_timing();
+int ViceApp::CyclesPerSecond(const ViceOptions &options) {
+  int timing = options.GetMachineTiming();
   if (timing == MACHINE_TIMING_NTSC_HDMI) {
     // 60hz
     return 1013760;
@@ -152,7 +152,7 @@ int ViceApp::circle_cycles_per_second() {
     // calculated. This keeps audio buffer to a minimum using ReSid.
     return 1014661;
   } else if (timing == MACHINE_TIMING_NTSC_CUSTOM_HDMI || timing == MACHINE_TIMING_NTSC_CUSTOM_DPI) {
-    return mViceOptions.GetCyclesPerSecond();
+    return options.GetCyclesPerSecond();
   } else if (timing == MACHINE_TIMING_PAL_HDMI) {
     // 50hz
     return 1001600;
@@ -162,7 +162,7 @@ int ViceApp::circle_cycles_per_second() {
     // calculated.  This keep audio buffer to a minimum using ReSid.
     return 1003202;
   } else if (timing == MACHINE_TIMING_PAL_CUSTOM_HDMI || timing == MACHINE_TIMING_PAL_CUSTOM_DPI) {
-    return mViceOptions.GetCyclesPerSecond();
+    return options.GetCyclesPerSecond();
   } else {
     return 1000000;
   }
@@ -171,6 +171,10 @@ int ViceApp::circle_cycles_per_second() {
   #error Unknown RASPI_ variant
 #endif
 
+int ViceApp::circle_cycles_per_second() {
+  return CyclesPerSecond(mViceOptions);
+}
+
 //
 // ViceScreenApp impl
 //
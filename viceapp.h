@@ -215,6 +215,10 @@ public:
   int circle_get_machine_timing();
   int circle_cycles_per_second();
 
+protected:
+  // The clock rate options asks for.
+  static int CyclesPerSecond(const ViceOptions &options);
+
 private:
   char const *FromKernel;
 
@@ -18,6 +18,7 @@
 #include <assert.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "defs.h"
 
@@ -25,44 +26,79 @@ extern "C" {
 #include "third_party/vice-3.3/src/main.h"
 #include "third_party/common/semaphore.h"
 
+#include "third_party/vice-3.3/src/sid/sid.h"
+#include "third_party/vice-3.3/src/drive/drive-async.h"
+#if defined(RASPI_C128)
+#include "third_party/vice-3.3/src/vdc/vdc-render.h"
+#endif
+
 extern void circle_kernel_core_init_complete(int core);
 }
 
-#include "third_party/vice-3.3/src/sid/sid.h"
 #include "third_party/vice-3.3/src/resid/sid.h"
 #include "third_party/vice-3.3/src/resid/filter.h"
 
+// Bump whenever the layout of the cached reSID tables changes.
+#define RESID_CACHE_VERSION 2
+#define RESID_CACHE_MAGIC 0x44495352 // 'RSID'
+
+#define RESID_CACHE_MAX_PARTS 40
+
+// The cache is written this much per frame so the SD card never holds
+// up the emulator for long.
+#define RESID_CACHE_CHUNK (16 * 1024)
+
+typedef struct resid_cache_header {
+  int magic;
+  int version;
+  int cyclesPerSecond;
+  int sampleRate;
+  int passBandFreq;
+  // The number of tables that follow and a hash of their sizes, so a
+  // cache from a build that lays them out differently is never read.
+  int numParts;
+  unsigned int layout;
+} resid_cache_header_t;
+
+// The cache being written out in the background. See ResidCacheStep.
+static struct {
+  FILE *fp;
+  char path[64];
+  char tmp_path[68];
+  reSID::table_part_t parts[RESID_CACHE_MAX_PARTS];
+  int numParts;
+  int part;
+  int pos;
+} resid_save;
+
+// Lists every table in the order they are cached. Returns the number
+// of tables or -1.
+static int GetResidTables(reSID::table_part_t *parts) {
+  int n = reSID::Filter::GetModelTables(parts, RESID_CACHE_MAX_PARTS - 2);
+  if (n < 0 ||
+      !reSID::SID::GetSamplingTable(reSID::SAMPLE_RESAMPLE, &parts[n]) ||
+      !reSID::SID::GetSamplingTable(reSID::SAMPLE_RESAMPLE_FASTMEM,
+                                    &parts[n + 1])) {
+    return -1;
+  }
+  return n + 2;
+}
+
+static unsigned int GetResidLayout(reSID::table_part_t *parts, int n) {
+  unsigned int h = 2166136261u;
+  for (int i = 0; i < n; i++) {
+    h = (h ^ (unsigned int)parts[i].size) * 16777619u;
+  }
+  return h;
+}
+
 ViceEmulatorCore::ViceEmulatorCore(CMemorySystem *pMemorySystem,
                                    int cyclesPerSecond) :
 #ifdef ARM_ALLOW_MULTI_CORE
        CMultiCoreSupport(pMemorySystem),
 #endif
-       launch_(false), cyclesPerSecond_(cyclesPerSecond) {
-
-  // These calls only allocate the sampling table. Population is
-  // done by cores 1 and 2 in parellel below.
-#ifdef ARM_ALLOW_MULTI_CORE
-
-  passBandFreq_ = 19845; // 90%
-  //unsigned clock = circle_get_arm_clock();
-  //if (clock < 1400000000) {
-     // For Pi3 models with a lower clock rate (<= 1.2Ghz)
-     // we must lower the passband freq to avoid stuttering
-     // in the worst case.  This logic must match the passband
-     // percentage we set in menu.c in common dir.
-     passBandFreq_ = 13230; // 60%
-  //}
-
-  reSID::SID::ComputeSamplingTable(cyclesPerSecond_,
-                                   reSID::SAMPLE_RESAMPLE,
-                                   SAMPLE_RATE, passBandFreq_, 0.97,
-                                   0);
-  reSID::SID::ComputeSamplingTable(cyclesPerSecond_,
-                                   reSID::SAMPLE_RESAMPLE_FASTMEM,
-                                   SAMPLE_RATE, passBandFreq_, 0.97,
-                                   0);
-#endif
-}
+       launch_(false), cyclesPerSecond_(cyclesPerSecond),
+       tableState_(TABLES_COMPUTE), numHelpersIdle_(0) {}
 
 ViceEmulatorCore::~ViceEmulatorCore(void) {}
 
@@ -78,6 +114,41 @@ void ViceEmulatorCore::RunMainVice(bool wait) {
      }
   }
 
+#ifdef ARM_ALLOW_MULTI_CORE
+  // Cores 2 and 3 started computing the reSID tables as soon as they came
+  // up. The SD card is mounted by now. If a cache for these parameters is
+  // present, stop them at their next step and restore the tables from it.
+  // Without one, nothing waits here; the cache is written once both cores
+  // are done (see HelperCoresComplete).
+  if (ResidCachePresent()) {
+     m_Lock.Acquire();
+     tableState_ = TABLES_LOADING;
+     m_Lock.Release();
+
+     bool waiting = true;
+     while (waiting) {
+       m_Lock.Acquire();
+       if (numHelpersIdle_ == 2)
+         waiting = false;
+       m_Lock.Release();
+     }
+
+     bool loaded = LoadResidCache();
+     if (!loaded) {
+        // A short read may have overwritten some of the tables.
+        for (int part = 0; part < 2; part++) {
+           for (int step = 0; step < 3; step++) {
+              ComputeResidStep(part, step);
+           }
+        }
+     }
+
+     m_Lock.Acquire();
+     tableState_ = loaded ? TABLES_LOADED : TABLES_COMPUTE;
+     m_Lock.Release();
+  }
+#endif
+
   // Call Vice's main_program
 
   // Use -soundsync 0 option for 'flexible'
@@ -145,6 +216,219 @@ void ViceEmulatorCore::RunMainVice(bool wait) {
   emu_exit();
 }
 
+void ViceEmulatorCore::GetResidCachePath(char *path, int len) {
+  snprintf(path, len, "/resid_%d_%d_%d.bin", cyclesPerSecond_,
+           SAMPLE_RATE, passBandFreq_);
+}
+
+// Reads the cache header and checks it was written for our parameters.
+bool ViceEmulatorCore::ReadResidCacheHeader(FILE *fp,
+                                            resid_cache_header_t *header) {
+  return fread(header, sizeof(*header), 1, fp) == 1 &&
+         header->magic == RESID_CACHE_MAGIC &&
+         header->version == RESID_CACHE_VERSION &&
+         header->cyclesPerSecond == cyclesPerSecond_ &&
+         header->sampleRate == SAMPLE_RATE &&
+         header->passBandFreq == passBandFreq_;
+}
+
+bool ViceEmulatorCore::ResidCachePresent() {
+  char path[64];
+  GetResidCachePath(path, sizeof(path));
+
+  FILE *fp = fopen(path, "r");
+  if (fp == NULL) {
+    return false;
+  }
+  resid_cache_header_t header;
+  bool ok = ReadResidCacheHeader(fp, &header);
+  fclose(fp);
+  return ok;
+}
+
+// Restores the reSID filter model tables and both resampling tables from
+// the SD card. Only once cores 2 and 3 are idle. Returns false if the
+// cache is unreadable or short, in which case the tables must be
+// computed.
+bool ViceEmulatorCore::LoadResidCache() {
+  char path[64];
+  GetResidCachePath(path, sizeof(path));
+
+  reSID::table_part_t parts[RESID_CACHE_MAX_PARTS];
+  int n = GetResidTables(parts);
+  if (n < 0) {
+    return false;
+  }
+
+  FILE *fp = fopen(path, "r");
+  if (fp == NULL) {
+    return false;
+  }
+
+  resid_cache_header_t header;
+  bool ok = ReadResidCacheHeader(fp, &header) &&
+            header.numParts == n &&
+            header.layout == GetResidLayout(parts, n);
+  for (int i = 0; ok && i < n; i++) {
+    ok = fread(parts[i].data, parts[i].size, 1, fp) == 1;
+  }
+  fclose(fp);
+
+  if (!ok) {
+    printf("Ignoring stale reSID cache %s\n", path);
+    return false;
+  }
+  reSID::Filter::SetModelTablesComputed();
+  return true;
+}
+
+// Starts writing the cache. The header goes out now, the tables a chunk
+// per frame from ResidCacheStep. They are written under a temporary
+// name so a cut in power never leaves a short cache behind.
+void ViceEmulatorCore::SaveResidCache() {
+  CancelResidCacheSave();
+
+  int n = GetResidTables(resid_save.parts);
+  if (n < 0 || !reSID::Filter::ModelTablesComputed()) {
+    return;
+  }
+
+  GetResidCachePath(resid_save.path, sizeof(resid_save.path));
+  snprintf(resid_save.tmp_path, sizeof(resid_save.tmp_path), "%s.tmp",
+           resid_save.path);
+
+  resid_save.fp = fopen(resid_save.tmp_path, "w");
+  if (resid_save.fp == NULL) {
+    printf("Can't write reSID cache %s\n", resid_save.tmp_path);
+    return;
+  }
+
+  resid_cache_header_t header;
+  header.magic = RESID_CACHE_MAGIC;
+  header.version = RESID_CACHE_VERSION;
+  header.cyclesPerSecond = cyclesPerSecond_;
+  header.sampleRate = SAMPLE_RATE;
+  header.passBandFreq = passBandFreq_;
+  header.numParts = n;
+  header.layout = GetResidLayout(resid_save.parts, n);
+
+  resid_save.numParts = n;
+  resid_save.part = 0;
+  resid_save.pos = 0;
+  if (fwrite(&header, sizeof(header), 1, resid_save.fp) != 1) {
+    printf("Failed writing reSID cache %s\n", resid_save.tmp_path);
+    CancelResidCacheSave();
+  }
+}
+
+// Drops a cache that is still being written, e.g. because the tables
+// are about to change under it.
+void ViceEmulatorCore::CancelResidCacheSave() {
+  if (resid_save.fp == NULL) {
+    return;
+  }
+  fclose(resid_save.fp);
+  resid_save.fp = NULL;
+  unlink(resid_save.tmp_path);
+}
+
+// Writes the next chunk of the cache. Once all of it is out, the cache
+// replaces any old one.
+void ViceEmulatorCore::ResidCacheStep() {
+  if (resid_save.fp == NULL) {
+    return;
+  }
+
+  int left = RESID_CACHE_CHUNK;
+  while (left > 0 && resid_save.part < resid_save.numParts) {
+    reSID::table_part_t &part = resid_save.parts[resid_save.part];
+    int n = part.size - resid_save.pos;
+    if (n > left) {
+      n = left;
+    }
+    if (fwrite((char *)part.data + resid_save.pos, n, 1,
+               resid_save.fp) != 1) {
+      printf("Failed writing reSID cache %s\n", resid_save.tmp_path);
+      CancelResidCacheSave();
+      return;
+    }
+    left -= n;
+    resid_save.pos += n;
+    if (resid_save.pos == part.size) {
+      resid_save.part++;
+      resid_save.pos = 0;
+    }
+  }
+
+  if (resid_save.part < resid_save.numParts) {
+    return;
+  }
+
+  bool ok = fclose(resid_save.fp) == 0;
+  resid_save.fp = NULL;
+  unlink(resid_save.path);
+  if (!ok || rename(resid_save.tmp_path, resid_save.path) != 0) {
+    printf("Failed writing reSID cache %s\n", resid_save.path);
+    unlink(resid_save.tmp_path);
+  }
+}
+
+// Called on core 1 from the emulation loop once cores 2 and 3 are done.
+// Starts writing the cache if the tables were computed this boot. This
+// happens once per configuration.
+void ViceEmulatorCore::HelperCoresComplete() {
+#ifdef ARM_ALLOW_MULTI_CORE
+  m_Lock.Acquire();
+  bool computed = tableState_ == TABLES_COMPUTE;
+  m_Lock.Release();
+  if (computed) {
+    SaveResidCache();
+  }
+#endif
+}
+
+void ViceEmulatorCore::BackgroundStep() {
+#ifdef ARM_ALLOW_MULTI_CORE
+  ResidCacheStep();
+#endif
+}
+
+// A machine switch changed the timing without a reboot. The resampling
+// tables are sized and filled for the clock, so replace them before VICE
+// re-times the machine, from the cache if there is one for this clock.
+// Cores 2 and 3 are done with the tables by now; they are computed here.
+void ViceEmulatorCore::SetCyclesPerSecond(int cyclesPerSecond) {
+  if (cyclesPerSecond == cyclesPerSecond_) {
+    return;
+  }
+  cyclesPerSecond_ = cyclesPerSecond;
+
+#ifdef ARM_ALLOW_MULTI_CORE
+  // A cache still being written holds the old tables.
+  CancelResidCacheSave();
+
+  reSID::SID::ComputeSamplingTable(cyclesPerSecond_,
+                                   reSID::SAMPLE_RESAMPLE,
+                                   SAMPLE_RATE, passBandFreq_, 0.97,
+                                   0);
+  reSID::SID::ComputeSamplingTable(cyclesPerSecond_,
+                                   reSID::SAMPLE_RESAMPLE_FASTMEM,
+                                   SAMPLE_RATE, passBandFreq_, 0.97,
+                                   0);
+
+  bool present = ResidCachePresent();
+  if (!present || !LoadResidCache()) {
+    // A short read may have overwritten the filter tables too.
+    for (int part = 0; part < 2; part++) {
+      for (int step = present ? 0 : 1; step < 3; step++) {
+        ComputeResidStep(part, step);
+      }
+    }
+    SaveResidCache();
+  }
+#endif
+}
+
 // Initializing the filters for each SID model takes quite a bit.
 // This method instantiates a modified Filter object in ReSid.  The
 // modified version lets us initialize both SIDs in parallel on seperate
@@ -154,6 +438,56 @@ void ViceEmulatorCore::RunMainVice(bool wait) {
 // modifications done for BMC64.
 void ViceEmulatorCore::ComputeResidFilter(int model) { reSID::Filter f(model); }
 
+// One step of a helper core's share of the tables: the filter for SID
+// model 'part', then partition part + 1 of each resampling table.
+void ViceEmulatorCore::ComputeResidStep(int part, int step) {
+  switch (step) {
+  case 0:
+    ComputeResidFilter(part);
+    break;
+  case 1:
+    reSID::SID::ComputeSamplingTable(cyclesPerSecond_,
+                                     reSID::SAMPLE_RESAMPLE,
+                                     SAMPLE_RATE, passBandFreq_, 0.97,
+                                     part + 1);
+    break;
+  case 2:
+    reSID::SID::ComputeSamplingTable(cyclesPerSecond_,
+                                     reSID::SAMPLE_RESAMPLE_FASTMEM,
+                                     SAMPLE_RATE, passBandFreq_, 0.97,
+                                     part + 1);
+    break;
+  }
+}
+
+// Runs on cores 2 and 3 from the moment they start. Stops between steps
+// if core 1 found a cache, and doesn't return while core 1 is still
+// restoring the tables from it.
+void ViceEmulatorCore::ComputeResidTables(int part) {
+  for (int step = 0; step < 3; step++) {
+    m_Lock.Acquire();
+    bool compute = tableState_ == TABLES_COMPUTE;
+    m_Lock.Release();
+    if (!compute) {
+      break;
+    }
+    ComputeResidStep(part, step);
+  }
+
+  m_Lock.Acquire();
+  numHelpersIdle_++;
+  m_Lock.Release();
+
+  while (true) {
+    m_Lock.Acquire();
+    TableState state = tableState_;
+    m_Lock.Release();
+    if (state != TABLES_LOADING) {
+      break;
+    }
+  }
+}
+
 // In addition to initializing the filters in parellel during boot, we
 // compute the resampling tables for the two resampling methods.
 void ViceEmulatorCore::Run(unsigned nCore) {
@@ -164,48 +498,58 @@ void ViceEmulatorCore::Run(unsigned nCore) {
     break;
   case 2:
     // Core 2 will initialize 6581 filter data. Then partition 1
-    // of the resampling tables. Then sleep.
+    // of the resampling tables unless they are restored from the cache.
 #ifdef ARM_ALLOW_MULTI_CORE
-    ComputeResidFilter(0);
-    reSID::SID::ComputeSamplingTable(cyclesPerSecond_,
-                                     reSID::SAMPLE_RESAMPLE,
-                                     SAMPLE_RATE, passBandFreq_, 0.97,
-                                     1);
-    reSID::SID::ComputeSamplingTable(cyclesPerSecond_,
-                                     reSID::SAMPLE_RESAMPLE_FASTMEM,
-                                     SAMPLE_RATE, passBandFreq_, 0.97,
-                                     1);
+    ComputeResidTables(0);
     circle_kernel_core_init_complete(2);
 #endif
     break;
   case 3:
     // Core 3 will initialize 8580 filter data. Then partition 2
-    // of the resampling tables. Then sleep.
+    // of the resampling tables unless they are restored from the cache.
 #ifdef ARM_ALLOW_MULTI_CORE
-    ComputeResidFilter(1);
-    reSID::SID::ComputeSamplingTable(cyclesPerSecond_,
-                                     reSID::SAMPLE_RESAMPLE,
-                                     SAMPLE_RATE, passBandFreq_, 0.97,
-                                     2);
-    reSID::SID::ComputeSamplingTable(cyclesPerSecond_,
-                                     reSID::SAMPLE_RESAMPLE_FASTMEM,
-                                     SAMPLE_RATE, passBandFreq_, 0.97,
-                                     2);
+    ComputeResidTables(1);
     circle_kernel_core_init_complete(3);
 #endif
     break;
   }
 
+#ifdef ARM_ALLOW_MULTI_CORE
+  // Cores 2 and 3 now serve SID sample calculation jobs handed out by
+  // sid_sound_machine_calculate_samples for multi-SID configurations.
   if (nCore == 2) {
-     while (true) {
-        sem_dec(&sid_job);
-        sid_job_func(sid_job_psid, sid_job_pbuf, sid_job_nr,
-                     2, &sid_job_delta_t);
-        sem_inc(&sid_done);
+#if defined(RASPI_C128) && defined(VDC_RENDER_ASYNC)
+     // On the C128, core 2 also draws the VDC raster (see
+     // vdc/vdc-render.h).
+     for (;;) {
+        int busy = sid_job_poll(nCore);
+        busy |= vdc_render_step();
+        if (!busy) {
+           asm volatile("wfe");
+        }
      }
+#else
+     sid_job_worker(nCore);
+#endif
+  }
+
+  if (nCore == 3) {
+#ifdef DRIVE_ASYNC
+     // Core 3 also runs the true drive CPUs when the DriveAsync resource
+     // is on (see drive/drive-async.h). Both kinds of work are polled and
+     // the core sleeps until the next event when there is neither.
+     for (;;) {
+        int busy = sid_job_poll(nCore);
+        busy |= drive_async_step();
+        if (!busy) {
+           asm volatile("wfe");
+        }
+     }
+#else
+     sid_job_worker(nCore);
+#endif
   }
 
-#ifdef ARM_ALLOW_MULTI_CORE
   printf("Core %d idle\n", nCore);
   asm("dsb\n\t"
       "1: wfi\n\t"
@@ -215,6 +559,32 @@ void ViceEmulatorCore::Run(unsigned nCore) {
 
 bool ViceEmulatorCore::Init(ViceOptions* options) {
   m_options = options;
+
+  // These calls only allocate the sampling table. Population is
+  // done by cores 2 and 3 in parallel once Initialize() starts them.
+#ifdef ARM_ALLOW_MULTI_CORE
+  passBandFreq_ = 19845; // 90%
+  //unsigned clock = circle_get_arm_clock();
+  //if (clock < 1400000000) {
+     // For Pi3 models with a lower clock rate (<= 1.2Ghz)
+     // we must lower the passband freq to avoid stuttering
+     // in the worst case.  This logic must match the passband
+     // percentage we set in vice_api.c in the raspi arch dir.
+     // The NEON FIR (resid/convolve.h) has not been measured on
+     // a Pi yet, so this stays at 60% for every model.
+     passBandFreq_ = 13230; // 60%
+  //}
+
+  reSID::SID::ComputeSamplingTable(cyclesPerSecond_,
+                                   reSID::SAMPLE_RESAMPLE,
+                                   SAMPLE_RATE, passBandFreq_, 0.97,
+                                   0);
+  reSID::SID::ComputeSamplingTable(cyclesPerSecond_,
+                                   reSID::SAMPLE_RESAMPLE_FASTMEM,
+                                   SAMPLE_RATE, passBandFreq_, 0.97,
+                                   0);
+#endif
+
   return Initialize();
 }
 
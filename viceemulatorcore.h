@@ -16,6 +16,8 @@
 #ifndef viceemualtorcore_h
 #define viceemulatorcore_h
 
+#include <stdio.h>
+
 #include <circle/memory.h>
 #include <circle/multicore.h>
 #include <circle/spinlock.h>
@@ -25,6 +27,8 @@ extern "C" {
 #include "third_party/common/circle.h"
 }
 
+struct resid_cache_header;
+
 class ViceEmulatorCore
  : public EmulatorCore
 #ifdef ARM_ALLOW_MULTI_CORE
@@ -47,17 +51,37 @@ public:
 
   bool Init(ViceOptions* options) override;
   void LaunchEmulator(char *timing_option) override;
+  void HelperCoresComplete() override;
+  void BackgroundStep() override;
+  void SetCyclesPerSecond(int cyclesPerSecond) override;
 
 private:
+  enum TableState {
+    TABLES_COMPUTE,
+    TABLES_LOADING,
+    TABLES_LOADED,
+  };
+
   bool launch_;
   int cyclesPerSecond_;
   int passBandFreq_;
   char timing_option_[8];
   CSpinLock m_Lock;
   ViceOptions *m_options;
+  TableState tableState_;
+  int numHelpersIdle_;
 
   void RunMainVice(bool wait);
   void ComputeResidFilter(int model);
+  void ComputeResidStep(int part, int step);
+  void ComputeResidTables(int part);
+  void GetResidCachePath(char *path, int len);
+  bool ReadResidCacheHeader(FILE *fp, struct resid_cache_header *header);
+  bool ResidCachePresent();
+  bool LoadResidCache();
+  void SaveResidCache();
+  void CancelResidCacheSave();
+  void ResidCacheStep();
 };
 
 #endif
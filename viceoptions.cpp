@@ -38,9 +38,13 @@ ViceOptions::ViceOptions(void)
       m_audioOut(VCHIQSoundDestinationAuto), m_bDPIEnabled(false),
       m_scaling_param_fbw{0,0}, m_scaling_param_fbh{0,0},
       m_scaling_param_sx{0,0}, m_scaling_param_sy{0,0},
-      m_raster_skip(false) {
+      m_raster_skip(false), m_cpu_palette(false) {
   s_pThis = this;
 
+  // Set the default volume we mount for fatfs
+  m_disk_partition = 0; // this tells fatfs 'auto'
+  strcpy(m_disk_volume, "SD");
+
   CBcmPropertyTags Tags;
   if (!Tags.GetTag(PROPTAG_GET_COMMAND_LINE, &m_TagCommandLine,
                    sizeof m_TagCommandLine)) {
@@ -53,11 +57,32 @@ ViceOptions::ViceOptions(void)
   m_TagCommandLine.String[m_TagCommandLine.Tag.nValueLength] = '\0';
 
   m_pOptions = (char *)m_TagCommandLine.String;
+  ParseOptions();
+}
 
-  // Set the default volume we mount for fatfs
-  m_disk_partition = 0; // this tells fatfs 'auto'
+// Parses a command line other than the one we booted with, such as a
+// cmdline.txt just written by a machine switch. Does not become the
+// instance Get() returns.
+ViceOptions::ViceOptions(const char *pCmdLine)
+    : m_nMachineTiming(MACHINE_TIMING_PAL_HDMI),
+      m_bDemoEnabled(false), m_bSerialEnabled(false),
+      m_bGPIOOutputsEnabled(false), m_nCyclesPerSecond(0),
+      m_audioOut(VCHIQSoundDestinationAuto), m_bDPIEnabled(false),
+      m_scaling_param_fbw{0,0}, m_scaling_param_fbh{0,0},
+      m_scaling_param_sx{0,0}, m_scaling_param_sy{0,0},
+      m_raster_skip(false), m_cpu_palette(false) {
+  m_disk_partition = 0;
   strcpy(m_disk_volume, "SD");
 
+  strncpy((char *)m_TagCommandLine.String, pCmdLine,
+          sizeof m_TagCommandLine.String - 1);
+  m_TagCommandLine.String[sizeof m_TagCommandLine.String - 1] = '\0';
+
+  m_pOptions = (char *)m_TagCommandLine.String;
+  ParseOptions();
+}
+
+void ViceOptions::ParseOptions(void) {
   char *pOption;
   while ((pOption = GetToken()) != 0) {
     char *pValue = GetOptionValue(pOption);
@@ -147,6 +172,12 @@ ViceOptions::ViceOptions(void)
       } else {
         m_raster_skip = false;
       }
+    } else if (strcmp(pOption, "cpu_palette") == 0) {
+      if (strcmp(pValue, "true") == 0 || strcmp(pValue, "1") == 0) {
+        m_cpu_palette = true;
+      } else {
+        m_cpu_palette = false;
+      }
     }
   }
 
@@ -179,10 +210,48 @@ ViceOptions::ViceOptions(void)
   }
 }
 
-ViceOptions::~ViceOptions(void) { s_pThis = 0; }
+ViceOptions::~ViceOptions(void) {
+  if (s_pThis == this) {
+    s_pThis = 0;
+  }
+}
+
+// True if everything in other but the machine timing, cycles per second,
+// audio out and scaling params matches. Those are all that can change
+// without a reboot.
+bool ViceOptions::SameBootOptions(const ViceOptions &other) const {
+  return m_bDemoEnabled == other.m_bDemoEnabled &&
+         m_bSerialEnabled == other.m_bSerialEnabled &&
+         m_bGPIOOutputsEnabled == other.m_bGPIOOutputsEnabled &&
+         m_disk_partition == other.m_disk_partition &&
+         strcmp(m_disk_volume, other.m_disk_volume) == 0 &&
+         m_bDPIEnabled == other.m_bDPIEnabled &&
+         m_raster_skip == other.m_raster_skip &&
+         m_cpu_palette == other.m_cpu_palette;
+}
+
+void ViceOptions::ApplyRuntimeOptions(const ViceOptions &other) {
+  m_nMachineTiming = other.m_nMachineTiming;
+  m_nCyclesPerSecond = other.m_nCyclesPerSecond;
+  m_audioOut = other.m_audioOut;
+  for (int i = 0; i < 2; i++) {
+    m_scaling_param_fbw[i] = other.m_scaling_param_fbw[i];
+    m_scaling_param_fbh[i] = other.m_scaling_param_fbh[i];
+    m_scaling_param_sx[i] = other.m_scaling_param_sx[i];
+    m_scaling_param_sy[i] = other.m_scaling_param_sy[i];
+  }
+}
 
 unsigned ViceOptions::GetMachineTiming(void) const { return m_nMachineTiming; }
 
+bool ViceOptions::IsNTSC(void) const {
+  return m_nMachineTiming == MACHINE_TIMING_NTSC_HDMI ||
+         m_nMachineTiming == MACHINE_TIMING_NTSC_CUSTOM_HDMI ||
+         m_nMachineTiming == MACHINE_TIMING_NTSC_COMPOSITE ||
+         m_nMachineTiming == MACHINE_TIMING_NTSC_DPI ||
+         m_nMachineTiming == MACHINE_TIMING_NTSC_CUSTOM_DPI;
+}
+
 bool ViceOptions::DemoEnabled(void) const { return m_bDemoEnabled; }
 
 bool ViceOptions::SerialEnabled(void) const { return m_bSerialEnabled; }
@@ -204,6 +273,8 @@ void ViceOptions::GetScalingParams(int display, int *fbw, int *fbh, int *sx, int
 
 bool ViceOptions::GetRasterSkip(void) const { return m_raster_skip; }
 
+bool ViceOptions::CpuPaletteEnabled(void) const { return m_cpu_palette; }
+
 const char *ViceOptions::GetDiskVolume(void) const { return m_disk_volume; }
 
 unsigned long ViceOptions::GetCyclesPerSecond(void) const {
@@ -25,9 +25,11 @@
 class ViceOptions {
 public:
   ViceOptions(void);
+  ViceOptions(const char *pCmdLine);
   ~ViceOptions(void);
 
   unsigned GetMachineTiming(void) const;
+  bool IsNTSC(void) const;
   bool DemoEnabled(void) const;
   bool SerialEnabled(void) const;
   bool GPIOOutputsEnabled(void) const;
@@ -38,10 +40,16 @@ public:
   bool DPIEnabled(void) const;
   void GetScalingParams(int display, int *fbw, int *fbh, int *sx, int *sy) const;
   bool GetRasterSkip(void) const;
+  bool CpuPaletteEnabled(void) const;
+
+  bool SameBootOptions(const ViceOptions &other) const;
+  void ApplyRuntimeOptions(const ViceOptions &other);
 
   static ViceOptions *Get(void);
 
 private:
+  void ParseOptions(void);
+
   char *
   GetToken(void); // returns next "option=value" pair, 0 if nothing follows
 
@@ -69,6 +77,7 @@ private:
   int m_scaling_param_sx[2];
   int m_scaling_param_sy[2];
   bool m_raster_skip;
+  bool m_cpu_palette;
 
   static ViceOptions *s_pThis;
 };
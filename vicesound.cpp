@@ -27,11 +27,13 @@ extern "C" {
 
 ViceSound::ViceSound(CVCHIQDevice *pVCHIQDevice,
                      TVCHIQSoundDestination Destination)
-    : ViceSoundBaseDevice(pVCHIQDevice, SAMPLE_RATE, CHUNK_SIZE, Destination) {
-  src_pos = 0;
-  src_size = 0;
-  src_buffer = 0;
+    : ViceSoundBaseDevice(pVCHIQDevice, SAMPLE_RATE, CHUNK_SIZE, Destination),
+      ring(RING_SIZE) {
   bytes_buffered = 0;
+  draining = 0;
+  num_channels = 1;
+  underruns = 0;
+  overruns = 0;
 }
 
 ViceSound::~ViceSound(void) {}
@@ -39,6 +41,7 @@ ViceSound::~ViceSound(void) {}
 boolean ViceSound::Playback(int volume, int channels) {
   assert(!IsActive());
   num_channels = channels;
+  ring.Reset();
   SetVolume(volume);
   SetChannels(channels);
   return Start();
@@ -52,57 +55,93 @@ void ViceSound::SetControl(int nVolume, TVCHIQSoundDestination Destination) {
   ViceSoundBaseDevice::SetControl(nVolume, Destination);
 }
 
+// Called from VICE on the emulation core. All we do here is copy the
+// samples into the ring. VC4 is fed from Drain, normally from the
+// completion callback. We only drain here ourselves if VC4 has nothing
+// queued, since no completion will arrive to do it for us in that case.
 unsigned ViceSound::AddChunk(s16 *pBuffer, unsigned nChunkSize) {
-  // nChunkSize is vice's sample count, not necessarily equal
-  // to VC4's chunk size.  Copy what we're given into our intermediate
-  // buffer and flush CHUNK_SIZE packets out of it for VC4.
-  src_pos = 0;
-  src_buffer = pBuffer;
+  bool waited = false;
 
   while (nChunkSize > 0) {
-    // This triggers the GetChunk call below. Yeild not required.
-    src_size = nChunkSize;
-    if (src_size > CHUNK_SIZE)
-      src_size = CHUNK_SIZE;
-
-    WriteChunk();
-    src_pos += src_size;
-    nChunkSize -= src_size;
+    unsigned n = ring.Write(pBuffer, nChunkSize);
+    pBuffer += n;
+    nChunkSize -= n;
+
+    if (nChunkSize > 0) {
+      // VICE expects us to 'block' if our buffer is full. But
+      // this shouldn't happen.
+      if (!waited) {
+        overruns++;
+        waited = true;
+      }
+      Drain();
+      CScheduler::Get()->Yield();
+    }
+  }
+
+  if (BytesInFlight() == 0) {
+    Drain();
   }
   return 0;
 }
 
+// Moves samples from the ring to VC4 until it holds our whole buffer
+// budget. Both the emulation core and the VCHIQ completion callback can
+// get here; only one of them drains at a time.
+void ViceSound::Drain(void) {
+  if (__sync_lock_test_and_set(&draining, 1)) {
+    return;
+  }
+
+  const unsigned max_bytes = FRAG_SIZE * NUM_FRAGS * BYTES_PER_SAMPLE;
+  while (ring.Available() > 0 && BytesInFlight() < max_bytes) {
+    if (WriteChunk() != 0) {
+      break;
+    }
+  }
+
+  __sync_lock_release(&draining);
+}
+
 unsigned ViceSound::GetChunk(s16 *pBuffer, unsigned nChunkSize) {
 
   assert(pBuffer != 0);
   assert(nChunkSize > 0);
   assert((nChunkSize & 1) == 0);
 
-  // VICE expects us to 'block' if our buffer is full. But
-  // this shouldn't happen.
-  while (bytes_buffered >= FRAG_SIZE * NUM_FRAGS * BYTES_PER_SAMPLE) {
-    CScheduler::Get()->Yield();
-  }
-
-  if (src_buffer == 0 || src_size == 0) {
-    // Nothing to give? Give a silent packet.
+  unsigned n = ring.Read(pBuffer, nChunkSize);
+  if (n == 0) {
+    // Nothing to give? Give a silent packet. Only happens when
+    // playback is started.
     memset(pBuffer, 0, FRAG_SIZE * BYTES_PER_SAMPLE);
-    src_size = FRAG_SIZE;
-  } else {
-    // We always give VC4 nChunkSize packets.
-    memcpy(pBuffer, src_buffer + src_pos, src_size * BYTES_PER_SAMPLE);
+    n = FRAG_SIZE;
   }
-  return src_size;
+  return n;
 }
 
 // Callback from VC to let us know how much is currently buffered.
 void ViceSound::AmountBufferedBytes(unsigned nBytes) {
   bytes_buffered = nBytes;
+  if (nBytes == 0 && ring.Available() == 0) {
+    underruns++;
+  }
+  Drain();
 }
 
 // Call from vice to ask us how much space is left in our buffer.
+// Both what waits in the ring and what VC4 has yet to play count.
 // Return value is in samples.
 unsigned ViceSound::BufferSpaceSamples() {
-  int left = FRAG_SIZE * NUM_FRAGS - bytes_buffered / BYTES_PER_SAMPLE / num_channels;
+  int used = (ring.Available() + BytesInFlight() / BYTES_PER_SAMPLE) /
+             num_channels;
+  int left = FRAG_SIZE * NUM_FRAGS - used;
   return left < 0 ? 0 : left;
 }
+
+void ViceSound::GetStats(unsigned *fill, unsigned *underrun_count,
+                         unsigned *overrun_count) {
+  *fill = (ring.Available() + BytesInFlight() / BYTES_PER_SAMPLE) /
+          num_channels;
+  *underrun_count = underruns;
+  *overrun_count = overruns;
+}
@@ -17,6 +17,7 @@
 #define _vice_sound_h
 
 #include "defs.h"
+#include "soundring.h"
 #include "vicesoundbasedevice.h"
 #include <circle/types.h>
 #include <vc4/vchiq/vchiqdevice.h>
@@ -38,6 +39,10 @@
 // 16 bit sound means this many bytes per sample.
 #define BYTES_PER_SAMPLE 2
 
+// Samples held between VICE and VC4. Big enough for the whole
+// FRAG_SIZE * NUM_FRAGS budget in stereo. Must be a power of two.
+#define RING_SIZE (FRAG_SIZE * NUM_FRAGS * 2)
+
 class ViceSound : private ViceSoundBaseDevice {
 public:
   /// \param pVCHIQDevice	pointer to the VCHIQ interface device
@@ -70,19 +75,27 @@ public:
   unsigned AddChunk(s16 *pBuffer, unsigned nChunkSize);
   unsigned BufferSpaceSamples();
 
+  /// \brief Audio telemetry
+  /// \param fill	samples per channel waiting in the ring and in VC4
+  /// \param underruns	times VC4 ran dry
+  /// \param overruns	times VICE had to wait for ring space
+  void GetStats(unsigned *fill, unsigned *underruns, unsigned *overruns);
+
 private:
   unsigned GetChunk(s16 *pBuffer, unsigned nChunkSize);
   void AmountBufferedBytes(unsigned);
+  void Drain(void);
 
   // Keep track of how many bytes we've sent to VC
   unsigned int bytes_buffered;
 
-  // Pointer to sample source while we draw from vice's buffer
-  s16 *src_buffer;
-  // Position within src_buffer we are drawing next chunk from
-  unsigned int src_pos;
-  unsigned int src_size;
+  // Samples handed over by vice but not yet queued to VC
+  SoundRing ring;
+  volatile int draining;
+
   unsigned int num_channels;
+  volatile unsigned int underruns;
+  volatile unsigned int overruns;
 };
 
 #endif // VICE_SOUND_H
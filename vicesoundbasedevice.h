@@ -112,6 +112,9 @@ protected:
   int WriteChunk(void);
   virtual void AmountBufferedBytes(unsigned) = 0;
 
+  /// \return Bytes queued to VC4 that have not been played yet
+  unsigned BytesInFlight(void) const { return m_nWritePos - m_nCompletePos; }
+
 private:
   void Callback(const VCHI_CALLBACK_REASON_T Reason, void *hMessage);
   static void CallbackStub(void *pParam, const VCHI_CALLBACK_REASON_T Reason,
@@ -130,8 +133,8 @@ private:
   CSynchronizationEvent m_Event;
   int m_nResult;
 
-  unsigned m_nWritePos;
-  unsigned m_nCompletePos;
+  volatile unsigned m_nWritePos;
+  volatile unsigned m_nCompletePos;
   s16 *p_buffer;
   int m_nVolume;
   int m_nChannels;